@@ -0,0 +1,201 @@
+/*
+**  Copyright (c) 2009-2017, The Trusted Domain Project.  All rights reserved.
+*/
+
+#include "build-config.h"
+
+/* system includes */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+/* libopenarc includes */
+#include "arc.h"
+
+/* allocation counts */
+struct counts
+{
+    pthread_mutex_t c_lock;
+    unsigned long   c_allocs;
+    unsigned long   c_frees;
+    long            c_outstanding;
+};
+
+/* a message with an ARC set that's missing its ARC-Message-Signature */
+static const char *broken_chain[] = {
+    "ARC-Seal: i=1; a=rsa-sha256; cv=none; d=example.com; s=elpmaxe;\r\n"
+    "\tt=1234567890; b=AAAA",
+    "ARC-Authentication-Results: i=1; example.com; spf=pass",
+    "From: user@example.com",
+    "Subject: alloc-test",
+    NULL,
+};
+
+/* a message with no chain */
+static const char *no_chain[] = {
+    "From: user@example.com",
+    "Subject: alloc-test",
+    NULL,
+};
+
+/*
+**  COUNT_MALLOC -- allocate memory and count it
+**
+**  Parameters:
+**  	closure -- allocation counts
+**  	nbytes -- bytes wanted
+**
+**  Return value:
+**  	Pointer to the new memory, or NULL.
+*/
+
+static void *
+count_malloc(void *closure, size_t nbytes)
+{
+    void          *p;
+    struct counts *c = closure;
+
+    p = malloc(nbytes);
+    if (p != NULL)
+    {
+        pthread_mutex_lock(&c->c_lock);
+        c->c_allocs++;
+        c->c_outstanding++;
+        pthread_mutex_unlock(&c->c_lock);
+    }
+
+    return p;
+}
+
+/*
+**  COUNT_FREE -- release memory and count it
+**
+**  Parameters:
+**  	closure -- allocation counts
+**  	ptr -- memory to release
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+count_free(void *closure, void *ptr)
+{
+    struct counts *c = closure;
+
+    if (ptr != NULL)
+    {
+        pthread_mutex_lock(&c->c_lock);
+        c->c_frees++;
+        c->c_outstanding--;
+        pthread_mutex_unlock(&c->c_lock);
+    }
+
+    free(ptr);
+}
+
+/*
+**  RUN_MESSAGE -- feed one message to a handle
+**
+**  Parameters:
+**  	msg -- message handle
+**  	hdrs -- NULL-terminated list of header fields
+**
+**  Return value:
+**  	The chain status, as a string, or NULL on error.
+*/
+
+static const char *
+run_message(ARC_MESSAGE *msg, const char **hdrs)
+{
+    static const char body[] = "test body\r\n";
+
+    for (int i = 0; hdrs[i] != NULL; i++)
+    {
+        if (arc_header_field(msg, hdrs[i], strlen(hdrs[i])) != ARC_STAT_OK)
+        {
+            return NULL;
+        }
+    }
+
+    if (arc_eoh(msg) != ARC_STAT_OK ||
+        arc_body(msg, (const unsigned char *) body, sizeof body - 1) !=
+            ARC_STAT_OK ||
+        arc_eom(msg) != ARC_STAT_OK)
+    {
+        return NULL;
+    }
+
+    return arc_chain_status_str(msg);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char   *err = NULL;
+    const char   *status1;
+    const char   *status2;
+    char         *p;
+    char         *progname;
+    ARC_LIB      *lib;
+    ARC_MESSAGE  *msg;
+    struct counts c;
+
+    progname = (p = strrchr(argv[0], '/')) == NULL ? argv[0] : p + 1;
+
+    if (argc != 1)
+    {
+        printf("%s: usage: %s\n", progname, progname);
+        return EX_USAGE;
+    }
+
+    memset(&c, '\0', sizeof c);
+    pthread_mutex_init(&c.c_lock, NULL);
+
+    lib = arc_init();
+    if (lib == NULL)
+    {
+        printf("%s: arc_init() failed\n", progname);
+        return EX_SOFTWARE;
+    }
+
+    if (arc_set_allocator(lib, count_malloc, count_free, &c) != ARC_STAT_OK)
+    {
+        printf("%s: arc_set_allocator() failed\n", progname);
+        return EX_SOFTWARE;
+    }
+
+    msg = arc_message(lib, ARC_CANON_RELAXED, ARC_CANON_RELAXED,
+                      ARC_SIGN_RSASHA256, ARC_MODE_VERIFY, &err);
+    if (msg == NULL)
+    {
+        printf("%s: arc_message() failed: %s\n", progname,
+               err == NULL ? "unknown error" : err);
+        return EX_SOFTWARE;
+    }
+
+    status1 = run_message(msg, broken_chain);
+
+    if (arc_message_reset(msg, ARC_CANON_RELAXED, ARC_CANON_RELAXED,
+                          ARC_SIGN_RSASHA256, ARC_MODE_VERIFY) != ARC_STAT_OK)
+    {
+        printf("%s: arc_message_reset() failed\n", progname);
+        return EX_SOFTWARE;
+    }
+
+    status2 = run_message(msg, no_chain);
+
+    printf("first message %s\n", status1 == NULL ? "error" : status1);
+    printf("second message %s\n", status2 == NULL ? "error" : status2);
+
+    arc_free(msg);
+    arc_close(lib);
+
+    printf("allocations %lu\n", c.c_allocs);
+    printf("frees %lu\n", c.c_frees);
+    printf("outstanding %ld\n", c.c_outstanding);
+
+    return EX_OK;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#include "build-config.h"
+
+/* system includes */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+/* libopenarc includes */
+#include "arc-arena.h"
+#include "arc-malloc.h"
+#include "arc-types.h"
+
+/* alignment of everything handed out; enough for any type we store */
+#define ARC_ARENA_ALIGN 16
+#define ARC_ARENA_ROUND(x) \
+    (((x) + ARC_ARENA_ALIGN - 1) & ~((size_t) ARC_ARENA_ALIGN - 1))
+
+/* chunk sizes, including the chunk header */
+#define ARC_ARENA_MINCHUNK 8192
+#define ARC_ARENA_MAXCHUNK 65536
+
+/* struct arc_arena -- one chunk of a message's arena */
+struct arc_arena
+{
+    size_t            ac_size; /* usable bytes after the header */
+    size_t            ac_used;
+    struct arc_arena *ac_next;
+};
+
+#define ARC_ARENA_HDRSIZE ARC_ARENA_ROUND(sizeof(struct arc_arena))
+
+/*
+**  ARC_LIB_MALLOC -- allocate memory using the library's allocator
+**
+**  Parameters:
+**  	lib -- library handle
+**  	size -- bytes wanted
+**
+**  Return value:
+**  	Pointer to the memory, or NULL on failure.
+*/
+
+void *
+arc_lib_malloc(ARC_LIB *lib, size_t size)
+{
+    assert(lib != NULL);
+
+    if (lib->arcl_malloc != NULL)
+    {
+        return lib->arcl_malloc(lib->arcl_memclosure, size);
+    }
+
+    return ARC_MALLOC(size);
+}
+
+/*
+**  ARC_LIB_FREE -- release memory obtained from arc_lib_malloc()
+**
+**  Parameters:
+**  	lib -- library handle
+**  	ptr -- memory to release (may be NULL)
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_lib_free(ARC_LIB *lib, void *ptr)
+{
+    assert(lib != NULL);
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    if (lib->arcl_free != NULL)
+    {
+        lib->arcl_free(lib->arcl_memclosure, ptr);
+    }
+    else
+    {
+        ARC_FREE(ptr);
+    }
+}
+
+/*
+**  ARC_ARENA_ALLOC -- allocate memory that lives as long as a message
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	size -- bytes wanted
+**
+**  Return value:
+**  	Pointer to uninitialized memory, or NULL on failure.
+**
+**  Notes:
+**  	Memory from the arena can't be released individually; all of it
+**  	goes at once when arc_free() calls arc_arena_free().
+*/
+
+void *
+arc_arena_alloc(ARC_MESSAGE *msg, size_t size)
+{
+    size_t             chunksize;
+    struct arc_arena  *ac;
+    struct arc_arena **pac;
+    char              *p;
+
+    assert(msg != NULL);
+
+    size = ARC_ARENA_ROUND(MAX(size, 1));
+
+    ac = msg->arc_arena;
+    if (ac != NULL && ac->ac_size - ac->ac_used >= size)
+    {
+        p = (char *) ac + ARC_ARENA_HDRSIZE + ac->ac_used;
+        ac->ac_used += size;
+        return p;
+    }
+
+    /* take a chunk left over from an earlier message if one fits */
+    for (pac = &msg->arc_arenaspare; *pac != NULL; pac = &(*pac)->ac_next)
+    {
+        if ((*pac)->ac_size >= size)
+        {
+            break;
+        }
+    }
+
+    if (*pac != NULL)
+    {
+        ac = *pac;
+        *pac = ac->ac_next;
+        chunksize = ac->ac_size;
+    }
+    else
+    {
+        /* grow geometrically so long chains don't need lots of chunks */
+        chunksize = ARC_ARENA_MINCHUNK;
+        if (ac != NULL)
+        {
+            chunksize = MIN((ac->ac_size + ARC_ARENA_HDRSIZE) * 2,
+                            ARC_ARENA_MAXCHUNK);
+        }
+        chunksize = MAX(chunksize - ARC_ARENA_HDRSIZE, size);
+
+        ac = arc_lib_malloc(msg->arc_library, ARC_ARENA_HDRSIZE + chunksize);
+        if (ac == NULL)
+        {
+            arc_error(msg, "unable to allocate %d byte(s)", size);
+            return NULL;
+        }
+    }
+
+    ac->ac_size = chunksize;
+    ac->ac_used = size;
+
+    /*
+    **  An oversized request gets a chunk of its own; keep allocating
+    **  from the current chunk if it has more room left.
+    */
+
+    if (msg->arc_arena != NULL && chunksize == size &&
+        msg->arc_arena->ac_size - msg->arc_arena->ac_used > 0)
+    {
+        ac->ac_next = msg->arc_arena->ac_next;
+        msg->arc_arena->ac_next = ac;
+    }
+    else
+    {
+        ac->ac_next = msg->arc_arena;
+        msg->arc_arena = ac;
+    }
+
+    return (char *) ac + ARC_ARENA_HDRSIZE;
+}
+
+/*
+**  ARC_ARENA_CALLOC -- allocate cleared memory from a message's arena
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	nmemb -- number of elements
+**  	size -- size of each element
+**
+**  Return value:
+**  	Pointer to zeroed memory, or NULL on failure.
+*/
+
+void *
+arc_arena_calloc(ARC_MESSAGE *msg, size_t nmemb, size_t size)
+{
+    void *p;
+
+    assert(msg != NULL);
+
+    if (size != 0 && nmemb > SIZE_MAX / size)
+    {
+        arc_error(msg, "unable to allocate %u elements of %u byte(s)", nmemb,
+                  size);
+        return NULL;
+    }
+
+    p = arc_arena_alloc(msg, nmemb * size);
+    if (p != NULL)
+    {
+        memset(p, '\0', nmemb * size);
+    }
+
+    return p;
+}
+
+/*
+**  ARC_ARENA_RESET -- empty a message's arena but keep its chunks
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Everything allocated from the arena is invalidated.  Chunks of the
+**  	usual sizes are kept for arc_arena_alloc() to hand out again;
+**  	oversized ones are released so one large message doesn't pin its
+**  	memory for the life of the handle.
+*/
+
+void
+arc_arena_reset(ARC_MESSAGE *msg)
+{
+    struct arc_arena *ac;
+
+    assert(msg != NULL);
+
+    while (msg->arc_arena != NULL)
+    {
+        ac = msg->arc_arena;
+        msg->arc_arena = ac->ac_next;
+
+        if (ac->ac_size + ARC_ARENA_HDRSIZE > ARC_ARENA_MAXCHUNK)
+        {
+            arc_lib_free(msg->arc_library, ac);
+            continue;
+        }
+
+        ac->ac_used = 0;
+        ac->ac_next = msg->arc_arenaspare;
+        msg->arc_arenaspare = ac;
+    }
+}
+
+/*
+**  ARC_ARENA_FREE -- release everything allocated from a message's arena
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_arena_free(ARC_MESSAGE *msg)
+{
+    struct arc_arena *ac;
+
+    assert(msg != NULL);
+
+    while (msg->arc_arena != NULL)
+    {
+        ac = msg->arc_arena;
+        msg->arc_arena = ac->ac_next;
+        arc_lib_free(msg->arc_library, ac);
+    }
+
+    while (msg->arc_arenaspare != NULL)
+    {
+        ac = msg->arc_arenaspare;
+        msg->arc_arenaspare = ac->ac_next;
+        arc_lib_free(msg->arc_library, ac);
+    }
+}
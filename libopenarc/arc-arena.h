@@ -0,0 +1,26 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#ifndef ARC_ARC_ARENA_H_
+#define ARC_ARC_ARENA_H_
+
+/* system includes */
+#include <sys/types.h>
+
+/* libopenarc includes */
+#include "arc.h"
+
+/* opaque arena chunk */
+struct arc_arena;
+
+/* prototypes */
+extern void *arc_lib_malloc(ARC_LIB *, size_t);
+extern void  arc_lib_free(ARC_LIB *, void *);
+extern void *arc_arena_alloc(ARC_MESSAGE *, size_t);
+extern void *arc_arena_calloc(ARC_MESSAGE *, size_t, size_t);
+extern void  arc_arena_reset(ARC_MESSAGE *);
+extern void  arc_arena_free(ARC_MESSAGE *);
+
+#endif /* ! ARC_ARC_ARENA_H_ */
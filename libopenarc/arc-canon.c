@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 /* libopenarc includes */
+#include "arc-arena.h"
 #include "arc-canon.h"
 #include "arc-internal.h"
 #include "arc-tables.h"
@@ -43,12 +44,28 @@
 #endif /* USE_STRL_H */
 
 /* definitions */
-#define CRLF          "\r\n"
-#define SP            " "
+#define CRLF             "\r\n"
+#define SP               " "
+#define ARC_SEAL_NHASHES (ARC_HASHTYPE_SHA256 + 1)
 
 /* macros */
-#define ARC_ISWSP(x)  ((x) == 011 || (x) == 040)
-#define ARC_ISLWSP(x) ((x) == 011 || (x) == 012 || (x) == 015 || (x) == 040)
+#define ARC_ISWSP(x)     ((x) == 011 || (x) == 040)
+#define ARC_ISLWSP(x)    ((x) == 011 || (x) == 012 || (x) == 015 || (x) == 040)
+
+/* character classes for relaxed header canonicalization */
+#define ARC_HDRCHAR_LWSP    0x01 /* SP, HT, CR or LF */
+#define ARC_HDRCHAR_SPACE   0x02 /* isspace() */
+#define ARC_HDRCHAR_WORDEND 0x04 /* ends a run of non-space: space or NUL */
+
+static const unsigned char arc_hdrchars[256] = {
+    ['\0'] = ARC_HDRCHAR_WORDEND,
+    ['\t'] = ARC_HDRCHAR_LWSP | ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+    ['\n'] = ARC_HDRCHAR_LWSP | ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+    ['\v'] = ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+    ['\f'] = ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+    ['\r'] = ARC_HDRCHAR_LWSP | ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+    [' ']  = ARC_HDRCHAR_LWSP | ARC_HDRCHAR_SPACE | ARC_HDRCHAR_WORDEND,
+};
 
 /* prototypes */
 extern void arc_error(ARC_MESSAGE *, const char *, ...);
@@ -83,16 +100,67 @@ arc_canon_free(ARC_MESSAGE *msg, ARC_CANON *canon)
         EVP_MD_CTX_free(canon->canon_hash->hash_ctx);
 #endif /* OpenSSL < 1.1.0 */
         BIO_free(canon->canon_hash->hash_tmpbio);
-        ARC_FREE(canon->canon_hash);
     }
 
-    ARC_FREE(canon->canon_hashbuf);
+    /* the handle and its buffers belong to the message's arena */
     arc_dstring_free(canon->canon_buf);
-    ARC_FREE(canon);
 }
 
 /*
-**  ARC_CANON_WRITE -- write data to canonicalization stream(s)
+**  ARC_CANON_RECYCLE -- keep a canonicalization's hash state for reuse
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	canon -- canonicalization being discarded
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	The digest context and line buffer go to the message's spare list,
+**  	where arc_canon_init() finds them after arc_message_reset().
+**  	Anything that can't be kept is released.
+*/
+
+static void
+arc_canon_recycle(ARC_MESSAGE *msg, ARC_CANON *canon)
+{
+    struct arc_spare *new;
+
+    assert(msg != NULL);
+    assert(canon != NULL);
+
+    if (canon->canon_hash == NULL || canon->canon_hash->hash_ctx == NULL ||
+        canon->canon_buf == NULL)
+    {
+        arc_canon_free(msg, canon);
+        return;
+    }
+
+    if (msg->arc_ncanonspares == msg->arc_maxcanonspares)
+    {
+        unsigned int n;
+
+        n = MAX(msg->arc_maxcanonspares * 2, 8);
+        new = ARC_REALLOC(msg->arc_canonspares, n * sizeof *new);
+        if (new == NULL)
+        {
+            arc_canon_free(msg, canon);
+            return;
+        }
+        msg->arc_canonspares = new;
+        msg->arc_maxcanonspares = n;
+    }
+
+    BIO_free(canon->canon_hash->hash_tmpbio);
+
+    new = &msg->arc_canonspares[msg->arc_ncanonspares++];
+    new->sp_ctx = canon->canon_hash->hash_ctx;
+    new->sp_buf = canon->canon_buf;
+}
+
+/*
+**  ARC_CANON_HASH -- write data to a single canonicalization's hash
 **
 **  Parameters:
 **  	canon -- ARC_CANON handle
@@ -104,7 +172,7 @@ arc_canon_free(ARC_MESSAGE *msg, ARC_CANON *canon)
 */
 
 static void
-arc_canon_write(ARC_CANON *canon, const char *buf, size_t buflen)
+arc_canon_hash(ARC_CANON *canon, const char *buf, size_t buflen)
 {
     assert(canon != NULL);
 
@@ -134,6 +202,92 @@ arc_canon_write(ARC_CANON *canon, const char *buf, size_t buflen)
     }
 }
 
+/*
+**  ARC_CANON_WRITE -- write data to canonicalization stream(s)
+**
+**  Parameters:
+**  	canon -- ARC_CANON handle
+**  	buf -- buffer containing canonicalized data
+**  	buflen -- number of bytes to consume
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Body canonicalizations that differ only in hash or length limit
+**  	share one canonicalized stream; the data is fed to every hash on
+**  	the "canon_fanout" list that isn't finished yet.
+*/
+
+static void
+arc_canon_write(ARC_CANON *canon, const char *buf, size_t buflen)
+{
+    ARC_CANON *cur;
+
+    for (cur = canon; cur != NULL; cur = cur->canon_fanout)
+    {
+        if (cur->canon_type == ARC_CANONTYPE_BODY && cur->canon_done)
+        {
+            continue;
+        }
+
+        arc_canon_hash(cur, buf, buflen);
+    }
+}
+
+/*
+**  ARC_CANON_ACTIVE -- determine whether a body stream still has work to do
+**
+**  Parameters:
+**  	canon -- ARC_CANON handle
+**
+**  Return value:
+**  	true iff "canon" or any hash it feeds isn't finished.
+*/
+
+static bool
+arc_canon_active(ARC_CANON *canon)
+{
+    ARC_CANON *cur;
+
+    for (cur = canon; cur != NULL; cur = cur->canon_fanout)
+    {
+        if (!cur->canon_done)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+**  ARC_CANON_WANTED -- determine whether a body stream can still be hashed
+**
+**  Parameters:
+**  	canon -- ARC_CANON handle
+**
+**  Return value:
+**  	true iff "canon" or any hash it feeds isn't finished and hasn't
+**  	reached its length limit.
+*/
+
+static bool
+arc_canon_wanted(ARC_CANON *canon)
+{
+    ARC_CANON *cur;
+
+    for (cur = canon; cur != NULL; cur = cur->canon_fanout)
+    {
+        if (!cur->canon_done && cur->canon_remain != 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /*
 **  ARC_CANON_BUFFER -- buffer for arc_canon_write()
 **
@@ -186,6 +340,124 @@ arc_canon_buffer(ARC_CANON *canon, const char *buf, size_t buflen)
     }
 }
 
+/*
+**  ARC_CANON_RELAXED_BOUND -- upper bound on a relaxed header field's size
+**
+**  Parameters:
+**  	hdr -- header field input
+**  	hdrlen -- bytes to process at "hdr"
+**
+**  Return value:
+**  	Maximum number of bytes arc_canon_relaxed() will write for "hdr".
+*/
+
+static size_t
+arc_canon_relaxed_bound(const char *hdr, size_t hdrlen)
+{
+    const char *colon;
+    size_t      namelen;
+
+    colon = memchr(hdr, ':', hdrlen);
+    namelen = (colon == NULL ? hdrlen : (size_t) (colon - hdr) + 1);
+
+    return namelen + strlen(hdr + namelen);
+}
+
+/*
+**  ARC_CANON_RELAXED -- apply relaxed canonicalization to a header field
+**
+**  Parameters:
+**  	hdr -- header field input
+**  	hdrlen -- bytes to process at "hdr"
+**  	out -- output buffer, at least arc_canon_relaxed_bound() bytes
+**
+**  Return value:
+**  	Number of bytes written to "out".
+**
+**  Notes:
+**  	Relaxed canonicalization never makes anything longer, so this
+**  	writes straight to "out" without checking for space, and copies
+**  	each run of non-whitespace in one step.
+*/
+
+static size_t
+arc_canon_relaxed(const char *hdr, size_t hdrlen, char *out)
+{
+    bool        space;
+    const char *p;
+    const char *q;
+    char       *o = out;
+
+    /* process header field name (before colon) first */
+    for (p = hdr; p < hdr + hdrlen; p++)
+    {
+        /* discard spaces, convert to lowercase */
+        if ((arc_hdrchars[(unsigned char) *p] & ARC_HDRCHAR_LWSP) != 0)
+        {
+            continue;
+        }
+
+        if (*p >= 'A' && *p <= 'Z')
+        {
+            *o++ = *p - 'A' + 'a';
+        }
+        else
+        {
+            *o++ = *p;
+        }
+
+        if (*p == ':')
+        {
+            p++;
+            break;
+        }
+    }
+
+    /* skip all spaces before first word */
+    while ((arc_hdrchars[(unsigned char) *p] & ARC_HDRCHAR_LWSP) != 0)
+    {
+        p++;
+    }
+
+    space = false; /* just saw a space */
+
+    while (*p != '\0')
+    {
+        if ((arc_hdrchars[(unsigned char) *p] & ARC_HDRCHAR_SPACE) != 0)
+        {
+            /* mark that there was a space and continue */
+            space = true;
+            p++;
+            continue;
+        }
+
+        /*
+        **  Any non-space marks the beginning of a word.
+        **  If there's a stored space, use it up.
+        */
+
+        if (space)
+        {
+            *o++ = ' ';
+            space = false;
+        }
+
+        /* copy the word */
+        for (q = p + 1;
+             (arc_hdrchars[(unsigned char) *q] & ARC_HDRCHAR_WORDEND) == 0;
+             q++)
+        {
+            continue;
+        }
+
+        memcpy(o, p, q - p);
+        o += q - p;
+        p = q;
+    }
+
+    return o - out;
+}
+
 /*
 **  ARC_CANON_HEADER_STRING -- canonicalize a header field
 **
@@ -207,17 +479,13 @@ arc_canon_header_string(struct arc_dstring *dstr,
                         size_t              hdrlen,
                         bool                crlf)
 {
-    bool        space;
-    const char *p;
-    char       *tmp;
-    char       *end;
-    char        tmpbuf[BUFRSZ];
+    bool   ok;
+    size_t len;
+    char  *out;
+    char   tmpbuf[BUFRSZ];
     assert(dstr != NULL);
     assert(hdr != NULL);
 
-    tmp = tmpbuf;
-    end = tmpbuf + sizeof tmpbuf - 1;
-
     switch (canon)
     {
     case ARC_CANON_SIMPLE:
@@ -229,136 +497,115 @@ arc_canon_header_string(struct arc_dstring *dstr,
         break;
 
     case ARC_CANON_RELAXED:
-        /* process header field name (before colon) first */
-        for (p = hdr; p < hdr + hdrlen; p++)
+        len = arc_canon_relaxed_bound(hdr, hdrlen);
+        if (len <= sizeof tmpbuf)
         {
-            /*
-            **  Discard spaces before the colon or before the end
-            **  of the first word.
-            */
-
-            if (isascii(*p))
-            {
-                /* discard spaces */
-                if (ARC_ISLWSP(*p))
-                {
-                    continue;
-                }
-
-                /* convert to lowercase */
-                if (isupper(*p))
-                {
-                    *tmp++ = tolower(*p);
-                }
-                else
-                {
-                    *tmp++ = *p;
-                }
-            }
-            else
-            {
-                *tmp++ = *p;
-            }
-
-            /* reaching the end of the cache buffer, flush it */
-            if (tmp == end)
-            {
-                *tmp = '\0';
-
-                if (!arc_dstring_catn(dstr, tmpbuf, tmp - tmpbuf))
-                {
-                    return ARC_STAT_NORESOURCE;
-                }
-
-                tmp = tmpbuf;
-            }
-
-            if (*p == ':')
+            out = tmpbuf;
+        }
+        else
+        {
+            out = ARC_MALLOC(len);
+            if (out == NULL)
             {
-                p++;
-                break;
+                return ARC_STAT_NORESOURCE;
             }
         }
 
-        /* skip all spaces before first word */
-        while (*p != '\0' && ARC_ISLWSP(*p))
+        len = arc_canon_relaxed(hdr, hdrlen, out);
+        ok = arc_dstring_catn(dstr, out, len);
+
+        if (out != tmpbuf)
         {
-            p++;
+            ARC_FREE(out);
         }
 
-        space = false; /* just saw a space */
-
-        for (; *p != '\0'; p++)
+        if (!ok || (crlf && !arc_dstring_catn(dstr, CRLF, 2)))
         {
-            if (isascii(*p) && isspace(*p))
-            {
-                /* mark that there was a space and continue */
-                space = true;
-
-                continue;
-            }
-
-            /*
-            **  Any non-space marks the beginning of a word.
-            **  If there's a stored space, use it up.
-            */
-
-            if (space)
-            {
-                *tmp++ = ' ';
-
-                /* flush buffer? */
-                if (tmp == end)
-                {
-                    *tmp = '\0';
-
-                    if (!arc_dstring_catn(dstr, tmpbuf, tmp - tmpbuf))
-                    {
-                        return ARC_STAT_NORESOURCE;
-                    }
-
-                    tmp = tmpbuf;
-                }
+            return ARC_STAT_NORESOURCE;
+        }
 
-                space = false;
-            }
+        break;
+    }
 
-            /* copy the byte */
-            *tmp++ = *p;
+    return ARC_STAT_OK;
+}
 
-            /* flush buffer? */
-            if (tmp == end)
-            {
-                *tmp = '\0';
+/*
+**  ARC_CANON_HEADER_RELAXED -- get the relaxed form of a header field
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	hdr -- header handle
+**  	buf -- canonicalized header field, without CRLF (returned)
+**  	buflen -- bytes at "buf" (returned)
+**
+**  Return value:
+**  	A ARC_STAT constant.
+**
+**  Notes:
+**  	The result is kept with the header field, so every header and seal
+**  	canonicalization that covers it shares one copy.  Temporary header
+**  	fields (ARC_HDR_NOCACHE) are canonicalized into msg->arc_canonbuf
+**  	instead, which is only valid until the next call.
+*/
 
-                if (!arc_dstring_catn(dstr, tmpbuf, tmp - tmpbuf))
-                {
-                    return ARC_STAT_NORESOURCE;
-                }
+static ARC_STAT
+arc_canon_header_relaxed(ARC_MESSAGE         *msg,
+                         struct arc_hdrfield *hdr,
+                         const char         **buf,
+                         size_t              *buflen)
+{
+    size_t   len;
+    ARC_STAT status;
 
-                tmp = tmpbuf;
-            }
-        }
+    if (hdr->hdr_relaxed != NULL)
+    {
+        *buf = hdr->hdr_relaxed;
+        *buflen = hdr->hdr_relaxedlen;
+        return ARC_STAT_OK;
+    }
 
-        /* flush any cached data */
-        if (tmp != tmpbuf)
+    if ((hdr->hdr_flags & ARC_HDR_NOCACHE) != 0)
+    {
+        if (msg->arc_canonbuf == NULL)
         {
-            *tmp = '\0';
-
-            if (!arc_dstring_catn(dstr, tmpbuf, tmp - tmpbuf))
+            msg->arc_canonbuf = arc_dstring_new(hdr->hdr_textlen, 0, msg,
+                                                &arc_error_cb);
+            if (msg->arc_canonbuf == NULL)
             {
                 return ARC_STAT_NORESOURCE;
             }
         }
+        else
+        {
+            arc_dstring_blank(msg->arc_canonbuf);
+        }
 
-        if (crlf && !arc_dstring_catn(dstr, CRLF, 2))
+        status = arc_canon_header_string(msg->arc_canonbuf, ARC_CANON_RELAXED,
+                                         hdr->hdr_text, hdr->hdr_textlen,
+                                         false);
+        if (status != ARC_STAT_OK)
         {
-            return ARC_STAT_NORESOURCE;
+            return status;
         }
 
-        break;
+        *buf = arc_dstring_get(msg->arc_canonbuf);
+        *buflen = arc_dstring_len(msg->arc_canonbuf);
+        return ARC_STAT_OK;
     }
 
+    len = arc_canon_relaxed_bound(hdr->hdr_text, hdr->hdr_textlen);
+    hdr->hdr_relaxed = arc_arena_alloc(msg, len);
+    if (hdr->hdr_relaxed == NULL)
+    {
+        return ARC_STAT_NORESOURCE;
+    }
+
+    hdr->hdr_relaxedlen = arc_canon_relaxed(hdr->hdr_text, hdr->hdr_textlen,
+                                            hdr->hdr_relaxed);
+
+    *buf = hdr->hdr_relaxed;
+    *buflen = hdr->hdr_relaxedlen;
     return ARC_STAT_OK;
 }
 
@@ -381,39 +628,35 @@ arc_canon_header(ARC_MESSAGE         *msg,
                  struct arc_hdrfield *hdr,
                  bool                 crlf)
 {
-    ARC_STAT status;
+    size_t      buflen;
+    ARC_STAT    status;
+    const char *buf;
 
     assert(msg != NULL);
     assert(canon != NULL);
     assert(hdr != NULL);
 
-    if (msg->arc_canonbuf == NULL)
+    /* simple canonicalization is the header field itself */
+    if (canon->canon_canon == ARC_CANON_SIMPLE)
     {
-        msg->arc_canonbuf = arc_dstring_new(hdr->hdr_textlen, 0, msg,
-                                            &arc_error_cb);
-        if (msg->arc_canonbuf == NULL)
-        {
-            return ARC_STAT_NORESOURCE;
-        }
+        buf = hdr->hdr_text;
+        buflen = hdr->hdr_textlen;
     }
     else
     {
-        arc_dstring_blank(msg->arc_canonbuf);
+        status = arc_canon_header_relaxed(msg, hdr, &buf, &buflen);
+        if (status != ARC_STAT_OK)
+        {
+            return status;
+        }
     }
 
-    arc_canon_buffer(canon, NULL, 0);
-
-    status = arc_canon_header_string(msg->arc_canonbuf, canon->canon_canon,
-                                     hdr->hdr_text, hdr->hdr_textlen, crlf);
-
-    if (status != ARC_STAT_OK)
+    arc_canon_buffer(canon, buf, buflen);
+    if (crlf)
     {
-        return status;
+        arc_canon_buffer(canon, CRLF, 2);
     }
 
-    arc_canon_buffer(canon, arc_dstring_get(msg->arc_canonbuf),
-                     arc_dstring_len(msg->arc_canonbuf));
-
     return ARC_STAT_OK;
 }
 
@@ -446,7 +689,6 @@ arc_canon_flushblanks(ARC_CANON *canon)
 **
 **  Parameters:
 **  	msg -- ARC message handle
-**  	canon -- canonicalization being handled
 **  	buf -- buffer to be fixed
 **  	buflen -- number of bytes at "buf"
 **
@@ -458,17 +700,13 @@ arc_canon_flushblanks(ARC_CANON *canon)
 */
 
 static ARC_STAT
-arc_canon_fixcrlf(ARC_MESSAGE *msg,
-                  ARC_CANON   *canon,
-                  const char  *buf,
-                  size_t       buflen)
+arc_canon_fixcrlf(ARC_MESSAGE *msg, const char *buf, size_t buflen)
 {
     char        prev;
     const char *p;
     const char *eob;
 
     assert(msg != NULL);
-    assert(canon != NULL);
     assert(buf != NULL);
 
     if (msg->arc_canonbuf == NULL)
@@ -486,7 +724,7 @@ arc_canon_fixcrlf(ARC_MESSAGE *msg,
 
     eob = buf + buflen - 1;
 
-    prev = canon->canon_lastchar;
+    prev = msg->arc_lastbodychar;
 
     for (p = buf; p <= eob; p++)
     {
@@ -537,10 +775,11 @@ arc_canon_fixcrlf(ARC_MESSAGE *msg,
 ARC_STAT
 arc_canon_init(ARC_MESSAGE *msg, bool tmp, bool keep)
 {
-    int        fd;
-    int        rc;
-    ARC_STAT   status;
-    ARC_CANON *cur;
+    int               fd;
+    int               rc;
+    ARC_STAT          status;
+    ARC_CANON        *cur;
+    struct arc_spare *spare;
 
     assert(msg != NULL);
 
@@ -551,37 +790,51 @@ arc_canon_init(ARC_MESSAGE *msg, bool tmp, bool keep)
             /* already initialized, nothing to do */
             continue;
         }
-        cur->canon_hashbuf = ARC_MALLOC(ARC_HASHBUFSIZE);
+        cur->canon_hashbuf = arc_arena_alloc(msg, ARC_HASHBUFSIZE);
         if (cur->canon_hashbuf == NULL)
         {
-            arc_error(msg, "unable to allocate %d byte(s)", ARC_HASHBUFSIZE);
             return ARC_STAT_NORESOURCE;
         }
         cur->canon_hashbufsize = ARC_HASHBUFSIZE;
         cur->canon_hashbuflen = 0;
-        cur->canon_buf = arc_dstring_new(BUFRSZ, BUFRSZ, msg, &arc_error_cb);
-        if (cur->canon_buf == NULL)
+
+        cur->canon_hash = arc_arena_calloc(msg, 1, sizeof(struct arc_hash));
+        if (cur->canon_hash == NULL)
         {
             return ARC_STAT_NORESOURCE;
         }
 
-        cur->canon_hash = ARC_CALLOC(1, sizeof(struct arc_hash));
-        if (cur->canon_hash == NULL)
+        /* reuse state left by a previous message on this handle */
+        if (msg->arc_ncanonspares > 0)
         {
-            arc_error(msg, "unable to allocate %d bytes",
-                      sizeof(struct arc_hash));
-            return ARC_STAT_NORESOURCE;
+            spare = &msg->arc_canonspares[--msg->arc_ncanonspares];
+            cur->canon_hash->hash_ctx = spare->sp_ctx;
+            cur->canon_buf = spare->sp_buf;
+            arc_dstring_blank(cur->canon_buf);
         }
 
+        if (cur->canon_buf == NULL)
+        {
+            cur->canon_buf = arc_dstring_new(BUFRSZ, BUFRSZ, msg,
+                                             &arc_error_cb);
+            if (cur->canon_buf == NULL)
+            {
+                return ARC_STAT_NORESOURCE;
+            }
+        }
+
+        if (cur->canon_hash->hash_ctx == NULL)
+        {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-        cur->canon_hash->hash_ctx = EVP_MD_CTX_create();
+            cur->canon_hash->hash_ctx = EVP_MD_CTX_create();
 #else
-        cur->canon_hash->hash_ctx = EVP_MD_CTX_new();
+            cur->canon_hash->hash_ctx = EVP_MD_CTX_new();
 #endif /* OpenSSL < 1.1.0 */
-        if (cur->canon_hash->hash_ctx == NULL)
-        {
-            arc_error(msg, "EVP_MD_CTX_new() failed");
-            return ARC_STAT_NORESOURCE;
+            if (cur->canon_hash->hash_ctx == NULL)
+            {
+                arc_error(msg, "EVP_MD_CTX_new() failed");
+                return ARC_STAT_NORESOURCE;
+            }
         }
         if (cur->canon_hashtype == ARC_HASHTYPE_SHA1)
         {
@@ -646,6 +899,45 @@ arc_canon_cleanup(ARC_MESSAGE *msg)
     msg->arc_canonhead = NULL;
     arc_dstring_free(msg->arc_canonbuf);
     msg->arc_canonbuf = NULL;
+
+    for (unsigned int c = 0; c < msg->arc_ncanonspares; c++)
+    {
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        EVP_MD_CTX_destroy(msg->arc_canonspares[c].sp_ctx);
+#else
+        EVP_MD_CTX_free(msg->arc_canonspares[c].sp_ctx);
+#endif /* OpenSSL < 1.1.0 */
+        arc_dstring_free(msg->arc_canonspares[c].sp_buf);
+    }
+    ARC_FREE(msg->arc_canonspares);
+    msg->arc_canonspares = NULL;
+    msg->arc_ncanonspares = 0;
+    msg->arc_maxcanonspares = 0;
+}
+
+/*
+**  ARC_CANON_RESET -- discard canonicalizations, keeping reusable state
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_canon_reset(ARC_MESSAGE *msg)
+{
+    ARC_CANON *cur;
+
+    assert(msg != NULL);
+
+    for (cur = msg->arc_canonhead; cur != NULL; cur = cur->canon_next)
+    {
+        arc_canon_recycle(msg, cur);
+    }
+
+    msg->arc_canonhead = NULL;
 }
 
 /*
@@ -677,22 +969,33 @@ arc_add_canon(ARC_MESSAGE         *msg,
 {
     ARC_CANON *cur;
     ARC_CANON *new;
+    ARC_CANON *stream = NULL;
 
     assert(msg != NULL);
     assert(canon == ARC_CANON_SIMPLE || canon == ARC_CANON_RELAXED);
 
     assert(hashtype == ARC_HASHTYPE_SHA1 || hashtype == ARC_HASHTYPE_SHA256);
 
-    /* Body canons can be shared if the parameters match. Header canons could
-     * theoretically be partially shared if the `h` tags match, but it would be
-     * complex so we don't currently do it. */
+    /* Body canons can be shared if the parameters match, and those that
+     * only differ in hash or length can share the canonicalized stream.
+     * Header canons could theoretically be partially shared if the `h`
+     * tags match, but it would be complex so we don't currently do it. */
     if (type == ARC_CANONTYPE_BODY)
     {
         for (cur = msg->arc_canonhead; cur != NULL; cur = cur->canon_next)
         {
             if (cur->canon_type != ARC_CANONTYPE_BODY ||
-                cur->canon_canon != canon || cur->canon_hashtype != hashtype ||
-                cur->canon_length != length)
+                cur->canon_canon != canon)
+            {
+                continue;
+            }
+
+            if (stream == NULL && !cur->canon_follower)
+            {
+                stream = cur;
+            }
+
+            if (cur->canon_hashtype != hashtype || cur->canon_length != length)
             {
                 continue;
             }
@@ -706,10 +1009,9 @@ arc_add_canon(ARC_MESSAGE         *msg,
         }
     }
 
-    new = ARC_MALLOC(sizeof *new);
+    new = arc_arena_alloc(msg, sizeof *new);
     if (new == NULL)
     {
-        arc_error(msg, "unable to allocate %d byte(s)", sizeof *new);
         return ARC_STAT_NORESOURCE;
     }
 
@@ -732,6 +1034,8 @@ arc_add_canon(ARC_MESSAGE         *msg,
     new->canon_sigheader = sighdr;
     new->canon_hdrlist = hdrlist;
     new->canon_buf = NULL;
+    new->canon_follower = false;
+    new->canon_fanout = NULL;
     new->canon_next = NULL;
     new->canon_blankline = true;
     new->canon_blanks = 0;
@@ -741,6 +1045,14 @@ arc_add_canon(ARC_MESSAGE         *msg,
     new->canon_hashbuf = NULL;
     new->canon_lastchar = '\0';
 
+    /* canonicalize once, hash for each */
+    if (stream != NULL)
+    {
+        new->canon_follower = true;
+        new->canon_fanout = stream->canon_fanout;
+        stream->canon_fanout = new;
+    }
+
     if (msg->arc_canonhead == NULL)
     {
         msg->arc_canontail = new;
@@ -778,8 +1090,8 @@ arc_add_canon(ARC_MESSAGE         *msg,
 **  	which this is done.  "ptrs" is populated by pointers to header fields
 **  	in the order in which they should be fed to canonicalization.
 **
-**  	If any of the returned pointers is NULL, then a header field named by
-**  	"hdrlist" was not found.
+**  	Names in "hdrlist" with no unused header field left to match are
+**  	skipped.
 */
 
 int
@@ -788,17 +1100,12 @@ arc_canon_selecthdrs(ARC_MESSAGE          *msg,
                      struct arc_hdrfield **ptrs,
                      int                   nptrs)
 {
-    int                   c;
-    int                   n;
-    int                   m;
-    int                   shcnt;
-    size_t                len;
-    char                 *bar;
-    char                 *ctx;
-    char                 *colon;
-    struct arc_hdrfield  *hdr;
-    struct arc_hdrfield **lhdrs;
-    char                **hdrs;
+    int                  n;
+    size_t               len;
+    const char          *p;
+    const char          *colon;
+    struct arc_hdrfield *hdr;
+    struct arc_hdrname  *hn;
 
     assert(msg != NULL);
     assert(ptrs != NULL);
@@ -823,114 +1130,77 @@ arc_canon_selecthdrs(ARC_MESSAGE          *msg,
         return n;
     }
 
-    if (msg->arc_hdrlist == NULL)
-    {
-        msg->arc_hdrlist = ARC_MALLOC(ARC_MAXHEADER);
-        if (msg->arc_hdrlist == NULL)
-        {
-            arc_error(msg, "unable to allocate %d bytes(s)", ARC_MAXHEADER);
-            return -1;
-        }
-    }
-
-    strlcpy(msg->arc_hdrlist, hdrlist, ARC_MAXHEADER);
-
     /* mark all headers as not used */
     for (hdr = msg->arc_hhead; hdr != NULL; hdr = hdr->hdr_next)
     {
         hdr->hdr_flags &= ~ARC_HDR_SIGNED;
     }
 
-    lhdrs = ARC_CALLOC(msg->arc_hdrcnt, sizeof(struct arc_hdrfield *));
-    if (lhdrs == NULL)
-    {
-        return -1;
-    }
-
-    shcnt = 1;
-    for (colon = msg->arc_hdrlist; *colon != '\0'; colon++)
-    {
-        if (*colon == ':')
-        {
-            shcnt++;
-        }
-    }
-    hdrs = ARC_CALLOC(shcnt, sizeof(char *));
-    if (hdrs == NULL)
-    {
-        ARC_FREE(lhdrs);
-        return -1;
-    }
+    /*
+    **  For each named header, find the last unused one and use it up.
+    **  The name index chains each field to the previous one of the same
+    **  name, so each entry keeps a cursor that starts at the last
+    **  occurrence at the beginning of every selection pass.
+    */
 
+    msg->arc_hdrgen++;
     n = 0;
 
-    /* make a split-out copy of hdrlist */
-    for (bar = strtok_r(msg->arc_hdrlist, ":", &ctx); bar != NULL;
-         bar = strtok_r(NULL, ":", &ctx))
-    {
-        hdrs[n] = bar;
-        n++;
-    }
-
-    /* for each named header, find the last unused one and use it up */
-    shcnt = 0;
-    for (c = 0; c < n; c++)
+    for (p = hdrlist; *p != '\0'; p = colon)
     {
-        lhdrs[shcnt] = NULL;
+        colon = strchr(p, ':');
+        if (colon == NULL)
+        {
+            colon = p + strlen(p);
+        }
 
-        len = MIN(ARC_MAXHEADER, strlen(hdrs[c]));
-        while (len > 0 && ARC_ISWSP(hdrs[c][len - 1]))
+        len = colon - p;
+        while (len > 0 && ARC_ISWSP(p[len - 1]))
         {
             len--;
         }
 
-        for (hdr = msg->arc_hhead; hdr != NULL; hdr = hdr->hdr_next)
+        if (*colon == ':')
         {
-            if (hdr->hdr_flags & ARC_HDR_SIGNED)
-            {
-                continue;
-            }
-
-            if (len == hdr->hdr_namelen &&
-                strncasecmp(hdr->hdr_text, hdrs[c], len) == 0)
-            {
-                lhdrs[shcnt] = hdr;
-            }
+            colon++;
         }
 
-        if (lhdrs[shcnt] != NULL)
+        if (len == 0)
         {
-            lhdrs[shcnt]->hdr_flags |= ARC_HDR_SIGNED;
-            shcnt++;
+            continue;
         }
-    }
 
-    /* bounds check */
-    if (shcnt > nptrs)
-    {
-        arc_error(msg, "too many headers (found %d, max %d)", shcnt, nptrs);
+        hn = arc_hdrindex_find(msg, p, len);
+        if (hn == NULL)
+        {
+            continue;
+        }
 
-        ARC_FREE(lhdrs);
-        ARC_FREE(hdrs);
+        if (hn->hn_gen != msg->arc_hdrgen)
+        {
+            hn->hn_gen = msg->arc_hdrgen;
+            hn->hn_cursor = hn->hn_last;
+        }
 
-        return -1;
-    }
+        if (hn->hn_cursor == NULL)
+        {
+            continue;
+        }
 
-    /* copy to the caller's buffers */
-    m = 0;
-    for (c = 0; c < shcnt; c++)
-    {
-        if (lhdrs[c] != NULL)
+        /* bounds check */
+        if (n >= nptrs)
         {
-            ptrs[m] = lhdrs[c];
-            m++;
+            arc_error(msg, "too many headers (max %d)", nptrs);
+            return -1;
         }
-    }
 
-    ARC_FREE(lhdrs);
-    ARC_FREE(hdrs);
+        ptrs[n] = hn->hn_cursor;
+        ptrs[n]->hdr_flags |= ARC_HDR_SIGNED;
+        hn->hn_cursor = hn->hn_cursor->hdr_prevname;
+        n++;
+    }
 
-    return m;
+    return n;
 }
 
 /*
@@ -1050,6 +1320,65 @@ arc_canon_finalize(ARC_CANON *canon)
     }
 }
 
+/*
+**  ARC_CANON_SEAL_STREAM -- add a complete ARC header field to the running
+**                           seal stream
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	run -- running digests, indexed by ARC_HASHTYPE_* (may be NULL)
+**  	prefix -- copy of the canonicalized stream (may be NULL)
+**  	hdr -- header field to add
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Side effects:
+**  	The field is also written to the re-sealing canonicalization,
+**  	if there is one.
+*/
+
+static ARC_STAT
+arc_canon_seal_stream(ARC_MESSAGE         *msg,
+                      EVP_MD_CTX         **run,
+                      struct arc_dstring  *prefix,
+                      struct arc_hdrfield *hdr)
+{
+    int         c;
+    ARC_STAT    status;
+    const char *buf;
+    size_t      buflen;
+
+    status = arc_canon_header_relaxed(msg, hdr, &buf, &buflen);
+    if (status != ARC_STAT_OK)
+    {
+        return status;
+    }
+
+    for (c = 0; c < ARC_SEAL_NHASHES; c++)
+    {
+        if (run[c] != NULL)
+        {
+            EVP_DigestUpdate(run[c], buf, buflen);
+            EVP_DigestUpdate(run[c], CRLF, 2);
+        }
+    }
+
+    if (prefix != NULL && (!arc_dstring_catn(prefix, buf, buflen) ||
+                           !arc_dstring_catn(prefix, CRLF, 2)))
+    {
+        return ARC_STAT_NORESOURCE;
+    }
+
+    if (msg->arc_sealcanon != NULL && !msg->arc_sealcanon->canon_done)
+    {
+        arc_canon_buffer(msg->arc_sealcanon, buf, buflen);
+        arc_canon_buffer(msg->arc_sealcanon, CRLF, 2);
+    }
+
+    return ARC_STAT_OK;
+}
+
 /*
 **  ARC_CANON_RUNHEADERS_SEAL -- run the ARC-specific header fields through
 **                               seal canonicalization(s)
@@ -1060,22 +1389,31 @@ arc_canon_finalize(ARC_CANON *canon)
 **  Return value:
 **  	An ARC_STAT_* constant.
 **
-**  For each ARC set number N, apply it to seal canonicalization handles 0
-**  through N-1.  That way the first one is only set 1, the second one is
-**  sets 1 and 2, etc.  For the final one in each set, strip "b=".  Then
-**  also do one more complete one so that can be used for re-sealing.
+**  The input for the seal of set N is sets 1 through N-1, then set N with
+**  "b=" stripped from its seal.  Rather than rebuilding that for every set,
+**  one running digest per hash type is fed each set in turn and copied into
+**  set N's canonicalization just before its seal; only the stripped seal is
+**  then hashed separately.  The running stream also feeds the re-sealing
+**  canonicalization, which covers all of the sets.
 */
 
 ARC_STAT
 arc_canon_runheaders_seal(ARC_MESSAGE *msg)
 {
-    ARC_STAT     status;
-    unsigned int m;
-    unsigned int n;
-    ARC_CANON   *cur;
+    bool                keep = false;
+    int                 c;
+    ARC_STAT            status = ARC_STAT_OK;
+    unsigned int        n;
+    ARC_CANON          *cur;
+    struct arc_dstring *prefix = NULL;
+    EVP_MD_CTX         *run[ARC_SEAL_NHASHES];
+    struct arc_hdrfield tmphdr;
 
     assert(msg != NULL);
 
+    memset(run, '\0', sizeof run);
+
+    /* start a running digest for each hash type still needed */
     for (n = 0; n < msg->arc_nsets; n++)
     {
         cur = msg->arc_sealcanons[n];
@@ -1085,80 +1423,141 @@ arc_canon_runheaders_seal(ARC_MESSAGE *msg)
             continue;
         }
 
-        /* build up the canonicalized seals for verification */
-        for (m = 0; m <= n; m++)
+        assert(cur->canon_hashtype < ARC_SEAL_NHASHES);
+
+        if (cur->canon_hash->hash_tmpbio != NULL)
+        {
+            keep = true;
+        }
+
+        if (run[cur->canon_hashtype] != NULL)
         {
-            status = arc_canon_header(msg, cur, msg->arc_sets[m].arcset_aar,
-                                      true);
-            if (status != ARC_STAT_OK)
+            continue;
+        }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        run[cur->canon_hashtype] = EVP_MD_CTX_create();
+#else
+        run[cur->canon_hashtype] = EVP_MD_CTX_new();
+#endif /* OpenSSL < 1.1.0 */
+        if (run[cur->canon_hashtype] == NULL)
+        {
+            arc_error(msg, "EVP_MD_CTX_new() failed");
+            status = ARC_STAT_NORESOURCE;
+            goto done;
+        }
+
+        if (cur->canon_hashtype == ARC_HASHTYPE_SHA1)
+        {
+            c = EVP_DigestInit_ex(run[cur->canon_hashtype], EVP_sha1(), NULL);
+        }
+        else
+        {
+            c = EVP_DigestInit_ex(run[cur->canon_hashtype], EVP_sha256(),
+                                  NULL);
+        }
+        if (c != 1)
+        {
+            arc_error(msg, "EVP_DigestInit_ex() failed");
+            status = ARC_STAT_INTERNAL;
+            goto done;
+        }
+    }
+
+    /* temporary files need the whole stream, not just the tail */
+    if (keep)
+    {
+        prefix = arc_dstring_new(BUFRSZ, 0, msg, &arc_error_cb);
+        if (prefix == NULL)
+        {
+            status = ARC_STAT_NORESOURCE;
+            goto done;
+        }
+    }
+
+    for (n = 0; n < msg->arc_nsets; n++)
+    {
+        status = arc_canon_seal_stream(msg, run, prefix,
+                                       msg->arc_sets[n].arcset_aar);
+        if (status != ARC_STAT_OK)
+        {
+            goto done;
+        }
+
+        status = arc_canon_seal_stream(msg, run, prefix,
+                                       msg->arc_sets[n].arcset_ams);
+        if (status != ARC_STAT_OK)
+        {
+            goto done;
+        }
+
+        /* fork the stream for this set's seal */
+        cur = msg->arc_sealcanons[n];
+        if (!cur->canon_done)
+        {
+            if (EVP_MD_CTX_copy_ex(cur->canon_hash->hash_ctx,
+                                   run[cur->canon_hashtype]) != 1)
             {
-                return status;
+                arc_error(msg, "EVP_MD_CTX_copy_ex() failed");
+                status = ARC_STAT_INTERNAL;
+                goto done;
             }
 
-            status = arc_canon_header(msg, cur, msg->arc_sets[m].arcset_ams,
-                                      true);
-            if (status != ARC_STAT_OK)
+            if (cur->canon_hash->hash_tmpbio != NULL)
             {
-                return status;
+                BIO_write(cur->canon_hash->hash_tmpbio,
+                          arc_dstring_get(prefix), arc_dstring_len(prefix));
             }
 
-            if (m != n)
+            status = arc_canon_strip_b(msg,
+                                       msg->arc_sets[n].arcset_as->hdr_text);
+            if (status != ARC_STAT_OK)
             {
-                status = arc_canon_header(msg, cur, msg->arc_sets[m].arcset_as,
-                                          true);
+                goto done;
             }
-            else
-            {
-                struct arc_hdrfield tmphdr;
-                arc_canon_strip_b(msg, msg->arc_sets[m].arcset_as->hdr_text);
 
-                tmphdr.hdr_text = arc_dstring_get(msg->arc_hdrbuf);
-                tmphdr.hdr_namelen = cur->canon_sigheader->hdr_namelen;
-                tmphdr.hdr_textlen = arc_dstring_len(msg->arc_hdrbuf);
-                tmphdr.hdr_flags = 0;
-                tmphdr.hdr_next = NULL;
-
-                status = arc_canon_header(msg, cur, &tmphdr, false);
-                arc_canon_buffer(cur, NULL, 0);
-            }
+            tmphdr.hdr_text = arc_dstring_get(msg->arc_hdrbuf);
+            tmphdr.hdr_namelen = cur->canon_sigheader->hdr_namelen;
+            tmphdr.hdr_textlen = arc_dstring_len(msg->arc_hdrbuf);
+            tmphdr.hdr_flags = ARC_HDR_NOCACHE;
+            tmphdr.hdr_relaxed = NULL;
+            tmphdr.hdr_next = NULL;
 
+            status = arc_canon_header(msg, cur, &tmphdr, false);
             if (status != ARC_STAT_OK)
             {
-                return status;
+                goto done;
             }
-        }
-
-        arc_canon_finalize(cur);
-        cur->canon_done = true;
-
-        cur = msg->arc_sealcanon;
-
-        if (cur == NULL || cur->canon_done)
-        {
-            continue;
-        }
+            arc_canon_buffer(cur, NULL, 0);
 
-        /* write all the ARC sets once more for re-sealing */
-        status = arc_canon_header(msg, cur, msg->arc_sets[n].arcset_aar, true);
-        if (status != ARC_STAT_OK)
-        {
-            return status;
+            arc_canon_finalize(cur);
+            cur->canon_done = true;
         }
 
-        status = arc_canon_header(msg, cur, msg->arc_sets[n].arcset_ams, true);
+        status = arc_canon_seal_stream(msg, run, prefix,
+                                       msg->arc_sets[n].arcset_as);
         if (status != ARC_STAT_OK)
         {
-            return status;
+            goto done;
         }
+    }
 
-        status = arc_canon_header(msg, cur, msg->arc_sets[n].arcset_as, true);
-        if (status != ARC_STAT_OK)
+done:
+    for (c = 0; c < ARC_SEAL_NHASHES; c++)
+    {
+        if (run[c] != NULL)
         {
-            return status;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+            EVP_MD_CTX_destroy(run[c]);
+#else
+            EVP_MD_CTX_free(run[c]);
+#endif /* OpenSSL < 1.1.0 */
         }
     }
 
-    return ARC_STAT_OK;
+    arc_dstring_free(prefix);
+
+    return status;
 }
 
 /*
@@ -1181,7 +1580,7 @@ ARC_STAT
 arc_canon_runheaders(ARC_MESSAGE *msg)
 {
     bool                  signing;
-    unsigned char         savechar;
+    char                  hnbuf[ARC_MAXHDRNAMELEN + 1];
     int                   c;
     size_t                n;
     int                   nhdrs = 0;
@@ -1244,11 +1643,6 @@ arc_canon_runheaders(ARC_MESSAGE *msg)
             }
             else
             {
-                for (hdr = msg->arc_hhead; hdr != NULL; hdr = hdr->hdr_next)
-                {
-                    hdr->hdr_flags &= ~ARC_HDR_SIGNED;
-                }
-
                 memset(hdrset, '\0', n);
 
                 /* do header selection */
@@ -1333,15 +1727,10 @@ arc_canon_runheaders(ARC_MESSAGE *msg)
                 **  given, so just do those.
                 */
 
-                /* could be space, could be colon ... */
-                savechar = hdr->hdr_text[hdr->hdr_namelen];
-
-                /* terminate the header field name and test */
-                hdr->hdr_text[hdr->hdr_namelen] = '\0';
-                status = regexec(hdrtest, hdr->hdr_text, 0, NULL, 0);
-
-                /* restore the character */
-                hdr->hdr_text[hdr->hdr_namelen] = savechar;
+                /* the text may be borrowed, so test a copy of the name */
+                memcpy(hnbuf, hdr->hdr_text, hdr->hdr_namelen);
+                hnbuf[hdr->hdr_namelen] = '\0';
+                status = regexec(hdrtest, hnbuf, 0, NULL, 0);
 
                 if (status == 0)
                 {
@@ -1422,7 +1811,8 @@ arc_canon_runheaders(ARC_MESSAGE *msg)
         tmphdr.hdr_text = arc_dstring_get(msg->arc_hdrbuf);
         tmphdr.hdr_namelen = cur->canon_sigheader->hdr_namelen;
         tmphdr.hdr_textlen = arc_dstring_len(msg->arc_hdrbuf);
-        tmphdr.hdr_flags = 0;
+        tmphdr.hdr_flags = ARC_HDR_NOCACHE;
+        tmphdr.hdr_relaxed = NULL;
         tmphdr.hdr_next = NULL;
 
         (void) arc_canon_header(msg, cur, &tmphdr, false);
@@ -1497,7 +1887,8 @@ arc_canon_signature(ARC_MESSAGE *msg, struct arc_hdrfield *hdr, int type)
         tmphdr.hdr_text = arc_dstring_get(msg->arc_hdrbuf);
         tmphdr.hdr_namelen = hdr->hdr_namelen;
         tmphdr.hdr_textlen = arc_dstring_len(msg->arc_hdrbuf);
-        tmphdr.hdr_flags = 0;
+        tmphdr.hdr_flags = ARC_HDR_NOCACHE;
+        tmphdr.hdr_relaxed = NULL;
         tmphdr.hdr_next = NULL;
 
         /* canonicalize the signature */
@@ -1581,6 +1972,8 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
     ARC_CANON   *cur;
     size_t       plen;
     const char  *p;
+    const char  *q;
+    const char  *r;
     const char  *wrote;
     const char  *eob;
     const char  *start;
@@ -1589,29 +1982,39 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
 
     msg->arc_bodylen += buflen;
 
+    /* nothing to do if no body hash wants any more data */
+    if (buflen == 0 || arc_canon_minbody(msg) == 0)
+    {
+        return ARC_STAT_OK;
+    }
+
     fixcrlf = (msg->arc_library->arcl_flags & ARC_LIBFLAGS_FIXCRLF);
 
-    for (cur = msg->arc_canonhead; cur != NULL; cur = cur->canon_next)
+    start = buf;
+    plen = buflen;
+
+    /* the fixed-up chunk is the same for every canonicalization */
+    if (fixcrlf)
     {
-        /* skip done hashes and those which are of the wrong type */
-        if (cur->canon_done || cur->canon_type != ARC_CANONTYPE_BODY)
+        status = arc_canon_fixcrlf(msg, buf, buflen);
+        if (status != ARC_STAT_OK)
         {
-            continue;
+            return status;
         }
 
-        start = buf;
-        plen = buflen;
+        start = arc_dstring_get(msg->arc_canonbuf);
+        plen = arc_dstring_len(msg->arc_canonbuf);
+    }
+
+    msg->arc_lastbodychar = buf[buflen - 1];
 
-        if (fixcrlf)
+    for (cur = msg->arc_canonhead; cur != NULL; cur = cur->canon_next)
+    {
+        /* skip finished streams, shared streams and the wrong type */
+        if (cur->canon_type != ARC_CANONTYPE_BODY || cur->canon_follower ||
+            !arc_canon_wanted(cur))
         {
-            status = arc_canon_fixcrlf(msg, cur, buf, buflen);
-            if (status != ARC_STAT_OK)
-            {
-                return status;
-            }
-
-            start = arc_dstring_get(msg->arc_canonbuf);
-            plen = arc_dstring_len(msg->arc_canonbuf);
+            continue;
         }
 
         eob = start + plen - 1;
@@ -1661,7 +2064,19 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
                         }
                     }
 
-                    if (*p != '\r')
+                    /* take the rest of the line in one step */
+                    q = memchr(p, '\n', eob - p + 1);
+                    if (q == NULL)
+                    {
+                        q = eob + 1;
+                    }
+
+                    for (r = p; r < q && *r == '\r'; r++)
+                    {
+                        continue;
+                    }
+
+                    if (r < q)
                     {
                         if (cur->canon_blanks > 0)
                         {
@@ -1670,7 +2085,8 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
                         cur->canon_blankline = false;
                     }
 
-                    wlen++;
+                    wlen += q - p;
+                    p = q - 1;
                 }
 
                 cur->canon_lastchar = *p;
@@ -1788,7 +2204,52 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
                     break;
 
                 case 3:
-                    if (ARC_ISWSP(*p))
+                    /*
+                    **  Find the end of this run of text.  If it's
+                    **  terminated within this chunk, hash it straight
+                    **  from the input rather than staging it a byte at
+                    **  a time.
+                    */
+
+                    for (q = p; q <= eob && !ARC_ISWSP(*q) && *q != '\r'; q++)
+                    {
+                        continue;
+                    }
+
+                    if (q > p)
+                    {
+                        if (q <= eob &&
+                            (ARC_ISWSP(*q) || (q < eob && *(q + 1) == '\n')))
+                        {
+                            arc_canon_flushblanks(cur);
+                            arc_canon_buffer(cur,
+                                             arc_dstring_get(cur->canon_buf),
+                                             arc_dstring_len(cur->canon_buf));
+                            arc_dstring_blank(cur->canon_buf);
+                            arc_canon_buffer(cur, p, q - p);
+
+                            /* consume the terminator too */
+                            if (ARC_ISWSP(*q))
+                            {
+                                cur->canon_bodystate = 1;
+                            }
+                            else
+                            {
+                                arc_canon_buffer(cur, CRLF, 2);
+                                cur->canon_blankline = true;
+                                cur->canon_bodystate = 0;
+                                q++;
+                            }
+
+                            p = q;
+                        }
+                        else
+                        {
+                            arc_dstring_catn(cur->canon_buf, p, q - p);
+                            p = q - 1;
+                        }
+                    }
+                    else if (ARC_ISWSP(*p))
                     {
                         arc_canon_flushblanks(cur);
                         arc_canon_buffer(cur, arc_dstring_get(cur->canon_buf),
@@ -1800,10 +2261,6 @@ arc_canon_bodychunk(ARC_MESSAGE *msg, const char *buf, size_t buflen)
                     {
                         cur->canon_bodystate = 2;
                     }
-                    else
-                    {
-                        arc_dstring_cat1(cur->canon_buf, *p);
-                    }
                     break;
                 }
 
@@ -1839,19 +2296,26 @@ ARC_STAT
 arc_canon_closebody(ARC_MESSAGE *msg)
 {
     ARC_CANON *cur;
+    ARC_CANON *hc;
 
     assert(msg != NULL);
 
     for (cur = msg->arc_canonhead; cur != NULL; cur = cur->canon_next)
     {
-        /* skip done hashes or header canonicalizations */
-        if (cur->canon_done || cur->canon_type != ARC_CANONTYPE_BODY)
+        /* skip done streams, shared streams or header canonicalizations */
+        if (cur->canon_type != ARC_CANONTYPE_BODY || cur->canon_follower ||
+            !arc_canon_active(cur))
         {
             continue;
         }
 
-        /* handle unprocessed content */
-        if (arc_dstring_len(cur->canon_buf) > 0)
+        /*
+        **  Handle unprocessed content.  Once every hash has reached its
+        **  length limit the rest of the body may not have been seen at all,
+        **  so leftovers don't matter.
+        */
+
+        if (arc_dstring_len(cur->canon_buf) > 0 && arc_canon_wanted(cur))
         {
             if ((msg->arc_library->arcl_flags & ARC_LIBFLAGS_FIXCRLF) != 0)
             {
@@ -1868,16 +2332,25 @@ arc_canon_closebody(ARC_MESSAGE *msg)
 
         arc_canon_buffer(cur, NULL, 0);
 
-        if (cur->canon_remain > 0)
+        for (hc = cur; hc != NULL; hc = hc->canon_fanout)
         {
-            arc_error(msg, "body length in signature longer than actual body");
-            return ARC_STAT_SYNTAX;
-        }
+            if (hc->canon_done)
+            {
+                continue;
+            }
 
-        /* finalize */
-        arc_canon_finalize(cur);
+            if (hc->canon_remain > 0)
+            {
+                arc_error(msg,
+                          "body length in signature longer than actual body");
+                return ARC_STAT_SYNTAX;
+            }
 
-        cur->canon_done = true;
+            /* finalize */
+            arc_canon_finalize(hc);
+
+            hc->canon_done = true;
+        }
     }
 
     return ARC_STAT_OK;
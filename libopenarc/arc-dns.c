@@ -9,16 +9,27 @@
 #endif /* ! REENTRANT */
 
 /* system includes */
+#include <arpa/inet.h>
 #include <arpa/nameser.h>
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <resolv.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+/* OpenSSL includes */
+#include <openssl/rand.h>
 
 /* libopenarc includes */
 #include "arc-dns.h"
@@ -32,18 +43,631 @@
 #ifndef MAXPACKET
 #define MAXPACKET 8192
 #endif /* ! MAXPACKET */
+#ifndef MAXNS
+#define MAXNS 3
+#endif /* ! MAXNS */
+#ifndef RES_TIMEOUT
+#define RES_TIMEOUT 5
+#endif /* ! RES_TIMEOUT */
+#ifndef RES_DFLRETRY
+#define RES_DFLRETRY 2
+#endif /* ! RES_DFLRETRY */
+#ifndef RES_MAXRETRANS
+#define RES_MAXRETRANS 30
+#endif /* ! RES_MAXRETRANS */
+#ifndef RES_MAXRETRY
+#define RES_MAXRETRY 5
+#endif /* ! RES_MAXRETRY */
+#ifndef _PATH_RESCONF
+#define _PATH_RESCONF "/etc/resolv.conf"
+#endif /* ! _PATH_RESCONF */
+#ifndef T_OPT
+#define T_OPT 41
+#endif /* ! T_OPT */
+
+#define ARC_RES_EDNSSZ       1232 /* advertised UDP payload size */
+#define ARC_RES_OPTSZ        11   /* size of an empty OPT record */
+
+#define ARC_RES_STATE_UDP    0 /* waiting for a UDP reply */
+#define ARC_RES_STATE_TCPCON 1 /* waiting for a TCP connection */
+#define ARC_RES_STATE_TCPOUT 2 /* sending the query over TCP */
+#define ARC_RES_STATE_TCPIN  3 /* reading the reply over TCP */
+#define ARC_RES_STATE_DONE   4 /* reply available */
+#define ARC_RES_STATE_FAILED 5 /* all attempts exhausted */
 
 /*
-**  Standard UNIX resolver stub functions
+**  Non-blocking stub resolver
+**
+**  Each query gets its own socket, so any number of queries can be in
+**  flight at once and threads share nothing but the (read-only) server
+**  list.  A query tries each configured nameserver in turn over UDP,
+**  switching to TCP if the reply is truncated.
 */
 
+struct arc_res_svc
+{
+    int                     rs_nscount;
+    int                     rs_attempts;
+    int                     rs_timeout;
+    socklen_t               rs_nslen[MAXNS];
+    struct sockaddr_storage rs_ns[MAXNS];
+};
+
 struct arc_res_qh
 {
-    int    rq_error;
-    int    rq_dnssec;
-    size_t rq_buflen;
+    int            rq_fd;
+    int            rq_state;
+    int            rq_error;
+    int            rq_dnssec;
+    int            rq_try;
+    unsigned short rq_id;
+    size_t         rq_qlen;
+    size_t         rq_qsectlen;
+    size_t         rq_buflen;
+    size_t         rq_anslen;
+    size_t         rq_done;
+    unsigned char *rq_buf;
+    struct timeval rq_deadline;
+    unsigned char  rq_tcplen[INT16SZ];
+    unsigned char  rq_query[INT16SZ + HFIXEDSZ + MAXCDNAME + QFIXEDSZ +
+                           ARC_RES_OPTSZ];
 };
 
+/*
+**  ARC_RES_ADDNS -- add a nameserver to a service handle
+**
+**  Parameters:
+**  	svc -- service handle
+**  	addr -- numeric IPv4 or IPv6 address, optionally with a port
+**  	        ("192.0.2.1:5353" or "[2001:db8::1]:5353")
+**
+**  Return value:
+**  	0 on success, -1 on error.
+*/
+
+static int
+arc_res_addns(struct arc_res_svc *svc, const char *addr)
+{
+    const char      *end;
+    const char      *port = "53";
+    struct addrinfo  hints;
+    struct addrinfo *ai;
+    char             host[NI_MAXHOST];
+
+    if (svc->rs_nscount >= MAXNS)
+    {
+        return 0;
+    }
+
+    if (addr[0] == '[')
+    {
+        /* "[address]" or "[address]:port" */
+        addr++;
+        end = strchr(addr, ']');
+        if (end == NULL || (end[1] != '\0' && end[1] != ':'))
+        {
+            return -1;
+        }
+
+        if (end[1] == ':')
+        {
+            port = end + 2;
+        }
+    }
+    else
+    {
+        /* one colon separates a port, more make an IPv6 address */
+        end = strchr(addr, ':');
+        if (end == NULL || strchr(end + 1, ':') != NULL)
+        {
+            end = addr + strlen(addr);
+        }
+        else
+        {
+            port = end + 1;
+        }
+    }
+
+    if ((size_t) (end - addr) >= sizeof host)
+    {
+        return -1;
+    }
+
+    memcpy(host, addr, end - addr);
+    host[end - addr] = '\0';
+
+    memset(&hints, '\0', sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+    if (getaddrinfo(host, port, &hints, &ai) != 0)
+    {
+        return -1;
+    }
+
+    if (ai->ai_addrlen > sizeof svc->rs_ns[0])
+    {
+        freeaddrinfo(ai);
+        return -1;
+    }
+
+    memcpy(&svc->rs_ns[svc->rs_nscount], ai->ai_addr, ai->ai_addrlen);
+    svc->rs_nslen[svc->rs_nscount] = ai->ai_addrlen;
+    svc->rs_nscount++;
+
+    freeaddrinfo(ai);
+
+    return 0;
+}
+
+/*
+**  ARC_RES_READCONF -- load nameservers and options from resolv.conf
+**
+**  Parameters:
+**  	svc -- service handle
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_readconf(struct arc_res_svc *svc)
+{
+    FILE *f;
+    char *p;
+    char *tok;
+    char *last;
+    char  buf[BUFRSZ + 1];
+
+    f = fopen(_PATH_RESCONF, "r");
+    if (f == NULL)
+    {
+        return;
+    }
+
+    while (fgets(buf, sizeof buf, f) != NULL)
+    {
+        p = strpbrk(buf, "#;\n");
+        if (p != NULL)
+        {
+            *p = '\0';
+        }
+
+        tok = strtok_r(buf, " \t", &last);
+        if (tok == NULL)
+        {
+            continue;
+        }
+
+        if (strcmp(tok, "nameserver") == 0)
+        {
+            tok = strtok_r(NULL, " \t", &last);
+            if (tok != NULL)
+            {
+                (void) arc_res_addns(svc, tok);
+            }
+        }
+        else if (strcmp(tok, "options") == 0)
+        {
+            while ((tok = strtok_r(NULL, " \t", &last)) != NULL)
+            {
+                if (strncmp(tok, "timeout:", 8) == 0)
+                {
+                    svc->rs_timeout = MIN(MAX(atoi(tok + 8), 1),
+                                          RES_MAXRETRANS);
+                }
+                else if (strncmp(tok, "attempts:", 9) == 0)
+                {
+                    svc->rs_attempts = MIN(MAX(atoi(tok + 9), 1),
+                                           RES_MAXRETRY);
+                }
+            }
+        }
+    }
+
+    fclose(f);
+}
+
+/*
+**  ARC_RES_CLOSEFD -- release the socket used by a query, if any
+**
+**  Parameters:
+**  	rq -- query handle
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_closefd(struct arc_res_qh *rq)
+{
+    if (rq->rq_fd != -1)
+    {
+        close(rq->rq_fd);
+        rq->rq_fd = -1;
+    }
+}
+
+/*
+**  ARC_RES_SOCKET -- open a non-blocking socket to a nameserver
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**  	socktype -- SOCK_DGRAM or SOCK_STREAM
+**
+**  Return value:
+**  	0 on success (including a TCP connect in progress), -1 on error.
+*/
+
+static int
+arc_res_socket(struct arc_res_svc *svc, struct arc_res_qh *rq, int socktype)
+{
+    int                    fd;
+    int                    flags;
+    struct sockaddr_storage *ns;
+
+    arc_res_closefd(rq);
+
+    ns = &svc->rs_ns[rq->rq_try % svc->rs_nscount];
+
+    fd = socket(ns->ss_family, socktype, 0);
+    if (fd == -1)
+    {
+        rq->rq_error = errno;
+        return -1;
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+    {
+        rq->rq_error = errno;
+        close(fd);
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *) ns,
+                svc->rs_nslen[rq->rq_try % svc->rs_nscount]) == -1 &&
+        errno != EINPROGRESS)
+    {
+        rq->rq_error = errno;
+        close(fd);
+        return -1;
+    }
+
+    rq->rq_fd = fd;
+
+    return 0;
+}
+
+/*
+**  ARC_RES_SETDEADLINE -- start the clock on the current attempt
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_setdeadline(struct arc_res_svc *svc, struct arc_res_qh *rq)
+{
+    (void) gettimeofday(&rq->rq_deadline, NULL);
+    rq->rq_deadline.tv_sec += svc->rs_timeout;
+}
+
+/*
+**  ARC_RES_SEND -- start the next UDP attempt of a query
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**
+**  Return value:
+**  	None.  On return the query is either waiting for a UDP reply or
+**  	has exhausted its attempts.
+*/
+
+static void
+arc_res_send(struct arc_res_svc *svc, struct arc_res_qh *rq)
+{
+    for (; rq->rq_try < svc->rs_nscount * svc->rs_attempts; rq->rq_try++)
+    {
+        if (arc_res_socket(svc, rq, SOCK_DGRAM) != 0)
+        {
+            continue;
+        }
+
+        if (send(rq->rq_fd, rq->rq_query + INT16SZ, rq->rq_qlen, 0) !=
+            (ssize_t) rq->rq_qlen)
+        {
+            rq->rq_error = errno;
+            continue;
+        }
+
+        rq->rq_state = ARC_RES_STATE_UDP;
+        arc_res_setdeadline(svc, rq);
+        return;
+    }
+
+    arc_res_closefd(rq);
+    rq->rq_state = ARC_RES_STATE_FAILED;
+}
+
+/*
+**  ARC_RES_NEXT -- abandon the current attempt and move on
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**  	error -- why the current attempt is being abandoned
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_next(struct arc_res_svc *svc, struct arc_res_qh *rq, int error)
+{
+    rq->rq_error = error;
+    rq->rq_try++;
+    arc_res_send(svc, rq);
+}
+
+/*
+**  ARC_RES_CHECKREPLY -- see if a reply answers our question
+**
+**  Parameters:
+**  	rq -- query handle
+**  	len -- bytes of reply at rq->rq_buf
+**
+**  Return value:
+**  	true iff the reply has our ID and repeats our question.
+*/
+
+static bool
+arc_res_checkreply(struct arc_res_qh *rq, size_t len)
+{
+    size_t         c;
+    unsigned char *q;
+    unsigned char *a;
+    HEADER         hdr;
+
+    if (len < HFIXEDSZ + rq->rq_qsectlen)
+    {
+        return false;
+    }
+
+    memcpy(&hdr, rq->rq_buf, sizeof hdr);
+    if (ntohs(hdr.id) != rq->rq_id || hdr.qr != 1 ||
+        ntohs(hdr.qdcount) != 1)
+    {
+        return false;
+    }
+
+    q = rq->rq_query + INT16SZ + HFIXEDSZ;
+    a = rq->rq_buf + HFIXEDSZ;
+    for (c = 0; c < rq->rq_qsectlen; c++)
+    {
+        if (tolower(q[c]) != tolower(a[c]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+**  ARC_RES_ACCEPT -- decide what to do with a matching reply
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**  	len -- bytes of reply at rq->rq_buf
+**  	tcp -- reply arrived over TCP
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_accept(struct arc_res_svc *svc,
+               struct arc_res_qh  *rq,
+               size_t              len,
+               bool                tcp)
+{
+    HEADER hdr;
+
+    memcpy(&hdr, rq->rq_buf, sizeof hdr);
+
+    switch (hdr.rcode)
+    {
+    case NOERROR:
+    case NXDOMAIN:
+        break;
+
+    default:
+        /* this server can't help; try the next one */
+        arc_res_next(svc, rq, ECONNREFUSED);
+        return;
+    }
+
+    if (hdr.tc && !tcp)
+    {
+        /* retry the same server over TCP */
+        if (arc_res_socket(svc, rq, SOCK_STREAM) != 0)
+        {
+            arc_res_next(svc, rq, rq->rq_error);
+            return;
+        }
+
+        rq->rq_state = ARC_RES_STATE_TCPCON;
+        rq->rq_done = 0;
+        arc_res_setdeadline(svc, rq);
+        return;
+    }
+
+    arc_res_closefd(rq);
+    rq->rq_anslen = len;
+    rq->rq_error = 0;
+    rq->rq_state = ARC_RES_STATE_DONE;
+}
+
+/*
+**  ARC_RES_IO -- make progress on a query whose socket is ready
+**
+**  Parameters:
+**  	svc -- service handle
+**  	rq -- query handle
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_res_io(struct arc_res_svc *svc, struct arc_res_qh *rq)
+{
+    int     soerr;
+    ssize_t n;
+
+    for (;;)
+    {
+        switch (rq->rq_state)
+        {
+        case ARC_RES_STATE_UDP:
+            n = recv(rq->rq_fd, rq->rq_buf, rq->rq_buflen, 0);
+            if (n == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    arc_res_next(svc, rq, errno);
+                }
+                return;
+            }
+
+            /* ignore anything that isn't a reply to this query */
+            if (arc_res_checkreply(rq, n))
+            {
+                arc_res_accept(svc, rq, n, false);
+
+                /*
+                **  Whatever comes next is on a new socket, and a TCP
+                **  connect in particular has to be polled for POLLOUT
+                **  before it can be checked.
+                */
+
+                return;
+            }
+            break;
+
+        case ARC_RES_STATE_TCPCON:
+        {
+            socklen_t slen = sizeof soerr;
+
+            if (getsockopt(rq->rq_fd, SOL_SOCKET, SO_ERROR, &soerr, &slen) ==
+                -1)
+            {
+                soerr = errno;
+            }
+
+            if (soerr != 0)
+            {
+                arc_res_next(svc, rq, soerr);
+                return;
+            }
+
+            rq->rq_state = ARC_RES_STATE_TCPOUT;
+            break;
+        }
+
+        case ARC_RES_STATE_TCPOUT:
+            n = send(rq->rq_fd, rq->rq_query + rq->rq_done,
+                     INT16SZ + rq->rq_qlen - rq->rq_done, 0);
+            if (n == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    arc_res_next(svc, rq, errno);
+                }
+                return;
+            }
+
+            rq->rq_done += n;
+            if (rq->rq_done == INT16SZ + rq->rq_qlen)
+            {
+                rq->rq_state = ARC_RES_STATE_TCPIN;
+                rq->rq_done = 0;
+                rq->rq_anslen = 0;
+            }
+            break;
+
+        case ARC_RES_STATE_TCPIN:
+            if (rq->rq_done < INT16SZ)
+            {
+                /* the two-byte length prefix */
+                n = recv(rq->rq_fd, rq->rq_tcplen + rq->rq_done,
+                         INT16SZ - rq->rq_done, 0);
+            }
+            else
+            {
+                n = recv(rq->rq_fd, rq->rq_buf + rq->rq_done - INT16SZ,
+                         rq->rq_anslen - (rq->rq_done - INT16SZ), 0);
+            }
+
+            if (n == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    arc_res_next(svc, rq, errno);
+                }
+                return;
+            }
+            else if (n == 0)
+            {
+                arc_res_next(svc, rq, ECONNRESET);
+                return;
+            }
+
+            rq->rq_done += n;
+            if (rq->rq_done == INT16SZ)
+            {
+                rq->rq_anslen = (rq->rq_tcplen[0] << 8) | rq->rq_tcplen[1];
+                if (rq->rq_anslen > rq->rq_buflen || rq->rq_anslen == 0)
+                {
+                    arc_res_next(svc, rq, EMSGSIZE);
+                    return;
+                }
+            }
+            else if (rq->rq_done == INT16SZ + rq->rq_anslen)
+            {
+                if (arc_res_checkreply(rq, rq->rq_anslen))
+                {
+                    arc_res_accept(svc, rq, rq->rq_anslen, true);
+                }
+                else
+                {
+                    arc_res_next(svc, rq, EPROTO);
+                }
+            }
+            break;
+
+        default:
+            return;
+        }
+
+        if (rq->rq_state == ARC_RES_STATE_DONE ||
+            rq->rq_state == ARC_RES_STATE_FAILED)
+        {
+            return;
+        }
+    }
+}
+
 /*
 **  ARC_RES_INIT -- initialize the resolver
 **
@@ -57,35 +681,29 @@ struct arc_res_qh
 int
 arc_res_init(void **srv)
 {
-#ifdef HAVE_RES_NINIT
-    struct __res_state *res;
+    struct arc_res_svc *svc;
 
-    res = ARC_CALLOC(1, sizeof(struct __res_state));
-    if (res == NULL)
+    svc = ARC_CALLOC(1, sizeof *svc);
+    if (svc == NULL)
     {
         return -1;
     }
 
-    if (res_ninit(res) != 0)
+    svc->rs_timeout = RES_TIMEOUT;
+    svc->rs_attempts = RES_DFLRETRY;
+
+    arc_res_readconf(svc);
+
+    /* same default as the stock resolver */
+    if (svc->rs_nscount == 0 && arc_res_addns(svc, "127.0.0.1") != 0)
     {
-        ARC_FREE(res);
+        ARC_FREE(svc);
         return -1;
     }
 
-    *srv = res;
+    *srv = svc;
 
     return 0;
-#else  /* HAVE_RES_NINIT */
-    if (res_init() == 0)
-    {
-        *srv = (void *) 0x01;
-        return 0;
-    }
-    else
-    {
-        return -1;
-    }
-#endif /* HAVE_RES_NINIT */
 }
 
 /*
@@ -101,17 +719,7 @@ arc_res_init(void **srv)
 void
 arc_res_close(void *srv)
 {
-#ifdef HAVE_RES_NINIT
-    struct __res_state *res;
-
-    res = srv;
-
-    if (res != NULL)
-    {
-        res_nclose(res);
-        ARC_FREE(res);
-    }
-#endif /* HAVE_RES_NINIT */
+    ARC_FREE(srv);
 }
 
 /*
@@ -119,23 +727,25 @@ arc_res_close(void *srv)
 **
 **  Parameters:
 **  	srv -- query service handle (ignored)
-**  	qh -- query handle (ignored)
+**  	qh -- query handle
 **
 **  Return value:
 **  	0 on success, !0 on error
 **
 **  Notes:
-**  	The standard UNIX resolver is synchronous, so in theory this can
-**  	never get called.  We have not yet got any use cases for one thread
-**  	canceling another thread's pending queries, so for now just return 0.
+**  	This also releases the handle of a query that has completed.
 */
 
 int
 arc_res_cancel(void *srv, void *qh)
 {
-    if (qh != NULL)
+    struct arc_res_qh *rq;
+
+    rq = qh;
+    if (rq != NULL)
     {
-        ARC_FREE(qh);
+        arc_res_closefd(rq);
+        ARC_FREE(rq);
     }
 
     return 0;
@@ -145,7 +755,7 @@ arc_res_cancel(void *srv, void *qh)
 **  ARC_RES_QUERY -- initiate a DNS query
 **
 **  Parameters:
-**  	srv -- service handle (ignored)
+**  	srv -- service handle
 **  	type -- RR type to query
 **  	query -- the question to ask
 **  	buf -- where to write the answer
@@ -156,10 +766,9 @@ arc_res_cancel(void *srv, void *qh)
 **  	0 on success, -1 on error
 **
 **  Notes:
-**  	This is a stub for the stock UNIX resolver (res_) functions, which
-**  	are synchronous so no handle needs to be created, so "qh" is set to
-**  	"buf".  "buf" is actually populated before this returns (unless
-**  	there's an error).
+**  	The query is sent before this returns, but "buf" is not populated
+**  	until arc_res_waitreply() reports success, so it must remain valid
+**  	until then (or until the query is canceled).
 */
 
 int
@@ -170,52 +779,85 @@ arc_res_query(void          *srv,
               size_t         buflen,
               void         **qh)
 {
-    int                n;
-    int                ret;
-    struct arc_res_qh *rq;
-    unsigned char      qbuf[HFIXEDSZ + MAXPACKET];
-#ifdef HAVE_RES_NINIT
-    struct __res_state *statp;
-#endif /* HAVE_RES_NINIT */
-
-#ifdef HAVE_RES_NINIT
-    statp = srv;
-    n = res_nmkquery(statp, QUERY, query, C_IN, type, NULL, 0, NULL, qbuf,
-                     sizeof qbuf);
-#else  /* HAVE_RES_NINIT */
-    n = res_mkquery(QUERY, query, C_IN, type, NULL, 0, NULL, qbuf, sizeof qbuf);
-#endif /* HAVE_RES_NINIT */
-    if (n == (size_t) -1)
+    int                 n;
+    unsigned char      *p;
+    unsigned char      *end;
+    struct arc_res_svc *svc;
+    struct arc_res_qh  *rq;
+    HEADER              hdr;
+
+    assert(srv != NULL);
+    assert(query != NULL);
+    assert(buf != NULL);
+    assert(qh != NULL);
+
+    svc = srv;
+
+    if (buflen < HFIXEDSZ)
     {
         return ARC_DNS_ERROR;
     }
 
-#ifdef HAVE_RES_NINIT
-    ret = res_nsend(statp, qbuf, n, buf, buflen);
-#else  /* HAVE_RES_NINIT */
-    ret = res_send(qbuf, n, buf, buflen);
-#endif /* HAVE_RES_NINIT */
-    if (ret == -1)
+    rq = ARC_CALLOC(1, sizeof *rq);
+    if (rq == NULL)
     {
         return ARC_DNS_ERROR;
     }
 
-    rq = ARC_MALLOC(sizeof *rq);
-    if (rq == NULL)
+    rq->rq_fd = -1;
+    rq->rq_dnssec = ARC_DNSSEC_UNKNOWN;
+    rq->rq_buf = buf;
+    rq->rq_buflen = MIN(buflen, MAXPACKET * 8);
+
+    if (RAND_bytes((unsigned char *) &rq->rq_id, sizeof rq->rq_id) != 1)
     {
+        ARC_FREE(rq);
         return ARC_DNS_ERROR;
     }
 
-    rq->rq_dnssec = ARC_DNSSEC_UNKNOWN;
-    if (ret == -1)
+    /* build the query after room for the TCP length prefix */
+    memset(&hdr, '\0', sizeof hdr);
+    hdr.id = htons(rq->rq_id);
+    hdr.opcode = QUERY;
+    hdr.rd = 1;
+    hdr.qdcount = htons(1);
+    hdr.arcount = htons(1);
+
+    p = rq->rq_query + INT16SZ;
+    end = rq->rq_query + sizeof rq->rq_query;
+
+    memcpy(p, &hdr, HFIXEDSZ);
+    p += HFIXEDSZ;
+
+    n = dn_comp(query, p, end - p - QFIXEDSZ - ARC_RES_OPTSZ, NULL, NULL);
+    if (n < 0)
     {
-        rq->rq_error = errno;
-        rq->rq_buflen = 0;
+        ARC_FREE(rq);
+        return ARC_DNS_ERROR;
     }
-    else
+    p += n;
+
+    PUTSHORT(type, p);
+    PUTSHORT(C_IN, p);
+    rq->rq_qsectlen = p - (rq->rq_query + INT16SZ + HFIXEDSZ);
+
+    /* EDNS0 OPT record so larger keys fit in a UDP reply */
+    *p++ = 0;
+    PUTSHORT(T_OPT, p);
+    PUTSHORT(MIN(rq->rq_buflen, ARC_RES_EDNSSZ), p);
+    PUTLONG(0, p);
+    PUTSHORT(0, p);
+
+    rq->rq_qlen = p - (rq->rq_query + INT16SZ);
+    rq->rq_query[0] = (rq->rq_qlen >> 8) & 0xff;
+    rq->rq_query[1] = rq->rq_qlen & 0xff;
+
+    rq->rq_error = ETIMEDOUT;
+    arc_res_send(svc, rq);
+    if (rq->rq_state == ARC_RES_STATE_FAILED)
     {
-        rq->rq_error = 0;
-        rq->rq_buflen = (size_t) ret;
+        ARC_FREE(rq);
+        return ARC_DNS_ERROR;
     }
 
     *qh = (void *) rq;
@@ -229,16 +871,16 @@ arc_res_query(void          *srv,
 **  Parameters:
 **  	srv -- service handle
 **  	qh -- query handle
-**  	to -- timeout
+**  	to -- timeout (NULL to wait until the query succeeds or fails)
 **  	bytes -- number of bytes in the reply (returned)
 **  	error -- error code (returned)
+**  	dnssec -- DNSSEC status (returned)
 **
 **  Return value:
-**  	A ARC_DNS_* code.
-**
-**  Notes:
-**  	Since the stock UNIX resolver is synchronous, the reply was completed
-** 	before arc_res_query() returned, and thus this is almost a no-op.
+**  	ARC_DNS_SUCCESS -- reply available
+**  	ARC_DNS_NOREPLY -- "to" elapsed; the query is still pending
+**  	ARC_DNS_EXPIRED -- every attempt timed out
+**  	ARC_DNS_ERROR -- every attempt failed, at least one with an error
 */
 
 int
@@ -249,59 +891,124 @@ arc_res_waitreply(void           *srv,
                   int            *error,
                   int            *dnssec)
 {
-    struct arc_res_qh *rq;
+    int                 ms;
+    struct arc_res_svc *svc;
+    struct arc_res_qh  *rq;
+    struct timeval      now;
+    struct timeval      limit;
+    struct timeval     *wake;
+    struct pollfd       pfd;
 
+    assert(srv != NULL);
     assert(qh != NULL);
 
+    svc = srv;
     rq = qh;
 
-    if (bytes != NULL)
-    {
-        *bytes = rq->rq_buflen;
-    }
-    if (error != NULL)
+    if (to != NULL)
     {
-        *error = rq->rq_error;
+        (void) gettimeofday(&limit, NULL);
+        timeradd(&limit, to, &limit);
     }
-    if (dnssec != NULL)
+
+    for (;;)
     {
-        *dnssec = rq->rq_dnssec;
-    }
+        if (rq->rq_state == ARC_RES_STATE_DONE)
+        {
+            if (bytes != NULL)
+            {
+                *bytes = rq->rq_anslen;
+            }
+            if (error != NULL)
+            {
+                *error = 0;
+            }
+            if (dnssec != NULL)
+            {
+                *dnssec = rq->rq_dnssec;
+            }
 
-    return ARC_DNS_SUCCESS;
+            return ARC_DNS_SUCCESS;
+        }
+        else if (rq->rq_state == ARC_RES_STATE_FAILED)
+        {
+            if (error != NULL)
+            {
+                *error = rq->rq_error;
+            }
+
+            return rq->rq_error == ETIMEDOUT ? ARC_DNS_EXPIRED : ARC_DNS_ERROR;
+        }
+
+        (void) gettimeofday(&now, NULL);
+
+        if (!timercmp(&now, &rq->rq_deadline, <))
+        {
+            arc_res_next(svc, rq, ETIMEDOUT);
+            continue;
+        }
+
+        wake = &rq->rq_deadline;
+        if (to != NULL)
+        {
+            if (!timercmp(&now, &limit, <))
+            {
+                return ARC_DNS_NOREPLY;
+            }
+
+            if (timercmp(&limit, wake, <))
+            {
+                wake = &limit;
+            }
+        }
+
+        ms = (wake->tv_sec - now.tv_sec) * 1000 +
+             (wake->tv_usec - now.tv_usec + 999) / 1000;
+
+        pfd.fd = rq->rq_fd;
+        pfd.events = (rq->rq_state == ARC_RES_STATE_TCPCON ||
+                      rq->rq_state == ARC_RES_STATE_TCPOUT)
+                         ? POLLOUT
+                         : POLLIN;
+        pfd.revents = 0;
+
+        if (poll(&pfd, 1, MAX(ms, 0)) > 0)
+        {
+            arc_res_io(svc, rq);
+        }
+    }
 }
 
 /*
-**  ARC_RES_SETNS -- set nameserver list
+**  ARC_RES_NSLIST -- set nameserver list
 **
 **  Parameters:
 **  	srv -- service handle
-**  	nslist -- nameserver list, as a string
+**  	nslist -- comma-separated list of nameserver addresses
 **
 **  Return value:
 **  	ARC_DNS_SUCCESS -- success
 **  	ARC_DNS_ERROR -- error
+**
+**  Notes:
+**  	This must not be called while queries are outstanding.
 */
 
 int
 arc_res_nslist(void *srv, const char *nslist)
 {
-#ifdef HAVE_RES_SETSERVERS
-    int                nscount = 0;
-    char              *tmp;
-    char              *ns;
-    char              *last = NULL;
-    struct sockaddr_in in;
-#ifdef AF_INET6
-    struct sockaddr_in6 in6;
-#endif /* AF_INET6 */
-    struct state      *res;
-    res_sockaddr_union nses[MAXNS];
+    char               *tmp;
+    char               *ns;
+    char               *last = NULL;
+    struct arc_res_svc *svc;
+    struct arc_res_svc  new;
 
     assert(srv != NULL);
     assert(nslist != NULL);
 
-    memset(nses, '\0', sizeof nses);
+    svc = srv;
+    memcpy(&new, svc, sizeof new);
+    new.rs_nscount = 0;
 
     tmp = ARC_STRDUP(nslist);
     if (tmp == NULL)
@@ -309,45 +1016,24 @@ arc_res_nslist(void *srv, const char *nslist)
         return ARC_DNS_ERROR;
     }
 
-    for (ns = strtok_r(tmp, ",", &last);
-	     ns != NULL && nscount < MAXNS;
-	     ns = strtok_r(NULL, ",", &last)
-	{
-        memset(&in, '\0', sizeof in);
-#ifdef AF_INET6
-        memset(&in6, '\0', sizeof in6);
-#endif /* AF_INET6 */
-
-        if (inet_pton(AF_INET, ns, (struct in_addr *) &in.sin_addr,
-                      sizeof in.sin_addr) == 1)
-        {
-            in.sin_family = AF_INET;
-            in.sin_port = htons(DNSPORT);
-            memcpy(&nses[nscount].sin, &in, sizeof nses[nscount].sin);
-            nscount++;
-        }
-#ifdef AF_INET6
-        else if (inet_pton(AF_INET6, ns, (struct in6_addr *) &in6.sin6_addr,
-                           sizeof in6.sin6_addr) == 1)
-        {
-            in6.sin6_family = AF_INET6;
-            in6.sin6_port = htons(DNSPORT);
-            memcpy(&nses[nscount].sin6, &in6, sizeof nses[nscount].sin6);
-            nscount++;
-        }
-#endif /* AF_INET6 */
-        else
+    for (ns = strtok_r(tmp, ",", &last); ns != NULL;
+         ns = strtok_r(NULL, ",", &last))
+    {
+        if (arc_res_addns(&new, ns) != 0)
         {
             ARC_FREE(tmp);
             return ARC_DNS_ERROR;
         }
-	}
+    }
 
-	res = srv;
-	res_setservers(res, nses, nscount);
+    ARC_FREE(tmp);
 
-	ARC_FREE(tmp);
-#endif /* HAVE_RES_SETSERVERS */
+    if (new.rs_nscount == 0)
+    {
+        return ARC_DNS_ERROR;
+    }
 
-	return ARC_DNS_SUCCESS;
+    memcpy(svc, &new, sizeof new);
+
+    return ARC_DNS_SUCCESS;
 }
@@ -35,10 +35,10 @@
 #define MAXBUFRSZ          65536 /* max temp buffer size */
 #define MAXTAGNAME         8     /* biggest tag name */
 
-#define NPRINTABLE         95 /* number of printable characters */
-
 #define ARC_MAXHEADER      4096 /* buffer for caching one header */
 #define ARC_MAXHOSTNAMELEN 256  /* max. FQDN we support */
+#define ARC_HDRINDEXSIZE   64   /* buckets in the header name index */
+#define ARC_KVSET_NTAGS    12   /* tags stored inline in a set */
 
 /* defaults */
 #define DEFTMPDIR          "/tmp" /* default temporary directory */
@@ -56,6 +56,27 @@ typedef int arc_kvsettype_t;
 #define ARC_KVSETTYPE_AR        3
 #define ARC_KVSETTYPE_MAX       3 /* sentinel value */
 
+/*
+**  ARC_TAG -- tag names interned when a set is parsed
+*/
+
+#define ARC_TAG_OTHER 0 /* anything not listed here */
+#define ARC_TAG_A     1
+#define ARC_TAG_B     2
+#define ARC_TAG_BH    3
+#define ARC_TAG_C     4
+#define ARC_TAG_CV    5
+#define ARC_TAG_D     6
+#define ARC_TAG_H     7
+#define ARC_TAG_I     8
+#define ARC_TAG_K     9
+#define ARC_TAG_L     10
+#define ARC_TAG_P     11
+#define ARC_TAG_S     12
+#define ARC_TAG_T     13
+#define ARC_TAG_V     14
+#define ARC_TAG_X     15
+
 /*
 **  ARC_HASHTYPE -- types of hashes
 */
@@ -70,6 +91,7 @@ typedef int arc_kvsettype_t;
 
 #define ARC_KEYTYPE_UNKNOWN     (-1)
 #define ARC_KEYTYPE_RSA         0
+#define ARC_KEYTYPE_ED25519     1
 
 /*
 **  ARC_QUERY -- types of queries
@@ -86,7 +108,7 @@ struct arc_kvset;
 typedef struct arc_kvset ARC_KVSET;
 
 /*
-**  ARC_PLIST -- a parameter/value pair, as a linked list
+**  ARC_PLIST -- a parameter/value pair
 */
 
 struct arc_plist;
@@ -0,0 +1,396 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#include "build-config.h"
+
+/* system includes */
+#include <assert.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* OpenSSL includes */
+#include <openssl/evp.h>
+
+/* libopenarc includes */
+#include "arc-keycache.h"
+#include "arc-malloc.h"
+#include "arc-types.h"
+
+/* struct arc_keycache_entry -- one cached key lookup */
+struct arc_keycache_entry
+{
+    uint32_t                   kce_hash;
+    time_t                     kce_expire;
+    struct arc_keyinfo         kce_info;
+    char                      *kce_name;
+    struct arc_keycache_entry *kce_chain;
+    struct arc_keycache_entry *kce_prev;
+    struct arc_keycache_entry *kce_next;
+};
+
+/* struct arc_keycache -- a bounded, thread-safe cache of key lookups */
+struct arc_keycache
+{
+    unsigned int                kc_maxentries;
+    unsigned int                kc_nentries;
+    unsigned int                kc_nbuckets;
+    pthread_mutex_t             kc_lock;
+    struct arc_keycache_entry **kc_buckets;
+    struct arc_keycache_entry  *kc_head; /* most recently used */
+    struct arc_keycache_entry  *kc_tail; /* least recently used */
+};
+
+/*
+**  ARC_KEYCACHE_HASH -- hash a key record name, ignoring case
+**
+**  Parameters:
+**  	name -- record name
+**
+**  Return value:
+**  	32-bit FNV-1a hash of the lowercased name.
+*/
+
+static uint32_t
+arc_keycache_hash(const char *name)
+{
+    uint32_t h = 2166136261U;
+
+    for (; *name != '\0'; name++)
+    {
+        h ^= (unsigned char) tolower((unsigned char) *name);
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/*
+**  ARC_KEYCACHE_UNLINK -- remove an entry from the hash chain and LRU list
+**
+**  Parameters:
+**  	kc -- key cache
+**  	kce -- entry to remove
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Caller must hold kc_lock.
+*/
+
+static void
+arc_keycache_unlink(struct arc_keycache *kc, struct arc_keycache_entry *kce)
+{
+    struct arc_keycache_entry **pp;
+
+    for (pp = &kc->kc_buckets[kce->kce_hash % kc->kc_nbuckets]; *pp != kce;
+         pp = &(*pp)->kce_chain)
+    {
+        assert(*pp != NULL);
+    }
+    *pp = kce->kce_chain;
+
+    if (kce->kce_prev != NULL)
+    {
+        kce->kce_prev->kce_next = kce->kce_next;
+    }
+    else
+    {
+        kc->kc_head = kce->kce_next;
+    }
+
+    if (kce->kce_next != NULL)
+    {
+        kce->kce_next->kce_prev = kce->kce_prev;
+    }
+    else
+    {
+        kc->kc_tail = kce->kce_prev;
+    }
+
+    kc->kc_nentries--;
+}
+
+/*
+**  ARC_KEYCACHE_ENTRY_FREE -- release an unlinked entry
+**
+**  Parameters:
+**  	kce -- entry to release
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_keycache_entry_free(struct arc_keycache_entry *kce)
+{
+    EVP_PKEY_free(kce->kce_info.ki_pkey);
+    ARC_FREE(kce->kce_name);
+    ARC_FREE(kce);
+}
+
+/*
+**  ARC_KEYCACHE_NEW -- create a key cache
+**
+**  Parameters:
+**  	maxentries -- maximum number of entries to retain
+**
+**  Return value:
+**  	A new key cache, or NULL on error.
+*/
+
+struct arc_keycache *
+arc_keycache_new(unsigned int maxentries)
+{
+    struct arc_keycache *kc;
+
+    assert(maxentries > 0);
+
+    kc = ARC_CALLOC(1, sizeof *kc);
+    if (kc == NULL)
+    {
+        return NULL;
+    }
+
+    kc->kc_maxentries = maxentries;
+    kc->kc_nbuckets = maxentries;
+    kc->kc_buckets = ARC_CALLOC(kc->kc_nbuckets, sizeof *kc->kc_buckets);
+    if (kc->kc_buckets == NULL)
+    {
+        ARC_FREE(kc);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&kc->kc_lock, NULL) != 0)
+    {
+        ARC_FREE(kc->kc_buckets);
+        ARC_FREE(kc);
+        return NULL;
+    }
+
+    return kc;
+}
+
+/*
+**  ARC_KEYCACHE_FREE -- destroy a key cache
+**
+**  Parameters:
+**  	kc -- key cache to destroy
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_keycache_free(struct arc_keycache *kc)
+{
+    struct arc_keycache_entry *kce;
+
+    if (kc == NULL)
+    {
+        return;
+    }
+
+    while (kc->kc_head != NULL)
+    {
+        kce = kc->kc_head;
+        kc->kc_head = kce->kce_next;
+        arc_keycache_entry_free(kce);
+    }
+
+    pthread_mutex_destroy(&kc->kc_lock);
+    ARC_FREE(kc->kc_buckets);
+    ARC_FREE(kc);
+}
+
+/*
+**  ARC_KEYCACHE_GET -- look up a key record in the cache
+**
+**  Parameters:
+**  	kc -- key cache
+**  	name -- record name
+**  	now -- current time
+**  	ki -- key information (returned)
+**
+**  Return value:
+**  	true iff an unexpired entry was found.  The caller owns a reference
+**  	to any EVP_PKEY returned in "ki" and must release it.
+*/
+
+bool
+arc_keycache_get(struct arc_keycache *kc,
+                 const char          *name,
+                 time_t               now,
+                 struct arc_keyinfo  *ki)
+{
+    uint32_t                   hash;
+    struct arc_keycache_entry *kce;
+
+    assert(kc != NULL);
+    assert(name != NULL);
+    assert(ki != NULL);
+
+    hash = arc_keycache_hash(name);
+
+    pthread_mutex_lock(&kc->kc_lock);
+
+    for (kce = kc->kc_buckets[hash % kc->kc_nbuckets]; kce != NULL;
+         kce = kce->kce_chain)
+    {
+        if (kce->kce_hash == hash && strcasecmp(kce->kce_name, name) == 0)
+        {
+            break;
+        }
+    }
+
+    if (kce == NULL)
+    {
+        pthread_mutex_unlock(&kc->kc_lock);
+        return false;
+    }
+
+    if (kce->kce_expire <= now)
+    {
+        arc_keycache_unlink(kc, kce);
+        pthread_mutex_unlock(&kc->kc_lock);
+        arc_keycache_entry_free(kce);
+        return false;
+    }
+
+    /* move it to the front of the LRU list */
+    if (kce != kc->kc_head)
+    {
+        kce->kce_prev->kce_next = kce->kce_next;
+        if (kce->kce_next != NULL)
+        {
+            kce->kce_next->kce_prev = kce->kce_prev;
+        }
+        else
+        {
+            kc->kc_tail = kce->kce_prev;
+        }
+
+        kce->kce_prev = NULL;
+        kce->kce_next = kc->kc_head;
+        kc->kc_head->kce_prev = kce;
+        kc->kc_head = kce;
+    }
+
+    memcpy(ki, &kce->kce_info, sizeof *ki);
+    if (ki->ki_pkey != NULL)
+    {
+        EVP_PKEY_up_ref(ki->ki_pkey);
+    }
+
+    pthread_mutex_unlock(&kc->kc_lock);
+
+    return true;
+}
+
+/*
+**  ARC_KEYCACHE_PUT -- add or replace a key record in the cache
+**
+**  Parameters:
+**  	kc -- key cache
+**  	name -- record name
+**  	expire -- time at which the entry expires
+**  	ki -- key information to store; the cache takes its own reference
+**  	      to any EVP_PKEY it contains
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Failure to allocate simply means the result isn't cached.
+*/
+
+void
+arc_keycache_put(struct arc_keycache      *kc,
+                 const char               *name,
+                 time_t                    expire,
+                 const struct arc_keyinfo *ki)
+{
+    uint32_t                   hash;
+    struct arc_keycache_entry *kce;
+    struct arc_keycache_entry *old = NULL;
+    struct arc_keycache_entry *evict = NULL;
+
+    assert(kc != NULL);
+    assert(name != NULL);
+    assert(ki != NULL);
+
+    kce = ARC_CALLOC(1, sizeof *kce);
+    if (kce == NULL)
+    {
+        return;
+    }
+
+    kce->kce_name = ARC_STRDUP(name);
+    if (kce->kce_name == NULL)
+    {
+        ARC_FREE(kce);
+        return;
+    }
+
+    hash = arc_keycache_hash(name);
+    kce->kce_hash = hash;
+    kce->kce_expire = expire;
+    memcpy(&kce->kce_info, ki, sizeof kce->kce_info);
+    if (ki->ki_pkey != NULL)
+    {
+        EVP_PKEY_up_ref(ki->ki_pkey);
+    }
+
+    pthread_mutex_lock(&kc->kc_lock);
+
+    /* drop any existing entry for the same name */
+    for (old = kc->kc_buckets[hash % kc->kc_nbuckets]; old != NULL;
+         old = old->kce_chain)
+    {
+        if (old->kce_hash == hash && strcasecmp(old->kce_name, name) == 0)
+        {
+            arc_keycache_unlink(kc, old);
+            break;
+        }
+    }
+
+    if (kc->kc_nentries >= kc->kc_maxentries)
+    {
+        evict = kc->kc_tail;
+        arc_keycache_unlink(kc, evict);
+    }
+
+    kce->kce_chain = kc->kc_buckets[hash % kc->kc_nbuckets];
+    kc->kc_buckets[hash % kc->kc_nbuckets] = kce;
+
+    kce->kce_next = kc->kc_head;
+    if (kc->kc_head != NULL)
+    {
+        kc->kc_head->kce_prev = kce;
+    }
+    kc->kc_head = kce;
+    if (kc->kc_tail == NULL)
+    {
+        kc->kc_tail = kce;
+    }
+
+    kc->kc_nentries++;
+
+    pthread_mutex_unlock(&kc->kc_lock);
+
+    if (old != NULL)
+    {
+        arc_keycache_entry_free(old);
+    }
+
+    if (evict != NULL)
+    {
+        arc_keycache_entry_free(evict);
+    }
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#ifndef ARC_ARC_KEYCACHE_H_
+#define ARC_ARC_KEYCACHE_H_
+
+/* system includes */
+#include <stdbool.h>
+#include <time.h>
+
+/* libopenarc includes */
+#include "arc-types.h"
+
+/* opaque key cache handle */
+struct arc_keycache;
+
+/* prototypes */
+extern struct arc_keycache *arc_keycache_new(unsigned int);
+extern void                 arc_keycache_free(struct arc_keycache *);
+extern bool arc_keycache_get(struct arc_keycache *,
+                             const char *,
+                             time_t,
+                             struct arc_keyinfo *);
+extern void arc_keycache_put(struct arc_keycache *,
+                             const char *,
+                             time_t,
+                             const struct arc_keyinfo *);
+
+#endif /* ! ARC_ARC_KEYCACHE_H_ */
@@ -14,16 +14,19 @@
 #include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <resolv.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "build-config.h"
 
 /* libopendkim includes */
 #include "arc-internal.h"
+#include "arc-keycache.h"
 #include "arc-keys.h"
 #include "arc-types.h"
 #include "arc-util.h"
@@ -56,58 +59,110 @@ extern void arc_error(ARC_MESSAGE *, const char *, ...);
 #endif /* ! T_RRSIG */
 
 /*
-**  ARC_GET_KEY_DNS -- retrieve a key from DNS
+**  ARC_GET_NEGTTL -- find the negative caching TTL in a DNS reply
 **
 **  Parameters:
-**  	msg -- ARC_MESSAGE handle
-**  	buf -- buffer into which to write the result
-**  	buflen -- bytes available at "buf"
+**  	cp -- start of the answer section
+**  	eom -- end of the reply
+**  	ancount -- records in the answer section
+**  	nscount -- records in the authority section
 **
 **  Return value:
-**  	A ARC_STAT_* constant.
+**  	The negative caching TTL per RFC 2308 section 5, or 0 if the
+**  	authority section contains no usable SOA record.
 */
 
-ARC_STAT
-arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
+static uint32_t
+arc_get_negttl(unsigned char *cp, unsigned char *eom, int ancount, int nscount)
 {
-    int status;
-    int qdcount;
-    int ancount;
-    int error;
-    int dnssec = ARC_DNSSEC_UNKNOWN;
-    int c;
-    int n = 0;
-    int rdlength = 0;
-    int type = -1;
-    int class = -1;
-    size_t         anslen;
-    void          *q;
-    ARC_LIB       *lib;
-    unsigned char *txtfound = NULL;
-    char          *p;
-    unsigned char *cp;
-    unsigned char *eom;
-    char          *eob;
-    char           qname[ARC_MAXHOSTNAMELEN + 1];
-    unsigned char  ansbuf[MAXPACKET];
-    struct timeval timeout;
-    HEADER         hdr;
+    int            c;
+    int            n;
+    int            type;
+    int            rdlength;
+    uint32_t       ttl;
+    uint32_t       minimum;
+    unsigned char *mp;
+
+    for (c = ancount + nscount; c > 0; c--)
+    {
+        if ((n = dn_skipname(cp, eom)) < 0)
+        {
+            return 0;
+        }
+        cp += n;
 
-    assert(msg != NULL);
-    assert(msg->arc_selector != NULL);
-    assert(msg->arc_domain != NULL);
+        if (cp + INT16SZ + INT16SZ + INT32SZ + INT16SZ > eom)
+        {
+            return 0;
+        }
 
-    lib = msg->arc_library;
+        GETSHORT(type, cp); /* TYPE */
+        cp += INT16SZ;      /* CLASS */
+        GETLONG(ttl, cp);   /* TTL */
+        GETSHORT(rdlength, cp);
 
-    n = snprintf(qname, sizeof qname - 1, "%s.%s.%s", msg->arc_selector,
-                 ARC_DNSKEYNAME, msg->arc_domain);
-    if (n == -1 || n > sizeof qname - 1)
+        if (cp + rdlength > eom)
+        {
+            return 0;
+        }
+
+        /* the SOA MINIMUM field is the last thing in the RDATA */
+        if (c <= nscount && type == T_SOA && rdlength >= 5 * INT32SZ)
+        {
+            mp = cp + rdlength - INT32SZ;
+            GETLONG(minimum, mp);
+            return MIN(ttl, minimum);
+        }
+
+        cp += rdlength;
+    }
+
+    return 0;
+}
+
+/* struct arc_keyquery -- a key lookup started ahead of arc_get_key() */
+struct arc_keyquery
+{
+    int                  kq_dnssec;
+    size_t               kq_anslen;
+    void                *kq_qh; /* NULL once the reply is in */
+    char                *kq_qname;
+    struct arc_keyquery *kq_next;
+};
+
+/*
+**  ARC_KEY_QNAME -- construct the DNS name of a key record
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	selector -- selector
+**  	domain -- signing domain
+**  	qname -- buffer into which to write the name
+**  	qnamelen -- bytes available at "qname"
+**
+**  Return value:
+**  	A ARC_STAT_* constant.
+*/
+
+static ARC_STAT
+arc_key_qname(ARC_MESSAGE *msg,
+              const char  *selector,
+              const char  *domain,
+              char        *qname,
+              size_t       qnamelen)
+{
+    int   n;
+    int   status;
+    char *qname_idn;
+
+    n = snprintf(qname, qnamelen - 1, "%s.%s.%s", selector, ARC_DNSKEYNAME,
+                 domain);
+    if (n == -1 || n > qnamelen - 1)
     {
         arc_error(msg, "key query name too large");
         return ARC_STAT_NORESOURCE;
     }
 
-    char *qname_idn;
     status = idn2_to_ascii_8z(qname, &qname_idn,
                               IDN2_NONTRANSITIONAL | IDN2_NFC_INPUT);
     if (status != IDN2_OK)
@@ -117,7 +172,7 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
         return ARC_STAT_KEYFAIL;
     }
 
-    if (strlcpy(qname, qname_idn, sizeof qname) >= sizeof qname)
+    if (strlcpy(qname, qname_idn, qnamelen) >= qnamelen)
     {
         arc_error(msg, "key query name too large");
         idn2_free(qname_idn);
@@ -125,27 +180,176 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
     }
     idn2_free(qname_idn);
 
-    anslen = sizeof ansbuf;
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_DNS_READY -- make sure the library's DNS service is initialized
+**
+**  Parameters:
+**  	lib -- ARC_LIB handle
+**
+**  Return value:
+**  	true iff the service is ready for queries.
+*/
 
-    timeout.tv_sec = msg->arc_timeout;
-    timeout.tv_usec = 0;
+static bool
+arc_dns_ready(ARC_LIB *lib)
+{
+    bool ret = true;
 
-    if (lib->arcl_dns_service == NULL && lib->arcl_dns_init != NULL &&
-        lib->arcl_dns_init(&lib->arcl_dns_service) != 0)
+    /* the service is shared, so only the first query starts it */
+    pthread_mutex_lock(&lib->arcl_dns_lock);
+    if (!lib->arcl_dnsinit_done)
     {
-        arc_error(msg, "cannot initialize resolver");
-        return ARC_STAT_KEYFAIL;
+        if (lib->arcl_dns_service == NULL && lib->arcl_dns_init != NULL &&
+            lib->arcl_dns_init(&lib->arcl_dns_service) != 0)
+        {
+            ret = false;
+        }
+        else
+        {
+            lib->arcl_dnsinit_done = true;
+        }
     }
+    pthread_mutex_unlock(&lib->arcl_dns_lock);
 
-    status = lib->arcl_dns_start(lib->arcl_dns_service, T_TXT, qname, ansbuf,
-                                 anslen, &q);
+    return ret;
+}
 
-    if (status != 0)
+/*
+**  ARC_PREFETCH_KEY -- start a key lookup without waiting for it
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	selector -- selector
+**  	domain -- signing domain
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Failures are ignored; arc_get_key_dns() will simply issue (and
+**  	report on) the query itself.
+*/
+
+void
+arc_prefetch_key(ARC_MESSAGE *msg, const char *selector, const char *domain)
+{
+    ARC_LIB             *lib;
+    struct arc_keyquery *kq;
+    struct arc_keyinfo   ki;
+    char                 qname[ARC_MAXHOSTNAMELEN + 1];
+
+    lib = msg->arc_library;
+
+    /* no point asking if the answer is already cached */
+    if (lib->arcl_keycache != NULL &&
+        snprintf(qname, sizeof qname, "%s.%s.%s", selector, ARC_DNSKEYNAME,
+                 domain) < sizeof qname &&
+        arc_keycache_get(lib->arcl_keycache, qname, time(NULL), &ki))
     {
-        arc_error(msg, "'%s' query failed", qname);
-        return ARC_STAT_KEYFAIL;
+        EVP_PKEY_free(ki.ki_pkey);
+        return;
+    }
+
+    if (arc_key_qname(msg, selector, domain, qname, sizeof qname) !=
+        ARC_STAT_OK)
+    {
+        return;
+    }
+
+    /* several sets are often signed with the same key */
+    for (kq = msg->arc_keyqueries; kq != NULL; kq = kq->kq_next)
+    {
+        if (strcasecmp(kq->kq_qname, qname) == 0)
+        {
+            return;
+        }
     }
 
+    if (!arc_dns_ready(lib))
+    {
+        return;
+    }
+
+    kq = ARC_CALLOC(1, sizeof *kq + MAXPACKET);
+    if (kq == NULL)
+    {
+        return;
+    }
+
+    kq->kq_qname = ARC_STRDUP(qname);
+    if (kq->kq_qname == NULL ||
+        lib->arcl_dns_start(lib->arcl_dns_service, T_TXT, qname,
+                            (unsigned char *) (kq + 1), MAXPACKET,
+                            &kq->kq_qh) != 0)
+    {
+        ARC_FREE(kq->kq_qname);
+        ARC_FREE(kq);
+        return;
+    }
+
+    kq->kq_next = msg->arc_keyqueries;
+    msg->arc_keyqueries = kq;
+}
+
+/*
+**  ARC_PREFETCH_CANCEL -- abandon any key lookups that were never collected
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_prefetch_cancel(ARC_MESSAGE *msg)
+{
+    ARC_LIB             *lib;
+    struct arc_keyquery *kq;
+
+    lib = msg->arc_library;
+
+    while (msg->arc_keyqueries != NULL)
+    {
+        kq = msg->arc_keyqueries;
+        msg->arc_keyqueries = kq->kq_next;
+
+        if (kq->kq_qh != NULL)
+        {
+            (void) lib->arcl_dns_cancel(lib->arcl_dns_service, kq->kq_qh);
+        }
+        ARC_FREE(kq->kq_qname);
+        ARC_FREE(kq);
+    }
+}
+
+/*
+**  ARC_KEY_WAITREPLY -- wait for a key query to complete
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	q -- query handle
+**  	anslen -- size of the reply (returned)
+**  	dnssec -- DNSSEC status of the reply (returned)
+**
+**  Return value:
+**  	An ARC_DNS_* constant.  ARC_DNS_NOREPLY means the message's
+**  	timeout elapsed before an answer arrived.
+*/
+
+static int
+arc_key_waitreply(ARC_MESSAGE *msg, void *q, size_t *anslen, int *dnssec)
+{
+    int            status;
+    int            error;
+    ARC_LIB       *lib;
+    struct timeval timeout;
+
+    lib = msg->arc_library;
+
     if (lib->arcl_dns_callback == NULL)
     {
         timeout.tv_sec = msg->arc_timeout;
@@ -153,7 +357,7 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
 
         status = lib->arcl_dns_waitreply(
             lib->arcl_dns_service, q, msg->arc_timeout == 0 ? NULL : &timeout,
-            &anslen, &error, &dnssec);
+            anslen, &error, dnssec);
     }
     else
     {
@@ -174,7 +378,7 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
             status = lib->arcl_dns_waitreply(lib->arcl_dns_service, q,
                                              msg->arc_timeout == 0 ? NULL
                                                                    : &timeout,
-                                             &anslen, &error, &dnssec);
+                                             anslen, &error, dnssec);
 
             if (wt == &next)
             {
@@ -194,21 +398,147 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
         }
     }
 
-    if (status == ARC_DNS_EXPIRED)
+    return status;
+}
+
+/*
+**  ARC_GET_KEY_DNS -- retrieve a key from DNS
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	buf -- buffer into which to write the result
+**  	buflen -- bytes available at "buf"
+**  	ttl -- how long the result may be cached, or 0 (returned)
+**
+**  Return value:
+**  	A ARC_STAT_* constant.
+**
+**  Notes:
+**  	"ttl" is set for a successful lookup and for a missing record
+**  	whose reply carried negative caching information.
+*/
+
+ARC_STAT
+arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen, uint32_t *ttl)
+{
+    int status;
+    int qdcount;
+    int ancount;
+    int dnssec = ARC_DNSSEC_UNKNOWN;
+    int c;
+    int n = 0;
+    int rdlength = 0;
+    int type = -1;
+    int class = -1;
+    uint32_t              rrttl;
+    size_t                anslen;
+    void                 *q;
+    ARC_LIB              *lib;
+    struct arc_keyquery  *kq = NULL;
+    struct arc_keyquery **kqp;
+    unsigned char        *txtfound = NULL;
+    char                 *p;
+    unsigned char        *cp;
+    unsigned char        *eom;
+    char                 *eob;
+    char                  qname[ARC_MAXHOSTNAMELEN + 1];
+    unsigned char         ansbuf[MAXPACKET];
+    HEADER                hdr;
+
+    assert(msg != NULL);
+    assert(msg->arc_selector != NULL);
+    assert(msg->arc_domain != NULL);
+    assert(ttl != NULL);
+
+    *ttl = 0;
+    lib = msg->arc_library;
+
+    status = arc_key_qname(msg, msg->arc_selector, msg->arc_domain, qname,
+                           sizeof qname);
+    if (status != ARC_STAT_OK)
+    {
+        return status;
+    }
+
+    anslen = sizeof ansbuf;
+
+    /* pick up the query started by arc_prefetch_key(), if there was one */
+    for (kqp = &msg->arc_keyqueries; *kqp != NULL; kqp = &(*kqp)->kq_next)
+    {
+        if (strcasecmp((*kqp)->kq_qname, qname) == 0)
+        {
+            kq = *kqp;
+            break;
+        }
+    }
+
+    if (kq != NULL && kq->kq_qh == NULL)
     {
+        /* already collected for another signature in this message */
+        anslen = kq->kq_anslen;
+        dnssec = kq->kq_dnssec;
+        memcpy(ansbuf, kq + 1, anslen);
+        status = ARC_DNS_SUCCESS;
+    }
+    else
+    {
+        if (kq != NULL)
+        {
+            q = kq->kq_qh;
+        }
+        else
+        {
+            if (!arc_dns_ready(lib))
+            {
+                arc_error(msg, "cannot initialize resolver");
+                return ARC_STAT_KEYFAIL;
+            }
+
+            status = lib->arcl_dns_start(lib->arcl_dns_service, T_TXT, qname,
+                                         ansbuf, anslen, &q);
+            if (status != 0)
+            {
+                arc_error(msg, "'%s' query failed", qname);
+                return ARC_STAT_KEYFAIL;
+            }
+        }
+
+        status = arc_key_waitreply(msg, q, &anslen, &dnssec);
+
         (void) lib->arcl_dns_cancel(lib->arcl_dns_service, q);
+
+        if (kq != NULL)
+        {
+            kq->kq_qh = NULL;
+
+            if (status == ARC_DNS_SUCCESS)
+            {
+                anslen = MIN(anslen, MAXPACKET);
+                kq->kq_anslen = anslen;
+                kq->kq_dnssec = dnssec;
+                memcpy(ansbuf, kq + 1, anslen);
+            }
+            else
+            {
+                *kqp = kq->kq_next;
+                ARC_FREE(kq->kq_qname);
+                ARC_FREE(kq);
+            }
+        }
+    }
+
+    /* NOREPLY here means the overall timeout elapsed first */
+    if (status == ARC_DNS_EXPIRED || status == ARC_DNS_NOREPLY)
+    {
         arc_error(msg, "'%s' query timed out", qname);
         return ARC_STAT_KEYFAIL;
     }
     else if (status == ARC_DNS_ERROR)
     {
-        (void) lib->arcl_dns_cancel(lib->arcl_dns_service, q);
         arc_error(msg, "'%s' query failed", qname);
         return ARC_STAT_KEYFAIL;
     }
 
-    (void) lib->arcl_dns_cancel(lib->arcl_dns_service, q);
-
     msg->arc_dnssec_key = dnssec;
 
     /* set up pointers */
@@ -250,6 +580,8 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
     /* if NXDOMAIN, return ARC_STAT_NOKEY */
     if (hdr.rcode == NXDOMAIN)
     {
+        *ttl = arc_get_negttl(cp, eom, ntohs((unsigned short) hdr.ancount),
+                              ntohs((unsigned short) hdr.nscount));
         arc_error(msg, "'%s' record not found", qname);
         return ARC_STAT_NOKEY;
     }
@@ -265,6 +597,7 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
     ancount = ntohs((unsigned short) hdr.ancount);
     if (ancount == 0)
     {
+        *ttl = arc_get_negttl(cp, eom, 0, ntohs((unsigned short) hdr.nscount));
         return ARC_STAT_NOKEY;
     }
 
@@ -293,9 +626,8 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
 
         GETSHORT(type, cp);  /* TYPE */
         GETSHORT(class, cp); /* CLASS */
-        /* skip the TTL */
-        cp += INT32SZ;   /* TTL */
-        GETSHORT(n, cp); /* RDLENGTH */
+        GETLONG(rrttl, cp);  /* TTL */
+        GETSHORT(n, cp);     /* RDLENGTH */
 
         /* skip CNAME if found; assume it was resolved */
         if (type == T_CNAME)
@@ -323,6 +655,7 @@ arc_get_key_dns(ARC_MESSAGE *msg, char *buf, size_t buflen)
         /* remember where this one started */
         txtfound = cp;
         rdlength = n;
+        *ttl = rrttl;
 
         /* move forward for now */
         cp += n;
@@ -12,7 +12,9 @@
 #include "arc.h"
 
 /* prototypes */
-extern ARC_STAT arc_get_key_dns(ARC_MESSAGE *, char *, size_t);
+extern ARC_STAT arc_get_key_dns(ARC_MESSAGE *, char *, size_t, uint32_t *);
 extern ARC_STAT arc_get_key_file(ARC_MESSAGE *, char *, size_t);
+extern void     arc_prefetch_cancel(ARC_MESSAGE *);
+extern void     arc_prefetch_key(ARC_MESSAGE *, const char *, const char *);
 
 #endif /* ! ARC_ARC_KEYS_H_ */
@@ -0,0 +1,369 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#include "build-config.h"
+
+/* system includes */
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* libopenarc includes */
+#include "arc-malloc.h"
+#include "arc-pool.h"
+
+/* struct arc_pool -- worker threads sharing a bounded FIFO of jobs */
+struct arc_pool
+{
+    bool            pool_shutdown;
+    unsigned int    pool_nthreads;
+    unsigned int    pool_maxqueue; /* 0 means unbounded */
+    unsigned int    pool_queued;
+    pthread_mutex_t pool_lock;
+    pthread_cond_t  pool_work; /* a job was queued, or shutting down */
+    pthread_cond_t  pool_done; /* some batch's job finished */
+    struct arc_job *pool_head;
+    struct arc_job *pool_tail;
+    pthread_t      *pool_threads;
+};
+
+/*
+**  ARC_POOL_DEQUEUE -- take the oldest queued job
+**
+**  Parameters:
+**  	pool -- worker pool
+**
+**  Return value:
+**  	The job.
+**
+**  Notes:
+**  	Caller must hold pool_lock, and the queue must not be empty.
+*/
+
+static struct arc_job *
+arc_pool_dequeue(struct arc_pool *pool)
+{
+    struct arc_job *job;
+
+    job = pool->pool_head;
+    assert(job != NULL);
+
+    pool->pool_head = job->job_next;
+    if (pool->pool_head == NULL)
+    {
+        pool->pool_tail = NULL;
+    }
+    pool->pool_queued--;
+
+    return job;
+}
+
+/*
+**  ARC_POOL_FINISH -- account for a completed job
+**
+**  Parameters:
+**  	pool -- worker pool
+**  	job -- job that has run
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Caller must hold pool_lock.  Once the batch drains its owner may
+**  	release the job, so it must not be touched afterwards.
+*/
+
+static void
+arc_pool_finish(struct arc_pool *pool, struct arc_job *job)
+{
+    struct arc_batch *batch = job->job_batch;
+
+    assert(batch->batch_pending > 0);
+
+    batch->batch_pending--;
+    if (batch->batch_pending == 0)
+    {
+        pthread_cond_broadcast(&pool->pool_done);
+    }
+}
+
+/*
+**  ARC_POOL_WORKER -- worker thread mainline
+**
+**  Parameters:
+**  	arg -- worker pool
+**
+**  Return value:
+**  	NULL.
+*/
+
+static void *
+arc_pool_worker(void *arg)
+{
+    struct arc_pool *pool = arg;
+    struct arc_job  *job;
+
+    pthread_mutex_lock(&pool->pool_lock);
+
+    for (;;)
+    {
+        while (pool->pool_head == NULL && !pool->pool_shutdown)
+        {
+            pthread_cond_wait(&pool->pool_work, &pool->pool_lock);
+        }
+
+        if (pool->pool_head == NULL)
+        {
+            break;
+        }
+
+        job = arc_pool_dequeue(pool);
+
+        pthread_mutex_unlock(&pool->pool_lock);
+        job->job_run(job);
+        pthread_mutex_lock(&pool->pool_lock);
+
+        arc_pool_finish(pool, job);
+    }
+
+    pthread_mutex_unlock(&pool->pool_lock);
+
+    return NULL;
+}
+
+/*
+**  ARC_POOL_NEW -- create a worker pool
+**
+**  Parameters:
+**  	nthreads -- number of worker threads
+**  	maxqueue -- most jobs to hold waiting for a worker, or 0 for no limit
+**
+**  Return value:
+**  	A new worker pool, or NULL on error.
+**
+**  Notes:
+**  	The workers block every signal, so they never take one meant for
+**  	the application.
+*/
+
+struct arc_pool *
+arc_pool_new(unsigned int nthreads, unsigned int maxqueue)
+{
+    unsigned int     n;
+    struct arc_pool *pool;
+    sigset_t         all;
+    sigset_t         old;
+
+    assert(nthreads > 0);
+
+    pool = ARC_CALLOC(1, sizeof *pool);
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    pool->pool_maxqueue = maxqueue;
+
+    pool->pool_threads = ARC_CALLOC(nthreads, sizeof *pool->pool_threads);
+    if (pool->pool_threads == NULL)
+    {
+        ARC_FREE(pool);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&pool->pool_lock, NULL) != 0)
+    {
+        ARC_FREE(pool->pool_threads);
+        ARC_FREE(pool);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&pool->pool_work, NULL) != 0)
+    {
+        pthread_mutex_destroy(&pool->pool_lock);
+        ARC_FREE(pool->pool_threads);
+        ARC_FREE(pool);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&pool->pool_done, NULL) != 0)
+    {
+        pthread_cond_destroy(&pool->pool_work);
+        pthread_mutex_destroy(&pool->pool_lock);
+        ARC_FREE(pool->pool_threads);
+        ARC_FREE(pool);
+        return NULL;
+    }
+
+    sigfillset(&all);
+    (void) pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    for (n = 0; n < nthreads; n++)
+    {
+        if (pthread_create(&pool->pool_threads[n], NULL, arc_pool_worker,
+                           pool) != 0)
+        {
+            break;
+        }
+
+        pool->pool_nthreads++;
+    }
+
+    (void) pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (pool->pool_nthreads < nthreads)
+    {
+        arc_pool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+/*
+**  ARC_POOL_FREE -- stop the workers and destroy a pool
+**
+**  Parameters:
+**  	pool -- worker pool to destroy
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	No batch may still be outstanding.
+*/
+
+void
+arc_pool_free(struct arc_pool *pool)
+{
+    unsigned int n;
+
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->pool_lock);
+    pool->pool_shutdown = true;
+    pthread_cond_broadcast(&pool->pool_work);
+    pthread_mutex_unlock(&pool->pool_lock);
+
+    for (n = 0; n < pool->pool_nthreads; n++)
+    {
+        (void) pthread_join(pool->pool_threads[n], NULL);
+    }
+
+    assert(pool->pool_head == NULL);
+
+    pthread_cond_destroy(&pool->pool_done);
+    pthread_cond_destroy(&pool->pool_work);
+    pthread_mutex_destroy(&pool->pool_lock);
+    ARC_FREE(pool->pool_threads);
+    ARC_FREE(pool);
+}
+
+/*
+**  ARC_POOL_SUBMIT -- hand a job to the pool
+**
+**  Parameters:
+**  	pool -- worker pool
+**  	batch -- batch the job belongs to
+**  	job -- job to run
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	If the queue is full the job is run at once by the calling thread,
+**  	so a burst of work can't grow the queue without bound.  Either way
+**  	the job has not necessarily finished until arc_pool_wait() returns
+**  	for its batch.
+*/
+
+void
+arc_pool_submit(struct arc_pool  *pool,
+                struct arc_batch *batch,
+                struct arc_job   *job)
+{
+    assert(pool != NULL);
+    assert(batch != NULL);
+    assert(job != NULL);
+
+    job->job_batch = batch;
+    job->job_next = NULL;
+
+    pthread_mutex_lock(&pool->pool_lock);
+
+    if (pool->pool_maxqueue != 0 && pool->pool_queued >= pool->pool_maxqueue)
+    {
+        pthread_mutex_unlock(&pool->pool_lock);
+        job->job_run(job);
+        return;
+    }
+
+    if (pool->pool_tail == NULL)
+    {
+        pool->pool_head = job;
+    }
+    else
+    {
+        pool->pool_tail->job_next = job;
+    }
+    pool->pool_tail = job;
+    pool->pool_queued++;
+    batch->batch_pending++;
+
+    pthread_cond_signal(&pool->pool_work);
+
+    pthread_mutex_unlock(&pool->pool_lock);
+}
+
+/*
+**  ARC_POOL_WAIT -- wait for every job in a batch to finish
+**
+**  Parameters:
+**  	pool -- worker pool
+**  	batch -- batch to wait for
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Rather than sleep while jobs are still queued, the calling thread
+**  	runs them itself, whichever batch they belong to.
+*/
+
+void
+arc_pool_wait(struct arc_pool *pool, struct arc_batch *batch)
+{
+    struct arc_job *job;
+
+    assert(pool != NULL);
+    assert(batch != NULL);
+
+    pthread_mutex_lock(&pool->pool_lock);
+
+    while (batch->batch_pending > 0)
+    {
+        if (pool->pool_head != NULL)
+        {
+            job = arc_pool_dequeue(pool);
+
+            pthread_mutex_unlock(&pool->pool_lock);
+            job->job_run(job);
+            pthread_mutex_lock(&pool->pool_lock);
+
+            arc_pool_finish(pool, job);
+        }
+        else
+        {
+            pthread_cond_wait(&pool->pool_done, &pool->pool_lock);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->pool_lock);
+}
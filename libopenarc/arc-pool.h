@@ -0,0 +1,34 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#ifndef ARC_ARC_POOL_H_
+#define ARC_ARC_POOL_H_
+
+/* opaque worker pool handle */
+struct arc_pool;
+
+/* struct arc_batch -- jobs whose completion is awaited together */
+struct arc_batch
+{
+    unsigned int batch_pending; /* queued or running on a worker */
+};
+
+/* struct arc_job -- a unit of work, embedded in the caller's own state */
+struct arc_job
+{
+    void (*job_run)(struct arc_job *);
+    struct arc_batch *job_batch;
+    struct arc_job   *job_next;
+};
+
+/* prototypes */
+extern struct arc_pool *arc_pool_new(unsigned int, unsigned int);
+extern void             arc_pool_free(struct arc_pool *);
+extern void arc_pool_submit(struct arc_pool *,
+                            struct arc_batch *,
+                            struct arc_job *);
+extern void arc_pool_wait(struct arc_pool *, struct arc_batch *);
+
+#endif /* ! ARC_ARC_POOL_H_ */
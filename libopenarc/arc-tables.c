@@ -20,9 +20,10 @@
 /* lookup tables */
 static struct nametable prv_algorithms[] = /* signing algorithms */
     {
-        {"rsa-sha1",   ARC_SIGN_RSASHA1  },
-        {"rsa-sha256", ARC_SIGN_RSASHA256},
-        {NULL,         -1                },
+        {"rsa-sha1",       ARC_SIGN_RSASHA1      },
+        {"rsa-sha256",     ARC_SIGN_RSASHA256    },
+        {"ed25519-sha256", ARC_SIGN_ED25519SHA256},
+        {NULL,             -1                    },
 };
 struct nametable       *algorithms = prv_algorithms;
 
@@ -61,8 +62,9 @@ struct nametable       *keyflags = prv_keyflags;
 
 static struct nametable prv_keytypes[] = /* key types */
     {
-        {"rsa", ARC_KEYTYPE_RSA},
-        {NULL,  -1             },
+        {"rsa",     ARC_KEYTYPE_RSA    },
+        {"ed25519", ARC_KEYTYPE_ED25519},
+        {NULL,      -1                 },
 };
 struct nametable       *keytypes = prv_keytypes;
 
@@ -8,6 +8,7 @@
 #include "build-config.h"
 
 /* system includes */
+#include <pthread.h>
 #include <regex.h>
 #include <stdbool.h>
 #include <sys/types.h>
@@ -21,6 +22,7 @@
 
 /* libopenarc includes */
 #include "arc-internal.h"
+#include "arc-pool.h"
 #include "arc.h"
 
 /* struct arc_hash -- stuff needed to do a hash */
@@ -33,6 +35,35 @@ struct arc_hash
     unsigned int  hash_outlen;
 };
 
+/* struct arc_keyinfo -- a decoded key record, as cached in the library */
+struct arc_keyinfo
+{
+    ARC_STAT      ki_status;
+    int           ki_dnssec;
+    int           ki_keytype;
+    unsigned int  ki_hashes;
+    unsigned long ki_flags;
+    EVP_PKEY     *ki_pkey;
+};
+
+/* struct arc_verify -- one signature check, split around its crypto */
+struct arc_verify
+{
+    struct arc_job av_job; /* must be first */
+    bool           av_seal;
+    bool           av_done; /* results consumed by arc_validate_end() */
+    ARC_STAT       av_status;
+    unsigned int   av_setnum;
+    unsigned int   av_keytype;
+    unsigned int   av_hashtype;
+    size_t         av_siglen;
+    size_t         av_hashlen;
+    const char    *av_error; /* static text from a worker */
+    unsigned char *av_sig;
+    void          *av_hash;
+    EVP_PKEY      *av_pkey;
+};
+
 /* struct arc_qmethod -- signature query method */
 struct arc_qmethod
 {
@@ -49,6 +80,15 @@ struct arc_xtag
     struct arc_xtag *xt_next;
 };
 
+/* struct arc_signkey -- a decoded private key, shared between messages */
+struct arc_signkey
+{
+    unsigned int    sk_refcnt;
+    int             sk_keytype;
+    pthread_mutex_t sk_lock;
+    EVP_PKEY       *sk_pkey;
+};
+
 /* struct arc_hdrfield -- a header field */
 struct arc_hdrfield
 {
@@ -56,16 +96,32 @@ struct arc_hdrfield
     size_t               hdr_namelen;
     size_t               hdr_textlen;
     char                *hdr_text;
+    size_t               hdr_relaxedlen;
+    char                *hdr_relaxed; /* cached relaxed canonical form */
     void                *hdr_data;
+    struct arc_hdrfield *hdr_prevname; /* previous field with this name */
     struct arc_hdrfield *hdr_next;
 };
 
 /* hdr_flags bits */
-#define ARC_HDR_SIGNED 0x01
+#define ARC_HDR_SIGNED  0x01
+#define ARC_HDR_NOCACHE 0x02 /* temporary; don't cache canonical forms */
+
+/* struct arc_hdrname -- all occurrences of one header field name */
+struct arc_hdrname
+{
+    uint32_t             hn_hash;
+    unsigned int         hn_gen;    /* selection pass that set hn_cursor */
+    struct arc_hdrfield *hn_last;   /* last occurrence in the message */
+    struct arc_hdrfield *hn_cursor; /* next occurrence to select */
+    struct arc_hdrname  *hn_next;
+};
 
 /* struct arc_set -- a complete single set of ARC header fields */
 struct arc_set
 {
+    arc_canon_t          arcset_hdrcanon; /* from the AMS c= */
+    arc_canon_t          arcset_bodycanon;
     struct arc_hdrfield *arcset_aar;
     struct arc_hdrfield *arcset_ams;
     struct arc_hdrfield *arcset_as;
@@ -74,9 +130,9 @@ struct arc_set
 /* struct arc_plist -- a parameter/value pair */
 struct arc_plist
 {
-    char             *plist_param;
-    char             *plist_value;
-    struct arc_plist *plist_next;
+    int   plist_tag; /* ARC_TAG_* */
+    char *plist_param;
+    char *plist_value;
 };
 
 /* struct arc_kvset -- a set of parameter/value pairs */
@@ -84,10 +140,20 @@ struct arc_kvset
 {
     bool              set_bad;
     arc_kvsettype_t   set_type;
+    unsigned int      set_nplist;
+    unsigned int      set_maxplist;
     char             *set_data;
     void             *set_udata;
-    struct arc_plist *set_plist[NPRINTABLE];
+    struct arc_plist *set_plist; /* set_inline, or a bigger arena copy */
     struct arc_kvset *set_next;
+    struct arc_plist  set_inline[ARC_KVSET_NTAGS];
+};
+
+/* struct arc_spare -- hash state kept for reuse by arc_message_reset() */
+struct arc_spare
+{
+    EVP_MD_CTX         *sp_ctx;
+    struct arc_dstring *sp_buf;
 };
 
 /* struct arc_canon -- a canonicalization status handle */
@@ -95,6 +161,7 @@ struct arc_canon
 {
     bool                 canon_done;
     bool                 canon_blankline;
+    bool                 canon_follower;
     int                  canon_type;
     int                  canon_lastchar;
     int                  canon_bodystate;
@@ -111,6 +178,7 @@ struct arc_canon
     struct arc_hash     *canon_hash;
     struct arc_dstring  *canon_buf;
     struct arc_hdrfield *canon_sigheader;
+    struct arc_canon    *canon_fanout; /* next hash fed by this stream */
     struct arc_canon    *canon_next;
 };
 
@@ -119,39 +187,42 @@ struct arc_msghandle
 {
     bool                 arc_partial;
     bool                 arc_infail;
+    bool                 arc_sealsdone;
+    bool                 arc_oldestpending; /* arc_oldest_pass not found yet */
     int                  arc_dnssec_key;
     int                  arc_signalg;
+    int                  arc_lastbodychar;
     int                  arc_oldest_pass;
     unsigned int         arc_mode;
     unsigned int         arc_nsets;
     unsigned int         arc_margin;
     unsigned int         arc_state;
     unsigned int         arc_hdrcnt;
+    unsigned int         arc_hdrgen;
     unsigned int         arc_timeout;
     unsigned int         arc_keybits;
+    unsigned int         arc_verifybits; /* key bits used verifying so far */
     unsigned int         arc_keytype;
     unsigned int         arc_hashtype;
     unsigned int         arc_sigttl;
+    unsigned int         arc_ncanonspares;
+    unsigned int         arc_maxcanonspares;
     unsigned long        arc_flags;
     arc_query_t          arc_query;
     time_t               arc_timestamp;
     size_t               arc_siglen;
-    size_t               arc_keylen;
     size_t               arc_errorlen;
-    size_t               arc_b64keylen;
     ssize_t              arc_bodylen;
     arc_canon_t          arc_canonhdr;
     arc_canon_t          arc_canonbody;
     ARC_CHAIN            arc_cstate;
-    unsigned char       *arc_key;
     char                *arc_error;
-    char                *arc_hdrlist;
     const char          *arc_domain;
     const char          *arc_selector;
     const char          *arc_authservid;
     char                *arc_b64sig;
-    char                *arc_b64key;
     void                *arc_signature;
+    EVP_PKEY            *arc_pkey;
     struct arc_qmethod  *arc_querymethods;
     struct arc_xtag     *arc_xtags;
     struct arc_dstring  *arc_canonbuf;
@@ -164,6 +235,7 @@ struct arc_msghandle
     struct arc_canon    *arc_sign_bodycanon;
     struct arc_canon    *arc_canonhead;
     struct arc_canon    *arc_canontail;
+    struct arc_hdrname **arc_hdrindex;
     struct arc_hdrfield *arc_hhead;
     struct arc_hdrfield *arc_htail;
     struct arc_hdrfield *arc_sealhead;
@@ -171,6 +243,10 @@ struct arc_msghandle
     struct arc_kvset    *arc_kvsethead;
     struct arc_kvset    *arc_kvsettail;
     struct arc_set      *arc_sets;
+    struct arc_keyquery *arc_keyqueries;
+    struct arc_arena    *arc_arena;
+    struct arc_arena    *arc_arenaspare; /* chunks kept by a reset */
+    struct arc_spare    *arc_canonspares;
     ARC_LIB             *arc_library;
     const void          *arc_user_context;
 };
@@ -178,17 +254,28 @@ struct arc_msghandle
 /* struct arc_lib -- a ARC library context */
 struct arc_lib
 {
-    bool                arcl_signre;
-    bool                arcl_dnsinit_done;
-    unsigned int        arcl_flsize;
-    unsigned int        arcl_sigttl;
-    uint32_t            arcl_flags;
-    time_t              arcl_fixedtime;
-    unsigned int        arcl_callback_int;
-    unsigned int        arcl_minkeysize;
-    unsigned int       *arcl_flist;
-    struct arc_dstring *arcl_sslerrbuf;
-    char              **arcl_oversignhdrs;
+    bool                 arcl_signre;
+    bool                 arcl_dnsinit_done;
+    unsigned int         arcl_flsize;
+    unsigned int         arcl_sigttl;
+    uint32_t             arcl_flags;
+    time_t               arcl_fixedtime;
+    unsigned int         arcl_callback_int;
+    unsigned int         arcl_minkeysize;
+    unsigned int         arcl_maxverifybits;
+    unsigned int         arcl_keycache_size;
+    unsigned int         arcl_keycache_maxttl;
+    unsigned int         arcl_crypto_threads;
+    unsigned int         arcl_crypto_queue;
+    pthread_mutex_t      arcl_dns_lock;
+    unsigned int        *arcl_flist;
+    struct arc_dstring  *arcl_sslerrbuf;
+    char               **arcl_oversignhdrs;
+    struct arc_keycache *arcl_keycache;
+    struct arc_pool     *arcl_pool;
+    void *(*arcl_malloc)(void *closure, size_t nbytes);
+    void (*arcl_free)(void *closure, void *ptr);
+    void *arcl_memclosure;
     void (*arcl_dns_callback)(const void *context);
     void *arcl_dns_service;
     int (*arcl_dns_init)(void **srv);
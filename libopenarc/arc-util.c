@@ -17,14 +17,17 @@
 #include <resolv.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/param.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 /* libopenarc includes */
+#include "arc-arena.h"
 #include "arc-internal.h"
 #include "arc-types.h"
 #include "arc-util.h"
@@ -144,6 +147,124 @@ arc_hdrlist(char *buf, size_t buflen, char **hdrlist, bool first)
     return true;
 }
 
+/*
+**  ARC_HDRINDEX_HASH -- hash a header field name, ignoring case
+**
+**  Parameters:
+**  	name -- header field name
+**  	len -- bytes at "name"
+**
+**  Return value:
+**  	32-bit FNV-1a hash of the lowercased name.
+*/
+
+static uint32_t
+arc_hdrindex_hash(const char *name, size_t len)
+{
+    uint32_t h = 2166136261U;
+
+    while (len-- > 0)
+    {
+        h ^= (unsigned char) tolower((unsigned char) *name++);
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/*
+**  ARC_HDRINDEX_ADD -- add a header field to a message's name index
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	hdr -- header field, which must be the last one seen so far
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+ARC_STAT
+arc_hdrindex_add(ARC_MESSAGE *msg, struct arc_hdrfield *hdr)
+{
+    uint32_t            hash;
+    struct arc_hdrname *hn;
+
+    assert(msg != NULL);
+    assert(hdr != NULL);
+
+    if (msg->arc_hdrindex == NULL)
+    {
+        msg->arc_hdrindex = arc_arena_calloc(msg, ARC_HDRINDEXSIZE,
+                                             sizeof *msg->arc_hdrindex);
+        if (msg->arc_hdrindex == NULL)
+        {
+            return ARC_STAT_NORESOURCE;
+        }
+    }
+
+    hn = arc_hdrindex_find(msg, hdr->hdr_text, hdr->hdr_namelen);
+    if (hn == NULL)
+    {
+        hash = arc_hdrindex_hash(hdr->hdr_text, hdr->hdr_namelen);
+
+        hn = arc_arena_calloc(msg, 1, sizeof *hn);
+        if (hn == NULL)
+        {
+            return ARC_STAT_NORESOURCE;
+        }
+
+        hn->hn_hash = hash;
+        hn->hn_next = msg->arc_hdrindex[hash % ARC_HDRINDEXSIZE];
+        msg->arc_hdrindex[hash % ARC_HDRINDEXSIZE] = hn;
+    }
+
+    hdr->hdr_prevname = hn->hn_last;
+    hn->hn_last = hdr;
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_HDRINDEX_FIND -- look up a header field name in a message's index
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**  	name -- header field name
+**  	len -- bytes at "name"
+**
+**  Return value:
+**  	The index entry for "name", or NULL if no such field was seen.
+*/
+
+struct arc_hdrname *
+arc_hdrindex_find(ARC_MESSAGE *msg, const char *name, size_t len)
+{
+    uint32_t            hash;
+    struct arc_hdrname *hn;
+
+    assert(msg != NULL);
+    assert(name != NULL);
+
+    if (msg->arc_hdrindex == NULL)
+    {
+        return NULL;
+    }
+
+    hash = arc_hdrindex_hash(name, len);
+
+    for (hn = msg->arc_hdrindex[hash % ARC_HDRINDEXSIZE]; hn != NULL;
+         hn = hn->hn_next)
+    {
+        if (hn->hn_hash == hash && hn->hn_last->hdr_namelen == len &&
+            strncasecmp(hn->hn_last->hdr_text, name, len) == 0)
+        {
+            return hn;
+        }
+    }
+
+    return NULL;
+}
+
 /*
 **  ARC_TMPFILE -- open a temporary file
 **
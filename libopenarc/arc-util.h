@@ -22,6 +22,11 @@ extern int      arc_check_dns_reply(unsigned char *ansbuf,
 
 extern bool     arc_hdrlist(char *, size_t, char **, bool);
 
+extern ARC_STAT arc_hdrindex_add(ARC_MESSAGE *, struct arc_hdrfield *);
+extern struct arc_hdrname *arc_hdrindex_find(ARC_MESSAGE *,
+                                             const char *,
+                                             size_t);
+
 extern void     arc_min_timeval(struct timeval *,
                                 struct timeval *,
                                 struct timeval *,
@@ -18,6 +18,7 @@
 #include <limits.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <resolv.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -41,10 +42,13 @@
 #include <openssl/sha.h>
 
 /* libopenarc includes */
+#include "arc-arena.h"
 #include "arc-canon.h"
 #include "arc-dns.h"
 #include "arc-internal.h"
+#include "arc-keycache.h"
 #include "arc-keys.h"
+#include "arc-pool.h"
 #include "arc-tables.h"
 #include "arc-types.h"
 #include "arc-util.h"
@@ -82,9 +86,6 @@ void arc_error(ARC_MESSAGE *, const char *, ...);
 /* generic array size macro */
 #define NITEMS(array)      ((int) (sizeof(array) / sizeof(array[0])))
 
-/* macros */
-#define ARC_PHASH(x)       ((x) - 32)
-
 /*
 **  ARC_ERROR -- log an error into a DKIM handle
 **
@@ -176,90 +177,35 @@ arc_error_cb(void *msg, const char *format, ...)
 }
 
 /*
-**  ARC_KEY_HASHOK -- return true iff a signature's hash is in the approved
-**                    list of hashes for a given key
+**  ARC_KEY_HASHES -- determine which hash methods a key may be used with
 **
 **  Parameters:
-**  	msg -- ARC_MESSAGE handle
-**  	hashlist -- colon-separated approved hash list
+**  	lib -- ARC_LIB handle
+**  	hashlist -- colon-separated list of hashes from the key (or NULL)
 **
 **  Return value:
-**  	true iff a particular hash is in the approved list of hashes.
+**  	A bitmask of (1 << ARC_HASHTYPE_*) values for each approved hash
+**  	that we support; zero if there are none.
 */
 
-static bool
-arc_key_hashok(ARC_MESSAGE *msg, char *hashlist)
+static unsigned int
+arc_key_hashes(ARC_LIB *lib, char *hashlist)
 {
-    int   hashalg;
-    char *x, *y;
-    char  tmp[BUFRSZ + 1];
+    unsigned int mask = 0;
+    int          hashcode;
+    char        *x, *y;
+    char         tmp[BUFRSZ + 1];
 
-    assert(msg != NULL);
+    assert(lib != NULL);
 
     if (hashlist == NULL)
     {
-        return true;
-    }
-
-    x = NULL;
-    memset(tmp, '\0', sizeof tmp);
-
-    y = hashlist;
-    for (;;)
-    {
-        if (*y == ':' || *y == '\0')
-        {
-            if (x != NULL)
-            {
-                strlcpy(tmp, x, sizeof tmp);
-                tmp[y - x] = '\0';
-                hashalg = arc_name_to_code(hashes, tmp);
-                if (hashalg == msg->arc_hashtype)
-                {
-                    return true;
-                }
-            }
-
-            x = NULL;
-        }
-        else if (x == NULL)
-        {
-            x = y;
-        }
-
-        if (*y == '\0')
+        mask |= (1 << ARC_HASHTYPE_SHA1);
+        if (arc_libfeature(lib, ARC_FEATURE_SHA256))
         {
-            return false;
+            mask |= (1 << ARC_HASHTYPE_SHA256);
         }
-        y++;
-    }
-
-    /* NOTREACHED */
-}
-
-/*
-**  ARC_KEY_HASHESOK -- return true iff this key supports at least one
-**                      hash method we know about (or doesn't specify)
-**
-**  Parameters:
-**  	hashlist -- colon-separated list of hashes (or NULL)
-**
-**  Return value:
-**  	true iff this key supports at least one hash method we know about
-**  	(or doesn't specify)
-*/
-
-static bool
-arc_key_hashesok(ARC_LIB *lib, char *hashlist)
-{
-    char *x, *y;
-    char  tmp[BUFRSZ + 1];
-
-    assert(lib != NULL);
-
-    if (hashlist == NULL)
-    {
-        return true;
+        return mask;
     }
 
     x = NULL;
@@ -272,8 +218,6 @@ arc_key_hashesok(ARC_LIB *lib, char *hashlist)
         {
             if (x != NULL)
             {
-                int hashcode;
-
                 strlcpy(tmp, x, sizeof tmp);
                 tmp[y - x] = '\0';
 
@@ -282,7 +226,7 @@ arc_key_hashesok(ARC_LIB *lib, char *hashlist)
                 if (hashcode != -1 && (hashcode != ARC_HASHTYPE_SHA256 ||
                                        arc_libfeature(lib, ARC_FEATURE_SHA256)))
                 {
-                    return true;
+                    mask |= (1 << hashcode);
                 }
             }
 
@@ -295,7 +239,7 @@ arc_key_hashesok(ARC_LIB *lib, char *hashlist)
 
         if (*y == '\0')
         {
-            return false;
+            return mask;
         }
         y++;
     }
@@ -341,6 +285,11 @@ arc_parse_algorithm(ARC_MESSAGE *msg, const char *alg)
         msg->arc_hashtype = ARC_HASHTYPE_SHA256;
         msg->arc_keytype = ARC_KEYTYPE_RSA;
     }
+    else if (algtype == ARC_SIGN_ED25519SHA256)
+    {
+        msg->arc_hashtype = ARC_HASHTYPE_SHA256;
+        msg->arc_keytype = ARC_KEYTYPE_ED25519;
+    }
     else
     {
         arc_error(msg, "unknown or invalid algorithm: %s", alg);
@@ -350,6 +299,76 @@ arc_parse_algorithm(ARC_MESSAGE *msg, const char *alg)
     return ARC_STAT_OK;
 }
 
+/*
+**  ARC_SIGN_HASHTYPE -- determine the hash used by a signing algorithm
+**
+**  Parameters:
+**  	signalg -- an ARC_SIGN_* constant
+**
+**  Return value:
+**  	An ARC_HASHTYPE_* constant.
+*/
+
+static int
+arc_sign_hashtype(arc_alg_t signalg)
+{
+    if (signalg == ARC_SIGN_RSASHA1)
+    {
+        return ARC_HASHTYPE_SHA1;
+    }
+
+    return ARC_HASHTYPE_SHA256;
+}
+
+/*
+**  ARC_SIGN_KEYTYPE -- determine the key type used by a signing algorithm
+**
+**  Parameters:
+**  	signalg -- an ARC_SIGN_* constant
+**
+**  Return value:
+**  	An ARC_KEYTYPE_* constant.
+*/
+
+static int
+arc_sign_keytype(arc_alg_t signalg)
+{
+    if (signalg == ARC_SIGN_ED25519SHA256)
+    {
+        return ARC_KEYTYPE_ED25519;
+    }
+
+    return ARC_KEYTYPE_RSA;
+}
+
+/*
+**  ARC_PKEY_KEYTYPE -- determine the key type of an OpenSSL key
+**
+**  Parameters:
+**  	pkey -- key to examine
+**
+**  Return value:
+**  	An ARC_KEYTYPE_* constant.
+*/
+
+static int
+arc_pkey_keytype(EVP_PKEY *pkey)
+{
+    switch (EVP_PKEY_base_id(pkey))
+    {
+    case EVP_PKEY_RSA:
+        return ARC_KEYTYPE_RSA;
+
+#ifdef EVP_PKEY_ED25519
+    case EVP_PKEY_ED25519:
+        return ARC_KEYTYPE_ED25519;
+#endif /* EVP_PKEY_ED25519 */
+
+    default:
+        return ARC_KEYTYPE_UNKNOWN;
+    }
+}
+
 /*
 **  ARC_GENAMSHDR -- generate a signature or seal header field
 **
@@ -756,6 +775,7 @@ arc_init(void)
     }
 
     lib->arcl_minkeysize = ARC_DEFAULT_MINKEYSIZE;
+    lib->arcl_keycache_maxttl = ARC_DEFAULT_KEYTTL;
     lib->arcl_flags = ARC_LIBFLAGS_DEFAULT;
 
 #define FEATURE_INDEX(x)  ((x) / (8 * sizeof(unsigned int)))
@@ -771,6 +791,13 @@ arc_init(void)
         return NULL;
     }
 
+    if (pthread_mutex_init(&lib->arcl_dns_lock, NULL) != 0)
+    {
+        ARC_FREE(lib->arcl_flist);
+        ARC_FREE(lib);
+        return NULL;
+    }
+
     lib->arcl_dns_callback = NULL;
     lib->arcl_dns_service = NULL;
     lib->arcl_dnsinit_done = false;
@@ -782,6 +809,9 @@ arc_init(void)
     strlcpy(lib->arcl_tmpdir, DEFTMPDIR, sizeof lib->arcl_tmpdir);
 
     FEATURE_ADD(lib, ARC_FEATURE_SHA256);
+#ifdef EVP_PKEY_ED25519
+    FEATURE_ADD(lib, ARC_FEATURE_ED25519);
+#endif /* EVP_PKEY_ED25519 */
 
     return lib;
 }
@@ -802,10 +832,66 @@ arc_close(ARC_LIB *lib)
     arc_options(lib, ARC_OP_SETOPT, ARC_OPTS_SIGNHDRS, NULL, sizeof(char **));
     arc_options(lib, ARC_OP_SETOPT, ARC_OPTS_OVERSIGNHDRS, NULL,
                 sizeof(char **));
+    arc_keycache_free(lib->arcl_keycache);
+    arc_pool_free(lib->arcl_pool);
+
+    if (lib->arcl_dns_close != NULL && lib->arcl_dns_service != NULL)
+    {
+        lib->arcl_dns_close(lib->arcl_dns_service);
+    }
+    pthread_mutex_destroy(&lib->arcl_dns_lock);
+
     ARC_FREE(lib->arcl_flist);
     ARC_FREE(lib);
 }
 
+/*
+**  ARC_SET_ALLOCATOR -- supply the functions used for per-message memory
+**
+**  Parameters:
+**  	lib -- library handle
+**  	mallocf -- allocation function, called as mallocf(closure, nbytes)
+**  	freef -- release function, called as freef(closure, ptr)
+**  	closure -- opaque pointer passed to both
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	Only two things are allocated through these: ARC_MESSAGE handles,
+**  	and the arena chunks that hold a message's header fields and their
+**  	relaxed forms, parsed tag sets, ARC set table and canonicalization
+**  	state.  Everything else still comes from the default allocator,
+**  	including the growable buffers (header and canonicalization
+**  	buffers, the error string), short-lived buffers used while
+**  	signing and verifying, key lookups, digest contexts and keys
+**  	allocated by OpenSSL, and the library handle itself.
+**
+**  	They must be safe to call from several threads at once, and must
+**  	be set before any message handle is created.  Passing NULL for
+**  	both restores the default allocator.
+*/
+
+ARC_STAT
+arc_set_allocator(ARC_LIB *lib,
+                  void *(*mallocf)(void *closure, size_t nbytes),
+                  void (*freef)(void *closure, void *ptr),
+                  void *closure)
+{
+    assert(lib != NULL);
+
+    if ((mallocf == NULL) != (freef == NULL))
+    {
+        return ARC_STAT_INVALID;
+    }
+
+    lib->arcl_malloc = mallocf;
+    lib->arcl_free = freef;
+    lib->arcl_memclosure = closure;
+
+    return ARC_STAT_OK;
+}
+
 /*
 **  ARC_GETERROR -- return any stored error string from within the ARC
 **                  context handle
@@ -825,6 +911,43 @@ arc_geterror(ARC_MESSAGE *msg)
     return msg->arc_error;
 }
 
+/*
+**  ARC_SET_POOL -- replace the library's crypto worker pool
+**
+**  Parameters:
+**  	lib -- library handle
+**  	nthreads -- number of worker threads, or 0 for none
+**  	maxqueue -- most checks to queue for the workers, or 0 for no limit
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	No message may be in progress on the library when this is called.
+*/
+
+static ARC_STAT
+arc_set_pool(ARC_LIB *lib, unsigned int nthreads, unsigned int maxqueue)
+{
+    struct arc_pool *pool = NULL;
+
+    if (nthreads > 0)
+    {
+        pool = arc_pool_new(nthreads, maxqueue);
+        if (pool == NULL)
+        {
+            return ARC_STAT_NORESOURCE;
+        }
+    }
+
+    arc_pool_free(lib->arcl_pool);
+    lib->arcl_pool = pool;
+    lib->arcl_crypto_threads = nthreads;
+    lib->arcl_crypto_queue = maxqueue;
+
+    return ARC_STAT_OK;
+}
+
 /*
 **
 **  ARC_OPTIONS -- get/set library options
@@ -968,97 +1091,229 @@ arc_options(ARC_LIB *lib, int op, int arg, void *val, size_t valsz)
 
         return ARC_STAT_OK;
 
-    case ARC_OPTS_SIGNHDRS:
-        if (valsz != sizeof(char **) || op == ARC_OP_GETOPT)
+    case ARC_OPTS_MAXVERIFYBITS:
+        if (val == NULL)
         {
             return ARC_STAT_INVALID;
         }
-        else if (val == NULL)
+
+        if (valsz != sizeof lib->arcl_maxverifybits)
         {
-            if (lib->arcl_signre)
-            {
-                (void) regfree(&lib->arcl_hdrre);
-                lib->arcl_signre = false;
-            }
+            return ARC_STAT_INVALID;
+        }
+
+        if (op == ARC_OP_GETOPT)
+        {
+            memcpy(val, &lib->arcl_maxverifybits, valsz);
         }
         else
         {
-            int  status;
-            char buf[BUFRSZ + 1];
+            memcpy(&lib->arcl_maxverifybits, val, valsz);
+        }
 
-            if (lib->arcl_signre)
-            {
-                (void) regfree(&lib->arcl_hdrre);
-                lib->arcl_signre = false;
-            }
-            memset(buf, '\0', sizeof buf);
+        return ARC_STAT_OK;
 
-            (void) strlcpy(buf, "^(", sizeof buf);
-            if (!arc_hdrlist(buf, sizeof buf, (char **) val, true))
-            {
-                return ARC_STAT_INVALID;
-            }
+    case ARC_OPTS_KEYCACHE:
+        if (val == NULL)
+        {
+            return ARC_STAT_INVALID;
+        }
 
-            if (strlcat(buf, ")$", sizeof buf) >= sizeof buf)
-            {
-                return ARC_STAT_INVALID;
-            }
+        if (valsz != sizeof lib->arcl_keycache_size)
+        {
+            return ARC_STAT_INVALID;
+        }
 
-            status = regcomp(&lib->arcl_hdrre, buf, (REG_EXTENDED | REG_ICASE));
-            if (status != 0)
+        if (op == ARC_OP_GETOPT)
+        {
+            memcpy(val, &lib->arcl_keycache_size, valsz);
+        }
+        else
+        {
+            struct arc_keycache *kc = NULL;
+            unsigned int         size;
+
+            memcpy(&size, val, valsz);
+
+            if (size > 0)
             {
-                return ARC_STAT_INTERNAL;
+                kc = arc_keycache_new(size);
+                if (kc == NULL)
+                {
+                    return ARC_STAT_NORESOURCE;
+                }
             }
 
-            lib->arcl_signre = true;
+            arc_keycache_free(lib->arcl_keycache);
+            lib->arcl_keycache = kc;
+            lib->arcl_keycache_size = size;
         }
+
         return ARC_STAT_OK;
 
-    case ARC_OPTS_OVERSIGNHDRS:
-        if (valsz != sizeof lib->arcl_oversignhdrs)
+    case ARC_OPTS_KEYCACHE_TTL:
+        if (val == NULL)
         {
             return ARC_STAT_INVALID;
         }
 
-        if (op == ARC_OP_GETOPT)
+        if (valsz != sizeof lib->arcl_keycache_maxttl)
         {
-            memcpy(val, &lib->arcl_oversignhdrs, valsz);
+            return ARC_STAT_INVALID;
         }
-        else if (val == NULL)
+
+        if (op == ARC_OP_GETOPT)
         {
-            if (lib->arcl_oversignhdrs != NULL)
-            {
-                arc_clobber_array(lib->arcl_oversignhdrs);
-            }
-            lib->arcl_oversignhdrs = NULL;
+            memcpy(val, &lib->arcl_keycache_maxttl, valsz);
         }
         else
         {
-            char **tmp = arc_copy_array(val);
-            if (tmp == NULL)
-            {
-                return ARC_STAT_NORESOURCE;
-            }
+            memcpy(&lib->arcl_keycache_maxttl, val, valsz);
+        }
 
-            if (lib->arcl_oversignhdrs != NULL)
-            {
-                arc_clobber_array(lib->arcl_oversignhdrs);
-            }
+        return ARC_STAT_OK;
 
-            lib->arcl_oversignhdrs = tmp;
+    case ARC_OPTS_CRYPTO_THREADS:
+        if (val == NULL)
+        {
+            return ARC_STAT_INVALID;
         }
-        return ARC_STAT_OK;
 
-    default:
-        assert(0);
-    }
-}
+        if (valsz != sizeof lib->arcl_crypto_threads)
+        {
+            return ARC_STAT_INVALID;
+        }
 
-/*
-**  ARC_SET_DNS -- override DNS resolver
-**
-**  Parameters:
-**      lib -- library handle
+        if (op == ARC_OP_GETOPT)
+        {
+            memcpy(val, &lib->arcl_crypto_threads, valsz);
+            return ARC_STAT_OK;
+        }
+        else
+        {
+            unsigned int nthreads;
+
+            memcpy(&nthreads, val, valsz);
+
+            return arc_set_pool(lib, nthreads, lib->arcl_crypto_queue);
+        }
+
+    case ARC_OPTS_CRYPTO_QUEUE:
+        if (val == NULL)
+        {
+            return ARC_STAT_INVALID;
+        }
+
+        if (valsz != sizeof lib->arcl_crypto_queue)
+        {
+            return ARC_STAT_INVALID;
+        }
+
+        if (op == ARC_OP_GETOPT)
+        {
+            memcpy(val, &lib->arcl_crypto_queue, valsz);
+            return ARC_STAT_OK;
+        }
+        else
+        {
+            unsigned int maxqueue;
+
+            memcpy(&maxqueue, val, valsz);
+
+            return arc_set_pool(lib, lib->arcl_crypto_threads, maxqueue);
+        }
+
+    case ARC_OPTS_SIGNHDRS:
+        if (valsz != sizeof(char **) || op == ARC_OP_GETOPT)
+        {
+            return ARC_STAT_INVALID;
+        }
+        else if (val == NULL)
+        {
+            if (lib->arcl_signre)
+            {
+                (void) regfree(&lib->arcl_hdrre);
+                lib->arcl_signre = false;
+            }
+        }
+        else
+        {
+            int  status;
+            char buf[BUFRSZ + 1];
+
+            if (lib->arcl_signre)
+            {
+                (void) regfree(&lib->arcl_hdrre);
+                lib->arcl_signre = false;
+            }
+            memset(buf, '\0', sizeof buf);
+
+            (void) strlcpy(buf, "^(", sizeof buf);
+            if (!arc_hdrlist(buf, sizeof buf, (char **) val, true))
+            {
+                return ARC_STAT_INVALID;
+            }
+
+            if (strlcat(buf, ")$", sizeof buf) >= sizeof buf)
+            {
+                return ARC_STAT_INVALID;
+            }
+
+            status = regcomp(&lib->arcl_hdrre, buf, (REG_EXTENDED | REG_ICASE));
+            if (status != 0)
+            {
+                return ARC_STAT_INTERNAL;
+            }
+
+            lib->arcl_signre = true;
+        }
+        return ARC_STAT_OK;
+
+    case ARC_OPTS_OVERSIGNHDRS:
+        if (valsz != sizeof lib->arcl_oversignhdrs)
+        {
+            return ARC_STAT_INVALID;
+        }
+
+        if (op == ARC_OP_GETOPT)
+        {
+            memcpy(val, &lib->arcl_oversignhdrs, valsz);
+        }
+        else if (val == NULL)
+        {
+            if (lib->arcl_oversignhdrs != NULL)
+            {
+                arc_clobber_array(lib->arcl_oversignhdrs);
+            }
+            lib->arcl_oversignhdrs = NULL;
+        }
+        else
+        {
+            char **tmp = arc_copy_array(val);
+            if (tmp == NULL)
+            {
+                return ARC_STAT_NORESOURCE;
+            }
+
+            if (lib->arcl_oversignhdrs != NULL)
+            {
+                arc_clobber_array(lib->arcl_oversignhdrs);
+            }
+
+            lib->arcl_oversignhdrs = tmp;
+        }
+        return ARC_STAT_OK;
+
+    default:
+        assert(0);
+    }
+}
+
+/*
+**  ARC_SET_DNS -- override DNS resolver
+**
+**  Parameters:
+**      lib -- library handle
 **      dns_init -- initialization function
 **      dns_callback -- callback function
 **      dns_callback_int -- callback interval
@@ -1091,11 +1346,23 @@ arc_set_dns(ARC_LIB *lib,
                                  int            *error,
                                  int            *dnssec))
 {
+    pthread_mutex_lock(&lib->arcl_dns_lock);
     if (lib->arcl_dnsinit_done)
     {
+        pthread_mutex_unlock(&lib->arcl_dns_lock);
         return ARC_STAT_INTERNAL;
     }
 
+    /* a service started by arc_dns_nslist() belongs to the old resolver */
+    if (lib->arcl_dns_service != NULL)
+    {
+        if (lib->arcl_dns_close != NULL)
+        {
+            lib->arcl_dns_close(lib->arcl_dns_service);
+        }
+        lib->arcl_dns_service = NULL;
+    }
+
     lib->arcl_dns_init = dns_init;
     lib->arcl_dns_callback = dns_callback;
     lib->arcl_callback_int = dns_callback_int;
@@ -1103,10 +1370,57 @@ arc_set_dns(ARC_LIB *lib,
     lib->arcl_dns_start = dns_start;
     lib->arcl_dns_cancel = dns_cancel;
     lib->arcl_dns_waitreply = dns_waitreply;
+    pthread_mutex_unlock(&lib->arcl_dns_lock);
 
     return ARC_STAT_OK;
 }
 
+/*
+**  ARC_DNS_NSLIST -- set the nameservers used by the built-in resolver
+**
+**  Parameters:
+**      lib -- library handle
+**      nslist -- comma-separated list of nameservers
+**
+**  Return value:
+**      An ARC_STAT constant.
+**
+**  Notes:
+**      Each nameserver is a numeric IPv4 or IPv6 address, optionally with
+**      a port ("192.0.2.1:5353", "[2001:db8::1]:5353").  The list replaces
+**      the one read from resolv.conf.  This has to be called before the
+**      first key lookup, and fails if arc_set_dns() installed a different
+**      resolver.
+*/
+
+ARC_STAT
+arc_dns_nslist(ARC_LIB *lib, const char *nslist)
+{
+    ARC_STAT status = ARC_STAT_OK;
+
+    assert(lib != NULL);
+    assert(nslist != NULL);
+
+    pthread_mutex_lock(&lib->arcl_dns_lock);
+    if (lib->arcl_dnsinit_done || lib->arcl_dns_init != arc_res_init)
+    {
+        status = ARC_STAT_INTERNAL;
+    }
+    else if (lib->arcl_dns_service == NULL &&
+             arc_res_init(&lib->arcl_dns_service) != 0)
+    {
+        lib->arcl_dns_service = NULL;
+        status = ARC_STAT_NORESOURCE;
+    }
+    else if (arc_res_nslist(lib->arcl_dns_service, nslist) != ARC_DNS_SUCCESS)
+    {
+        status = ARC_STAT_INVALID;
+    }
+    pthread_mutex_unlock(&lib->arcl_dns_lock);
+
+    return status;
+}
+
 /*
 **  ARC_GETSSLBUF -- retrieve SSL error buffer
 **
@@ -1172,6 +1486,74 @@ arc_check_uint(char *value, uint64_t *out)
     return true;
 }
 
+/*
+**  ARC_TAG_ID -- map a tag name to its interned ID
+**
+**  Parameters:
+**  	tag -- tag name
+**
+**  Return value:
+**  	An ARC_TAG_* constant; ARC_TAG_OTHER if the name isn't one we know.
+*/
+
+static int
+arc_tag_id(const char *tag)
+{
+    if (tag[0] == '\0')
+    {
+        return ARC_TAG_OTHER;
+    }
+
+    if (tag[1] == '\0')
+    {
+        switch (tag[0])
+        {
+        case 'a':
+            return ARC_TAG_A;
+        case 'b':
+            return ARC_TAG_B;
+        case 'c':
+            return ARC_TAG_C;
+        case 'd':
+            return ARC_TAG_D;
+        case 'h':
+            return ARC_TAG_H;
+        case 'i':
+            return ARC_TAG_I;
+        case 'k':
+            return ARC_TAG_K;
+        case 'l':
+            return ARC_TAG_L;
+        case 'p':
+            return ARC_TAG_P;
+        case 's':
+            return ARC_TAG_S;
+        case 't':
+            return ARC_TAG_T;
+        case 'v':
+            return ARC_TAG_V;
+        case 'x':
+            return ARC_TAG_X;
+        default:
+            return ARC_TAG_OTHER;
+        }
+    }
+
+    if (tag[2] == '\0')
+    {
+        if (tag[0] == 'b' && tag[1] == 'h')
+        {
+            return ARC_TAG_BH;
+        }
+        if (tag[0] == 'c' && tag[1] == 'v')
+        {
+            return ARC_TAG_CV;
+        }
+    }
+
+    return ARC_TAG_OTHER;
+}
+
 /*
 **  ARC_PARAM_GET -- get a parameter from a set
 **
@@ -1181,20 +1563,29 @@ arc_check_uint(char *value, uint64_t *out)
 **
 **  Return value:
 **  	Pointer to the parameter requested, or NULL if it's not in the set.
+**
+**  Notes:
+**  	Sets hold a handful of tags, so a linear scan comparing interned IDs
+**  	is cheaper than any hashing would be.
 */
 
 static char *
 arc_param_get(ARC_KVSET *set, const char *param)
 {
-    ARC_PLIST *plist;
+    int          tag;
+    unsigned int n;
+    ARC_PLIST   *plist;
 
     assert(set != NULL);
     assert(param != NULL);
 
-    for (plist = set->set_plist[ARC_PHASH(param[0])]; plist != NULL;
-         plist = plist->plist_next)
+    tag = arc_tag_id(param);
+
+    for (n = 0; n < set->set_nplist; n++)
     {
-        if (strcmp(plist->plist_param, param) == 0)
+        plist = &set->set_plist[n];
+        if (plist->plist_tag == tag &&
+            (tag != ARC_TAG_OTHER || strcmp(plist->plist_param, param) == 0))
         {
             return plist->plist_value;
         }
@@ -1354,7 +1745,6 @@ arc_key_smtp(ARC_KVSET *set)
 **  	set -- set to modify
 **   	param -- parameter
 **  	value -- value
-**  	force -- override existing value, if any
 **  	ignore_dups -- drop duplicate submissions
 **
 **  Return value:
@@ -1369,10 +1759,11 @@ arc_add_plist(ARC_MESSAGE *msg,
               ARC_KVSET   *set,
               char        *param,
               char        *value,
-              bool         force,
               bool         ignore_dups)
 {
-    ARC_PLIST *plist;
+    int          tag;
+    unsigned int n;
+    ARC_PLIST   *plist;
 
     assert(msg != NULL);
     assert(set != NULL);
@@ -1385,45 +1776,51 @@ arc_add_plist(ARC_MESSAGE *msg,
         return -1;
     }
 
+    tag = arc_tag_id(param);
+
     /* see if we have one already */
-    for (plist = set->set_plist[ARC_PHASH(param[0])]; plist != NULL;
-         plist = plist->plist_next)
+    for (n = 0; n < set->set_nplist; n++)
     {
-        if (strcasecmp(plist->plist_param, param) == 0)
+        plist = &set->set_plist[n];
+        if (tag != ARC_TAG_OTHER && plist->plist_tag != ARC_TAG_OTHER)
         {
-            if (ignore_dups)
+            if (plist->plist_tag != tag)
             {
-                return 0;
+                continue;
             }
+        }
+        else if (strcasecmp(plist->plist_param, param) != 0)
+        {
+            continue;
+        }
 
-            arc_error(msg, "duplicate parameter '%s'", param);
-            return -1;
+        if (ignore_dups)
+        {
+            return 0;
         }
+
+        arc_error(msg, "duplicate parameter '%s'", param);
+        return -1;
     }
 
-    /* nope; make one and connect it */
-    if (plist == NULL)
+    /* nope; make room if the set is full, then append it */
+    if (set->set_nplist == set->set_maxplist)
     {
-        int n;
-
-        plist = ARC_MALLOC(sizeof(ARC_PLIST));
+        plist = arc_arena_alloc(msg,
+                                sizeof(ARC_PLIST) * set->set_maxplist * 2);
         if (plist == NULL)
         {
-            arc_error(msg, "unable to allocate %d byte(s)", sizeof(ARC_PLIST));
             return -1;
         }
-        force = true;
-        n = ARC_PHASH(param[0]);
-        plist->plist_next = set->set_plist[n];
-        set->set_plist[n] = plist;
-        plist->plist_param = param;
+        memcpy(plist, set->set_plist, sizeof(ARC_PLIST) * set->set_nplist);
+        set->set_plist = plist;
+        set->set_maxplist *= 2;
     }
 
-    /* set the value if "force" was set (or this was a new entry) */
-    if (force)
-    {
-        plist->plist_value = value;
-    }
+    plist = &set->set_plist[set->set_nplist++];
+    plist->plist_tag = tag;
+    plist->plist_param = param;
+    plist->plist_value = value;
 
     return 0;
 }
@@ -1438,7 +1835,8 @@ arc_add_plist(ARC_MESSAGE *msg,
 **  	str -- string to be scanned
 **  	len -- number of bytes available at "str"
 **  	data -- opaque handle to store with the set
-**  	out -- the set created by this function (returned)
+**  	out -- the set created by this function (returned); this is
+**  	       returned even if the data turn out to be malformed
 **
 **  Return value:
 **  	An ARC_STAT constant.
@@ -1476,19 +1874,16 @@ arc_process_set(ARC_MESSAGE    *msg,
     state = 0;
     spaced = false;
 
-    hcopy = ARC_MALLOC(len + 1);
+    hcopy = arc_arena_alloc(msg, len + 1);
     if (hcopy == NULL)
     {
-        arc_error(msg, "unable to allocate %d byte(s)", len + 1);
         return ARC_STAT_INTERNAL;
     }
     strlcpy(hcopy, str, len + 1);
 
-    set = ARC_CALLOC(1, sizeof(ARC_KVSET));
+    set = arc_arena_calloc(msg, 1, sizeof(ARC_KVSET));
     if (set == NULL)
     {
-        ARC_FREE(hcopy);
-        arc_error(msg, "unable to allocate %d byte(s)", sizeof(ARC_KVSET));
         return ARC_STAT_INTERNAL;
     }
 
@@ -1508,10 +1903,17 @@ arc_process_set(ARC_MESSAGE    *msg,
     msg->arc_kvsettail = set;
 
     set->set_next = NULL;
-    memset(&set->set_plist, '\0', sizeof set->set_plist);
+    set->set_plist = set->set_inline;
+    set->set_nplist = 0;
+    set->set_maxplist = ARC_KVSET_NTAGS;
     set->set_data = hcopy;
     set->set_bad = false;
 
+    if (out != NULL)
+    {
+        *out = set;
+    }
+
     if (!arc_check_utf8(hcopy))
     {
         arc_error(msg, "invalid UTF-8 in %s data", settype);
@@ -1598,7 +2000,7 @@ arc_process_set(ARC_MESSAGE    *msg,
                 }
 
                 /* create the ARC_PLIST entry */
-                status = arc_add_plist(msg, set, param, value, true, false);
+                status = arc_add_plist(msg, set, param, value, false);
                 if (status == -1)
                 {
                     set->set_bad = true;
@@ -1638,7 +2040,7 @@ arc_process_set(ARC_MESSAGE    *msg,
                 }
 
                 /* create the ARC_PLIST entry */
-                status = arc_add_plist(msg, set, param, value, true, false);
+                status = arc_add_plist(msg, set, param, value, false);
                 if (status == -1)
                 {
                     set->set_bad = true;
@@ -1681,7 +2083,7 @@ arc_process_set(ARC_MESSAGE    *msg,
             arc_collapse(value);
 
             /* create the ARC_PLIST entry */
-            status = arc_add_plist(msg, set, param, value, true, false);
+            status = arc_add_plist(msg, set, param, value, false);
             if (status == -1)
             {
                 set->set_bad = true;
@@ -1692,7 +2094,7 @@ arc_process_set(ARC_MESSAGE    *msg,
 
     case 2: /* before value */
         /* create an empty ARC_PLIST entry */
-        status = arc_add_plist(msg, set, param, "", true, false);
+        status = arc_add_plist(msg, set, param, "", false);
         if (status == -1)
         {
             set->set_bad = true;
@@ -1796,7 +2198,7 @@ arc_process_set(ARC_MESSAGE    *msg,
         }
 
         /* default for "q" */
-        status = arc_add_plist(msg, set, "q", "dns/txt", false, true);
+        status = arc_add_plist(msg, set, "q", "dns/txt", true);
         if (status == -1)
         {
             set->set_bad = true;
@@ -1806,7 +2208,7 @@ arc_process_set(ARC_MESSAGE    *msg,
         break;
 
     case ARC_KVSETTYPE_KEY:
-        status = arc_add_plist(msg, set, "k", "rsa", false, true);
+        status = arc_add_plist(msg, set, "k", "rsa", true);
         if (status == -1)
         {
             set->set_bad = true;
@@ -1872,71 +2274,49 @@ arc_process_set(ARC_MESSAGE    *msg,
         break;
     }
 
-    if (out != NULL)
-    {
-        *out = set;
-    }
-
     return ARC_STAT_OK;
 }
 
 /*
-**  ARC_GET_KEY -- acquire a public key used for verification
+**  ARC_PARSE_KEY -- decode a key record
 **
 **  Parameters:
 **  	msg -- ARC_MESSAGE handle
-**  	test -- skip signature-specific validity checks
+**  	txt -- text of the key record
+**  	ki -- decoded key (returned)
 **
 **  Return value:
 **  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	Nothing stored in "ki" depends on the signature being verified, so
+**  	it can be shared with other messages via the key cache.
 */
 
-ARC_STAT
-arc_get_key(ARC_MESSAGE *msg, bool test)
+static ARC_STAT
+arc_parse_key(ARC_MESSAGE *msg, char *txt, struct arc_keyinfo *ki)
 {
-    int               status;
-    struct arc_kvset *set = NULL;
-    struct arc_kvset *nextset;
-    char             *p;
-    char              buf[BUFRSZ + 1];
+    int                  status;
+    size_t               b64keylen;
+    struct arc_kvset    *set = NULL;
+    struct arc_kvset    *nextset;
+    char                *p;
+    char                *b64key;
+    const unsigned char *der;
+    unsigned char       *key;
 
     assert(msg != NULL);
-    assert(msg->arc_selector != NULL);
-    assert(msg->arc_domain != NULL);
-
-    memset(buf, '\0', sizeof buf);
-
-    /* use appropriate get method */
-    switch (msg->arc_query)
-    {
-    case ARC_QUERY_DNS:
-        status = (int) arc_get_key_dns(msg, buf, sizeof buf);
-        if (status != (int) ARC_STAT_OK)
-        {
-            return (ARC_STAT) status;
-        }
-        break;
-
-    case ARC_QUERY_FILE:
-        status = (int) arc_get_key_file(msg, buf, sizeof buf);
-        if (status != (int) ARC_STAT_OK)
-        {
-            return (ARC_STAT) status;
-        }
-        break;
-
-    default:
-        assert(0);
-    }
+    assert(txt != NULL);
+    assert(ki != NULL);
 
     /* decode the payload */
-    if (buf[0] == '\0')
+    if (txt[0] == '\0')
     {
         arc_error(msg, "empty key record");
         return ARC_STAT_SYNTAX;
     }
 
-    status = arc_process_set(msg, ARC_KVSETTYPE_KEY, buf, strlen(buf), NULL,
+    status = arc_process_set(msg, ARC_KVSETTYPE_KEY, txt, strlen(txt), NULL,
                              NULL);
     if (status != ARC_STAT_OK)
     {
@@ -1967,17 +2347,12 @@ arc_get_key(ARC_MESSAGE *msg, bool test)
 
     /* then make sure the hash type is something we can handle */
     p = arc_param_get(set, "h");
-    if (!arc_key_hashesok(msg->arc_library, p))
+    ki->ki_hashes = arc_key_hashes(msg->arc_library, p);
+    if (ki->ki_hashes == 0)
     {
         arc_error(msg, "unknown hash '%s'", p);
         return ARC_STAT_SYNTAX;
     }
-    /* ...and that this key is approved for this signature's hash */
-    else if (!test && !arc_key_hashok(msg, p))
-    {
-        arc_error(msg, "signature-key hash mismatch");
-        return ARC_STAT_CANTVRFY;
-    }
 
     /* make sure it's a key designated for e-mail */
     if (!arc_key_smtp(set))
@@ -1993,49 +2368,80 @@ arc_get_key(ARC_MESSAGE *msg, bool test)
         arc_error(msg, "key type missing");
         return ARC_STAT_SYNTAX;
     }
-    else if (arc_name_to_code(keytypes, p) == -1)
+    ki->ki_keytype = arc_name_to_code(keytypes, p);
+    if (ki->ki_keytype == -1)
     {
         arc_error(msg, "unknown key type '%s'", p);
         return ARC_STAT_SYNTAX;
     }
 
     /* decode the key */
-    msg->arc_b64key = arc_param_get(set, "p");
-    if (msg->arc_b64key == NULL)
+    b64key = arc_param_get(set, "p");
+    if (b64key == NULL)
     {
         arc_error(msg, "key missing");
         return ARC_STAT_SYNTAX;
     }
-    else if (msg->arc_b64key[0] == '\0')
+    else if (b64key[0] == '\0')
     {
         return ARC_STAT_REVOKED;
     }
-    msg->arc_b64keylen = strlen(msg->arc_b64key);
+    b64keylen = strlen(b64key);
 
-    if (msg->arc_key != NULL)
+    key = ARC_MALLOC(b64keylen);
+    if (key == NULL)
     {
-        ARC_FREE(msg->arc_key);
-    }
-
-    msg->arc_key = ARC_MALLOC(msg->arc_b64keylen);
-    if (msg->arc_key == NULL)
-    {
-        arc_error(msg, "unable to allocate %d byte(s)", msg->arc_b64keylen);
+        arc_error(msg, "unable to allocate %d byte(s)", b64keylen);
         return ARC_STAT_NORESOURCE;
     }
 
-    status = arc_base64_decode((unsigned char *) msg->arc_b64key, msg->arc_key,
-                               msg->arc_b64keylen);
+    status = arc_base64_decode((unsigned char *) b64key, key, b64keylen);
     if (status < 0)
     {
         arc_error(msg, "key missing");
+        ARC_FREE(key);
         return ARC_STAT_SYNTAX;
     }
 
-    msg->arc_keylen = status;
-    msg->arc_flags = 0;
+    if (ki->ki_keytype == ARC_KEYTYPE_ED25519)
+    {
+        /* RFC 8463 publishes the bare 32-byte public key */
+#ifdef EVP_PKEY_ED25519
+        if (status != 32)
+        {
+            arc_error(msg, "invalid ed25519 key length %d", status);
+            ARC_FREE(key);
+            return ARC_STAT_SYNTAX;
+        }
+
+        ki->ki_pkey = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, NULL, key,
+                                                  status);
+        ARC_FREE(key);
+        if (ki->ki_pkey == NULL)
+        {
+            arc_error(msg, "EVP_PKEY_new_raw_public_key() failed");
+            return ARC_STAT_INTERNAL;
+        }
+#else  /* EVP_PKEY_ED25519 */
+        arc_error(msg, "ed25519 keys are not supported");
+        ARC_FREE(key);
+        return ARC_STAT_CANTVRFY;
+#endif /* EVP_PKEY_ED25519 */
+    }
+    else
+    {
+        der = key;
+        ki->ki_pkey = d2i_PUBKEY(NULL, &der, status);
+        ARC_FREE(key);
+        if (ki->ki_pkey == NULL)
+        {
+            arc_error(msg, "d2i_PUBKEY() failed");
+            return ARC_STAT_INTERNAL;
+        }
+    }
 
     /* store key flags */
+    ki->ki_flags = 0;
     p = arc_param_get(set, "t");
     if (p != NULL)
     {
@@ -2052,7 +2458,7 @@ arc_get_key(ARC_MESSAGE *msg, bool test)
             flag = (unsigned int) arc_name_to_code(keyflags, t);
             if (flag != (unsigned int) -1)
             {
-                msg->arc_flags |= flag;
+                ki->ki_flags |= flag;
             }
         }
     }
@@ -2061,30 +2467,158 @@ arc_get_key(ARC_MESSAGE *msg, bool test)
 }
 
 /*
-**  ARC_VERIFY_HASH -- verify a hash
+**  ARC_GET_KEY -- acquire a public key used for verification
 **
 **  Parameters:
-**	msg -- ARC_MESSAGE handle
-**	b64sig -- base64 encoded signature
-**	h -- hash
-**	hlen -- hash length
+**  	msg -- ARC_MESSAGE handle
+**  	test -- skip signature-specific validity checks
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	If the library has a key cache, DNS results that found a usable
+**  	key, no key or a revoked key are remembered for as long as their
+**  	TTL (capped by ARC_OPTS_KEYCACHE_TTL) allows.
+*/
+
+ARC_STAT
+arc_get_key(ARC_MESSAGE *msg, bool test)
+{
+    ARC_STAT             status;
+    uint32_t             ttl = 0;
+    time_t               now = 0;
+    ARC_LIB             *lib;
+    struct arc_keycache *kc = NULL;
+    struct arc_keyinfo   ki;
+    char                 name[ARC_MAXHOSTNAMELEN + 1];
+    char                 buf[BUFRSZ + 1];
+
+    assert(msg != NULL);
+    assert(msg->arc_selector != NULL);
+    assert(msg->arc_domain != NULL);
+
+    lib = msg->arc_library;
+    memset(&ki, '\0', sizeof ki);
+
+    if (msg->arc_query == ARC_QUERY_DNS && lib->arcl_keycache != NULL)
+    {
+        int n;
+
+        n = snprintf(name, sizeof name, "%s.%s.%s", msg->arc_selector,
+                     ARC_DNSKEYNAME, msg->arc_domain);
+        if (n > 0 && n < sizeof name)
+        {
+            kc = lib->arcl_keycache;
+            (void) time(&now);
+        }
+    }
+
+    if (kc != NULL && arc_keycache_get(kc, name, now, &ki))
+    {
+        msg->arc_dnssec_key = ki.ki_dnssec;
+
+        if (ki.ki_status == ARC_STAT_NOKEY)
+        {
+            arc_error(msg, "'%s' record not found (cached)", name);
+        }
+    }
+    else
+    {
+        memset(buf, '\0', sizeof buf);
+
+        /* use appropriate get method */
+        switch (msg->arc_query)
+        {
+        case ARC_QUERY_DNS:
+            status = arc_get_key_dns(msg, buf, sizeof buf, &ttl);
+            break;
+
+        case ARC_QUERY_FILE:
+            status = arc_get_key_file(msg, buf, sizeof buf);
+            break;
+
+        default:
+            assert(0);
+        }
+
+        if (status == ARC_STAT_OK)
+        {
+            status = arc_parse_key(msg, buf, &ki);
+        }
+
+        ki.ki_status = status;
+        ki.ki_dnssec = msg->arc_dnssec_key;
+
+        ttl = MIN(ttl, lib->arcl_keycache_maxttl);
+        if (kc != NULL && ttl > 0 &&
+            (status == ARC_STAT_OK || status == ARC_STAT_NOKEY ||
+             status == ARC_STAT_REVOKED))
+        {
+            arc_keycache_put(kc, name, now + ttl, &ki);
+        }
+    }
+
+    if (ki.ki_status != ARC_STAT_OK)
+    {
+        EVP_PKEY_free(ki.ki_pkey);
+        return ki.ki_status;
+    }
+
+    /* make sure this key is approved for this signature's hash */
+    if (!test && (ki.ki_hashes & (1 << msg->arc_hashtype)) == 0)
+    {
+        arc_error(msg, "signature-key hash mismatch");
+        EVP_PKEY_free(ki.ki_pkey);
+        return ARC_STAT_CANTVRFY;
+    }
+
+    /* ...and for this signature's algorithm */
+    if (!test && ki.ki_keytype != msg->arc_keytype)
+    {
+        arc_error(msg, "signature-key type mismatch");
+        EVP_PKEY_free(ki.ki_pkey);
+        return ARC_STAT_CANTVRFY;
+    }
+
+    EVP_PKEY_free(msg->arc_pkey);
+    msg->arc_pkey = ki.ki_pkey;
+    msg->arc_flags = ki.ki_flags;
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_VERIFY_START -- get ready to verify a signature
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle, with the selector, domain and algorithm
+**  	       of the signature already set
+**  	b64sig -- base64 encoded signature
+**  	h -- hash
+**  	hlen -- hash length
+**  	av -- verification state to fill in
 **
 **  Return value:
-**	An ARC_STAT_* constant.
+**  	An ARC_STAT_* constant.  On success "av" owns the key and decoded
+**  	signature, and arc_verify_run() can be called on it from any thread.
+**
+**  Side effects:
+**  	Counts the key's size against the library's ARC_OPTS_MAXVERIFYBITS
+**  	limit for this message.
 */
 
 static ARC_STAT
-arc_verify_hash(ARC_MESSAGE *msg, char *b64sig, void *h, size_t hlen)
-{
-    int           rc;
-    size_t        b64siglen;
-    size_t        siglen;
-    size_t        keysize;
-    ARC_STAT      status;
-    void         *sig;
-    BIO          *keydata = NULL;
-    EVP_PKEY     *pkey = NULL;
-    EVP_PKEY_CTX *ctx = NULL;
+arc_verify_start(ARC_MESSAGE       *msg,
+                 char              *b64sig,
+                 void              *h,
+                 size_t             hlen,
+                 struct arc_verify *av)
+{
+    int      siglen;
+    size_t   b64siglen;
+    size_t   keysize;
+    ARC_STAT status;
 
     /* get the key from DNS (or wherever) */
     status = arc_get_key(msg, false);
@@ -2094,71 +2628,137 @@ arc_verify_hash(ARC_MESSAGE *msg, char *b64sig, void *h, size_t hlen)
         return status;
     }
 
+    keysize = EVP_PKEY_bits(msg->arc_pkey);
+
+    if (msg->arc_keytype == ARC_KEYTYPE_RSA &&
+        keysize < msg->arc_library->arcl_minkeysize)
+    {
+        arc_error(msg, "key size (%u) below minimum (%u)", keysize,
+                  msg->arc_library->arcl_minkeysize);
+        return ARC_STAT_BADSIG;
+    }
+
+    /* bound the public key work a single message can cause */
+    if (msg->arc_library->arcl_maxverifybits != 0 &&
+        keysize > msg->arc_library->arcl_maxverifybits - msg->arc_verifybits)
+    {
+        arc_error(msg, "verification limit (%u key bits) reached",
+                  msg->arc_library->arcl_maxverifybits);
+        return ARC_STAT_CANTVRFY;
+    }
+    msg->arc_verifybits += keysize;
+
     b64siglen = strlen(b64sig);
 
-    sig = ARC_MALLOC(b64siglen);
-    if (sig == NULL)
+    av->av_sig = ARC_MALLOC(b64siglen);
+    if (av->av_sig == NULL)
     {
         arc_error(msg, "unable to allocate %d bytes", b64siglen);
         return ARC_STAT_INTERNAL;
     }
 
-    siglen = arc_base64_decode((unsigned char *) b64sig, sig, b64siglen);
+    siglen = arc_base64_decode((unsigned char *) b64sig, av->av_sig,
+                               b64siglen);
     if (siglen < 0)
     {
         arc_error(msg, "unable to decode signature");
-        status = ARC_STAT_SYNTAX;
-        goto error;
+        ARC_FREE(av->av_sig);
+        av->av_sig = NULL;
+        return ARC_STAT_SYNTAX;
     }
 
-    keydata = BIO_new_mem_buf(msg->arc_key, msg->arc_keylen);
-    if (keydata == NULL)
-    {
-        arc_error(msg, "BIO_new_mem_buf() failed");
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
+    av->av_siglen = siglen;
+    av->av_hash = h;
+    av->av_hashlen = hlen;
+    av->av_keytype = msg->arc_keytype;
+    av->av_hashtype = msg->arc_hashtype;
 
-    pkey = d2i_PUBKEY_bio(keydata, NULL);
-    if (pkey == NULL)
-    {
-        arc_error(msg, "d2i_PUBKEY_bio() failed");
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
+    /* the check takes over the key */
+    av->av_pkey = msg->arc_pkey;
+    msg->arc_pkey = NULL;
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_VERIFY_RUN -- verify a signature prepared by arc_verify_start()
+**
+**  Parameters:
+**  	job -- the av_job member of a struct arc_verify
+**
+**  Return value:
+**  	None.  The result is left in av_status, and a description of any
+**  	internal error in av_error.
+**
+**  Notes:
+**  	This touches nothing but the struct arc_verify, so it can run on a
+**  	worker thread while the message's own thread waits.
+*/
+
+static void
+arc_verify_run(struct arc_job *job)
+{
+    int                rc;
+    struct arc_verify *av = (struct arc_verify *) job;
+    EVP_PKEY_CTX      *ctx = NULL;
+#ifdef EVP_PKEY_ED25519
+    EVP_MD_CTX *mctx = NULL;
+#endif /* EVP_PKEY_ED25519 */
 
-    keysize = EVP_PKEY_bits(pkey);
-    if (keysize < msg->arc_library->arcl_minkeysize)
+    av->av_status = ARC_STAT_INTERNAL;
+
+#ifdef EVP_PKEY_ED25519
+    if (av->av_keytype == ARC_KEYTYPE_ED25519)
     {
-        arc_error(msg, "key size (%u) below minimum (%u)", keysize,
-                  msg->arc_library->arcl_minkeysize);
-        status = ARC_STAT_BADSIG;
-        goto error;
+        /* RFC 8463: PureEd25519 over the SHA-256 digest */
+        mctx = EVP_MD_CTX_new();
+        if (mctx == NULL)
+        {
+            av->av_error = "EVP_MD_CTX_new() failed";
+            goto done;
+        }
+
+        rc = EVP_DigestVerifyInit(mctx, NULL, NULL, NULL, av->av_pkey);
+        if (rc <= 0)
+        {
+            av->av_error = "EVP_DigestVerifyInit() failed";
+            goto done;
+        }
+
+        av->av_status = ARC_STAT_BADSIG;
+        rc = EVP_DigestVerify(mctx, av->av_sig, av->av_siglen, av->av_hash,
+                              av->av_hashlen);
+        if (rc == 1)
+        {
+            av->av_status = ARC_STAT_OK;
+        }
+
+        goto done;
     }
+#endif /* EVP_PKEY_ED25519 */
 
-    status = ARC_STAT_INTERNAL;
-    ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    ctx = EVP_PKEY_CTX_new(av->av_pkey, NULL);
     if (ctx == NULL)
     {
-        arc_error(msg, "EVP_PKEY_CTX_new() failed");
-        goto error;
+        av->av_error = "EVP_PKEY_CTX_new() failed";
+        goto done;
     }
 
     rc = EVP_PKEY_verify_init(ctx);
     if (rc <= 0)
     {
-        arc_error(msg, "EVP_PKEY_verify_init() failed");
-        goto error;
+        av->av_error = "EVP_PKEY_verify_init() failed";
+        goto done;
     }
 
     rc = EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING);
     if (rc <= 0)
     {
-        arc_error(msg, "EVP_PKEY_CTX_set_rsa_padding() failed");
-        goto error;
+        av->av_error = "EVP_PKEY_CTX_set_rsa_padding() failed";
+        goto done;
     }
 
-    if (msg->arc_hashtype == ARC_HASHTYPE_SHA1)
+    if (av->av_hashtype == ARC_HASHTYPE_SHA1)
     {
         rc = EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha1());
     }
@@ -2168,50 +2768,143 @@ arc_verify_hash(ARC_MESSAGE *msg, char *b64sig, void *h, size_t hlen)
     }
     if (rc <= 0)
     {
-        arc_error(msg, "EVP_PKEY_CTX_set_signature_md() failed");
-        goto error;
+        av->av_error = "EVP_PKEY_CTX_set_signature_md() failed";
+        goto done;
     }
 
-    status = ARC_STAT_BADSIG;
-    rc = EVP_PKEY_verify(ctx, sig, siglen, h, hlen);
+    av->av_status = ARC_STAT_BADSIG;
+    rc = EVP_PKEY_verify(ctx, av->av_sig, av->av_siglen, av->av_hash,
+                         av->av_hashlen);
     if (rc == 1)
     {
-        status = ARC_STAT_OK;
+        av->av_status = ARC_STAT_OK;
     }
 
-error:
+done:
+#ifdef EVP_PKEY_ED25519
+    EVP_MD_CTX_free(mctx);
+#endif /* EVP_PKEY_ED25519 */
     EVP_PKEY_CTX_free(ctx);
-    EVP_PKEY_free(pkey);
-    BIO_free(keydata);
-    ARC_FREE(sig);
+}
 
-    return status;
+/*
+**  ARC_VERIFY_CLEAR -- release what a signature check holds
+**
+**  Parameters:
+**  	av -- verification state
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_verify_clear(struct arc_verify *av)
+{
+    EVP_PKEY_free(av->av_pkey);
+    av->av_pkey = NULL;
+    ARC_FREE(av->av_sig);
+    av->av_sig = NULL;
 }
 
 /*
-**  ARC_VALIDATE_MSG -- validate a specific ARC-Message-Signature
+**  ARC_VALIDATE_BH -- check the body hash an ARC-Message-Signature claims
 **
 **  Parameters:
 **  	msg -- ARC message handle
-**  	set -- ARC set number whose AMS should be validated (zero-based)
-**  	verify -- verify or sign
+**  	setnum -- ARC set number whose AMS should be checked (one-based)
 **
 **  Return value:
-**  	An ARC_STAT_* constant.
+**  	ARC_STAT_OK if its bh= value matches the body, ARC_STAT_BADSIG if
+**  	it doesn't, or another ARC_STAT_* constant on error.
+**
+**  Notes:
+**  	This needs neither a key nor a public key operation, so it is done
+**  	before either.
 */
 
 static ARC_STAT
-arc_validate_msg(ARC_MESSAGE *msg, unsigned int setnum)
+arc_validate_bh(ARC_MESSAGE *msg, unsigned int setnum)
+{
+    bool           match;
+    size_t         elen;
+    size_t         hhlen;
+    size_t         bhlen;
+    size_t         b64bhlen;
+    ARC_STAT       status;
+    unsigned char *b64bh;
+    char          *b64bhtag;
+    void          *hh;
+    void          *bh;
+    ARC_KVSET     *kvset;
+
+    /* finalize body canonicalizations */
+    status = arc_canon_closebody(msg);
+    if (status != ARC_STAT_OK)
+    {
+        arc_error(msg, "arc_canon_closebody() failed");
+        return status;
+    }
+
+    /* extract the body hash from the message */
+    status = arc_canon_gethashes(msg, setnum, &hh, &hhlen, &bh, &bhlen);
+    if (status != ARC_STAT_OK)
+    {
+        arc_error(msg, "arc_canon_gethashes() failed");
+        return status;
+    }
+
+    /* compare the signature's "bh" with our computed one */
+    kvset = msg->arc_sets[setnum - 1].arcset_ams->hdr_data;
+    b64bhtag = arc_param_get(kvset, "bh");
+
+    b64bhlen = BASE64SIZE(bhlen);
+    b64bh = ARC_CALLOC(1, b64bhlen + 1);
+    if (b64bh == NULL)
+    {
+        arc_error(msg, "unable to allocate %d bytes", b64bhlen + 1);
+        return ARC_STAT_INTERNAL;
+    }
+    elen = arc_base64_encode(bh, bhlen, b64bh, b64bhlen);
+    match = (elen == strlen(b64bhtag) &&
+             strcmp((char *) b64bh, b64bhtag) == 0);
+    ARC_FREE(b64bh);
+
+    if (!match)
+    {
+        arc_error(msg, "body hash mismatch");
+        return ARC_STAT_BADSIG;
+    }
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_VALIDATE_MSG_START -- get ready to validate an ARC-Message-Signature
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	setnum -- ARC set number whose AMS should be validated (one-based)
+**  	av -- verification state (returned)
+**
+**  Return value:
+**  	None.  av_status is ARC_STAT_OK if the signature is ready for
+**  	arc_verify_run(), or says why the AMS can't pass otherwise.
+**
+**  Notes:
+**  	The body hash is compared first, so a mismatch costs neither a key
+**  	lookup nor a public key operation.
+*/
+
+static void
+arc_validate_msg_start(ARC_MESSAGE       *msg,
+                       unsigned int       setnum,
+                       struct arc_verify *av)
 {
-    size_t          elen;
     size_t          hhlen;
     size_t          bhlen;
-    size_t          b64bhlen;
     ARC_STAT        status;
     char           *alg;
     char           *b64sig;
-    unsigned char  *b64bh;
-    char           *b64bhtag;
     void           *hh;
     void           *bh;
     struct arc_set *set;
@@ -2219,6 +2912,10 @@ arc_validate_msg(ARC_MESSAGE *msg, unsigned int setnum)
 
     assert(msg != NULL);
 
+    memset(av, '\0', sizeof *av);
+    av->av_job.job_run = arc_verify_run;
+    av->av_setnum = setnum;
+
     /* pull the (set-1)th ARC Set */
     set = &msg->arc_sets[setnum - 1];
 
@@ -2226,14 +2923,6 @@ arc_validate_msg(ARC_MESSAGE *msg, unsigned int setnum)
     **  Validate the ARC-Message-Signature.
     */
 
-    /* finalize body canonicalizations */
-    status = arc_canon_closebody(msg);
-    if (status != ARC_STAT_OK)
-    {
-        arc_error(msg, "arc_canon_closebody() failed");
-        return status;
-    }
-
     /*
     **  The stub AMS was generated, canonicalized, and hashed by
     **  arc_canon_runheaders().  It should also have been finalized.
@@ -2249,65 +2938,51 @@ arc_validate_msg(ARC_MESSAGE *msg, unsigned int setnum)
     status = arc_parse_algorithm(msg, alg);
     if (status != ARC_STAT_OK)
     {
-        return status;
+        av->av_status = status;
+        return;
     }
 
-    /* extract the header and body hashes from the message */
-    status = arc_canon_gethashes(msg, setnum, &hh, &hhlen, &bh, &bhlen);
+    /* the body hash is cheap to check, so do that first */
+    status = arc_validate_bh(msg, setnum);
     if (status != ARC_STAT_OK)
     {
-        arc_error(msg, "arc_canon_gethashes() failed");
-        return status;
+        av->av_status = status;
+        return;
     }
 
-    /* extract the signature and body hash from the message */
-    b64sig = arc_param_get(kvset, "b");
-    b64bhtag = arc_param_get(kvset, "bh");
-
-    /* verify the signature against the header hash and the key */
-    status = arc_verify_hash(msg, b64sig, hh, hhlen);
+    /* extract the header hash from the message */
+    status = arc_canon_gethashes(msg, setnum, &hh, &hhlen, &bh, &bhlen);
     if (status != ARC_STAT_OK)
     {
-        return status;
+        arc_error(msg, "arc_canon_gethashes() failed");
+        av->av_status = status;
+        return;
     }
 
-    /* verify the signature's "bh" against our computed one */
-    b64bhlen = BASE64SIZE(bhlen);
-    b64bh = ARC_CALLOC(1, b64bhlen + 1);
-    if (b64bh == NULL)
-    {
-        arc_error(msg, "unable to allocate %d bytes", b64bhlen + 1);
-        return ARC_STAT_INTERNAL;
-    }
-    elen = arc_base64_encode(bh, bhlen, b64bh, b64bhlen);
-    if (elen != strlen(b64bhtag) || strcmp((char *) b64bh, b64bhtag) != 0)
-    {
-        ARC_FREE(b64bh);
-        arc_error(msg, "body hash mismatch");
-        return ARC_STAT_BADSIG;
-    }
+    /* extract the signature from the message */
+    b64sig = arc_param_get(kvset, "b");
 
-    ARC_FREE(b64bh);
-    /* if we got this far, the signature was good */
-    return ARC_STAT_OK;
+    /* get ready to verify the signature against the header hash */
+    av->av_status = arc_verify_start(msg, b64sig, hh, hhlen, av);
 }
 
 /*
-**  ARC_VALIDATE_SEAL -- validate a specific ARC seal
+**  ARC_VALIDATE_SEAL_START -- get ready to validate an ARC-Seal
 **
 **  Parameters:
 **  	msg -- ARC message handle
-**  	set -- ARC set number to be validated (zero-based)
+**  	setnum -- ARC set number to be validated (one-based)
+**  	av -- verification state (returned)
 **
 **  Return value:
-**  	An ARC_STAT_* constant.
-**
-**  Side effects:
-**  	Updates msg->arc_cstate.
+**  	None.  av_status is ARC_STAT_OK if the signature is ready for
+**  	arc_verify_run(), or says why the seal can't pass otherwise.
 */
 
-static ARC_STAT
-arc_validate_seal(ARC_MESSAGE *msg, unsigned int setnum)
+static void
+arc_validate_seal_start(ARC_MESSAGE       *msg,
+                        unsigned int       setnum,
+                        struct arc_verify *av)
 {
     ARC_STAT        status;
     size_t          shlen;
@@ -2319,6 +2994,11 @@ arc_validate_seal(ARC_MESSAGE *msg, unsigned int setnum)
 
     assert(msg != NULL);
 
+    memset(av, '\0', sizeof *av);
+    av->av_job.job_run = arc_verify_run;
+    av->av_seal = true;
+    av->av_setnum = setnum;
+
     /* pull the (set-1)th ARC Set */
     set = &msg->arc_sets[setnum - 1];
 
@@ -2332,39 +3012,467 @@ arc_validate_seal(ARC_MESSAGE *msg, unsigned int setnum)
     status = arc_parse_algorithm(msg, alg);
     if (status != ARC_STAT_OK)
     {
-        return status;
+        av->av_status = status;
+        return;
+    }
+
+    if (msg->arc_selector == NULL)
+    {
+        arc_error(msg, "seal at i=%u has no selector", setnum);
+        av->av_status = ARC_STAT_SYNTAX;
+        return;
     }
+    if (msg->arc_domain == NULL)
+    {
+        arc_error(msg, "seal at i=%u has no domain", setnum);
+        av->av_status = ARC_STAT_SYNTAX;
+        return;
+    }
+
+    /* extract the seal hash */
+    status = arc_canon_getsealhash(msg, setnum, &sh, &shlen);
+    if (status != ARC_STAT_OK)
+    {
+        arc_error(msg, "arc_canon_getsealhashes() failed");
+        av->av_status = status;
+        return;
+    }
+
+    /* extract the signature from the seal */
+    b64sig = arc_param_get(kvset, "b");
+
+    /* get ready to verify the signature against the seal hash */
+    av->av_status = arc_verify_start(msg, b64sig, sh, shlen, av);
+}
+
+/*
+**  ARC_VALIDATE_END -- collect the result of an AMS or seal check
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	av -- verification state, started and (if it could be) run
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Side effects:
+**  	Sets msg->arc_cstate to ARC_CHAIN_FAIL if a seal's signature
+**  	doesn't verify.
+*/
+
+static ARC_STAT
+arc_validate_end(ARC_MESSAGE *msg, struct arc_verify *av)
+{
+    ARC_STAT status;
+
+    av->av_done = true;
+    arc_verify_clear(av);
+
+    status = av->av_status;
+
+    if (av->av_error != NULL)
+    {
+        arc_error(msg, "%s", av->av_error);
+    }
+
+    if (av->av_seal && status == ARC_STAT_BADSIG)
+    {
+        msg->arc_cstate = ARC_CHAIN_FAIL;
+    }
+
+    return status;
+}
+
+/*
+**  ARC_VALIDATE_MSG -- validate a specific ARC-Message-Signature
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	setnum -- ARC set number whose AMS should be validated (one-based)
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+static ARC_STAT
+arc_validate_msg(ARC_MESSAGE *msg, unsigned int setnum)
+{
+    struct arc_verify av;
+
+    arc_validate_msg_start(msg, setnum, &av);
+    if (av.av_status == ARC_STAT_OK)
+    {
+        arc_verify_run(&av.av_job);
+    }
+
+    return arc_validate_end(msg, &av);
+}
+
+/*
+**  ARC_VALIDATE_SEAL -- validate a specific ARC seal
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	setnum -- ARC set number to be validated (one-based)
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Side effects:
+**  	Updates msg->arc_cstate.
+*/
+
+static ARC_STAT
+arc_validate_seal(ARC_MESSAGE *msg, unsigned int setnum)
+{
+    struct arc_verify av;
+
+    arc_validate_seal_start(msg, setnum, &av);
+    if (av.av_status == ARC_STAT_OK)
+    {
+        arc_verify_run(&av.av_job);
+    }
+
+    return arc_validate_end(msg, &av);
+}
+
+/*
+**  ARC_VALIDATE_CV -- check the cv= value a seal asserts
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	setnum -- ARC set number (one-based)
+**
+**  Return value:
+**  	true iff the seal asserts "none" for the first set or "pass" for
+**  	any other.
+*/
+
+static bool
+arc_validate_cv(ARC_MESSAGE *msg, unsigned int setnum)
+{
+    char *cv;
+
+    cv = arc_param_get(msg->arc_sets[setnum - 1].arcset_as->hdr_data, "cv");
+
+    return (setnum == 1 && strcasecmp(cv, "none") == 0) ||
+           (setnum != 1 && strcasecmp(cv, "pass") == 0);
+}
+
+/*
+**  ARC_VALIDATE_SETS -- check a chain's structure before any hashing
+**
+**  Parameters:
+**  	msg -- ARC message handle, with arc_sets filled in
+**
+**  Return value:
+**  	None.
+**
+**  Side effects:
+**  	Records each AMS's canonicalizations in its struct arc_set.
+**  	Sets msg->arc_cstate to ARC_CHAIN_FAIL if the chain can't pass
+**  	whatever its signatures turn out to say: a set is incomplete, a
+**  	cv= value is wrong, a seal or the newest AMS names an unknown
+**  	algorithm, or an AMS has a c= value that can't be parsed.  A wrong
+**  	cv= value is a hard failure, and also sets msg->arc_infail.
+**
+**  Notes:
+**  	This runs before arc_eoh_verify(), so a chain that fails here
+**  	never gets verification canonicalizations or body hashes.
+*/
+
+static void
+arc_validate_sets(ARC_MESSAGE *msg)
+{
+    unsigned int    n;
+    char           *c;
+    struct arc_set *set;
+
+    for (n = 1; n <= msg->arc_nsets; n++)
+    {
+        set = &msg->arc_sets[n - 1];
+
+        if (set->arcset_aar == NULL || set->arcset_ams == NULL ||
+            set->arcset_as == NULL)
+        {
+            arc_error(msg, "missing or incomplete ARC set at instance %u", n);
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            return;
+        }
+    }
+
+    for (n = msg->arc_nsets; n > 0; n--)
+    {
+        if (!arc_validate_cv(msg, n))
+        {
+            arc_error(msg, "seal at i=%u asserts the wrong cv= value", n);
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            msg->arc_infail = true;
+            return;
+        }
+    }
+
+    for (n = msg->arc_nsets; n > 0; n--)
+    {
+        set = &msg->arc_sets[n - 1];
+
+        c = arc_param_get(set->arcset_as->hdr_data, "a");
+        if (arc_name_to_code(algorithms, c) == -1)
+        {
+            arc_error(msg, "seal at i=%u has unknown algorithm %s", n, c);
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            return;
+        }
+
+        /* only the newest AMS decides the chain's fate */
+        c = arc_param_get(set->arcset_ams->hdr_data, "a");
+        if (n == msg->arc_nsets && arc_name_to_code(algorithms, c) == -1)
+        {
+            arc_error(msg, "AMS at i=%u has unknown algorithm %s", n, c);
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            return;
+        }
+
+        c = arc_param_get(set->arcset_ams->hdr_data, "c");
+        if (c == NULL)
+        {
+            set->arcset_hdrcanon = ARC_CANON_SIMPLE;
+            set->arcset_bodycanon = ARC_CANON_SIMPLE;
+        }
+        else if (arc_parse_canon_t(c, &set->arcset_hdrcanon,
+                                   &set->arcset_bodycanon) != ARC_STAT_OK)
+        {
+            arc_error(msg, "failed to parse header c= tag with value %s", c);
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            return;
+        }
+    }
+}
+
+/*
+**  ARC_VALIDATE_BATCH -- run a message's signature checks on the pool
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	older -- true for the AMS of every set but the newest, false for
+**  	         the seals and the newest AMS
+**
+**  Return value:
+**  	An array of 2 * arc_nsets checks, the AMS of set i at [i - 1] and
+**  	its seal at [arc_nsets + i - 1], the ones asked for finished; or
+**  	NULL if it couldn't be allocated.
+**
+**  Notes:
+**  	Keys are fetched and signatures decoded on this thread, in the
+**  	order the results will be collected; only the public key operations
+**  	go to the pool.  Nothing is started after a check that can't be, as
+**  	the outcome is settled there.  The caller collects the results with
+**  	arc_validate_result() and then calls arc_validate_release().
+*/
+
+static struct arc_verify *
+arc_validate_batch(ARC_MESSAGE *msg, bool older)
+{
+    bool               ok = true;
+    unsigned int       n;
+    unsigned int       nsets = msg->arc_nsets;
+    struct arc_pool   *pool = msg->arc_library->arcl_pool;
+    struct arc_verify *avs;
+    struct arc_batch   batch;
+
+    avs = ARC_CALLOC(2 * nsets, sizeof *avs);
+    if (avs == NULL)
+    {
+        return NULL;
+    }
+
+    if (older)
+    {
+        for (n = nsets - 1; n > 0 && ok; n--)
+        {
+            arc_validate_msg_start(msg, n, &avs[n - 1]);
+            ok = (avs[n - 1].av_status == ARC_STAT_OK);
+        }
+    }
+    else
+    {
+        for (n = nsets; n > 0 && ok && !msg->arc_sealsdone; n--)
+        {
+            arc_validate_seal_start(msg, n, &avs[nsets + n - 1]);
+            ok = (avs[nsets + n - 1].av_status == ARC_STAT_OK);
+        }
+
+        if (ok)
+        {
+            arc_validate_msg_start(msg, nsets, &avs[nsets - 1]);
+        }
+    }
+
+    memset(&batch, '\0', sizeof batch);
+
+    for (n = 0; n < 2 * nsets; n++)
+    {
+        if (avs[n].av_job.job_run != NULL && avs[n].av_status == ARC_STAT_OK)
+        {
+            arc_pool_submit(pool, &batch, &avs[n].av_job);
+        }
+    }
+
+    arc_pool_wait(pool, &batch);
+
+    return avs;
+}
+
+/*
+**  ARC_VALIDATE_RESULT -- validate an AMS or seal, or collect its result
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	avs -- checks run by arc_validate_batch(), or NULL
+**  	seal -- true for the ARC-Seal, false for the ARC-Message-Signature
+**  	setnum -- ARC set number (one-based)
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+static ARC_STAT
+arc_validate_result(ARC_MESSAGE       *msg,
+                    struct arc_verify *avs,
+                    bool               seal,
+                    unsigned int       setnum)
+{
+    struct arc_verify *av;
+
+    if (avs != NULL)
+    {
+        av = &avs[(seal ? msg->arc_nsets : 0) + setnum - 1];
+        if (av->av_job.job_run != NULL && !av->av_done)
+        {
+            return arc_validate_end(msg, av);
+        }
+    }
+
+    if (seal)
+    {
+        return arc_validate_seal(msg, setnum);
+    }
+    else
+    {
+        return arc_validate_msg(msg, setnum);
+    }
+}
+
+/*
+**  ARC_VALIDATE_RELEASE -- release checks made by arc_validate_batch()
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	avs -- checks, or NULL
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arc_validate_release(ARC_MESSAGE *msg, struct arc_verify *avs)
+{
+    if (avs == NULL)
+    {
+        return;
+    }
+
+    for (unsigned int n = 0; n < 2 * msg->arc_nsets; n++)
+    {
+        arc_verify_clear(&avs[n]);
+    }
+
+    ARC_FREE(avs);
+}
+
+/*
+**  ARC_VALIDATE_SEALS -- validate every ARC seal in the chain
+**
+**  Parameters:
+**  	msg -- ARC message handle
+**  	avs -- checks run by arc_validate_batch(), or NULL
+**
+**  Return value:
+**  	ARC_STAT_INTERNAL on an internal error, ARC_STAT_OK otherwise.
+**
+**  Side effects:
+**  	Sets msg->arc_cstate to ARC_CHAIN_FAIL if any seal fails; sets
+**  	msg->arc_sealsdone otherwise.
+*/
+
+static ARC_STAT
+arc_validate_seals(ARC_MESSAGE *msg, struct arc_verify *avs)
+{
+    ARC_STAT status;
+
+    for (int i = msg->arc_nsets; i > 0; i--)
+    {
+        status = arc_validate_result(msg, avs, true, i);
+        if (status == ARC_STAT_INTERNAL)
+        {
+            return status;
+        }
+        if (status != ARC_STAT_OK)
+        {
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+            return ARC_STAT_OK;
+        }
+    }
+
+    msg->arc_sealsdone = true;
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_MESSAGE_SETUP -- apply per-message settings to a cleared handle
+**
+**  Parameters:
+**  	msg -- message handle, with arc_library set
+**  	canonhdr -- canonicalization mode to use on the header
+**  	canonbody -- canonicalization mode to use on the body
+**  	signalg -- signing algorithm
+**  	mode -- mask of mode bits
+**
+**  Return value:
+**  	None.
+*/
 
-    if (msg->arc_selector == NULL)
+static void
+arc_message_setup(ARC_MESSAGE *msg,
+                  arc_canon_t  canonhdr,
+                  arc_canon_t  canonbody,
+                  arc_alg_t    signalg,
+                  arc_mode_t   mode)
+{
+    ARC_LIB *lib = msg->arc_library;
+
+    if (lib->arcl_fixedtime != 0)
     {
-        arc_error(msg, "seal at i=%u has no selector", setnum);
-        return ARC_STAT_SYNTAX;
+        msg->arc_timestamp = lib->arcl_fixedtime;
     }
-    if (msg->arc_domain == NULL)
+    else
     {
-        arc_error(msg, "seal at i=%u has no domain", setnum);
-        return ARC_STAT_SYNTAX;
+        time(&msg->arc_timestamp);
     }
 
-    /* extract the seal hash */
-    status = arc_canon_getsealhash(msg, setnum, &sh, &shlen);
-    if (status != ARC_STAT_OK)
-    {
-        arc_error(msg, "arc_canon_getsealhashes() failed");
-        return status;
-    }
+    msg->arc_sigttl = lib->arcl_sigttl;
 
-    /* extract the signature from the seal */
-    b64sig = arc_param_get(kvset, "b");
+    msg->arc_canonhdr = canonhdr;
+    msg->arc_canonbody = canonbody;
+    msg->arc_signalg = signalg;
+    msg->arc_margin = ARC_HDRMARGIN;
+    msg->arc_mode = mode;
 
-    /* verify the signature against the header hash and the key */
-    status = arc_verify_hash(msg, b64sig, sh, shlen);
-    if (status == ARC_STAT_BADSIG)
+    if (strlen(lib->arcl_queryinfo) > 0)
     {
-        msg->arc_cstate = ARC_CHAIN_FAIL;
+        msg->arc_query = ARC_QUERY_FILE;
     }
-
-    return status;
 }
 
 /*
@@ -2400,7 +3508,7 @@ arc_message(ARC_LIB     *lib,
         return NULL;
     }
 
-    msg = ARC_CALLOC(1, sizeof *msg);
+    msg = arc_lib_malloc(lib, sizeof *msg);
     if (msg == NULL)
     {
         if (err != NULL)
@@ -2409,31 +3517,85 @@ arc_message(ARC_LIB     *lib,
         }
         return NULL;
     }
+    memset(msg, '\0', sizeof *msg);
 
     msg->arc_library = lib;
-    if (lib->arcl_fixedtime != 0)
+    arc_message_setup(msg, canonhdr, canonbody, signalg, mode);
+
+    return msg;
+}
+
+/*
+**  ARC_MESSAGE_RESET -- prepare a message handle for another message
+**
+**  Parameters:
+**  	msg -- message handle to reuse
+**  	canonhdr -- canonicalization mode to use on the header
+**  	canonbody -- canonicalization mode to use on the body
+**  	signalg -- signing algorithm
+**  	mode -- mask of mode bits
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+ARC_STAT
+arc_message_reset(ARC_MESSAGE *msg,
+                  arc_canon_t  canonhdr,
+                  arc_canon_t  canonbody,
+                  arc_alg_t    signalg,
+                  arc_mode_t   mode)
+{
+    unsigned int        ncanonspares;
+    unsigned int        maxcanonspares;
+    struct arc_dstring *hdrbuf;
+    struct arc_dstring *canonbuf;
+    struct arc_arena   *arenaspare;
+    struct arc_spare   *canonspares;
+    ARC_LIB            *lib;
+
+    assert(msg != NULL);
+
+    if (mode == 0)
     {
-        msg->arc_timestamp = lib->arcl_fixedtime;
+        arc_error(msg, "no mode(s) selected");
+        return ARC_STAT_INVALID;
     }
-    else
+
+    if (msg->arc_error != NULL)
     {
-        time(&msg->arc_timestamp);
+        ARC_FREE(msg->arc_error);
     }
 
-    msg->arc_sigttl = lib->arcl_sigttl;
+    arc_canon_reset(msg);
+    arc_prefetch_cancel(msg);
 
-    msg->arc_canonhdr = canonhdr;
-    msg->arc_canonbody = canonbody;
-    msg->arc_signalg = signalg;
-    msg->arc_margin = ARC_HDRMARGIN;
-    msg->arc_mode = mode;
+    EVP_PKEY_free(msg->arc_pkey);
 
-    if (strlen(lib->arcl_queryinfo) > 0)
-    {
-        msg->arc_query = ARC_QUERY_FILE;
-    }
+    arc_arena_reset(msg);
 
-    return msg;
+    /* keep what the next message can reuse, and forget everything else */
+    lib = msg->arc_library;
+    hdrbuf = msg->arc_hdrbuf;
+    canonbuf = msg->arc_canonbuf;
+    arenaspare = msg->arc_arenaspare;
+    canonspares = msg->arc_canonspares;
+    ncanonspares = msg->arc_ncanonspares;
+    maxcanonspares = msg->arc_maxcanonspares;
+
+    memset(msg, '\0', sizeof *msg);
+
+    msg->arc_library = lib;
+    msg->arc_hdrbuf = hdrbuf;
+    msg->arc_canonbuf = canonbuf;
+    msg->arc_arenaspare = arenaspare;
+    msg->arc_canonspares = canonspares;
+    msg->arc_ncanonspares = ncanonspares;
+    msg->arc_maxcanonspares = maxcanonspares;
+
+    arc_message_setup(msg, canonhdr, canonbody, signalg, mode);
+
+    return ARC_STAT_OK;
 }
 
 /*
@@ -2449,9 +3611,6 @@ arc_message(ARC_LIB     *lib,
 void
 arc_free(ARC_MESSAGE *msg)
 {
-    struct arc_hdrfield *h;
-    struct arc_hdrfield *tmp;
-
     if (msg == NULL)
     {
         return;
@@ -2462,58 +3621,114 @@ arc_free(ARC_MESSAGE *msg)
         ARC_FREE(msg->arc_error);
     }
 
-    h = msg->arc_hhead;
-    while (h != NULL)
-    {
-        tmp = h->hdr_next;
-        ARC_FREE(h->hdr_text);
-        ARC_FREE(h);
-        h = tmp;
-    }
+    arc_dstring_free(msg->arc_hdrbuf);
 
-    h = msg->arc_sealhead;
-    while (h != NULL)
-    {
-        tmp = h->hdr_next;
-        ARC_FREE(h->hdr_text);
-        ARC_FREE(h);
-        h = tmp;
-    }
+    arc_canon_cleanup(msg);
+    arc_prefetch_cancel(msg);
 
-    if (msg->arc_hdrlist != NULL)
-    {
-        ARC_FREE(msg->arc_hdrlist);
-    }
+    EVP_PKEY_free(msg->arc_pkey);
 
-    arc_dstring_free(msg->arc_hdrbuf);
+    /* header fields, tag sets, canonicalizations, etc. */
+    arc_arena_free(msg);
 
-    while (msg->arc_kvsethead != NULL)
-    {
-        int        i;
-        ARC_KVSET *set = msg->arc_kvsethead;
+    arc_lib_free(msg->arc_library, msg);
+}
 
-        msg->arc_kvsethead = set->set_next;
-        ARC_FREE(set->set_data);
+/*
+**  ARC_FIXCRLF -- convert bare CRs and LFs in a header field to CRLFs
+**
+**  Parameters:
+**  	in -- input
+**  	inlen -- bytes to use at "in"
+**  	out -- output buffer, or NULL to only measure
+**
+**  Return value:
+**  	Length of the converted text.  "out" is not NUL-terminated.
+*/
+
+static size_t
+arc_fixcrlf(const char *in, size_t inlen, char *out)
+{
+    char   prev = '\0';
+    size_t n = 0;
 
-        for (i = 0; i < NITEMS(set->set_plist); i++)
+    for (const char *p = in, *q = in + inlen; p < q; p++)
+    {
+        if (*p == '\n' && prev != '\r') /* bare LF */
+        {
+            if (out != NULL)
+            {
+                out[n] = '\r';
+                out[n + 1] = '\n';
+            }
+            n += 2;
+        }
+        else if (prev == '\r' && *p != '\n') /* bare CR */
+        {
+            if (out != NULL)
+            {
+                out[n] = '\n';
+                out[n + 1] = *p;
+            }
+            n += 2;
+        }
+        else /* other */
         {
-            while (set->set_plist[i] != NULL)
+            if (out != NULL)
             {
-                ARC_PLIST *plist = set->set_plist[i];
-                set->set_plist[i] = plist->plist_next;
-                ARC_FREE(plist);
+                out[n] = *p;
             }
+            n++;
         }
 
-        ARC_FREE(set);
+        prev = *p;
     }
 
-    arc_canon_cleanup(msg);
+    if (prev == '\r') /* end CR */
+    {
+        if (out != NULL)
+        {
+            out[n] = '\n';
+        }
+        n++;
+    }
+
+    return n;
+}
+
+/*
+**  ARC_HDRFIELD_ALLOC -- allocate a header field and room for its text
+**
+**  Parameters:
+**  	msg -- message handle
+**  	textlen -- length of the text, not counting a terminating NUL
+**
+**  Return value:
+**  	A cleared header field whose hdr_text points to "textlen" + 1 bytes
+**  	allocated along with it, or NULL on failure.
+**
+**  Notes:
+**  	The text is NUL-terminated but otherwise left for the caller to fill
+**  	in.  Both come from the message's arena.
+*/
+
+static struct arc_hdrfield *
+arc_hdrfield_alloc(ARC_MESSAGE *msg, size_t textlen)
+{
+    struct arc_hdrfield *h;
+
+    h = arc_arena_alloc(msg, sizeof *h + textlen + 1);
+    if (h == NULL)
+    {
+        return NULL;
+    }
+
+    memset(h, '\0', sizeof *h);
+    h->hdr_text = (char *) (h + 1);
+    h->hdr_text[textlen] = '\0';
+    h->hdr_textlen = textlen;
 
-    ARC_FREE(msg->arc_sealcanons);
-    ARC_FREE(msg->arc_sets);
-    ARC_FREE(msg->arc_key);
-    ARC_FREE(msg);
+    return h;
 }
 
 /*
@@ -2523,6 +3738,7 @@ arc_free(ARC_MESSAGE *msg)
 **  	msg -- message handle
 **  	hdr -- full text of the header field
 **  	hlen -- bytes to use at hname
+**  	borrow -- if true, refer to "hdr" rather than copying it when possible
 **  	ret -- (returned) object, if it's good
 **
 **  Return value:
@@ -2533,12 +3749,14 @@ static ARC_STAT
 arc_parse_header_field(ARC_MESSAGE          *msg,
                        const char           *hdr,
                        size_t                hlen,
+                       bool                  borrow,
                        struct arc_hdrfield **ret)
 {
     const char          *colon;
     const char          *semicolon;
     const char          *end = NULL;
     size_t               c;
+    size_t               textlen;
     struct arc_hdrfield *h;
 
     assert(msg != NULL);
@@ -2607,68 +3825,42 @@ arc_parse_header_field(ARC_MESSAGE          *msg,
         return ARC_STAT_SYNTAX;
     }
 
-    h = ARC_MALLOC(sizeof *h);
-    if (h == NULL)
+    textlen = hlen;
+    if ((msg->arc_library->arcl_flags & ARC_LIBFLAGS_FIXCRLF) != 0)
     {
-        arc_error(msg, "unable to allocate %d byte(s)", sizeof *h);
-        return ARC_STAT_NORESOURCE;
+        textlen = arc_fixcrlf(hdr, hlen, NULL);
     }
 
-    if ((msg->arc_library->arcl_flags & ARC_LIBFLAGS_FIXCRLF) != 0)
+    /* fix-ups only ever add bytes, so an unchanged length means no change */
+    if (borrow && textlen == hlen)
     {
-        char                prev = '\0';
-        struct arc_dstring *tmphdr;
-
-        tmphdr = arc_dstring_new(BUFRSZ, MAXBUFRSZ, msg, &arc_error_cb);
-        if (tmphdr == NULL)
+        h = arc_arena_calloc(msg, 1, sizeof *h);
+        if (h == NULL)
         {
-            ARC_FREE(h);
             return ARC_STAT_NORESOURCE;
         }
-
-        for (const char *p = hdr, *q = hdr + hlen; p < q && *p != '\0'; p++)
+        h->hdr_text = (char *) hdr;
+    }
+    else
+    {
+        h = arc_hdrfield_alloc(msg, textlen);
+        if (h == NULL)
         {
-            if (*p == '\n' && prev != '\r') /* bare LF */
-            {
-                arc_dstring_catn(tmphdr, CRLF, 2);
-            }
-            else if (prev == '\r' && *p != '\n') /* bare CR */
-            {
-                arc_dstring_cat1(tmphdr, '\n');
-                arc_dstring_cat1(tmphdr, *p);
-            }
-            else /* other */
-            {
-                arc_dstring_cat1(tmphdr, *p);
-            }
-
-            prev = *p;
+            return ARC_STAT_NORESOURCE;
         }
 
-        if (prev == '\r') /* end CR */
+        if (textlen == hlen)
         {
-            arc_dstring_cat1(tmphdr, '\n');
+            memcpy(h->hdr_text, hdr, hlen);
+        }
+        else
+        {
+            (void) arc_fixcrlf(hdr, hlen, h->hdr_text);
         }
-
-        h->hdr_text = strndup(arc_dstring_get(tmphdr), arc_dstring_len(tmphdr));
-
-        arc_dstring_free(tmphdr);
-    }
-    else
-    {
-        h->hdr_text = strndup(hdr, hlen);
-    }
-
-    if (h->hdr_text == NULL)
-    {
-        ARC_FREE(h);
-        return ARC_STAT_NORESOURCE;
     }
 
-    h->hdr_namelen = end != NULL ? end - hdr : hlen;
-    h->hdr_textlen = hlen;
-    h->hdr_flags = 0;
-    h->hdr_next = NULL;
+    h->hdr_namelen = end - hdr;
+    h->hdr_textlen = textlen;
 
     *ret = h;
 
@@ -2676,21 +3868,28 @@ arc_parse_header_field(ARC_MESSAGE          *msg,
 }
 
 /*
-**  ARC_HEADER_FIELD -- consume a header field
+**  ARC_ADD_HEADER_FIELD -- common code for arc_header_field{,_borrow}()
 **
 **  Parameters:
 **  	msg -- message handle
 **  	hdr -- full text of the header field
 **  	hlen -- bytes to use at hname
+**  	borrow -- refer to "hdr" rather than copying it
 **
 **  Return value:
 **  	An ARC_STAT_* constant.
 */
 
-ARC_STAT
-arc_header_field(ARC_MESSAGE *msg, const char *hdr, size_t hlen)
+static ARC_STAT
+arc_add_header_field(ARC_MESSAGE *msg,
+                     const char  *hdr,
+                     size_t       hlen,
+                     bool         borrow)
 {
+    arc_kvsettype_t      kvtype;
+    char                 hnbuf[ARC_MAXHDRNAMELEN + 1];
     ARC_STAT             status;
+    ARC_KVSET           *set = NULL;
     struct arc_hdrfield *h;
 
     assert(msg != NULL);
@@ -2703,7 +3902,13 @@ arc_header_field(ARC_MESSAGE *msg, const char *hdr, size_t hlen)
     }
     msg->arc_state = ARC_STATE_HEADER;
 
-    status = arc_parse_header_field(msg, hdr, hlen, &h);
+    status = arc_parse_header_field(msg, hdr, hlen, borrow, &h);
+    if (status != ARC_STAT_OK)
+    {
+        return status;
+    }
+
+    status = arc_hdrindex_add(msg, h);
     if (status != ARC_STAT_OK)
     {
         return status;
@@ -2719,10 +3924,118 @@ arc_header_field(ARC_MESSAGE *msg, const char *hdr, size_t hlen)
         msg->arc_htail->hdr_next = h;
         msg->arc_htail = h;
     }
-
-    msg->arc_hdrcnt++;
-
-    return ARC_STAT_OK;
+
+    msg->arc_hdrcnt++;
+
+    /* parse ARC set members now rather than all at once in arc_eoh() */
+    if (h->hdr_namelen <= 4 || strncasecmp(h->hdr_text, "ARC-", 4) != 0)
+    {
+        return ARC_STAT_OK;
+    }
+
+    memcpy(hnbuf, h->hdr_text, h->hdr_namelen);
+    hnbuf[h->hdr_namelen] = '\0';
+    kvtype = arc_name_to_code(archdrnames, hnbuf);
+    if (kvtype != ARC_KVSETTYPE_ANY)
+    {
+        status = arc_process_set(msg, kvtype, h->hdr_text + h->hdr_namelen + 1,
+                                 h->hdr_textlen - h->hdr_namelen - 1, h, &set);
+        if (status != ARC_STAT_OK)
+        {
+            msg->arc_cstate = ARC_CHAIN_FAIL;
+        }
+        h->hdr_data = set;
+    }
+
+    return ARC_STAT_OK;
+}
+
+/*
+**  ARC_HEADER_FIELD -- consume a header field
+**
+**  Parameters:
+**  	msg -- message handle
+**  	hdr -- full text of the header field
+**  	hlen -- bytes to use at hname
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+ARC_STAT
+arc_header_field(ARC_MESSAGE *msg, const char *hdr, size_t hlen)
+{
+    return arc_add_header_field(msg, hdr, hlen, false);
+}
+
+/*
+**  ARC_HEADER_FIELD_BORROW -- consume a header field without copying it
+**
+**  Parameters:
+**  	msg -- message handle
+**  	hdr -- full text of the header field, NUL-terminated at "hlen"
+**  	hlen -- bytes to use at hname
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	The library refers to "hdr" in place, so it must not be changed or
+**  	released until arc_free() has been called on "msg".  A copy is
+**  	still made if line endings have to be fixed up.
+*/
+
+ARC_STAT
+arc_header_field_borrow(ARC_MESSAGE *msg, const char *hdr, size_t hlen)
+{
+    return arc_add_header_field(msg, hdr, hlen, true);
+}
+
+/*
+**  ARC_PREFETCH_KEYS -- start lookups for every key the chain refers to
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE handle
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Called once the ARC sets have been assembled, so that DNS latency
+**  	overlaps with delivery of the body.  The answers are collected by
+**  	arc_get_key() at EOM.
+*/
+
+static void
+arc_prefetch_keys(ARC_MESSAGE *msg)
+{
+    unsigned int         n;
+    const char          *selector;
+    const char          *domain;
+    struct arc_hdrfield *h[2];
+
+    assert(msg != NULL);
+
+    if (msg->arc_query != ARC_QUERY_DNS)
+    {
+        return;
+    }
+
+    for (n = 0; n < msg->arc_nsets; n++)
+    {
+        h[0] = msg->arc_sets[n].arcset_as;
+        h[1] = msg->arc_sets[n].arcset_ams;
+
+        for (int c = 0; c < 2; c++)
+        {
+            selector = arc_param_get(h[c]->hdr_data, "s");
+            domain = arc_param_get(h[c]->hdr_data, "d");
+            if (selector != NULL && domain != NULL)
+            {
+                arc_prefetch_key(msg, selector, domain);
+            }
+        }
+    }
 }
 
 /*
@@ -2745,8 +4058,6 @@ arc_eoh_verify(ARC_MESSAGE *msg)
     ARC_STAT             status;
     struct arc_hdrfield *h = NULL;
     char                *htag = NULL;
-    arc_canon_t          hdr_canon;
-    arc_canon_t          body_canon;
 
     /* if the chain is dead, nothing to do here */
     if (msg->arc_cstate == ARC_CHAIN_FAIL)
@@ -2764,9 +4075,12 @@ arc_eoh_verify(ARC_MESSAGE *msg)
     */
 
     /* sets already in the chain, validation */
-    msg->arc_sealcanons = ARC_CALLOC(msg->arc_nsets, sizeof(ARC_CANON *));
-    msg->arc_hdrcanons = ARC_CALLOC(msg->arc_nsets, sizeof(ARC_CANON *));
-    msg->arc_bodycanons = ARC_CALLOC(msg->arc_nsets, sizeof(ARC_CANON *));
+    msg->arc_sealcanons = arc_arena_calloc(msg, msg->arc_nsets,
+                                           sizeof(ARC_CANON *));
+    msg->arc_hdrcanons = arc_arena_calloc(msg, msg->arc_nsets,
+                                          sizeof(ARC_CANON *));
+    msg->arc_bodycanons = arc_arena_calloc(msg, msg->arc_nsets,
+                                           sizeof(ARC_CANON *));
 
     if (msg->arc_sealcanons == NULL || msg->arc_hdrcanons == NULL ||
         msg->arc_bodycanons == NULL)
@@ -2809,25 +4123,6 @@ arc_eoh_verify(ARC_MESSAGE *msg)
             hashtype = ARC_HASHTYPE_SHA256;
         }
 
-        c = arc_param_get(h->hdr_data, "c");
-        if (c != NULL)
-        {
-            status = arc_parse_canon_t(c, &hdr_canon, &body_canon);
-            if (status != ARC_STAT_OK)
-            {
-                arc_error(msg, "failed to parse header c= tag with value %s",
-                          c);
-                hdr_canon = ARC_CANON_SIMPLE;
-                body_canon = ARC_CANON_SIMPLE;
-                msg->arc_cstate = ARC_CHAIN_FAIL;
-            }
-        }
-        else
-        {
-            hdr_canon = ARC_CANON_SIMPLE;
-            body_canon = ARC_CANON_SIMPLE;
-        }
-
         c = arc_param_get(h->hdr_data, "l");
         if (c != NULL)
         {
@@ -2838,7 +4133,8 @@ arc_eoh_verify(ARC_MESSAGE *msg)
             len = -1;
         }
 
-        status = arc_add_canon(msg, ARC_CANONTYPE_HEADER, hdr_canon, hashtype,
+        status = arc_add_canon(msg, ARC_CANONTYPE_HEADER,
+                               msg->arc_sets[n].arcset_hdrcanon, hashtype,
                                htag, h, (ssize_t) -1, &msg->arc_hdrcanons[n]);
 
         if (status != ARC_STAT_OK)
@@ -2849,7 +4145,8 @@ arc_eoh_verify(ARC_MESSAGE *msg)
         }
 
         /* body, validation */
-        status = arc_add_canon(msg, ARC_CANONTYPE_BODY, body_canon, hashtype,
+        status = arc_add_canon(msg, ARC_CANONTYPE_BODY,
+                               msg->arc_sets[n].arcset_bodycanon, hashtype,
                                NULL, NULL, (ssize_t) len,
                                &msg->arc_bodycanons[n]);
 
@@ -2880,8 +4177,8 @@ arc_eoh_sign(ARC_MESSAGE *msg)
 
     /* headers, signing */
     status = arc_add_canon(msg, ARC_CANONTYPE_AMS, msg->arc_canonhdr,
-                           msg->arc_signalg, NULL, NULL, (ssize_t) -1,
-                           &msg->arc_sign_hdrcanon);
+                           arc_sign_hashtype(msg->arc_signalg), NULL,
+                           NULL, (ssize_t) -1, &msg->arc_sign_hdrcanon);
     if (status != ARC_STAT_OK)
     {
         arc_error(msg, "failed to initialize header canonicalization object");
@@ -2890,8 +4187,8 @@ arc_eoh_sign(ARC_MESSAGE *msg)
 
     /* all sets, for the next chain, signing */
     status = arc_add_canon(msg, ARC_CANONTYPE_SEAL, ARC_CANON_RELAXED,
-                           msg->arc_signalg, NULL, NULL, (ssize_t) -1,
-                           &msg->arc_sealcanon);
+                           arc_sign_hashtype(msg->arc_signalg), NULL,
+                           NULL, (ssize_t) -1, &msg->arc_sealcanon);
     if (status != ARC_STAT_OK)
     {
         arc_error(msg, "failed to initialize seal canonicalization object");
@@ -2900,8 +4197,8 @@ arc_eoh_sign(ARC_MESSAGE *msg)
 
     /* body, signing */
     status = arc_add_canon(msg, ARC_CANONTYPE_BODY, msg->arc_canonbody,
-                           msg->arc_signalg, NULL, NULL, (ssize_t) -1,
-                           &msg->arc_sign_bodycanon);
+                           arc_sign_hashtype(msg->arc_signalg), NULL,
+                           NULL, (ssize_t) -1, &msg->arc_sign_bodycanon);
     if (status != ARC_STAT_OK)
     {
         arc_error(msg, "failed to initialize body canonicalization object");
@@ -2911,6 +4208,41 @@ arc_eoh_sign(ARC_MESSAGE *msg)
     return ARC_STAT_OK;
 }
 
+/*
+**  ARC_DROP_CHAIN_BODY -- stop hashing the body for an existing chain
+**
+**  Parameters:
+**  	msg -- message handle
+**
+**  Return value:
+**  	None.
+**
+**  Notes:
+**  	Once the chain has failed none of its body hashes will be checked,
+**  	so there's no point computing them.  The body hash for a new
+**  	signature is left alone.
+*/
+
+static void
+arc_drop_chain_body(ARC_MESSAGE *msg)
+{
+    unsigned int c;
+
+    if (msg->arc_bodycanons == NULL)
+    {
+        return;
+    }
+
+    for (c = 0; c < msg->arc_nsets; c++)
+    {
+        if (msg->arc_bodycanons[c] != NULL &&
+            msg->arc_bodycanons[c] != msg->arc_sign_bodycanon)
+        {
+            msg->arc_bodycanons[c]->canon_done = true;
+        }
+    }
+}
+
 /*
 **  ARC_EOH -- declare no more header fields are coming
 **
@@ -2925,13 +4257,11 @@ ARC_STAT
 arc_eoh(ARC_MESSAGE *msg)
 {
     bool                 keep;
-    unsigned int         c;
     uint64_t             n;
     unsigned int         nsets = 0;
     arc_kvsettype_t      type;
     ARC_STAT             status;
     char                *inst;
-    struct arc_hdrfield *h;
     ARC_KVSET           *set;
 
     assert(msg != NULL);
@@ -2942,35 +4272,6 @@ arc_eoh(ARC_MESSAGE *msg)
     }
     msg->arc_state = ARC_STATE_EOH;
 
-    /*
-    **  Process all the header fields that make up ARC sets.
-    */
-
-    for (h = msg->arc_hhead; h != NULL; h = h->hdr_next)
-    {
-        char hnbuf[ARC_MAXHDRNAMELEN + 1];
-        assert(h->hdr_namelen <= ARC_MAXHDRNAMELEN);
-
-        memset(hnbuf, '\0', sizeof hnbuf);
-        strncpy(hnbuf, h->hdr_text, h->hdr_namelen);
-        if (strcasecmp(hnbuf, ARC_AR_HDRNAME) == 0 ||
-            strcasecmp(hnbuf, ARC_MSGSIG_HDRNAME) == 0 ||
-            strcasecmp(hnbuf, ARC_SEAL_HDRNAME) == 0)
-        {
-            arc_kvsettype_t kvtype;
-
-            kvtype = arc_name_to_code(archdrnames, hnbuf);
-            status = arc_process_set(
-                msg, kvtype, h->hdr_text + h->hdr_namelen + 1,
-                h->hdr_textlen - h->hdr_namelen - 1, h, &set);
-            if (status != ARC_STAT_OK)
-            {
-                msg->arc_cstate = ARC_CHAIN_FAIL;
-            }
-            h->hdr_data = set;
-        }
-    }
-
     /*
     **  Ensure all sets are complete.
     */
@@ -3006,7 +4307,7 @@ arc_eoh(ARC_MESSAGE *msg)
     /* build up the array of ARC sets, for use later */
     if (nsets > 0)
     {
-        msg->arc_sets = ARC_CALLOC(nsets, sizeof(struct arc_set));
+        msg->arc_sets = arc_arena_calloc(msg, nsets, sizeof(struct arc_set));
         if (msg->arc_sets == NULL)
         {
             return ARC_STAT_NORESOURCE;
@@ -3062,17 +4363,16 @@ arc_eoh(ARC_MESSAGE *msg)
         }
     }
 
-    /* look for invalid stuff */
-    for (c = 0; c < nsets; c++)
+    /* fail whatever can be failed without hashing anything */
+    if (msg->arc_cstate != ARC_CHAIN_FAIL)
     {
-        if (msg->arc_sets[c].arcset_aar == NULL ||
-            msg->arc_sets[c].arcset_ams == NULL ||
-            msg->arc_sets[c].arcset_as == NULL)
-        {
-            arc_error(msg, "missing or incomplete ARC set at instance %u", c);
-            msg->arc_cstate = ARC_CHAIN_FAIL;
-            break;
-        }
+        arc_validate_sets(msg);
+    }
+
+    /* start the key lookups now so they overlap with the body */
+    if (msg->arc_cstate != ARC_CHAIN_FAIL && nsets > 0)
+    {
+        arc_prefetch_keys(msg);
     }
 
     /*
@@ -3124,6 +4424,23 @@ arc_eoh(ARC_MESSAGE *msg)
         }
     }
 
+    /* the seals don't cover the body, so they can be checked now */
+    if ((msg->arc_library->arcl_flags & ARC_LIBFLAGS_EARLYSEAL) != 0 &&
+        msg->arc_cstate != ARC_CHAIN_FAIL && nsets > 0)
+    {
+        status = arc_validate_seals(msg, NULL);
+        if (status != ARC_STAT_OK)
+        {
+            return status;
+        }
+    }
+
+    /* no point hashing the body for signatures we won't check */
+    if (msg->arc_cstate == ARC_CHAIN_FAIL)
+    {
+        arc_drop_chain_body(msg);
+    }
+
     return ARC_STAT_OK;
 }
 
@@ -3154,6 +4471,38 @@ arc_body(ARC_MESSAGE *msg, const unsigned char *buf, size_t len)
     return arc_canon_bodychunk(msg, (const char *) buf, len);
 }
 
+/*
+**  ARC_BODY_NEEDED -- determine whether any more of the body is wanted
+**
+**  Parameters:
+**  	msg -- an ARC message handle
+**
+**  Return value:
+**  	true iff feeding more body chunks to arc_body() could change the
+**  	outcome of arc_eom() or arc_getseal().
+**
+**  Notes:
+**  	This is false once arc_eoh() has run if the message has no ARC sets
+**  	and isn't being signed, if the chain has already failed and the
+**  	message isn't being signed, or if every body hash has reached the
+**  	length limit in its signature.  It never changes from false back
+**  	to true, so a caller can stop collecting the body as soon as it
+**  	returns false.
+*/
+
+bool
+arc_body_needed(ARC_MESSAGE *msg)
+{
+    assert(msg != NULL);
+
+    if (msg->arc_state < ARC_STATE_EOH)
+    {
+        return true;
+    }
+
+    return arc_canon_minbody(msg) > 0;
+}
+
 /*
 **  ARC_EOM -- declare end of message
 **
@@ -3162,12 +4511,25 @@ arc_body(ARC_MESSAGE *msg, const unsigned char *buf, size_t len)
 **
 **  Return value:
 **  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	The cheapest checks are made first: arc_eoh() has already failed a
+**  	chain whose structure or cv= values are wrong, and here the body
+**  	hash of the newest AMS is compared before the seals are verified,
+**  	and they before the newest AMS signature, so a failing chain stops
+**  	before most of the public key work.  Older AMSs are left to
+**  	arc_chain_oldest_pass().
+**
+**  	If the library has a worker pool, the signature checks are run on
+**  	it together.  Their results are still taken in the same order, with
+**  	the same effect, as when they are run one at a time.
 */
 
 ARC_STAT
 arc_eom(ARC_MESSAGE *msg)
 {
-    ARC_STAT status;
+    ARC_STAT           status;
+    struct arc_verify *avs = NULL;
 
     /* nothing to do if the chain has been expressly failed */
     if (msg->arc_cstate == ARC_CHAIN_FAIL)
@@ -3185,8 +4547,8 @@ arc_eom(ARC_MESSAGE *msg)
         return ARC_STAT_OK;
     }
 
-    /* validate the final ARC-Message-Signature */
-    status = arc_validate_msg(msg, msg->arc_nsets);
+    /* the body hash of the final ARC-Message-Signature is cheap */
+    status = arc_validate_bh(msg, msg->arc_nsets);
     if (status == ARC_STAT_INTERNAL)
     {
         return status;
@@ -3197,96 +4559,339 @@ arc_eom(ARC_MESSAGE *msg)
         return ARC_STAT_OK;
     }
 
-    /* determine the oldest-pass value */
-    for (int i = msg->arc_nsets - 1; i > 0; i--)
+    /* with a worker pool, run the remaining signature checks at once */
+    if (msg->arc_library->arcl_pool != NULL && !msg->arc_sealsdone)
+    {
+        avs = arc_validate_batch(msg, false);
+    }
+
+    /* validate each ARC-Seal, unless arc_eoh() already did */
+    if (!msg->arc_sealsdone)
     {
-        if (arc_validate_msg(msg, i) != ARC_STAT_OK)
+        status = arc_validate_seals(msg, avs);
+        if (status != ARC_STAT_OK || msg->arc_cstate == ARC_CHAIN_FAIL)
         {
-            msg->arc_oldest_pass = i + 1;
-            break;
+            goto done;
+        }
+    }
+
+    /* validate the final ARC-Message-Signature */
+    status = arc_validate_result(msg, avs, false, msg->arc_nsets);
+    if (status == ARC_STAT_INTERNAL)
+    {
+        goto done;
+    }
+    if (status != ARC_STAT_OK)
+    {
+        msg->arc_cstate = ARC_CHAIN_FAIL;
+        status = ARC_STAT_OK;
+        goto done;
+    }
+
+    /* the older signatures are only checked if oldest-pass is wanted */
+    msg->arc_cstate = ARC_CHAIN_PASS;
+    msg->arc_oldestpending = (msg->arc_nsets > 1);
+    status = ARC_STAT_OK;
+
+done:
+    arc_validate_release(msg, avs);
+
+    return status;
+}
+
+/*
+**  ARC_SET_CV -- force the chain state
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE object
+**  	cv -- chain state
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arc_set_cv(ARC_MESSAGE *msg, ARC_CHAIN cv)
+{
+    assert(msg != NULL);
+    assert(cv == ARC_CHAIN_UNKNOWN || cv == ARC_CHAIN_NONE ||
+           cv == ARC_CHAIN_FAIL || cv == ARC_CHAIN_PASS);
+
+    /* none is only valid if there is no existing chain */
+    if ((cv == ARC_CHAIN_NONE) && (msg->arc_nsets != 0))
+    {
+        cv = ARC_CHAIN_PASS;
+    }
+
+    /* only update the state if it's not a hard failure */
+    if (!msg->arc_infail)
+    {
+        if (msg->arc_cstate != cv)
+        {
+            /* there's no way of knowing. */
+            msg->arc_oldest_pass = -1;
+            msg->arc_oldestpending = false;
+        }
+        msg->arc_cstate = cv;
+    }
+
+    if (msg->arc_cstate == ARC_CHAIN_FAIL)
+    {
+        arc_drop_chain_body(msg);
+    }
+}
+
+/*
+**  ARC_SIGN_DIGEST -- sign a canonicalized digest
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE object
+**  	pkey -- private key
+**  	digest -- digest to sign
+**  	diglen -- length of "digest"
+**  	sigout -- signature buffer, at least EVP_PKEY_size(pkey) bytes long
+**  	siglen -- length of the signature (returned)
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+static ARC_STAT
+arc_sign_digest(ARC_MESSAGE   *msg,
+                EVP_PKEY      *pkey,
+                unsigned char *digest,
+                size_t         diglen,
+                unsigned char *sigout,
+                size_t        *siglen)
+{
+    int           rstatus;
+    ARC_STAT      status = ARC_STAT_INTERNAL;
+    EVP_PKEY_CTX *ctx = NULL;
+
+    *siglen = EVP_PKEY_size(pkey);
+
+#ifdef EVP_PKEY_ED25519
+    if (msg->arc_keytype == ARC_KEYTYPE_ED25519)
+    {
+        EVP_MD_CTX *mctx;
+
+        /* RFC 8463: PureEd25519 over the SHA-256 digest */
+        mctx = EVP_MD_CTX_new();
+        if (mctx == NULL)
+        {
+            arc_error(msg, "EVP_MD_CTX_new() failed");
+            return ARC_STAT_NORESOURCE;
+        }
+
+        if (EVP_DigestSignInit(mctx, NULL, NULL, NULL, pkey) <= 0)
+        {
+            arc_error(msg, "EVP_DigestSignInit() failed");
+            EVP_MD_CTX_free(mctx);
+            return ARC_STAT_INTERNAL;
+        }
+
+        rstatus = EVP_DigestSign(mctx, sigout, siglen, digest, diglen);
+        EVP_MD_CTX_free(mctx);
+        if (rstatus != 1 || *siglen == 0)
+        {
+            arc_error(msg, "EVP_DigestSign() failed (status %d, length %d)",
+                      rstatus, *siglen);
+            return ARC_STAT_INTERNAL;
+        }
+
+        return ARC_STAT_OK;
+    }
+#endif /* EVP_PKEY_ED25519 */
+
+    ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    if (ctx == NULL)
+    {
+        arc_error(msg, "EVP_PKEY_CTX_new() failed");
+        return ARC_STAT_NORESOURCE;
+    }
+    if (EVP_PKEY_sign_init(ctx) <= 0)
+    {
+        arc_error(msg, "EVP_PKEY_sign_init() failed");
+        goto error;
+    }
+    if (EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0)
+    {
+        arc_error(msg, "EVP_PKEY_CTX_set_rsa_padding() failed");
+        goto error;
+    }
+    if (msg->arc_hashtype == ARC_HASHTYPE_SHA1)
+    {
+        rstatus = EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha1());
+    }
+    else
+    {
+        rstatus = EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256());
+    }
+    if (rstatus <= 0)
+    {
+        arc_error(msg, "EVP_PKEY_CTX_set_signature_md() failed");
+        goto error;
+    }
+
+    /* encrypt the digest; that's our signature */
+    rstatus = EVP_PKEY_sign(ctx, sigout, siglen, digest, diglen);
+    if (rstatus != 1 || *siglen == 0)
+    {
+        arc_error(msg, "EVP_PKEY_sign() failed (status %d, length %d)", rstatus,
+                  *siglen);
+        goto error;
+    }
+
+    status = ARC_STAT_OK;
+
+error:
+    EVP_PKEY_CTX_free(ctx);
+    return status;
+}
+
+/*
+**  ARC_SIGNKEY_LOAD -- decode a private key for use with arc_getseal_key()
+**
+**  Parameters:
+**  	key -- secret key, PEM or DER encoded
+**  	keylen -- key length
+**  	err -- error string (returned)
+**
+**  Return value:
+**  	A new signing key holding one reference, or NULL on failure (and
+**  	"err" is updated).
+*/
+
+ARC_SIGNKEY *
+arc_signkey_load(const unsigned char *key, size_t keylen, const char **err)
+{
+    BIO         *keydata;
+    EVP_PKEY    *pkey;
+    ARC_SIGNKEY *sk;
+
+    assert(key != NULL);
+    assert(keylen > 0);
+
+    keydata = BIO_new_mem_buf(key, keylen);
+    if (keydata == NULL)
+    {
+        if (err != NULL)
+        {
+            *err = "BIO_new_mem_buf() failed";
         }
-        if (i == 1)
+        return NULL;
+    }
+
+    if (strncmp((const char *) key, "-----", 5) == 0)
+    {
+        pkey = PEM_read_bio_PrivateKey(keydata, NULL, NULL, NULL);
+        if (pkey == NULL && err != NULL)
         {
-            /* everything passed */
-            msg->arc_oldest_pass = 0;
+            *err = "PEM_read_bio_PrivateKey() failed";
         }
     }
-
-    /* validate each ARC-Seal */
-    msg->arc_cstate = ARC_CHAIN_PASS;
-    for (int i = msg->arc_nsets; i > 0; i--)
+    else
     {
-        char      *cv;
-        ARC_KVSET *kvset;
-
-        for (kvset = arc_set_first(msg, ARC_KVSETTYPE_SEAL); kvset != NULL;
-             kvset = arc_set_next(kvset, ARC_KVSETTYPE_SEAL))
+        pkey = d2i_PrivateKey_bio(keydata, NULL);
+        if (pkey == NULL && err != NULL)
         {
-            if (atoi(arc_param_get(kvset, "i")) == i)
-            {
-                break;
-            }
+            *err = "d2i_PrivateKey_bio() failed";
         }
+    }
 
-        cv = arc_param_get(kvset, "cv");
-        if (!((i == 1 && strcasecmp(cv, "none") == 0) ||
-              (i != 1 && strcasecmp(cv, "pass") == 0)))
-        {
-            /* the chain has already failed */
-            msg->arc_cstate = ARC_CHAIN_FAIL;
-            msg->arc_infail = true;
-            return ARC_STAT_OK;
-        }
+    BIO_free(keydata);
 
-        status = arc_validate_seal(msg, i);
-        if (status == ARC_STAT_INTERNAL)
+    if (pkey == NULL)
+    {
+        return NULL;
+    }
+
+    sk = ARC_CALLOC(1, sizeof *sk);
+    if (sk == NULL)
+    {
+        if (err != NULL)
         {
-            return status;
+            *err = strerror(errno);
         }
-        if (status != ARC_STAT_OK)
+        EVP_PKEY_free(pkey);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&sk->sk_lock, NULL) != 0)
+    {
+        if (err != NULL)
         {
-            msg->arc_cstate = ARC_CHAIN_FAIL;
-            return ARC_STAT_OK;
+            *err = "pthread_mutex_init() failed";
         }
+        EVP_PKEY_free(pkey);
+        ARC_FREE(sk);
+        return NULL;
     }
 
-    return ARC_STAT_OK;
+    sk->sk_refcnt = 1;
+    sk->sk_keytype = arc_pkey_keytype(pkey);
+    sk->sk_pkey = pkey;
+
+    return sk;
 }
 
 /*
-**  ARC_SET_CV -- force the chain state
+**  ARC_SIGNKEY_REF -- take another reference to a signing key
 **
 **  Parameters:
-**  	msg -- ARC_MESSAGE object
-**  	cv -- chain state
+**  	sk -- signing key
+**
+**  Return value:
+**  	"sk", for convenience.
+*/
+
+ARC_SIGNKEY *
+arc_signkey_ref(ARC_SIGNKEY *sk)
+{
+    assert(sk != NULL);
+
+    pthread_mutex_lock(&sk->sk_lock);
+    sk->sk_refcnt++;
+    pthread_mutex_unlock(&sk->sk_lock);
+
+    return sk;
+}
+
+/*
+**  ARC_SIGNKEY_FREE -- drop a reference to a signing key
+**
+**  Parameters:
+**  	sk -- signing key (may be NULL)
 **
 **  Return value:
 **  	None.
+**
+**  Notes:
+**  	The key is destroyed when its last reference is dropped.
 */
 
 void
-arc_set_cv(ARC_MESSAGE *msg, ARC_CHAIN cv)
+arc_signkey_free(ARC_SIGNKEY *sk)
 {
-    assert(msg != NULL);
-    assert(cv == ARC_CHAIN_UNKNOWN || cv == ARC_CHAIN_NONE ||
-           cv == ARC_CHAIN_FAIL || cv == ARC_CHAIN_PASS);
+    unsigned int refcnt;
 
-    /* none is only valid if there is no existing chain */
-    if ((cv == ARC_CHAIN_NONE) && (msg->arc_nsets != 0))
+    if (sk == NULL)
     {
-        cv = ARC_CHAIN_PASS;
+        return;
     }
 
-    /* only update the state if it's not a hard failure */
-    if (!msg->arc_infail)
+    pthread_mutex_lock(&sk->sk_lock);
+    refcnt = --sk->sk_refcnt;
+    pthread_mutex_unlock(&sk->sk_lock);
+
+    if (refcnt > 0)
     {
-        if (msg->arc_cstate != cv)
-        {
-            /* there's no way of knowing. */
-            msg->arc_oldest_pass = -1;
-        }
-        msg->arc_cstate = cv;
+        return;
     }
+
+    pthread_mutex_destroy(&sk->sk_lock);
+    EVP_PKEY_free(sk->sk_pkey);
+    ARC_FREE(sk);
 }
 
 /*
@@ -3304,6 +4909,11 @@ arc_set_cv(ARC_MESSAGE *msg, ARC_CHAIN cv)
 **
 **  Return value:
 **  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	The key is decoded on every call; callers that seal many messages
+**  	with the same key should use arc_signkey_load() and
+**  	arc_getseal_key() instead.
 */
 
 ARC_STAT
@@ -3315,6 +4925,54 @@ arc_getseal(ARC_MESSAGE         *msg,
             const unsigned char *key,
             size_t               keylen,
             const char          *ar)
+{
+    ARC_STAT     status;
+    const char  *err = NULL;
+    ARC_SIGNKEY *sk;
+
+    assert(msg != NULL);
+    assert(key != NULL);
+    assert(keylen > 0);
+
+    sk = arc_signkey_load(key, keylen, &err);
+    if (sk == NULL)
+    {
+        arc_error(msg, "%s", err);
+        return ARC_STAT_NORESOURCE;
+    }
+
+    status = arc_getseal_key(msg, seal, authservid, selector, domain, sk, ar);
+
+    arc_signkey_free(sk);
+
+    return status;
+}
+
+/*
+**  ARC_GETSEAL_KEY -- get the "seal" to apply to this message, using a
+**                     preloaded key
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE object
+**  	seal -- seal to apply (returned)
+**      authservid -- authservid to use when generating the seal
+**      selector -- selector name
+**      domain -- domain name
+**      sk -- signing key from arc_signkey_load()
+**  	ar -- Authentication-Results to be enshrined
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+*/
+
+ARC_STAT
+arc_getseal_key(ARC_MESSAGE  *msg,
+                ARC_HDRFIELD **seal,
+                const char    *authservid,
+                const char    *selector,
+                const char    *domain,
+                ARC_SIGNKEY   *sk,
+                const char    *ar)
 {
     int                 rstatus;
     size_t              siglen;
@@ -3329,17 +4987,14 @@ arc_getseal(ARC_MESSAGE         *msg,
     ARC_HDRFIELD       *h;
     ARC_HDRFIELD        hdr;
     struct arc_dstring *dstr = NULL;
-    BIO                *keydata = NULL;
-    EVP_PKEY           *pkey = NULL;
-    EVP_PKEY_CTX       *ctx = NULL;
+    EVP_PKEY           *pkey;
 
     assert(msg != NULL);
     assert(seal != NULL);
     assert(authservid != NULL);
     assert(selector != NULL);
     assert(domain != NULL);
-    assert(key != NULL);
-    assert(keylen > 0);
+    assert(sk != NULL);
 
     /* if the chain arrived already failed, don't add anything */
     if (msg->arc_infail)
@@ -3366,8 +5021,8 @@ arc_getseal(ARC_MESSAGE         *msg,
     if (msg->arc_cstate == ARC_CHAIN_FAIL)
     {
         status = arc_add_canon(msg, ARC_CANONTYPE_SEAL, ARC_CANON_RELAXED,
-                               msg->arc_signalg, NULL, NULL, (ssize_t) -1,
-                               &msg->arc_sealcanon);
+                               arc_sign_hashtype(msg->arc_signalg), NULL,
+                               NULL, (ssize_t) -1, &msg->arc_sealcanon);
         if (status != ARC_STAT_OK)
         {
             arc_error(msg, "failed to initialize seal canonicalization object");
@@ -3388,61 +5043,27 @@ arc_getseal(ARC_MESSAGE         *msg,
     msg->arc_selector = selector;
     msg->arc_authservid = authservid;
 
-    /* load the key */
-    keydata = BIO_new_mem_buf(key, keylen);
-    if (keydata == NULL)
-    {
-        arc_error(msg, "BIO_new_mem_buf() failed");
-        status = ARC_STAT_NORESOURCE;
-        goto error;
-    }
+    pkey = sk->sk_pkey;
 
-    if (strncmp((const char *) key, "-----", 5) == 0)
-    {
-        pkey = PEM_read_bio_PrivateKey(keydata, NULL, NULL, NULL);
-        if (pkey == NULL)
-        {
-            arc_error(msg, "PEM_read_bio_PrivateKey() failed");
-            status = ARC_STAT_NORESOURCE;
-            goto error;
-        }
-    }
-    else
+    /* the key has to suit the algorithm we were asked to sign with */
+    msg->arc_hashtype = arc_sign_hashtype(msg->arc_signalg);
+    msg->arc_keytype = arc_sign_keytype(msg->arc_signalg);
+    if (sk->sk_keytype != msg->arc_keytype)
     {
-        pkey = d2i_PrivateKey_bio(keydata, NULL);
-        if (pkey == NULL)
-        {
-            arc_error(msg, "d2i_PrivateKey_bio() failed");
-            status = ARC_STAT_NORESOURCE;
-            goto error;
-        }
+        arc_error(msg, "signing key does not match algorithm %s",
+                  arc_code_to_name(algorithms, msg->arc_signalg));
+        status = ARC_STAT_BADALG;
+        goto error;
     }
 
-    ctx = EVP_PKEY_CTX_new(pkey, NULL);
-    if (ctx == NULL)
+    sigout = ARC_MALLOC(EVP_PKEY_size(pkey));
+    if (sigout == NULL)
     {
-        arc_error(msg, "EVP_PKEY_CTX_new() failed");
+        arc_error(msg, "can't allocate %d bytes for signature",
+                  EVP_PKEY_size(pkey));
         status = ARC_STAT_NORESOURCE;
         goto error;
     }
-    if (EVP_PKEY_sign_init(ctx) <= 0)
-    {
-        arc_error(msg, "EVP_PKEY_sign_init() failed");
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
-    if (EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0)
-    {
-        arc_error(msg, "EVP_PKEY_CTX_set_rsa_padding() failed");
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
-    if (EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) <= 0)
-    {
-        arc_error(msg, "EVP_PKEY_CTX_set_signature_md() failed");
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
 
     dstr = arc_dstring_new(ARC_MAXHEADER, 0, msg, &arc_error_cb);
 
@@ -3450,24 +5071,9 @@ arc_getseal(ARC_MESSAGE         *msg,
     **  Generate a new signature and store it.
     */
 
-    /* purge any previous seal */
-    if (msg->arc_sealhead != NULL)
-    {
-        ARC_HDRFIELD *tmphdr;
-        ARC_HDRFIELD *next;
-
-        tmphdr = msg->arc_sealhead;
-        while (tmphdr != NULL)
-        {
-            next = tmphdr->hdr_next;
-            ARC_FREE(tmphdr->hdr_text);
-            ARC_FREE(tmphdr);
-            tmphdr = next;
-        }
-
-        msg->arc_sealhead = NULL;
-        msg->arc_sealtail = NULL;
-    }
+    /* forget any previous seal; its memory goes with the arena */
+    msg->arc_sealhead = NULL;
+    msg->arc_sealtail = NULL;
 
     /*
     **  Part 1: Construct a new AAR
@@ -3486,7 +5092,7 @@ arc_getseal(ARC_MESSAGE         *msg,
     }
 
     status = arc_parse_header_field(msg, arc_dstring_get(dstr),
-                                    arc_dstring_len(dstr), &h);
+                                    arc_dstring_len(dstr), false, &h);
     if (status != ARC_STAT_OK)
     {
         arc_error(msg, "arc_parse_header_field() failed");
@@ -3525,7 +5131,8 @@ arc_getseal(ARC_MESSAGE         *msg,
     hdr.hdr_text = arc_dstring_get(dstr);
     hdr.hdr_namelen = ARC_MSGSIG_HDRNAMELEN;
     hdr.hdr_textlen = len;
-    hdr.hdr_flags = 0;
+    hdr.hdr_flags = ARC_HDR_NOCACHE;
+    hdr.hdr_relaxed = NULL;
     hdr.hdr_next = NULL;
 
     /* canonicalize */
@@ -3545,25 +5152,9 @@ arc_getseal(ARC_MESSAGE         *msg,
         goto error;
     }
 
-    /* encrypt the digest; that's our signature */
-    rstatus = EVP_PKEY_sign(ctx, NULL, &siglen, digest, diglen);
-    if (rstatus >= 0)
-    {
-        sigout = ARC_MALLOC(siglen);
-        if (sigout == NULL)
-        {
-            arc_error(msg, "can't allocate %d bytes for signature", siglen);
-            status = ARC_STAT_NORESOURCE;
-            goto error;
-        }
-        rstatus = EVP_PKEY_sign(ctx, sigout, &siglen, digest, diglen);
-    }
-
-    if (rstatus != 1 || siglen == 0)
+    status = arc_sign_digest(msg, pkey, digest, diglen, sigout, &siglen);
+    if (status != ARC_STAT_OK)
     {
-        arc_error(msg, "EVP_PKEY_sign() failed (status %d, length %d)", rstatus,
-                  siglen);
-        status = ARC_STAT_INTERNAL;
         goto error;
     }
 
@@ -3590,32 +5181,21 @@ arc_getseal(ARC_MESSAGE         *msg,
     /* append it to the stub */
     arc_dstring_cat_wrap(dstr, (char *) b64sig, msg->arc_margin, NULL);
 
-    /* add it to the seal */
-    h = ARC_MALLOC(sizeof hdr);
-    if (h == NULL)
-    {
-        arc_error(msg, "can't allocate %d bytes", sizeof hdr);
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
-
     /* This header is generated with \r\n so that simple canonicalization
      * will work, but the established interface is that the library returns
      * just \n.
      */
     arc_dstring_strip(dstr, "\r");
-    h->hdr_text = ARC_STRDUP(arc_dstring_get(dstr));
-    if (h->hdr_text == NULL)
+
+    /* add it to the seal */
+    h = arc_hdrfield_alloc(msg, arc_dstring_len(dstr));
+    if (h == NULL)
     {
-        arc_error(msg, "can't allocate %d bytes", arc_dstring_len(dstr));
         status = ARC_STAT_INTERNAL;
-        ARC_FREE(h);
         goto error;
     }
+    memcpy(h->hdr_text, arc_dstring_get(dstr), arc_dstring_len(dstr));
     h->hdr_namelen = ARC_MSGSIG_HDRNAMELEN;
-    h->hdr_textlen = arc_dstring_len(dstr);
-    h->hdr_flags = 0;
-    h->hdr_next = NULL;
 
     msg->arc_sealtail->hdr_next = h;
     msg->arc_sealtail = h;
@@ -3647,7 +5227,8 @@ arc_getseal(ARC_MESSAGE         *msg,
     hdr.hdr_text = arc_dstring_get(dstr);
     hdr.hdr_namelen = ARC_SEAL_HDRNAMELEN;
     hdr.hdr_textlen = len;
-    hdr.hdr_flags = 0;
+    hdr.hdr_flags = ARC_HDR_NOCACHE;
+    hdr.hdr_relaxed = NULL;
     hdr.hdr_next = NULL;
 
     /* canonicalize */
@@ -3666,13 +5247,9 @@ arc_getseal(ARC_MESSAGE         *msg,
         goto error;
     }
 
-    /* encrypt the digest; that's our signature */
-    rstatus = EVP_PKEY_sign(ctx, sigout, &siglen, digest, diglen);
-    if (rstatus != 1 || siglen == 0)
+    status = arc_sign_digest(msg, pkey, digest, diglen, sigout, &siglen);
+    if (status != ARC_STAT_OK)
     {
-        arc_error(msg, "EVP_PKEY_sign() failed (status %d, length %d)", rstatus,
-                  siglen);
-        status = ARC_STAT_INTERNAL;
         goto error;
     }
 
@@ -3690,26 +5267,15 @@ arc_getseal(ARC_MESSAGE         *msg,
     arc_dstring_cat_wrap(dstr, (char *) b64sig, msg->arc_margin, NULL);
 
     /* add it to the seal */
-    h = ARC_MALLOC(sizeof hdr);
-    if (h == NULL)
-    {
-        arc_error(msg, "can't allocate %d bytes", sizeof hdr);
-        status = ARC_STAT_INTERNAL;
-        goto error;
-    }
     arc_dstring_strip(dstr, "\r");
-    h->hdr_text = ARC_STRDUP(arc_dstring_get(dstr));
-    if (h->hdr_text == NULL)
+    h = arc_hdrfield_alloc(msg, arc_dstring_len(dstr));
+    if (h == NULL)
     {
-        arc_error(msg, "can't allocate %d bytes", sizeof hdr);
-        ARC_FREE(h);
         status = ARC_STAT_INTERNAL;
         goto error;
     }
+    memcpy(h->hdr_text, arc_dstring_get(dstr), arc_dstring_len(dstr));
     h->hdr_namelen = ARC_SEAL_HDRNAMELEN;
-    h->hdr_textlen = len;
-    h->hdr_flags = 0;
-    h->hdr_next = NULL;
 
     msg->arc_sealtail->hdr_next = h;
     msg->arc_sealtail = h;
@@ -3723,9 +5289,6 @@ error:
     arc_dstring_free(dstr);
     ARC_FREE(b64sig);
     ARC_FREE(sigout);
-    EVP_PKEY_free(pkey);
-    BIO_free(keydata);
-    EVP_PKEY_CTX_free(ctx);
     return status;
 }
 
@@ -3852,6 +5415,49 @@ arc_chain_status(ARC_MESSAGE *msg)
     return msg->arc_cstate;
 }
 
+/*
+**  ARC_CHAIN_EARLY_STATUS -- retrieve the chain status known after arc_eoh()
+**
+**  Parameters:
+**      msg -- ARC_MESSAGE object
+**
+**  Return value:
+**      ARC_CHAIN_FAIL if the chain is already known to be broken,
+**      ARC_CHAIN_NONE if there is no chain, ARC_CHAIN_PASS if every seal
+**      has been verified (only the final AMS and body hash remain), and
+**      ARC_CHAIN_UNKNOWN otherwise.
+**
+**  Notes:
+**      Seals are only verified by arc_eoh() when ARC_LIBFLAGS_EARLYSEAL
+**      is set.  After arc_eom() this is the same as arc_chain_status().
+*/
+
+ARC_CHAIN
+arc_chain_early_status(ARC_MESSAGE *msg)
+{
+    assert(msg != NULL);
+
+    if (msg->arc_state < ARC_STATE_EOH)
+    {
+        return ARC_CHAIN_UNKNOWN;
+    }
+    else if (msg->arc_cstate == ARC_CHAIN_FAIL ||
+             msg->arc_cstate == ARC_CHAIN_PASS)
+    {
+        return msg->arc_cstate;
+    }
+    else if (msg->arc_nsets == 0)
+    {
+        return ARC_CHAIN_NONE;
+    }
+    else if (msg->arc_sealsdone)
+    {
+        return ARC_CHAIN_PASS;
+    }
+
+    return ARC_CHAIN_UNKNOWN;
+}
+
 /*
 **  ARC_CHAIN_STATUS_STR -- retrieve chain status, as a string
 **
@@ -3922,6 +5528,79 @@ arc_chain_custody_str(ARC_MESSAGE *msg, char *buf, size_t buflen)
     return appendlen;
 }
 
+/*
+**  ARC_FIND_OLDEST_PASS -- verify the older AMSs to find oldest-pass
+**
+**  Parameters:
+**      msg -- ARC_MESSAGE object, whose chain has passed
+**
+**  Return value:
+**      None.
+**
+**  Side effects:
+**      Sets msg->arc_oldest_pass, to -1 if a signature could not be checked
+**      at all.
+*/
+
+static void
+arc_find_oldest_pass(ARC_MESSAGE *msg)
+{
+    unsigned int       keytype = msg->arc_keytype;
+    unsigned int       hashtype = msg->arc_hashtype;
+    const char        *domain = msg->arc_domain;
+    const char        *selector = msg->arc_selector;
+    struct arc_verify *avs = NULL;
+
+    /* with a worker pool, check them all at once */
+    if (msg->arc_library->arcl_pool != NULL && msg->arc_nsets > 2)
+    {
+        avs = arc_validate_batch(msg, true);
+    }
+
+    msg->arc_oldest_pass = 0;
+
+    for (unsigned int i = msg->arc_nsets - 1; i > 0; i--)
+    {
+        ARC_STAT status;
+
+        status = arc_validate_result(msg, avs, false, i);
+        if (status == ARC_STAT_OK)
+        {
+            continue;
+        }
+
+        switch (status)
+        {
+        case ARC_STAT_BADSIG:
+        case ARC_STAT_NOKEY:
+        case ARC_STAT_REVOKED:
+        case ARC_STAT_SYNTAX:
+        case ARC_STAT_BADALG:
+            msg->arc_oldest_pass = i + 1;
+            break;
+
+        default:
+            /*
+            **  Not a verdict on this signature (a verification limit
+            **  or a transient failure), so the oldest pass is unknown.
+            */
+
+            msg->arc_oldest_pass = -1;
+            break;
+        }
+
+        break;
+    }
+
+    arc_validate_release(msg, avs);
+
+    /* leave what arc_getseal() uses as it was */
+    msg->arc_keytype = keytype;
+    msg->arc_hashtype = hashtype;
+    msg->arc_domain = domain;
+    msg->arc_selector = selector;
+}
+
 /*
 **  ARC_CHAIN_OLDEST_PASS -- retrieve the oldest-pass value
 **
@@ -3931,14 +5610,26 @@ arc_chain_custody_str(ARC_MESSAGE *msg, char *buf, size_t buflen)
 **  Return value:
 **      The lowest instance value where the AMS signature passed verification,
 **      `0` if all signatures passed, or `-1` for unknown.
+**
+**  Notes:
+**      arc_eom() only verifies the newest AMS.  The older ones are verified
+**      the first time this is called, newest first, stopping at the first
+**      that fails.
 */
 
 int
 arc_chain_oldest_pass(ARC_MESSAGE *msg)
 {
-    if (msg->arc_cstate == ARC_CHAIN_PASS)
+    if (msg->arc_cstate != ARC_CHAIN_PASS)
+    {
+        return -1;
+    }
+
+    if (msg->arc_oldestpending)
     {
-        return msg->arc_oldest_pass;
+        msg->arc_oldestpending = false;
+        arc_find_oldest_pass(msg);
     }
-    return -1;
+
+    return msg->arc_oldest_pass;
 }
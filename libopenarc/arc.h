@@ -38,6 +38,7 @@ extern "C" {
 #define ARC_MAXHDRNAMELEN      (ARC_MAXLINELEN - 3) /* deduct ":" CRLF */
 
 #define ARC_AR_HDRNAME         "ARC-Authentication-Results"
+#define ARC_DEFAULT_KEYTTL     86400
 #define ARC_DEFAULT_MINKEYSIZE 1024
 #define ARC_MSGSIG_HDRNAME     "ARC-Message-Signature"
 #define ARC_MSGSIG_HDRNAMELEN  sizeof(ARC_MSGSIG_HDRNAME) - 1
@@ -107,10 +108,11 @@ typedef int arc_canon_t;
 
 typedef int arc_alg_t;
 
-#define ARC_SIGN_UNKNOWN   (-2) /* unknown method */
-#define ARC_SIGN_DEFAULT   (-1) /* use internal default */
-#define ARC_SIGN_RSASHA1   0    /* an RSA-signed SHA1 digest */
-#define ARC_SIGN_RSASHA256 1    /* an RSA-signed SHA256 digest */
+#define ARC_SIGN_UNKNOWN       (-2) /* unknown method */
+#define ARC_SIGN_DEFAULT       (-1) /* use internal default */
+#define ARC_SIGN_RSASHA1       0    /* an RSA-signed SHA1 digest */
+#define ARC_SIGN_RSASHA256     1    /* an RSA-signed SHA256 digest */
+#define ARC_SIGN_ED25519SHA256 2    /* an Ed25519-signed SHA256 digest */
 
 /*
 **  ARC_QUERY -- key query method
@@ -145,11 +147,17 @@ typedef int arc_opts_t;
 #define ARC_OPTS_MINKEYSIZE     5
 #define ARC_OPTS_TESTKEYS       6
 #define ARC_OPTS_SIGNATURE_TTL  7
+#define ARC_OPTS_KEYCACHE       8
+#define ARC_OPTS_KEYCACHE_TTL   9
+#define ARC_OPTS_CRYPTO_THREADS 10
+#define ARC_OPTS_CRYPTO_QUEUE   11
+#define ARC_OPTS_MAXVERIFYBITS  12
 
 /* flags */
 #define ARC_LIBFLAGS_NONE       0x00000000
 #define ARC_LIBFLAGS_FIXCRLF    0x00000001
 #define ARC_LIBFLAGS_KEEPFILES  0x00000002
+#define ARC_LIBFLAGS_EARLYSEAL  0x00000004
 
 /* default */
 #define ARC_LIBFLAGS_DEFAULT    ARC_LIBFLAGS_NONE
@@ -187,9 +195,10 @@ struct arc_lib;
 typedef struct arc_lib ARC_LIB;
 
 /* LIBRARY FEATURES */
-#define ARC_FEATURE_SHA256 1
+#define ARC_FEATURE_SHA256  1
+#define ARC_FEATURE_ED25519 2
 
-#define ARC_FEATURE_MAX    1
+#define ARC_FEATURE_MAX     2
 
 extern bool arc_libfeature(ARC_LIB *lib, unsigned int fc);
 
@@ -207,6 +216,13 @@ typedef struct arc_msghandle ARC_MESSAGE;
 struct arc_hdrfield;
 typedef struct arc_hdrfield ARC_HDRFIELD;
 
+/*
+**  ARC_SIGNKEY -- a decoded private key for signing
+*/
+
+struct arc_signkey;
+typedef struct arc_signkey ARC_SIGNKEY;
+
 /*
 **  PROTOTYPES
 */
@@ -279,6 +295,34 @@ extern const char *arc_geterror(ARC_MESSAGE *);
 
 extern ARC_STAT arc_options(ARC_LIB *, int, int, void *, size_t);
 
+/*
+**  ARC_SET_ALLOCATOR -- supply the functions used for per-message memory
+**
+**  Parameters:
+**  	lib -- library instance of interest
+**  	mallocf -- allocation function, called as mallocf(closure, nbytes)
+**  	freef -- release function, called as freef(closure, ptr)
+**  	closure -- opaque pointer passed to both
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	These allocate message handles and their arenas, which hold the
+**  	header fields, parsed tag sets and canonicalization state.  Other
+**  	memory, such as growable buffers, temporary buffers used while
+**  	signing and verifying, and anything OpenSSL allocates, still comes
+**  	from malloc().
+**
+**  	Both functions must be thread-safe.  Set them before creating any
+**  	message handles; NULL for both restores the default.
+*/
+
+extern ARC_STAT arc_set_allocator(ARC_LIB *,
+                                  void *(*)(void *, size_t),
+                                  void (*)(void *, void *),
+                                  void *);
+
 /*
 **  ARC_SET_DNS -- override DNS resolver
 */
@@ -293,6 +337,24 @@ extern ARC_STAT arc_set_dns(
     int (*)(void *, void *),
     int (*)(void *, void *, struct timeval *, size_t *, int *, int *));
 
+/*
+**  ARC_DNS_NSLIST -- set the nameservers used by the built-in resolver
+**
+**  Parameters:
+**  	lib -- library handle
+**  	nslist -- comma-separated list of numeric addresses, each optionally
+**  	          with a port ("192.0.2.1:5353", "[2001:db8::1]:5353")
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	Call this before the first message is processed.  It can't be
+**  	used along with arc_set_dns().
+*/
+
+extern ARC_STAT arc_dns_nslist(ARC_LIB *, const char *);
+
 /*
 **  ARC_GETSSLBUF -- retrieve SSL error buffer
 **
@@ -323,6 +385,29 @@ extern const char *arc_getsslbuf(ARC_LIB *);
 extern ARC_MESSAGE *arc_message(
     ARC_LIB *, arc_canon_t, arc_canon_t, arc_alg_t, arc_mode_t, const char **);
 
+/*
+**  ARC_MESSAGE_RESET -- prepare a message handle for another message
+**
+**  Parameters:
+**  	msg -- message handle to reuse
+**  	canonhdr -- canonicalization to use for the header
+**  	canonbody -- canonicalization to use for the body
+**  	signalg -- signing algorithm
+**  	mode -- mask of mode bits
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	The handle behaves as if newly returned by arc_message() on the
+**  	same library, but keeps its buffers, digest contexts and arena
+**  	memory.  Header fields passed to arc_header_field_borrow() need
+**  	not outlive the reset.
+*/
+
+extern ARC_STAT arc_message_reset(
+    ARC_MESSAGE *, arc_canon_t, arc_canon_t, arc_alg_t, arc_mode_t);
+
 /*
 **  ARC_FREE -- deallocate a message object
 **
@@ -349,6 +434,24 @@ extern void arc_free(ARC_MESSAGE *);
 
 extern ARC_STAT arc_header_field(ARC_MESSAGE *, const char *, size_t);
 
+/*
+**  ARC_HEADER_FIELD_BORROW -- consume a header field without copying it
+**
+**  Parameters:
+**  	msg -- message handle
+**  	hname -- name of the header field, NUL-terminated at hlen
+**  	hlen -- bytes to use at hname
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	The buffer must remain valid and unchanged until arc_free() or
+**  	arc_message_reset().
+*/
+
+extern ARC_STAT arc_header_field_borrow(ARC_MESSAGE *, const char *, size_t);
+
 /*
 **  ARC_EOH -- declare no more headers are coming
 **
@@ -378,6 +481,19 @@ extern ARC_STAT arc_eoh(ARC_MESSAGE *);
 
 extern ARC_STAT arc_body(ARC_MESSAGE *, const unsigned char *, size_t);
 
+/*
+**  ARC_BODY_NEEDED -- determine whether any more of the body is wanted
+**
+**  Parameters:
+**  	msg -- an ARC message handle
+**
+**  Return value:
+**  	true iff more body chunks could still affect the result; once this
+**  	returns false after arc_eoh(), the rest of the body may be skipped.
+*/
+
+extern bool arc_body_needed(ARC_MESSAGE *);
+
 /*
 **  ARC_EOM -- declare end of message
 **
@@ -433,6 +549,76 @@ extern ARC_STAT arc_getseal(ARC_MESSAGE *,
                             size_t,
                             const char *);
 
+/*
+**  ARC_SIGNKEY_LOAD -- decode a private key for use with arc_getseal_key()
+**
+**  Parameters:
+**  	key -- secret key, PEM or DER encoded
+**  	keylen -- key length
+**  	err -- error string (returned)
+**
+**  Return value:
+**  	A new signing key holding one reference, or NULL on failure (and
+**  	"err" is updated).
+*/
+
+extern ARC_SIGNKEY *arc_signkey_load(const unsigned char *,
+                                     size_t,
+                                     const char **);
+
+/*
+**  ARC_SIGNKEY_REF -- take another reference to a signing key
+**
+**  Parameters:
+**  	sk -- signing key
+**
+**  Return value:
+**  	"sk", for convenience.
+*/
+
+extern ARC_SIGNKEY *arc_signkey_ref(ARC_SIGNKEY *);
+
+/*
+**  ARC_SIGNKEY_FREE -- drop a reference to a signing key
+**
+**  Parameters:
+**  	sk -- signing key (may be NULL)
+**
+**  Return value:
+**  	None.
+*/
+
+extern void arc_signkey_free(ARC_SIGNKEY *);
+
+/*
+**  ARC_GETSEAL_KEY -- get the "seal" to apply to this message, using a
+**                     preloaded key
+**
+**  Parameters:
+**  	msg -- ARC_MESSAGE object
+**  	seal -- seal to apply (returned)
+**  	authservid -- authservid to use when generating A-R fields
+**  	selector -- selector name
+**  	domain -- domain name
+**  	sk -- signing key from arc_signkey_load()
+**  	ar -- Authentication-Results to be enshrined
+**
+**  Return value:
+**  	An ARC_STAT_* constant.
+**
+**  Notes:
+**  	As arc_getseal(), but without decoding the key for every message.
+**  	The caller keeps its reference to "sk".
+*/
+
+extern ARC_STAT arc_getseal_key(ARC_MESSAGE *,
+                                ARC_HDRFIELD **,
+                                const char *,
+                                const char *,
+                                const char *,
+                                ARC_SIGNKEY *,
+                                const char *);
+
 /*
 **  ARC_HDR_NAME -- extract name from an ARC_HDRFIELD
 **
@@ -501,6 +687,22 @@ extern const char *arc_get_domain(ARC_MESSAGE *msg);
 
 extern ARC_CHAIN arc_chain_status(ARC_MESSAGE *msg);
 
+/*
+**  ARC_CHAIN_EARLY_STATUS -- retrieve the chain status known after arc_eoh()
+**
+**  Parameters:
+**      msg -- ARC_MESSAGE object
+**
+**  Return value:
+**      ARC_CHAIN_FAIL if the chain is already known to be broken,
+**      ARC_CHAIN_NONE if there is no chain, ARC_CHAIN_PASS if every seal
+**      has been verified (only the final AMS and body hash remain), and
+**      ARC_CHAIN_UNKNOWN otherwise.  Seals are only verified by arc_eoh()
+**      when ARC_LIBFLAGS_EARLYSEAL is set.
+*/
+
+extern ARC_CHAIN arc_chain_early_status(ARC_MESSAGE *msg);
+
 /*
 **  ARC_CHAIN_STATUS_STR -- retrieve chain status, as a string
 **
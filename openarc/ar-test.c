@@ -19,14 +19,13 @@
 int
 main(int argc, char **argv)
 {
-    int            c;
-    int            d;
-    int            status;
-    char          *p;
-    char          *progname;
-    struct authres ar;
-    char           buf[ARC_MAXHEADER + 2];
-    char          *toks[1024];
+    int               c;
+    int               d;
+    int               status;
+    char             *p;
+    char             *progname;
+    struct authres    ar;
+    struct ares_token toks[1024];
 
     progname = (p = strrchr(argv[0], '/')) == NULL ? argv[0] : p + 1;
 
@@ -36,45 +35,53 @@ main(int argc, char **argv)
         return EX_USAGE;
     }
 
-    c = ares_tokenize(argv[1], buf, sizeof buf, toks, 1024);
-    for (d = 0; d < c; d++)
+    c = ares_tokenize(argv[1], toks, 1024);
+    for (d = 0; d < c && d < 1024; d++)
     {
-        printf("token %d = '%s'\n", d, toks[d]);
+        printf("token %d = '%.*s'\n", d, (int) toks[d].tok_len,
+               argv[1] + toks[d].tok_off);
     }
 
     printf("\n");
 
+    memset(&ar, '\0', sizeof ar);
     status = ares_parse(argv[1], &ar, NULL);
     if (status == -1)
     {
         printf("%s: ares_parse() returned -1\n", progname);
+        ares_free(&ar);
         return EX_OK;
     }
 
     printf("%d result%s found\n", ar.ares_count, ar.ares_count == 1 ? "" : "s");
 
-    printf("authserv-id '%s'\n", ar.ares_host);
-    printf("version '%s'\n", ar.ares_version);
+    printf("authserv-id '%.*s'\n", (int) ar.ares_hostlen, ar.ares_host);
+    printf("version '%.*s'\n", (int) ar.ares_versionlen, ar.ares_version);
 
     for (c = 0; c < ar.ares_count; c++)
     {
-        printf("result #%d, %d propert%s\n", c, ar.ares_result[c].result_props,
-               ar.ares_result[c].result_props == 1 ? "y" : "ies");
+        struct result *r = &ar.ares_result[c];
 
-        printf("\tmethod \"%s\"\n",
-               ares_getmethod(ar.ares_result[c].result_method));
-        printf("\tresult \"%s\"\n",
-               ares_getresult(ar.ares_result[c].result_result));
-        printf("\treason \"%s\"\n", ar.ares_result[c].result_reason);
+        printf("result #%d, %d propert%s\n", c, r->result_props,
+               r->result_props == 1 ? "y" : "ies");
 
-        for (d = 0; d < ar.ares_result[c].result_props; d++)
+        printf("\tmethod \"%s\"\n", ares_getmethod(r->result_method));
+        printf("\tresult \"%s\"\n", ares_getresult(r->result_result));
+        printf("\treason \"%.*s\"\n", (int) r->result_reasonlen,
+               r->result_reason);
+
+        for (d = 0; d < r->result_props; d++)
         {
+            struct prop *pr = &ar.ares_prop[r->result_firstprop + d];
+
             printf("\tproperty #%d\n", d);
-            printf("\t\tptype \"%s\"\n",
-                   ares_getptype(ar.ares_result[c].result_ptype[d]));
-            printf("\t\tproperty \"%s\"\n",
-                   ar.ares_result[c].result_property[d]);
-            printf("\t\tvalue \"%s\"\n", ar.ares_result[c].result_value[d]);
+            printf("\t\tptype \"%s\"\n", ares_getptype(pr->prop_ptype));
+            printf("\t\tproperty \"%.*s\"\n", (int) pr->prop_propertylen,
+                   pr->prop_property);
+            printf("\t\tvalue \"%.*s\"\n", (int) pr->prop_valuelen,
+                   pr->prop_value);
         }
     }
+
+    ares_free(&ar);
 }
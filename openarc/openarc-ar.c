@@ -12,31 +12,22 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/types.h>
 
-/* libbsd if found */
-#ifdef USE_BSD_H
-#include <bsd/string.h>
-#endif /* USE_BSD_H */
-
-/* libstrl if needed */
-#ifdef USE_STRL_H
-#include <strl.h>
-#endif /* USE_STRL_H */
-
 /* openarc includes */
+#include "arc-malloc.h"
 #include "arc-nametable.h"
 #include "openarc-ar.h"
 
 /* macros */
-#define ARES_ENDOF(x)     ((x) + sizeof(x) - 1)
-#define ARES_STRORNULL(x) ((x) == NULL ? "(null)" : (x))
-#define ARES_TOKENS       ";=."
-#define ARES_TOKENS2      "=."
+#define ARES_TOKENS  ";=."
+#define ARES_TOKENS2 "=."
 
-#define ARES_MAXTOKENS    1024
+/* is token "t" of length "l" the single character "c"? */
+#define ARES_ISCHAR(t, l, c) ((l) == 1 && (t)[0] == (c))
 
 struct nametable methods[] = {
     {"arc",        ARES_METHOD_ARC       },
@@ -101,223 +92,200 @@ enum ar_parser_state
 };
 
 /*
-**  ARES_TOKENIZE -- tokenize a string
+**  ARES_NEXTTOKEN -- find the next token in a string
 **
 **  Parameters:
 **  	input -- input string
-**  	outbuf -- output buffer
-**  	outbuflen -- number of bytes available at "outbuf"
-**  	tokens -- array of token pointers
-**  	ntokens -- number of token pointers available at "tokens"
+**  	pos -- offset at which to start looking (updated)
+**  	tok -- token found (returned)
 **
 **  Return value:
-**  	-1 -- bad syntax or not enough space at "outbuf" for tokenizing
-**  	other -- number of tokens identified; may be greater than
-**  	"ntokens" if there were more tokens found than there were
-**  	pointers available.
+**  	1 -- a token was found
+**  	0 -- no more tokens
+**  	-1 -- unbalanced quotes or comment
+**
+**  Notes:
+**  	A token is a delimiter, a comment, or a run of other text in which
+**  	quoted-strings and comments may appear.  The token covers the text
+**  	exactly as it appears in "input", including any quotes.
 */
 
-int
-ares_tokenize(const char *input,
-              char       *outbuf,
-              size_t      outbuflen,
-              char      **tokens,
-              int         ntokens)
+static int
+ares_nexttoken(const char *input, size_t *pos, struct ares_token *tok)
 {
-    bool  quoted = false;
-    bool  escaped = false;
-    bool  intok = false;
-    int   n = 0;
-    int   parens = 0;
-    char *q;
-    char *end;
-
-    assert(input != NULL);
-    assert(outbuf != NULL);
-    assert(outbuflen > 0);
-    assert(tokens != NULL);
-    assert(ntokens > 0);
+    bool        quoted = false;
+    bool        escaped = false;
+    int         parens = 0;
+    const char *p;
+    const char *start;
+
+    p = input + *pos;
+    while (isascii(*p) && isspace(*p))
+    {
+        p++;
+    }
 
-    q = outbuf;
-    end = outbuf + outbuflen - 1;
+    if (*p == '\0')
+    {
+        *pos = p - input;
+        return 0;
+    }
 
-    for (const char *p = input; *p != '\0' && q <= end; p++)
+    start = p;
+    if (strchr(ARES_TOKENS, *p) != NULL) /* delimiter */
+    {
+        p++;
+    }
+    else
     {
-        if (escaped) /* escape */
+        for (; *p != '\0'; p++)
         {
-            if (!intok)
+            if (escaped)
             {
-                if (n < ntokens)
-                {
-                    tokens[n] = q;
-                }
-                intok = true;
+                escaped = false;
             }
-
-            if (*p == '\\' || *p == '"')
+            else if (quoted) /* quoted character */
             {
-                /* Needs to remain escaped. */
-                *q = '\\';
-                q++;
-            }
-            *q = *p;
-            q++;
-            escaped = false;
-        }
-        else if (*p == '\\' && quoted) /* escape */
-        {
-            escaped = true;
-        }
-        else if (*p == '"' && parens == 0) /* quoting */
-        {
-            quoted = !quoted;
-
-            if (!intok)
-            {
-                if (n < ntokens)
+                if (*p == '\\')
                 {
-                    tokens[n] = q;
+                    escaped = true;
                 }
-                intok = true;
-            }
-        }
-        else if (*p == '(' && !quoted) /* "(" (comment) */
-        {
-            parens++;
-
-            if (!intok)
-            {
-                if (n < ntokens)
+                else if (*p == '"')
                 {
-                    tokens[n] = q;
+                    quoted = false;
                 }
-                intok = true;
             }
-
-            *q = *p;
-            q++;
-        }
-        else if (*p == ')' && !quoted) /* ")" (comment) */
-        {
-            if (parens > 0)
-            {
-                parens--;
-
-                if (parens == 0)
-                {
-                    intok = false;
-                    n++;
-
-                    *q = ')';
-                    q++;
-                    if (q <= end)
-                    {
-                        *q = '\0';
-                        q++;
-                    }
-                }
-            }
-        }
-        else if (quoted) /* quoted character */
-        {
-            *q = *p;
-            q++;
-        }
-        else if (isascii(*p) && isspace(*p)) /* whitespace */
-        {
-            if (intok)
+            else if (parens > 0) /* comment */
             {
-                if (quoted)
+                if (*p == '(')
                 {
-                    *q = *p;
-                    q++;
+                    parens++;
                 }
-                else if (parens > 0)
+                else if (*p == ')' && --parens == 0)
                 {
-                    /* turn all whitespace in comments into single spaces */
-                    *q = ' ';
-                    q++;
-                    while (isspace(p[1]))
-                    {
-                        p++;
-                    }
-                }
-                else
-                {
-                    intok = false;
-                    *q = '\0';
-                    q++;
-                    n++;
+                    /* a comment always ends a token */
+                    p++;
+                    break;
                 }
             }
-        }
-        else if (strchr(ARES_TOKENS, *p) != NULL) /* delimiter */
-        {
-            if (parens > 0)
+            else if (*p == '"')
             {
-                *q = *p;
-                q++;
-                continue;
+                quoted = true;
             }
-
-            if (intok)
+            else if (*p == '(')
             {
-                intok = false;
-                *q = '\0';
-                q++;
-                n++;
+                parens++;
             }
-
-            if (q <= end)
-            {
-                *q = *p;
-                if (n < ntokens)
-                {
-                    tokens[n] = q;
-                    n++;
-                }
-                q++;
-            }
-
-            if (q <= end)
+            else if ((isascii(*p) && isspace(*p)) ||
+                     strchr(ARES_TOKENS, *p) != NULL)
             {
-                *q = '\0';
-                q++;
+                break;
             }
         }
-        else /* other */
-        {
-            if (!intok)
-            {
-                if (n < ntokens)
-                {
-                    tokens[n] = q;
-                }
-                intok = true;
-            }
 
-            *q = *p;
-            q++;
+        if (quoted || parens > 0)
+        {
+            return -1;
         }
     }
 
-    if (quoted || parens > 0)
-    {
-        return -1;
-    }
+    tok->tok_off = start - input;
+    tok->tok_len = p - start;
+    *pos = p - input;
+
+    return 1;
+}
+
+/*
+**  ARES_TOKENIZE -- tokenize a string
+**
+**  Parameters:
+**  	input -- input string
+**  	tokens -- array of tokens
+**  	ntokens -- number of tokens available at "tokens"
+**
+**  Return value:
+**  	-1 -- bad syntax
+**  	other -- number of tokens identified; may be greater than
+**  	"ntokens" if there were more tokens found than there was
+**  	room for.
+*/
+
+int
+ares_tokenize(const char *input, struct ares_token *tokens, int ntokens)
+{
+    int               n = 0;
+    int               status;
+    size_t            pos = 0;
+    struct ares_token tok;
+
+    assert(input != NULL);
+    assert(tokens != NULL);
+    assert(ntokens > 0);
 
-    if (q >= end)
+    while ((status = ares_nexttoken(input, &pos, &tok)) == 1)
     {
-        return -1;
+        if (n < ntokens)
+        {
+            tokens[n] = tok;
+        }
+        n++;
     }
 
-    if (intok)
+    return status == -1 ? -1 : n;
+}
+
+/*
+**  ARES_PROP_NEW -- make room for another property
+**
+**  Parameters:
+**  	ar -- authentication results
+**
+**  Return value:
+**  	The slot after the last property, cleared, or NULL on failure.
+**  	It isn't counted until the caller increments ar->ares_nprops.
+*/
+
+static struct prop *
+ares_prop_new(struct authres *ar)
+{
+    struct prop *new;
+
+    if (ar->ares_nprops == ar->ares_maxprops)
     {
-        *q = '\0';
-        n++;
+        int n = MAX(ar->ares_maxprops * 2, 8);
+
+        new = ARC_REALLOC(ar->ares_prop, n * sizeof *new);
+        if (new == NULL)
+        {
+            return NULL;
+        }
+        ar->ares_prop = new;
+        ar->ares_maxprops = n;
     }
 
-    return n;
+    new = &ar->ares_prop[ar->ares_nprops];
+    memset(new, '\0', sizeof *new);
+
+    return new;
+}
+
+/*
+**  ARES_RESULT_INIT -- start a new result
+**
+**  Parameters:
+**  	ar -- authentication results
+**  	r -- result to initialize
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+ares_result_init(struct authres *ar, struct result *r)
+{
+    memset(r, '\0', sizeof *r);
+    r->result_firstprop = ar->ares_nprops;
 }
 
 /*
@@ -330,14 +298,20 @@ ares_tokenize(const char *input,
 **
 **  Return value:
 **  	Whether the method was added
+**
+**  Notes:
+**  	The properties of a result that isn't added are discarded.
 */
 
 static bool
 ares_method_add(struct authres *ar, struct result *r)
 {
+    struct result *new;
+
     if (r->result_method == ARES_METHOD_UNKNOWN ||
         ar->ares_count >= MAXARESULTS)
     {
+        ar->ares_nprops = r->result_firstprop;
         return false;
     }
     if (r->result_method != ARES_METHOD_DKIM)
@@ -346,20 +320,33 @@ ares_method_add(struct authres *ar, struct result *r)
         {
             if (ar->ares_result[i].result_method == r->result_method)
             {
+                ar->ares_nprops = r->result_firstprop;
                 return false;
             }
         }
     }
 
-    memcpy(ar->ares_result + ar->ares_count, r,
-           sizeof ar->ares_result[ar->ares_count]);
+    if (ar->ares_count == ar->ares_maxresults)
+    {
+        int n = MAX(ar->ares_maxresults * 2, 4);
+
+        new = ARC_REALLOC(ar->ares_result, n * sizeof *new);
+        if (new == NULL)
+        {
+            ar->ares_nprops = r->result_firstprop;
+            return false;
+        }
+        ar->ares_result = new;
+        ar->ares_maxresults = n;
+    }
+
+    ar->ares_result[ar->ares_count] = *r;
     ar->ares_count++;
     return true;
 }
 
 /*
-**  ARES_PARSE -- parse an Authentication-Results: header, return a
-**                structure containing a parsed result
+**  ARES_PARSE_TOKENS -- the guts of ares_parse()
 **
 **  Parameters:
 **  	hdr -- NULL-terminated contents of an Authentication-Results:
@@ -369,41 +356,42 @@ ares_method_add(struct authres *ar, struct result *r)
 **
 **  Return value:
 **  	0 on success, -1 on failure, -2 when a header is uninteresting.
+**  	On failure, "ar" may have been partly updated.
 */
 
-int
-ares_parse(const char *hdr, struct authres *ar, const char *authserv)
+static int
+ares_parse_tokens(const char *hdr, struct authres *ar, const char *authserv)
 {
-    int                  ntoks;
+    bool                 laststored = false;
+    int                  status;
+    size_t               pos = 0;
+    size_t               hostmatch = 0;
+    const char          *t;
+    size_t               tlen;
+    const char          *host = NULL;
+    size_t               hostlen = 0;
     enum ar_parser_state state;
     enum ar_parser_state prevstate;
-    ares_method          m;
-    char                 tmp[ARC_MAXHEADER + 2];
-    char                *tokens[ARES_MAXTOKENS];
-    char                 ares_host[ARC_MAXHOSTNAMELEN + 1];
+    struct ares_token    tok;
+    struct prop         *prop;
     struct result        cur;
-    int                  initial_ares_count;
 
-    assert(hdr != NULL);
-    assert(ar != NULL);
-
-    memset(tmp, '\0', sizeof tmp);
-    memset(&cur, '\0', sizeof cur);
-    memset(ares_host, '\0', sizeof ares_host);
-
-    ntoks = ares_tokenize(hdr, tmp, sizeof tmp, tokens, ARES_MAXTOKENS);
-    if (ntoks == -1 || ntoks > ARES_MAXTOKENS)
-    {
-        return -1;
-    }
+    ares_result_init(ar, &cur);
 
     prevstate = ARP_STATE_AUTHSERVID;
     state = ARP_STATE_AUTHSERVID;
-    initial_ares_count = ar->ares_count;
 
-    for (int c = 0; c < ntoks; c++)
+    /*
+    **  Tokens are found one at a time, so a header field for some other
+    **  authserv-id is dropped without looking at the rest of it.
+    */
+
+    while ((status = ares_nexttoken(hdr, &pos, &tok)) == 1)
     {
-        if (tokens[c][0] == '(')
+        t = hdr + tok.tok_off;
+        tlen = tok.tok_len;
+
+        if (t[0] == '(')
         {
             /* Comments are valid in a lot of places, but we're
              * only interested in storing ones that are placed
@@ -412,11 +400,17 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             if (cur.result_props < MAXPROPS &&
                 (state == ARP_STATE_PROP_OR_REASON || state == ARP_STATE_PTYPE))
             {
-                cur.result_ptype[cur.result_props] = ARES_PTYPE_COMMENT;
-                strlcpy((char *) cur.result_value[cur.result_props],
-                        (char *) tokens[c],
-                        sizeof cur.result_value[cur.result_props]);
+                prop = ares_prop_new(ar);
+                if (prop == NULL)
+                {
+                    return -1;
+                }
+                prop->prop_ptype = ARES_PTYPE_COMMENT;
+                prop->prop_value = t;
+                prop->prop_valuelen = tlen;
+                ar->ares_nprops++;
                 cur.result_props++;
+                laststored = true;
             }
             continue;
         }
@@ -424,76 +418,92 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
         switch (state)
         {
         case ARP_STATE_AUTHSERVID:
-            if (isascii(tokens[c][0]) && !isalnum(tokens[c][0]))
+            /* the authserv-id may be a quoted-string; match what's inside */
+            if (prevstate == ARP_STATE_AUTHSERVID && tlen > 2 &&
+                t[0] == '"' && t[tlen - 1] == '"' &&
+                memchr(t + 1, '"', tlen - 2) == NULL &&
+                memchr(t + 1, '\\', tlen - 2) == NULL)
             {
-                ar->ares_count = initial_ares_count;
-                return -1;
+                t++;
+                tlen -= 2;
             }
 
-            if (tokens[c][0] == ';')
-            {
-                prevstate = state;
-                state = ARP_STATE_METHODSPEC;
-            }
-            else
+            if (isascii(t[0]) && !isalnum(t[0]))
             {
-                strlcat((char *) ares_host, (char *) tokens[c],
-                        sizeof ares_host);
-
-                prevstate = state;
-                state = ARP_STATE_AUTHRESVERSION_OR_AUTHSERVID;
+                return -1;
             }
 
-            break;
+            /* FALLTHROUGH */
 
         case ARP_STATE_AUTHRESVERSION_OR_AUTHSERVID:
-            if (tokens[c][0] == '.' && tokens[c][1] == '\0' &&
-                prevstate == ARP_STATE_AUTHSERVID)
+            if (state == ARP_STATE_AUTHRESVERSION_OR_AUTHSERVID &&
+                (!ARES_ISCHAR(t, tlen, '.') ||
+                 prevstate != ARP_STATE_AUTHSERVID))
             {
-                strlcat((char *) ares_host, (char *) tokens[c],
-                        sizeof ares_host);
+                /* We've successfully assembled the authserv-id. */
+                if (authserv != NULL && authserv[hostmatch] != '\0')
+                {
+                    return -2;
+                }
+                ar->ares_host = host;
+                ar->ares_hostlen = hostlen;
 
-                prevstate = state;
-                state = ARP_STATE_AUTHSERVID;
+                if (ARES_ISCHAR(t, tlen, ';'))
+                {
+                    prevstate = state;
+                    state = ARP_STATE_METHODSPEC;
+                }
+                else if (isascii(t[0]) && isdigit(t[0]))
+                {
+                    ar->ares_version = t;
+                    ar->ares_versionlen = tlen;
+
+                    prevstate = state;
+                    state = ARP_STATE_RESINFO;
+                }
+                else
+                {
+                    return -1;
+                }
 
                 break;
             }
 
-            /* We've successfully assembled the authserv-id,
-             * see if it's what we're looking for.
-             */
-            if (authserv && strcasecmp(authserv, ares_host) != 0)
+            /*
+            **  Another piece of the authserv-id; give up on the field
+            **  as soon as it stops matching the one we care about.
+            */
+
+            if (authserv != NULL)
             {
-                ar->ares_count = initial_ares_count;
-                return -2;
+                if (strncasecmp(authserv + hostmatch, t, tlen) != 0)
+                {
+                    return -2;
+                }
+                hostmatch += tlen;
             }
-            strlcpy(ar->ares_host, ares_host, sizeof ar->ares_host);
 
-            if (tokens[c][0] == ';')
+            if (host == NULL)
             {
-                prevstate = state;
-                state = ARP_STATE_METHODSPEC;
+                host = t;
             }
-            else if (isascii(tokens[c][0]) && isdigit(tokens[c][0]))
-            {
-                strlcpy((char *) ar->ares_version, (char *) tokens[c],
-                        sizeof ar->ares_version);
+            hostlen = t + tlen - host;
 
-                prevstate = state;
-                state = ARP_STATE_RESINFO;
+            prevstate = state;
+            if (state == ARP_STATE_AUTHSERVID)
+            {
+                state = ARP_STATE_AUTHRESVERSION_OR_AUTHSERVID;
             }
             else
             {
-                ar->ares_count = initial_ares_count;
-                return -1;
+                state = ARP_STATE_AUTHSERVID;
             }
 
             break;
 
         case ARP_STATE_RESINFO:
-            if (tokens[c][0] != ';' || tokens[c][1] != '\0')
+            if (!ARES_ISCHAR(t, tlen, ';'))
             {
-                ar->ares_count = initial_ares_count;
                 return -1;
             }
 
@@ -503,7 +513,7 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_METHODSPEC:
-            if (strcasecmp((char *) tokens[c], "none") == 0)
+            if (tlen == 4 && strncasecmp(t, "none", 4) == 0)
             {
                 switch (prevstate)
                 {
@@ -515,25 +525,21 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
                     continue;
                 default:
                     /* should not have other resinfo */
-                    ar->ares_count = initial_ares_count;
                     return -1;
                 }
             }
 
-            memset(&cur, '\0', sizeof cur);
-
-            m = arc_name_to_code(methods, (char *) tokens[c]);
+            ares_result_init(ar, &cur);
+            cur.result_method = arc_namen_to_code(methods, t, tlen);
 
-            cur.result_method = m;
             prevstate = state;
             state = ARP_STATE_METHODSPEC_EQUALS;
 
             break;
 
         case ARP_STATE_METHODSPEC_EQUALS:
-            if (tokens[c][0] != '=' || tokens[c][1] != '\0')
+            if (!ARES_ISCHAR(t, tlen, '='))
             {
-                ar->ares_count = initial_ares_count;
                 return -1;
             }
 
@@ -543,16 +549,15 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_RESULT:
-            cur.result_result = arc_name_to_code(aresults, (char *) tokens[c]);
+            cur.result_result = arc_namen_to_code(aresults, t, tlen);
             prevstate = state;
             state = ARP_STATE_PROP_OR_REASON;
 
             break;
 
         case ARP_STATE_REASONSPEC_EQUALS:
-            if (tokens[c][0] != '=' || tokens[c][1] != '\0')
+            if (!ARES_ISCHAR(t, tlen, '='))
             {
-                ar->ares_count = initial_ares_count;
                 return -1;
             }
             prevstate = state;
@@ -561,8 +566,8 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_REASONSPEC_VALUE:
-            strlcpy((char *) cur.result_reason, (char *) tokens[c],
-                    sizeof cur.result_reason);
+            cur.result_reason = t;
+            cur.result_reasonlen = tlen;
 
             prevstate = state;
             state = ARP_STATE_PTYPE;
@@ -570,18 +575,17 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_PROP_OR_REASON:
-            if (tokens[c][0] == ';' && /* neither */
-                tokens[c][1] == '\0')
+            if (ARES_ISCHAR(t, tlen, ';')) /* neither */
             {
                 ares_method_add(ar, &cur);
-                memset(&cur, '\0', sizeof cur);
+                ares_result_init(ar, &cur);
                 prevstate = state;
                 state = ARP_STATE_METHODSPEC;
 
                 continue;
             }
 
-            if (strcasecmp((char *) tokens[c], "reason") == 0)
+            if (tlen == 6 && strncasecmp(t, "reason", 6) == 0)
             { /* reason */
                 prevstate = state;
                 state = ARP_STATE_REASONSPEC_EQUALS;
@@ -596,25 +600,27 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             /* FALLTHROUGH */
 
         case ARP_STATE_PTYPE:
-            if (prevstate == ARP_STATE_PVALUE &&
-                strchr(ARES_TOKENS2, tokens[c][0]) != NULL &&
-                tokens[c][1] == '\0')
+            if (prevstate == ARP_STATE_PVALUE && tlen == 1 &&
+                strchr(ARES_TOKENS2, t[0]) != NULL)
             {
                 /* actually a part of the previous value */
-                cur.result_props--;
-                strlcat((char *) cur.result_value[cur.result_props],
-                        (char *) tokens[c],
-                        sizeof cur.result_value[cur.result_props]);
+                if (laststored)
+                {
+                    ar->ares_nprops--;
+                    cur.result_props--;
+                    prop = &ar->ares_prop[ar->ares_nprops];
+                    prop->prop_valuelen = t + tlen - prop->prop_value;
+                }
 
                 prevstate = state;
                 state = ARP_STATE_PVALUE;
                 continue;
             }
 
-            if (tokens[c][0] == ';' && tokens[c][1] == '\0')
+            if (ARES_ISCHAR(t, tlen, ';'))
             {
                 ares_method_add(ar, &cur);
-                memset(&cur, '\0', sizeof(cur));
+                ares_result_init(ar, &cur);
                 prevstate = state;
                 state = ARP_STATE_METHODSPEC;
                 continue;
@@ -623,16 +629,20 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             {
                 ares_ptype x;
 
-                x = arc_name_to_code(ptypes, (char *) tokens[c]);
+                x = arc_namen_to_code(ptypes, t, tlen);
                 if (x == ARES_PTYPE_UNKNOWN)
                 {
-                    ar->ares_count = initial_ares_count;
                     return -1;
                 }
 
                 if (cur.result_props < MAXPROPS)
                 {
-                    cur.result_ptype[cur.result_props] = x;
+                    prop = ares_prop_new(ar);
+                    if (prop == NULL)
+                    {
+                        return -1;
+                    }
+                    prop->prop_ptype = x;
                 }
 
                 prevstate = state;
@@ -642,9 +652,8 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_PROPSPEC_DOT:
-            if (tokens[c][0] != '.' || tokens[c][1] != '\0')
+            if (!ARES_ISCHAR(t, tlen, '.'))
             {
-                ar->ares_count = initial_ares_count;
                 return -1;
             }
 
@@ -656,9 +665,9 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
         case ARP_STATE_PROPERTY:
             if (cur.result_props < MAXPROPS)
             {
-                strlcpy((char *) cur.result_property[cur.result_props],
-                        (char *) tokens[c],
-                        sizeof cur.result_property[cur.result_props]);
+                prop = &ar->ares_prop[ar->ares_nprops];
+                prop->prop_property = t;
+                prop->prop_propertylen = tlen;
             }
 
             prevstate = state;
@@ -667,9 +676,8 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_PROPSPEC_EQUALS:
-            if (tokens[c][0] != '=' || tokens[c][1] != '\0')
+            if (!ARES_ISCHAR(t, tlen, '='))
             {
-                ar->ares_count = initial_ares_count;
                 return -1;
             }
 
@@ -679,11 +687,16 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
             break;
 
         case ARP_STATE_PVALUE:
-            if (cur.result_props < MAXPROPS)
+            laststored = cur.result_props < MAXPROPS;
+            if (laststored)
             {
-                strlcat((char *) cur.result_value[cur.result_props],
-                        (char *) tokens[c],
-                        sizeof cur.result_value[cur.result_props]);
+                prop = &ar->ares_prop[ar->ares_nprops];
+                if (prop->prop_value == NULL)
+                {
+                    prop->prop_value = t;
+                }
+                prop->prop_valuelen = t + tlen - prop->prop_value;
+                ar->ares_nprops++;
                 cur.result_props++;
             }
 
@@ -694,16 +707,19 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
 
         case ARP_STATE_DONE:
             /* unexpected content after a singleton value */
-            ar->ares_count = initial_ares_count;
             return -1;
         }
     }
 
+    if (status == -1)
+    {
+        return -1;
+    }
+
     /* error out on non-terminal states */
     if (state != ARP_STATE_METHODSPEC && state != ARP_STATE_PROP_OR_REASON &&
         state != ARP_STATE_PTYPE && state != ARP_STATE_DONE)
     {
-        ar->ares_count = initial_ares_count;
         return -1;
     }
 
@@ -712,6 +728,68 @@ ares_parse(const char *hdr, struct authres *ar, const char *authserv)
     return 0;
 }
 
+/*
+**  ARES_PARSE -- parse an Authentication-Results: header, return a
+**                structure containing a parsed result
+**
+**  Parameters:
+**  	hdr -- NULL-terminated contents of an Authentication-Results:
+**  	       header field
+**  	ar -- a pointer to a (struct authres) loaded by values after parsing
+**	authserv -- string containing the authserv-id we care about
+**
+**  Return value:
+**  	0 on success, -1 on failure, -2 when a header is uninteresting.
+**
+**  Notes:
+**  	"ar" must be zeroed before its first use, and results from further
+**  	calls are added to it.  Strings in "ar" point into "hdr".  Release
+**  	"ar" with ares_free().
+*/
+
+int
+ares_parse(const char *hdr, struct authres *ar, const char *authserv)
+{
+    int status;
+    int count;
+    int nprops;
+
+    assert(hdr != NULL);
+    assert(ar != NULL);
+
+    count = ar->ares_count;
+    nprops = ar->ares_nprops;
+
+    status = ares_parse_tokens(hdr, ar, authserv);
+    if (status != 0)
+    {
+        ar->ares_count = count;
+        ar->ares_nprops = nprops;
+    }
+
+    return status;
+}
+
+/*
+**  ARES_FREE -- release memory held by a (struct authres)
+**
+**  Parameters:
+**  	ar -- authentication results
+**
+**  Return value:
+**  	None.
+*/
+
+void
+ares_free(struct authres *ar)
+{
+    assert(ar != NULL);
+
+    ARC_FREE(ar->ares_result);
+    ARC_FREE(ar->ares_prop);
+    memset(ar, '\0', sizeof *ar);
+}
+
 /*
 **  ARES_ISTOKEN -- check whether a string is a valid token
 **
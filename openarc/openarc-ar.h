@@ -18,7 +18,6 @@
 /* limits */
 #define MAXARESULTS 16
 #define MAXPROPS    16
-#define MAXAVALUE   256
 
 /* ARES_METHOD -- type for specifying an authentication method */
 typedef enum
@@ -70,30 +69,60 @@ typedef enum
     ARES_PTYPE_SMTP,
 } ares_ptype;
 
+/* ARES_TOKEN -- a token, as a piece of the header field it came from */
+struct ares_token
+{
+    size_t tok_off;
+    size_t tok_len;
+};
+
+/*
+**  PROP structure -- a single property of a result
+**
+**  Property names and values point into the parsed header field, which
+**  must outlive the (struct authres).  Values are as they appeared in the
+**  header field, quotes and all.
+*/
+
+struct prop
+{
+    ares_ptype  prop_ptype;
+    size_t      prop_propertylen;
+    size_t      prop_valuelen;
+    const char *prop_property;
+    const char *prop_value;
+};
+
 /* RESULT structure -- a single result */
 struct result
 {
-    int         result_props;
     ares_method result_method;
     ares_result result_result;
-    ares_ptype  result_ptype[MAXPROPS];
-    char        result_reason[MAXAVALUE + 1];
-    char        result_property[MAXPROPS][MAXAVALUE + 1];
-    char        result_value[MAXPROPS][MAXAVALUE + 1];
+    int         result_props;     /* number of properties */
+    int         result_firstprop; /* index of the first in ares_prop */
+    size_t      result_reasonlen;
+    const char *result_reason;
 };
 
 /* AUTHRES structure -- the entire header parsed */
 struct authres
 {
-    int           ares_count;
-    char          ares_host[ARC_MAXHOSTNAMELEN + 1];
-    char          ares_version[MAXAVALUE + 1];
-    struct result ares_result[MAXARESULTS];
+    int            ares_count;
+    int            ares_maxresults;
+    int            ares_nprops;
+    int            ares_maxprops;
+    size_t         ares_hostlen;
+    size_t         ares_versionlen;
+    const char    *ares_host;
+    const char    *ares_version;
+    struct result *ares_result;
+    struct prop   *ares_prop;
 };
 
-extern int         ares_tokenize(const char *, char *, size_t, char **, int);
-extern int         ares_parse(const char *, struct authres *, const char *);
-extern bool        ares_istoken(const char *);
+extern int  ares_tokenize(const char *, struct ares_token *, int);
+extern int  ares_parse(const char *, struct authres *, const char *);
+extern void ares_free(struct authres *);
+extern bool ares_istoken(const char *);
 
 extern const char *ares_getmethod(ares_method);
 extern const char *ares_getresult(ares_result);
@@ -22,18 +22,25 @@ struct configdef arcf_config[] = {
     {"BaseDirectory",                 CONFIG_TYPE_STRING,  false},
     {"Canonicalization",              CONFIG_TYPE_STRING,  false},
     {"ChangeRootDirectory",           CONFIG_TYPE_STRING,  false},
+    {"CryptoQueueSize",               CONFIG_TYPE_INTEGER, false},
+    {"CryptoThreads",                 CONFIG_TYPE_INTEGER, false},
     {"Domain",                        CONFIG_TYPE_STRING,  false},
+    {"EarlySealVerification",         CONFIG_TYPE_BOOLEAN, false},
     {"EnableCoredumps",               CONFIG_TYPE_BOOLEAN, false},
     {"FinalReceiver",                 CONFIG_TYPE_BOOLEAN, false},
     {"FixedTimestamp",                CONFIG_TYPE_STRING,  false},
     {"Include",                       CONFIG_TYPE_INCLUDE, false},
     {"InternalHosts",                 CONFIG_TYPE_STRING,  false},
     {"KeepTemporaryFiles",            CONFIG_TYPE_BOOLEAN, false},
+    {"KeyCacheSize",                  CONFIG_TYPE_INTEGER, false},
+    {"KeyCacheTTL",                   CONFIG_TYPE_INTEGER, false},
     {"KeyFile",                       CONFIG_TYPE_STRING,  false},
     {"MaximumHeaders",                CONFIG_TYPE_INTEGER, false},
+    {"MaximumVerifyBits",             CONFIG_TYPE_INTEGER, false},
     {"MilterDebug",                   CONFIG_TYPE_INTEGER, false},
     {"MinimumKeySizeRSA",             CONFIG_TYPE_INTEGER, false},
     {"Mode",                          CONFIG_TYPE_STRING,  false},
+    {"Nameservers",                   CONFIG_TYPE_STRING,  false},
     {"OverSignHeaders",               CONFIG_TYPE_STRING,  false},
     {"PeerList",                      CONFIG_TYPE_STRING,  false},
     {"PermitAuthenticationOverrides", CONFIG_TYPE_BOOLEAN, false},
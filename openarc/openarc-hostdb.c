@@ -0,0 +1,256 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#include "build-config.h"
+
+/* system includes */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+/* openarc includes */
+#include "openarc-hostset.h"
+
+/* globals */
+static char *progname;
+
+/*
+**  USAGE -- print a usage message and return the appropriate exit status
+**
+**  Parameters:
+**  	None.
+**
+**  Return value:
+**  	EX_USAGE.
+*/
+
+static int
+usage(void)
+{
+    fprintf(stderr,
+            "%s: usage: %s [options] listfile [host ...]\n"
+            "\t-o outfile \twrite the compiled list to outfile\n"
+            "\t-t         \tcheck each host against listfile\n",
+            progname, progname);
+    return EX_USAGE;
+}
+
+/*
+**  CHECK -- report whether hosts are members of a list
+**
+**  Parameters:
+**  	hs -- host set
+**  	hosts -- host names and addresses to check
+**  	nhosts -- number of entries in "hosts"
+**
+**  Return value:
+**  	EX_OK if all of them matched, 1 otherwise.
+*/
+
+static int
+check(struct hostset *hs, char **hosts, int nhosts)
+{
+    bool                    match;
+    int                     c;
+    int                     status = EX_OK;
+    struct sockaddr_storage ss;
+
+    for (c = 0; c < nhosts; c++)
+    {
+        memset(&ss, '\0', sizeof ss);
+
+        if (inet_pton(AF_INET, hosts[c],
+                      &((struct sockaddr_in *) &ss)->sin_addr) == 1)
+        {
+            ss.ss_family = AF_INET;
+            match = arcf_hostset_checkip(hs, (struct sockaddr *) &ss);
+        }
+#ifdef AF_INET6
+        else if (inet_pton(AF_INET6, hosts[c],
+                           &((struct sockaddr_in6 *) &ss)->sin6_addr) == 1)
+        {
+            ss.ss_family = AF_INET6;
+            match = arcf_hostset_checkip(hs, (struct sockaddr *) &ss);
+        }
+#endif /* AF_INET6 */
+        else
+        {
+            match = arcf_hostset_checkhost(hs, hosts[c]);
+        }
+
+        printf("%s: %s\n", hosts[c], match ? "match" : "no match");
+        if (!match)
+        {
+            status = 1;
+        }
+    }
+
+    return status;
+}
+
+/*
+**  COMPILE -- write a host set to a file
+**
+**  Parameters:
+**  	hs -- host set
+**  	outfile -- file to create or replace
+**
+**  Return value:
+**  	An exit status.
+**
+**  Notes:
+**  	The output is written to a temporary file that is then renamed
+**  	over "outfile", so a running filter that has the old file mapped
+**  	keeps seeing it intact until it reloads.
+*/
+
+static int
+compile(struct hostset *hs, const char *outfile)
+{
+    int   fd;
+    FILE *f;
+    char *err = NULL;
+    char  tmpfile[MAXPATHLEN + 1];
+
+    if (snprintf(tmpfile, sizeof tmpfile, "%s.XXXXXX", outfile) >=
+        (int) sizeof tmpfile)
+    {
+        fprintf(stderr, "%s: %s: %s\n", progname, outfile,
+                strerror(ENAMETOOLONG));
+        return EX_USAGE;
+    }
+
+    fd = mkstemp(tmpfile);
+    if (fd < 0)
+    {
+        fprintf(stderr, "%s: %s: mkstemp(): %s\n", progname, tmpfile,
+                strerror(errno));
+        return EX_CANTCREAT;
+    }
+
+    (void) fchmod(fd, 0644);
+
+    f = fdopen(fd, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: %s: fdopen(): %s\n", progname, tmpfile,
+                strerror(errno));
+        close(fd);
+        unlink(tmpfile);
+        return EX_IOERR;
+    }
+
+    if (!arcf_hostset_write(hs, f, &err) || fflush(f) != 0 ||
+        fsync(fd) != 0)
+    {
+        fprintf(stderr, "%s: %s: %s\n", progname, tmpfile,
+                err != NULL ? err : strerror(errno));
+        fclose(f);
+        unlink(tmpfile);
+        return EX_IOERR;
+    }
+
+    if (fclose(f) != 0 || rename(tmpfile, outfile) != 0)
+    {
+        fprintf(stderr, "%s: %s: %s\n", progname, outfile, strerror(errno));
+        unlink(tmpfile);
+        return EX_IOERR;
+    }
+
+    return EX_OK;
+}
+
+/*
+**  MAIN -- program mainline
+**
+**  Parameters:
+**  	argc, argv -- the usual
+**
+**  Return value:
+**  	Exit status.
+*/
+
+int
+main(int argc, char **argv)
+{
+    bool            test = false;
+    int             c;
+    int             status;
+    char           *p;
+    char           *err = NULL;
+    char           *outfile = NULL;
+    struct hostset *hs;
+    char            path[MAXPATHLEN + 1];
+
+    progname = (p = strrchr(argv[0], '/')) == NULL ? argv[0] : p + 1;
+
+    while ((c = getopt(argc, argv, "o:t")) != -1)
+    {
+        switch (c)
+        {
+        case 'o':
+            outfile = optarg;
+            break;
+
+        case 't':
+            test = true;
+            break;
+
+        default:
+            return usage();
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || (!test && argc != 1) || (test && outfile != NULL))
+    {
+        return usage();
+    }
+
+    hs = arcf_hostset_new();
+    if (hs == NULL)
+    {
+        fprintf(stderr, "%s: arcf_hostset_new(): %s\n", progname,
+                strerror(errno));
+        return EX_OSERR;
+    }
+
+    if (!arcf_hostset_load(hs, argv[0], NULL, &err))
+    {
+        fprintf(stderr, "%s: %s: %s\n", progname, argv[0], err);
+        arcf_hostset_free(hs);
+        return EX_DATAERR;
+    }
+
+    if (test)
+    {
+        status = check(hs, argv + 1, argc - 1);
+    }
+    else
+    {
+        if (outfile == NULL)
+        {
+            snprintf(path, sizeof path, "%s.db", argv[0]);
+            outfile = path;
+        }
+
+        status = compile(hs, outfile);
+    }
+
+    arcf_hostset_free(hs);
+
+    return status;
+}
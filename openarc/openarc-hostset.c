@@ -0,0 +1,1165 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#include "build-config.h"
+
+/* system includes */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* openarc includes */
+#include "openarc-hostset.h"
+#include "openarc.h"
+
+/* match flags */
+#define HL_ALLOW 0x01 /* plain entry */
+#define HL_DENY  0x02 /* negated ("!") entry */
+
+/* compiled file identification */
+#define HOSTSET_MAGIC "OARCHST1"
+#define HOSTSET_ORDER 0x01020304
+
+/* trie roots */
+#define HOSTSET_INET  0
+#define HOSTSET_INET6 1
+
+/*
+**  In memory and on disk, a host set is a handful of flat arrays linked by
+**  index, so a compiled file can be used directly from a read-only
+**  mapping.  Slot 0 of the name and node arrays is never used and serves
+**  as the null link.
+*/
+
+/* struct hostset_name -- a host or domain name in the hash table */
+struct hostset_name
+{
+    uint32_t hn_hash;
+    uint32_t hn_flags;
+    uint32_t hn_next; /* next name in the same bucket */
+    uint32_t hn_name; /* offset in the string table */
+};
+
+/* struct hostset_node -- a node in an address prefix trie */
+struct hostset_node
+{
+    uint32_t      an_bits;  /* prefix length */
+    uint32_t      an_flags; /* HL_* flags; 0 for a branch point */
+    uint32_t      an_child[2];
+    unsigned char an_addr[16];
+};
+
+/* struct hostset_filehdr -- header of a compiled host set file */
+struct hostset_filehdr
+{
+    char     hf_magic[8];
+    uint32_t hf_order;
+    uint32_t hf_nbuckets;
+    uint32_t hf_nnames;
+    uint32_t hf_nnodes;
+    uint32_t hf_root[2];
+    uint64_t hf_strlen;
+};
+
+/* struct hostset_map -- a compiled file mapped into memory */
+struct hostset_map
+{
+    unsigned int hm_refcnt;
+    size_t       hm_len;
+    void        *hm_base;
+    dev_t        hm_dev;
+    ino_t        hm_ino;
+    time_t       hm_mtime;
+};
+
+/* struct hostset -- a compiled PeerList or InternalHosts list */
+struct hostset
+{
+    uint32_t             hs_nbuckets;
+    uint32_t             hs_nnames;
+    uint32_t             hs_maxnames;
+    uint32_t             hs_nnodes;
+    uint32_t             hs_maxnodes;
+    uint32_t             hs_root[2];
+    size_t               hs_strlen;
+    size_t               hs_maxstr;
+    uint32_t            *hs_buckets;
+    struct hostset_name *hs_names;
+    struct hostset_node *hs_nodes;
+    char                *hs_strings;
+    struct hostset_map  *hs_map; /* set when backed by a compiled file */
+};
+
+/* protects mapping reference counts */
+static pthread_mutex_t hostset_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+**  ARCF_HOSTSET_HASH -- hash a host name
+**
+**  Parameters:
+**  	name -- name to hash
+**
+**  Return value:
+**  	32-bit FNV-1a hash of the name.
+**
+**  Notes:
+**  	Names are compared exactly, so they are not case-folded here.
+*/
+
+static uint32_t
+arcf_hostset_hash(const char *name)
+{
+    uint32_t h = 2166136261U;
+
+    for (; *name != '\0'; name++)
+    {
+        h ^= (unsigned char) *name;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/*
+**  ARCF_HOSTSET_FIND -- find a name in the hash table
+**
+**  Parameters:
+**  	hs -- host set
+**  	name -- name to find
+**
+**  Return value:
+**  	Index of the matching entry, or 0.
+**
+**  Notes:
+**  	Links are checked against the array bounds and a chain is cut off
+**  	after as many steps as there are names, so a damaged compiled file
+**  	cannot send a lookup astray.
+*/
+
+static uint32_t
+arcf_hostset_find(struct hostset *hs, const char *name)
+{
+    uint32_t             hash;
+    uint32_t             idx;
+    uint32_t             steps;
+    struct hostset_name *hn;
+
+    if (hs->hs_nbuckets == 0)
+    {
+        return 0;
+    }
+
+    hash = arcf_hostset_hash(name);
+    for (idx = hs->hs_buckets[hash % hs->hs_nbuckets], steps = 0;
+         idx != 0 && idx < hs->hs_nnames && steps < hs->hs_nnames;
+         idx = hn->hn_next, steps++)
+    {
+        hn = &hs->hs_names[idx];
+        if (hn->hn_hash == hash && hn->hn_name < hs->hs_strlen &&
+            strcmp(&hs->hs_strings[hn->hn_name], name) == 0)
+        {
+            return idx;
+        }
+    }
+
+    return 0;
+}
+
+/*
+**  ARCF_HOSTSET_REHASH -- grow the hash table
+**
+**  Parameters:
+**  	hs -- host set
+**
+**  Return value:
+**  	true on success, false on allocation failure.
+*/
+
+static bool
+arcf_hostset_rehash(struct hostset *hs)
+{
+    uint32_t             c;
+    uint32_t             nbuckets;
+    uint32_t            *buckets;
+    struct hostset_name *hn;
+
+    nbuckets = hs->hs_nbuckets == 0 ? 64 : hs->hs_nbuckets * 2;
+    buckets = ARC_CALLOC(nbuckets, sizeof *buckets);
+    if (buckets == NULL)
+    {
+        return false;
+    }
+
+    for (c = 1; c < hs->hs_nnames; c++)
+    {
+        hn = &hs->hs_names[c];
+        hn->hn_next = buckets[hn->hn_hash % nbuckets];
+        buckets[hn->hn_hash % nbuckets] = c;
+    }
+
+    ARC_FREE(hs->hs_buckets);
+    hs->hs_buckets = buckets;
+    hs->hs_nbuckets = nbuckets;
+
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_ADDNAME -- add a name to the hash table
+**
+**  Parameters:
+**  	hs -- host set
+**  	name -- name to add
+**  	flags -- HL_* flags for it
+**
+**  Return value:
+**  	true on success, false on allocation failure.
+*/
+
+static bool
+arcf_hostset_addname(struct hostset *hs, const char *name, unsigned int flags)
+{
+    uint32_t             idx;
+    size_t               len;
+    struct hostset_name *hn;
+
+    idx = arcf_hostset_find(hs, name);
+    if (idx != 0)
+    {
+        hs->hs_names[idx].hn_flags |= flags;
+        return true;
+    }
+
+    /* keep the chains short */
+    if (hs->hs_nnames >= hs->hs_nbuckets && !arcf_hostset_rehash(hs))
+    {
+        return false;
+    }
+
+    if (hs->hs_nnames == hs->hs_maxnames)
+    {
+        uint32_t             max;
+        struct hostset_name *names;
+
+        max = hs->hs_maxnames * 2;
+        names = ARC_REALLOC(hs->hs_names, max * sizeof *names);
+        if (names == NULL)
+        {
+            return false;
+        }
+
+        hs->hs_names = names;
+        hs->hs_maxnames = max;
+    }
+
+    len = strlen(name) + 1;
+    if (hs->hs_strlen + len > hs->hs_maxstr)
+    {
+        size_t max;
+        char  *strings;
+
+        max = MAX(hs->hs_maxstr * 2, hs->hs_strlen + len);
+        strings = ARC_REALLOC(hs->hs_strings, max);
+        if (strings == NULL)
+        {
+            return false;
+        }
+
+        hs->hs_strings = strings;
+        hs->hs_maxstr = max;
+    }
+
+    idx = hs->hs_nnames++;
+    hn = &hs->hs_names[idx];
+    hn->hn_hash = arcf_hostset_hash(name);
+    hn->hn_flags = flags;
+    hn->hn_name = hs->hs_strlen;
+    hn->hn_next = hs->hs_buckets[hn->hn_hash % hs->hs_nbuckets];
+    hs->hs_buckets[hn->hn_hash % hs->hs_nbuckets] = idx;
+
+    memcpy(&hs->hs_strings[hs->hs_strlen], name, len);
+    hs->hs_strlen += len;
+
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_BIT -- return one bit of an address
+**
+**  Parameters:
+**  	addr -- address, in network byte order
+**  	bit -- bit to return, counting from the most significant
+**
+**  Return value:
+**  	0 or 1.
+*/
+
+static int
+arcf_hostset_bit(const unsigned char *addr, unsigned int bit)
+{
+    return (addr[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/*
+**  ARCF_HOSTSET_COMMON -- count the leading bits two addresses share
+**
+**  Parameters:
+**  	a, b -- addresses to compare
+**  	max -- stop after this many bits
+**
+**  Return value:
+**  	Number of leading bits that match, at most "max".
+*/
+
+static unsigned int
+arcf_hostset_common(const unsigned char *a,
+                    const unsigned char *b,
+                    unsigned int         max)
+{
+    unsigned int bits = 0;
+
+    while (bits + 8 <= max && a[bits / 8] == b[bits / 8])
+    {
+        bits += 8;
+    }
+
+    while (bits < max &&
+           arcf_hostset_bit(a, bits) == arcf_hostset_bit(b, bits))
+    {
+        bits++;
+    }
+
+    return bits;
+}
+
+/*
+**  ARCF_HOSTSET_NEWNODE -- take a trie node from the node array
+**
+**  Parameters:
+**  	hs -- host set, with room for another node
+**  	addr -- address; only the first "bits" bits are kept
+**  	bits -- prefix length
+**  	flags -- HL_* flags
+**
+**  Return value:
+**  	Index of the new node.
+*/
+
+static uint32_t
+arcf_hostset_newnode(struct hostset      *hs,
+                     const unsigned char *addr,
+                     unsigned int         bits,
+                     unsigned int         flags)
+{
+    uint32_t             idx;
+    struct hostset_node *an;
+
+    assert(hs->hs_nnodes < hs->hs_maxnodes);
+
+    idx = hs->hs_nnodes++;
+    an = &hs->hs_nodes[idx];
+    memset(an, '\0', sizeof *an);
+
+    an->an_bits = bits;
+    an->an_flags = flags;
+    memcpy(an->an_addr, addr, (bits + 7) / 8);
+    if (bits % 8 != 0)
+    {
+        an->an_addr[bits / 8] &= 0xff << (8 - bits % 8);
+    }
+
+    return idx;
+}
+
+/*
+**  ARCF_HOSTSET_INSERT -- add a prefix to a trie
+**
+**  Parameters:
+**  	hs -- host set
+**  	root -- which trie (HOSTSET_INET or HOSTSET_INET6)
+**  	addr -- network address, host bits clear
+**  	bits -- prefix length
+**  	flags -- HL_* flags for the prefix
+**
+**  Return value:
+**  	true on success, false on allocation failure.
+**
+**  Notes:
+**  	The trie is path-compressed: every node either carries flags or
+**  	has two children, so it never holds more than two nodes per entry
+**  	and a lookup never visits more than one node per address bit.
+*/
+
+static bool
+arcf_hostset_insert(struct hostset      *hs,
+                    int                  root,
+                    const unsigned char *addr,
+                    unsigned int         bits,
+                    unsigned int         flags)
+{
+    uint32_t             idx;
+    uint32_t             leaf;
+    uint32_t             branch;
+    uint32_t            *link;
+    unsigned int         common;
+    struct hostset_node *an;
+
+    /* at most two nodes are added; make room before taking pointers */
+    if (hs->hs_nnodes + 2 > hs->hs_maxnodes)
+    {
+        uint32_t             max;
+        struct hostset_node *nodes;
+
+        max = hs->hs_maxnodes * 2;
+        nodes = ARC_REALLOC(hs->hs_nodes, max * sizeof *nodes);
+        if (nodes == NULL)
+        {
+            return false;
+        }
+
+        hs->hs_nodes = nodes;
+        hs->hs_maxnodes = max;
+    }
+
+    for (link = &hs->hs_root[root]; (idx = *link) != 0;
+         link = &an->an_child[arcf_hostset_bit(addr, an->an_bits)])
+    {
+        an = &hs->hs_nodes[idx];
+        common = arcf_hostset_common(an->an_addr, addr,
+                                     MIN(an->an_bits, bits));
+
+        if (common == an->an_bits && an->an_bits == bits)
+        {
+            an->an_flags |= flags;
+            return true;
+        }
+
+        if (common == an->an_bits)
+        {
+            continue;
+        }
+
+        /* the new prefix diverges from, or contains, this node */
+        leaf = arcf_hostset_newnode(hs, addr, bits, flags);
+        if (common == bits)
+        {
+            hs->hs_nodes[leaf].an_child[arcf_hostset_bit(an->an_addr, bits)] =
+                idx;
+            *link = leaf;
+            return true;
+        }
+
+        branch = arcf_hostset_newnode(hs, addr, common, 0);
+        hs->hs_nodes[branch].an_child[arcf_hostset_bit(an->an_addr, common)] =
+            idx;
+        hs->hs_nodes[branch].an_child[arcf_hostset_bit(addr, common)] = leaf;
+        *link = branch;
+        return true;
+    }
+
+    *link = arcf_hostset_newnode(hs, addr, bits, flags);
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_LOOKUP -- find the longest listed prefix of an address
+**
+**  Parameters:
+**  	hs -- host set
+**  	root -- which trie (HOSTSET_INET or HOSTSET_INET6)
+**  	addr -- address to find
+**  	maxbits -- length of the address in bits
+**
+**  Return value:
+**  	HL_* flags of the longest matching prefix, or 0 if none matched.
+*/
+
+static unsigned int
+arcf_hostset_lookup(struct hostset      *hs,
+                    int                  root,
+                    const unsigned char *addr,
+                    unsigned int         maxbits)
+{
+    uint32_t             idx;
+    uint32_t             steps;
+    unsigned int         flags = 0;
+    struct hostset_node *an;
+
+    for (idx = hs->hs_root[root], steps = 0;
+         idx != 0 && idx < hs->hs_nnodes && steps <= maxbits;
+         idx = an->an_child[arcf_hostset_bit(addr, an->an_bits)], steps++)
+    {
+        an = &hs->hs_nodes[idx];
+
+        if (an->an_bits > maxbits ||
+            arcf_hostset_common(an->an_addr, addr, an->an_bits) < an->an_bits)
+        {
+            break;
+        }
+
+        if (an->an_flags != 0)
+        {
+            flags = an->an_flags;
+        }
+
+        if (an->an_bits == maxbits)
+        {
+            break;
+        }
+    }
+
+    return flags;
+}
+
+/*
+**  ARCF_HOSTSET_PARSEADDR -- parse an address or network list entry
+**
+**  Parameters:
+**  	entry -- entry, without any leading "!"
+**  	family -- address family (returned)
+**  	addr -- network address (returned)
+**  	bits -- prefix length (returned)
+**
+**  Return value:
+**  	true iff "entry" is an address, optionally in square brackets,
+**  	optionally followed by "/" and a prefix length.
+**
+**  Notes:
+**  	Networks with bits set beyond the prefix length are not accepted;
+**  	such entries could never match an address.
+*/
+
+static bool
+arcf_hostset_parseaddr(const char    *entry,
+                       int           *family,
+                       unsigned char *addr,
+                       unsigned int  *bits)
+{
+    unsigned int  maxbits;
+    unsigned long len;
+    const char   *end;
+    const char   *pfx;
+    char         *q;
+    char          buf[INET6_ADDRSTRLEN + 1];
+
+    if (entry[0] == '[')
+    {
+        entry++;
+        end = strchr(entry, ']');
+        if (end == NULL)
+        {
+            return false;
+        }
+        pfx = end + 1;
+    }
+    else
+    {
+        end = strchr(entry, '/');
+        if (end == NULL)
+        {
+            end = entry + strlen(entry);
+        }
+        pfx = end;
+    }
+
+    if (end == entry || (size_t) (end - entry) >= sizeof buf)
+    {
+        return false;
+    }
+
+    memcpy(buf, entry, end - entry);
+    buf[end - entry] = '\0';
+
+    memset(addr, '\0', 16);
+    if (inet_pton(AF_INET, buf, addr) == 1)
+    {
+        *family = AF_INET;
+        maxbits = 32;
+    }
+#ifdef AF_INET6
+    else if (inet_pton(AF_INET6, buf, addr) == 1)
+    {
+        *family = AF_INET6;
+        maxbits = 128;
+    }
+#endif /* AF_INET6 */
+    else
+    {
+        return false;
+    }
+
+    if (*pfx == '\0')
+    {
+        *bits = maxbits;
+        return true;
+    }
+
+    if (pfx[0] != '/' || pfx[1] < '0' || pfx[1] > '9')
+    {
+        return false;
+    }
+
+    errno = 0;
+    len = strtoul(pfx + 1, &q, 10);
+    if (errno != 0 || *q != '\0' || len > maxbits)
+    {
+        return false;
+    }
+
+    for (*bits = len; len < maxbits; len++)
+    {
+        if (arcf_hostset_bit(addr, len) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_UNMAP -- drop a reference to a compiled file mapping
+**
+**  Parameters:
+**  	hm -- mapping
+**
+**  Return value:
+**  	None.
+*/
+
+static void
+arcf_hostset_unmap(struct hostset_map *hm)
+{
+    unsigned int refcnt;
+
+    pthread_mutex_lock(&hostset_lock);
+    refcnt = --hm->hm_refcnt;
+    pthread_mutex_unlock(&hostset_lock);
+
+    if (refcnt == 0)
+    {
+        (void) munmap(hm->hm_base, hm->hm_len);
+        ARC_FREE(hm);
+    }
+}
+
+/*
+**  ARCF_HOSTSET_ATTACH -- back a host set with a compiled file mapping
+**
+**  Parameters:
+**  	hs -- host set, which must not have had anything added
+**  	hm -- mapping
+**
+**  Return value:
+**  	true iff the mapping holds a usable host set.  On success "hs"
+**  	takes over the caller's reference to "hm".
+**
+**  Notes:
+**  	Only the header and the overall size are checked here, so that
+**  	attaching takes the same time however large the file is; lookups
+**  	check every link they follow.
+*/
+
+static bool
+arcf_hostset_attach(struct hostset *hs, struct hostset_map *hm)
+{
+    size_t                  len;
+    unsigned char          *p;
+    struct hostset_filehdr *hf;
+
+    if (hm->hm_len < sizeof *hf)
+    {
+        return false;
+    }
+
+    p = hm->hm_base;
+    hf = (struct hostset_filehdr *) p;
+
+    if (memcmp(hf->hf_magic, HOSTSET_MAGIC, sizeof hf->hf_magic) != 0 ||
+        hf->hf_order != HOSTSET_ORDER || hf->hf_nnames == 0 ||
+        hf->hf_nnodes == 0 || hf->hf_strlen == 0 ||
+        hf->hf_strlen > hm->hm_len)
+    {
+        return false;
+    }
+
+    len = sizeof *hf + (size_t) hf->hf_nbuckets * sizeof(uint32_t) +
+          (size_t) hf->hf_nnames * sizeof(struct hostset_name) +
+          (size_t) hf->hf_nnodes * sizeof(struct hostset_node) +
+          hf->hf_strlen;
+    if (len != hm->hm_len || p[len - 1] != '\0')
+    {
+        return false;
+    }
+
+    ARC_FREE(hs->hs_buckets);
+    ARC_FREE(hs->hs_names);
+    ARC_FREE(hs->hs_nodes);
+    ARC_FREE(hs->hs_strings);
+
+    hs->hs_map = hm;
+    hs->hs_nbuckets = hf->hf_nbuckets;
+    hs->hs_nnames = hf->hf_nnames;
+    hs->hs_maxnames = hf->hf_nnames;
+    hs->hs_nnodes = hf->hf_nnodes;
+    hs->hs_maxnodes = hf->hf_nnodes;
+    hs->hs_root[HOSTSET_INET] = hf->hf_root[HOSTSET_INET];
+    hs->hs_root[HOSTSET_INET6] = hf->hf_root[HOSTSET_INET6];
+    hs->hs_strlen = hf->hf_strlen;
+    hs->hs_maxstr = hf->hf_strlen;
+
+    p += sizeof *hf;
+    hs->hs_buckets = (uint32_t *) p;
+    p += (size_t) hf->hf_nbuckets * sizeof(uint32_t);
+    hs->hs_names = (struct hostset_name *) p;
+    p += (size_t) hf->hf_nnames * sizeof(struct hostset_name);
+    hs->hs_nodes = (struct hostset_node *) p;
+    p += (size_t) hf->hf_nnodes * sizeof(struct hostset_node);
+    hs->hs_strings = (char *) p;
+
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_NEW -- create an empty host set
+**
+**  Parameters:
+**  	None.
+**
+**  Return value:
+**  	A new host set, or NULL on allocation failure.
+*/
+
+struct hostset *
+arcf_hostset_new(void)
+{
+    struct hostset *hs;
+
+    hs = ARC_CALLOC(1, sizeof(struct hostset));
+    if (hs == NULL)
+    {
+        return NULL;
+    }
+
+    hs->hs_maxnames = 16;
+    hs->hs_maxnodes = 16;
+    hs->hs_maxstr = 256;
+    hs->hs_names = ARC_CALLOC(hs->hs_maxnames, sizeof *hs->hs_names);
+    hs->hs_nodes = ARC_CALLOC(hs->hs_maxnodes, sizeof *hs->hs_nodes);
+    hs->hs_strings = ARC_CALLOC(1, hs->hs_maxstr);
+    if (hs->hs_names == NULL || hs->hs_nodes == NULL ||
+        hs->hs_strings == NULL)
+    {
+        arcf_hostset_free(hs);
+        return NULL;
+    }
+
+    /* slot 0 is the null link; offset 0 is an empty string */
+    hs->hs_nnames = 1;
+    hs->hs_nnodes = 1;
+    hs->hs_strlen = 1;
+
+    return hs;
+}
+
+/*
+**  ARCF_HOSTSET_FREE -- destroy a host set
+**
+**  Parameters:
+**  	hs -- host set to destroy
+**
+**  Return value:
+**  	None.
+*/
+
+void
+arcf_hostset_free(struct hostset *hs)
+{
+    if (hs == NULL)
+    {
+        return;
+    }
+
+    if (hs->hs_map != NULL)
+    {
+        arcf_hostset_unmap(hs->hs_map);
+    }
+    else
+    {
+        ARC_FREE(hs->hs_buckets);
+        ARC_FREE(hs->hs_names);
+        ARC_FREE(hs->hs_nodes);
+        ARC_FREE(hs->hs_strings);
+    }
+
+    ARC_FREE(hs);
+}
+
+/*
+**  ARCF_HOSTSET_ADD -- add an entry to a host set
+**
+**  Parameters:
+**  	hs -- host set to update
+**  	entry -- entry to add
+**  	err -- error string (returned)
+**
+**  Return value:
+**  	true iff the operation succeeded.
+**
+**  Notes:
+**  	An entry is a host name, a domain suffix starting with ".", an
+**  	address, or a network in CIDR notation, optionally preceded by "!"
+**  	to exclude it.  Addresses may be enclosed in square brackets.
+**  	Every entry is kept as a name; those that are also addresses or
+**  	networks are added to the trie for their address family.
+**
+**  	A host set loaded from a compiled file cannot be changed.
+*/
+
+bool
+arcf_hostset_add(struct hostset *hs, const char *entry, char **err)
+{
+    bool          ok = true;
+    int           family;
+    unsigned int  bits;
+    unsigned int  flags = HL_ALLOW;
+    unsigned char addr[16];
+
+    assert(hs != NULL);
+    assert(entry != NULL);
+
+    if (hs->hs_map != NULL)
+    {
+        *err = strerror(EROFS);
+        return false;
+    }
+
+    if (entry[0] == '!')
+    {
+        flags = HL_DENY;
+        entry++;
+    }
+
+    if (entry[0] == '\0')
+    {
+        return true;
+    }
+
+    if (arcf_hostset_parseaddr(entry, &family, addr, &bits))
+    {
+        ok = arcf_hostset_insert(hs,
+                                 family == AF_INET ? HOSTSET_INET
+                                                   : HOSTSET_INET6,
+                                 addr, bits, flags);
+    }
+
+    if (ok)
+    {
+        ok = arcf_hostset_addname(hs, entry, flags);
+    }
+
+    if (!ok)
+    {
+        *err = strerror(errno);
+    }
+
+    return ok;
+}
+
+/*
+**  ARCF_HOSTSET_LOAD -- load a host set from a file
+**
+**  Parameters:
+**  	hs -- host set to update, which must not have had anything added
+**  	path -- file to read
+**  	prev -- host set this one replaces, or NULL
+**  	err -- error string (returned)
+**
+**  Return value:
+**  	true iff the operation succeeded.
+**
+**  Notes:
+**  	A file written by arcf_hostset_write() is mapped read-only rather
+**  	than read.  If "prev" is backed by the same compiled file and the
+**  	file has not changed since, that mapping is shared instead.
+**  	Anything else is read as text, one entry per line.
+*/
+
+bool
+arcf_hostset_load(struct hostset *hs,
+                  const char     *path,
+                  struct hostset *prev,
+                  char          **err)
+{
+    int                 fd;
+    FILE               *f;
+    char               *p;
+    void               *base;
+    struct hostset_map *hm;
+    struct stat         st;
+    char                buf[BUFRSZ + 1];
+
+    assert(hs != NULL);
+    assert(path != NULL);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        *err = strerror(errno);
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        *err = strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    /* share the current mapping if the file hasn't changed */
+    hm = (prev == NULL || prev == hs) ? NULL : prev->hs_map;
+    if (hm != NULL && hm->hm_dev == st.st_dev && hm->hm_ino == st.st_ino &&
+        hm->hm_len == (size_t) st.st_size && hm->hm_mtime == st.st_mtime)
+    {
+        close(fd);
+
+        pthread_mutex_lock(&hostset_lock);
+        hm->hm_refcnt++;
+        pthread_mutex_unlock(&hostset_lock);
+
+        if (!arcf_hostset_attach(hs, hm))
+        {
+            arcf_hostset_unmap(hm);
+            *err = "invalid compiled host list";
+            return false;
+        }
+
+        return true;
+    }
+
+    memset(buf, '\0', sizeof buf);
+    if (st.st_size >= (off_t) sizeof(struct hostset_filehdr) &&
+        read(fd, buf, sizeof HOSTSET_MAGIC - 1) ==
+            (ssize_t) sizeof HOSTSET_MAGIC - 1 &&
+        memcmp(buf, HOSTSET_MAGIC, sizeof HOSTSET_MAGIC - 1) == 0)
+    {
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+        {
+            *err = strerror(errno);
+            return false;
+        }
+
+        hm = ARC_CALLOC(1, sizeof *hm);
+        if (hm == NULL)
+        {
+            *err = strerror(errno);
+            (void) munmap(base, st.st_size);
+            return false;
+        }
+
+        hm->hm_refcnt = 1;
+        hm->hm_len = st.st_size;
+        hm->hm_base = base;
+        hm->hm_dev = st.st_dev;
+        hm->hm_ino = st.st_ino;
+        hm->hm_mtime = st.st_mtime;
+
+        if (!arcf_hostset_attach(hs, hm))
+        {
+            arcf_hostset_unmap(hm);
+            *err = "invalid compiled host list";
+            return false;
+        }
+
+        return true;
+    }
+
+    if (lseek(fd, 0, SEEK_SET) != 0 || (f = fdopen(fd, "r")) == NULL)
+    {
+        *err = strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    memset(buf, '\0', sizeof buf);
+    while (fgets(buf, sizeof buf - 1, f) != NULL)
+    {
+        p = strchr(buf, '\n');
+        if (p != NULL)
+        {
+            *p = '\0';
+        }
+
+        if (!arcf_hostset_add(hs, buf, err))
+        {
+            fclose(f);
+            return false;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_WRITE -- write a host set out in compiled form
+**
+**  Parameters:
+**  	hs -- host set to write
+**  	f -- output stream
+**  	err -- error string (returned)
+**
+**  Return value:
+**  	true iff the operation succeeded.
+**
+**  Notes:
+**  	The compiled form uses the byte order and structure layout of the
+**  	host that wrote it; arcf_hostset_load() treats a file from an
+**  	incompatible host as invalid.
+*/
+
+bool
+arcf_hostset_write(struct hostset *hs, FILE *f, char **err)
+{
+    struct hostset_filehdr hf;
+
+    assert(hs != NULL);
+    assert(f != NULL);
+
+    memset(&hf, '\0', sizeof hf);
+    memcpy(hf.hf_magic, HOSTSET_MAGIC, sizeof hf.hf_magic);
+    hf.hf_order = HOSTSET_ORDER;
+    hf.hf_nbuckets = hs->hs_nbuckets;
+    hf.hf_nnames = hs->hs_nnames;
+    hf.hf_nnodes = hs->hs_nnodes;
+    hf.hf_root[HOSTSET_INET] = hs->hs_root[HOSTSET_INET];
+    hf.hf_root[HOSTSET_INET6] = hs->hs_root[HOSTSET_INET6];
+    hf.hf_strlen = hs->hs_strlen;
+
+    if (fwrite(&hf, sizeof hf, 1, f) != 1 ||
+        (hs->hs_nbuckets > 0 &&
+         fwrite(hs->hs_buckets, sizeof *hs->hs_buckets, hs->hs_nbuckets, f) !=
+             hs->hs_nbuckets) ||
+        fwrite(hs->hs_names, sizeof *hs->hs_names, hs->hs_nnames, f) !=
+            hs->hs_nnames ||
+        fwrite(hs->hs_nodes, sizeof *hs->hs_nodes, hs->hs_nnodes, f) !=
+            hs->hs_nnodes ||
+        fwrite(hs->hs_strings, 1, hs->hs_strlen, f) != hs->hs_strlen)
+    {
+        *err = strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+**  ARCF_HOSTSET_CHECKHOST -- check a host set for a host and its domains
+**
+**  Parameters:
+**  	hs -- host set to check
+**  	host -- host name to find
+**
+**  Return value:
+**  	true if there's a match, false otherwise.
+**
+**  Notes:
+**  	The host name itself is tried first, then each of its parent
+**  	domains with a leading ".".  The first name listed decides; a
+**  	negated entry for it wins over a plain one.
+*/
+
+bool
+arcf_hostset_checkhost(struct hostset *hs, const char *host)
+{
+    uint32_t    idx;
+    const char *p;
+
+    assert(host != NULL);
+
+    /* short circuits */
+    if (hs == NULL || host[0] == '\0')
+    {
+        return false;
+    }
+
+    for (p = host; p != NULL; p = strchr(p + 1, '.'))
+    {
+        idx = arcf_hostset_find(hs, p);
+        if (idx != 0)
+        {
+            return (hs->hs_names[idx].hn_flags & HL_DENY) == 0;
+        }
+    }
+
+    return false;
+}
+
+/*
+**  ARCF_HOSTSET_CHECKIP -- check a host set for an IP address or any
+**                          network containing it
+**
+**  Parameters:
+**  	hs -- host set to check
+**  	ip -- IP address to find
+**
+**  Return value:
+**  	true if there's a match, false otherwise.
+**
+**  Notes:
+**  	The longest listed prefix decides; a negated entry for it wins
+**  	over a plain one.
+*/
+
+bool
+arcf_hostset_checkip(struct hostset *hs, struct sockaddr *ip)
+{
+    unsigned int flags = 0;
+
+    assert(ip != NULL);
+
+    /* short circuit */
+    if (hs == NULL)
+    {
+        return false;
+    }
+
+    if (ip->sa_family == AF_INET)
+    {
+        struct sockaddr_in sin;
+
+        memcpy(&sin, ip, sizeof sin);
+        flags = arcf_hostset_lookup(hs, HOSTSET_INET,
+                                    (unsigned char *) &sin.sin_addr, 32);
+    }
+#ifdef AF_INET6
+    else if (ip->sa_family == AF_INET6)
+    {
+        struct sockaddr_in6 sin6;
+
+        memcpy(&sin6, ip, sizeof sin6);
+        flags = arcf_hostset_lookup(hs, HOSTSET_INET6, sin6.sin6_addr.s6_addr,
+                                    128);
+    }
+#endif /* AF_INET6 */
+
+    return flags == HL_ALLOW;
+}
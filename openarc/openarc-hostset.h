@@ -0,0 +1,30 @@
+/*
+ * Copyright 2025 OpenARC contributors.
+ * See LICENSE.
+ */
+
+#ifndef _OPENARC_HOSTSET_H_
+#define _OPENARC_HOSTSET_H_
+
+/* system includes */
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/* opaque compiled PeerList or InternalHosts list */
+struct hostset;
+
+/* prototypes */
+extern struct hostset *arcf_hostset_new(void);
+extern void            arcf_hostset_free(struct hostset *);
+extern bool arcf_hostset_add(struct hostset *, const char *, char **);
+extern bool arcf_hostset_load(struct hostset *,
+                              const char *,
+                              struct hostset *,
+                              char **);
+extern bool arcf_hostset_write(struct hostset *, FILE *, char **);
+extern bool arcf_hostset_checkhost(struct hostset *, const char *);
+extern bool arcf_hostset_checkip(struct hostset *, struct sockaddr *);
+
+#endif /* _OPENARC_HOSTSET_H_ */
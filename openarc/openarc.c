@@ -37,6 +37,7 @@
 #include <pthread.h>
 #include <pwd.h>
 #include <regex.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -79,6 +80,7 @@
 #include "openarc-ar.h"
 #include "openarc-config.h"
 #include "openarc-crypto.h"
+#include "openarc-hostset.h"
 #include "openarc-test.h"
 #include "openarc.h"
 #include "util.h"
@@ -97,6 +99,16 @@ struct configvalue
 };
 LIST_HEAD(conflist, configvalue);
 
+/*
+**  SEALCHK -- a compiled SealHeaderChecks rule
+*/
+
+struct sealchk
+{
+    char   *sc_hdr; /* header field name */
+    regex_t sc_re;  /* pattern to match against its values */
+};
+
 /*
 **  CONFIG -- configuration data
 */
@@ -114,6 +126,7 @@ struct arcf_config
     bool            conf_finalreceiver;     /* act as final receiver */
     bool            conf_overridecv;        /* allow A-R to override CV */
     bool            conf_authresip;         /* include remote IP in A-R */
+    bool            conf_earlyseal;         /* verify seals at EOH */
     unsigned int    conf_refcnt;            /* reference count */
     unsigned int    conf_mode;              /* mode flags */
     arc_canon_t     conf_canonhdr;          /* canonicalization for header */
@@ -123,6 +136,7 @@ struct arcf_config
     char           *conf_selector;          /* signing selector */
     char           *conf_keyfile;           /* key file */
     char           *conf_testkeys;          /* keys for non-DNS lookup */
+    char           *conf_nslist;            /* nameservers to query */
     char           *conf_tmpdir;            /* temp file directory */
     char           *conf_authservid;        /* ID for A-R fields */
     char           *conf_peerfile;          /* peer hosts table */
@@ -131,19 +145,24 @@ struct arcf_config
     const char    **conf_signhdrs;          /* headers to sign (array) */
     char           *conf_oversignhdrs_raw;  /* fields to over-sign (raw) */
     const char    **conf_oversignhdrs;      /* fields to over-sign (array) */
-    unsigned char  *conf_keydata;           /* binary key data */
-    size_t          conf_keylen;            /* key length */
+    ARC_SIGNKEY    *conf_signkey;           /* decoded signing key */
     int             conf_maxhdrsz;          /* max. header size */
     int             conf_minkeysz;          /* min. key size */
+    int             conf_maxverifybits;     /* verify work limit */
+    int             conf_keycachesz;        /* key cache entries */
+    int             conf_keycachettl;       /* key cache max. TTL */
+    int             conf_cryptothreads;     /* crypto worker threads */
+    int             conf_cryptoqueue;       /* crypto queue limit */
     int             conf_sigttl;            /* signature TTL */
     int             conf_ret_disabled;      /* configured not to process */
     int             conf_ret_unable;        /* internal error */
     int             conf_ret_unwilling;     /* badly formed message */
     struct config  *conf_data;              /* configuration data */
     ARC_LIB        *conf_libopenarc;        /* shared library instance */
-    struct conflist conf_peers;             /* peers hosts */
-    struct conflist conf_internal;          /* internal hosts */
-    struct conflist conf_sealheaderchecks;  /* header checks for sealing */
+    struct hostset *conf_peers;             /* peers hosts */
+    struct hostset *conf_internal;          /* internal hosts */
+    unsigned int    conf_nsealchecks;       /* count of seal checks */
+    struct sealchk *conf_sealchecks;        /* header checks for sealing */
 };
 
 /*
@@ -159,6 +178,8 @@ struct msgctx
     struct Header      *mctx_hqhead;   /* header queue head */
     struct Header      *mctx_hqtail;   /* header queue tail */
     ARC_MESSAGE        *mctx_arcmsg;   /* libopenarc message */
+    ARC_STAT            mctx_hdrstatus; /* first header field error */
+    struct Header      *mctx_hdrerr;    /* header field that caused it */
     struct arc_dstring *mctx_tmpstr;   /* temporary string */
 };
 
@@ -175,8 +196,9 @@ struct connctx
     char         cctx_host[ARC_MAXHOSTNAMELEN + 1];
     /* hostname */
     struct sockaddr_storage cctx_ip;     /* IP info */
-    struct arcf_config     *cctx_config; /* configuration in use */
-    struct msgctx          *cctx_msg;    /* message context */
+    struct arcf_config     *cctx_config;   /* configuration in use */
+    struct msgctx          *cctx_msg;      /* message context */
+    ARC_MESSAGE            *cctx_arcspare; /* handle for the next message */
 };
 
 /*
@@ -213,9 +235,10 @@ struct nametable arcf_canonicalizations[] = {
 };
 
 struct nametable arcf_signalgorithms[] = {
-    {"rsa-sha1",   ARC_SIGN_RSASHA1  },
-    {"rsa-sha256", ARC_SIGN_RSASHA256},
-    {NULL,         -1                }
+    {"rsa-sha1",       ARC_SIGN_RSASHA1      },
+    {"rsa-sha256",     ARC_SIGN_RSASHA256    },
+    {"ed25519-sha256", ARC_SIGN_ED25519SHA256},
+    {NULL,             -1                    }
 };
 
 struct nametable arcf_chainstates[] = {
@@ -233,6 +256,28 @@ struct nametable arcf_responses[] = {
     {NULL,       -1            }
 };
 
+/* header fields with limited occurrences (RFC 5322 3.6) */
+struct arcf_hdrlimit
+{
+    const char *hl_name;
+    int         hl_min;
+    int         hl_max;
+};
+
+static struct arcf_hdrlimit arcf_hdrlimits[] = {
+    {"From",        1, 1},
+    {"Date",        1, 1},
+    {"Reply-To",    0, 1},
+    {"To",          0, 1},
+    {"Cc",          0, 1},
+    {"Bcc",         0, 1},
+    {"Message-Id",  0, 1},
+    {"In-Reply-To", 0, 1},
+    {"References",  0, 1},
+    {"Subject",     0, 1},
+    {NULL,          0, 0}
+};
+
 /* PROTOTYPES */
 sfsistat      mlfi_abort(SMFICTX *);
 sfsistat      mlfi_close(SMFICTX *);
@@ -252,7 +297,9 @@ sfsistat      mlfi_negotiate(SMFICTX *,
                              unsigned long *,
                              unsigned long *);
 
+static void   arcf_config_reload(void);
 static Header arcf_findheader(msgctx, char *, int);
+static Header arcf_nextheader(Header, char *);
 
 /* GLOBALS */
 bool                dolog;      /* logging? (exported) */
@@ -264,8 +311,9 @@ int                 diesig;     /* signal to distribute */
 char               *progname;   /* program name */
 char               *sock;       /* listening socket */
 char               *conffile;   /* configuration file */
+unsigned int        conf_epoch;        /* bumped by each reload */
+unsigned int        conf_acquiring[2]; /* threads reading "curconf" */
 struct arcf_config *curconf;    /* current configuration */
-pthread_mutex_t     conf_lock;  /* config lock */
 pthread_mutex_t     pwdb_lock;  /* passwd/group lock */
 char                myhostname[MAXHOSTNAMELEN + 1]; /* local host's name */
 
@@ -1095,6 +1143,10 @@ arcf_sighandler(int sig)
 **
 **  Return value:
 **  	NULL.
+**
+**  Notes:
+**  	main() joins this thread before freeing "curconf", so a reload
+**  	that is under way when the filter shuts down is allowed to finish.
 */
 
 static void *
@@ -1103,8 +1155,6 @@ arcf_reloader(/* UNUSED */ void *vp)
     int      sig;
     sigset_t mask;
 
-    (void) pthread_detach(pthread_self());
-
     sigemptyset(&mask);
     sigaddset(&mask, SIGUSR1);
 
@@ -1112,9 +1162,9 @@ arcf_reloader(/* UNUSED */ void *vp)
     {
         (void) sigwait(&mask, &sig);
 
-        if (conffile != NULL)
+        if (conffile != NULL && !die)
         {
-            reload = true;
+            arcf_config_reload();
         }
     }
 
@@ -1171,8 +1221,18 @@ arcf_config_new(void)
     new->conf_ret_unable = SMFIS_TEMPFAIL;
     new->conf_ret_unwilling = SMFIS_REJECT;
 
-    LIST_INIT(&new->conf_peers);
-    LIST_INIT(&new->conf_internal);
+    /* the creator's reference, later held by "curconf" */
+    new->conf_refcnt = 1;
+
+    new->conf_peers = arcf_hostset_new();
+    new->conf_internal = arcf_hostset_new();
+    if (new->conf_peers == NULL || new->conf_internal == NULL)
+    {
+        arcf_hostset_free(new->conf_peers);
+        arcf_hostset_free(new->conf_internal);
+        ARC_FREE(new);
+        return NULL;
+    }
 
     return new;
 }
@@ -1240,57 +1300,261 @@ arcf_list_load(struct conflist *list, char *path, char **err)
 }
 
 /*
-**  ARCF_ADDLIST -- add an entry to a list
+**  ARCF_LIST_DESTROY -- destroy a list
 **
 **  Parameters:
-**  	list -- list to update
-**  	str -- string to add
-**  	err -- error string (returned)
+**  	list -- LIST to be destroyed
 **
 **  Return value:
-**  	true iff the operation succeeded.
+**  	None.
 */
 
-bool
-arcf_addlist(struct conflist *list, char *str, char **err)
+void
+arcf_list_destroy(struct conflist *list)
 {
-    struct configvalue *v;
+    while (!LIST_EMPTY(list))
+    {
+        struct configvalue *n;
+
+        n = LIST_FIRST(list);
+        LIST_REMOVE(n, entries);
+        ARC_FREE(n->value);
+        ARC_FREE(n);
+    }
+}
+
+/*
+**  ARCF_SEALCHK_FREE -- release compiled SealHeaderChecks rules
+**
+**  Parameters:
+**  	checks -- array of rules
+**  	n -- number of rules in "checks"
+**
+**  Return value:
+**  	None.
+*/
 
-    v = ARC_MALLOC(sizeof(struct configvalue));
-    if (v == NULL)
+static void
+arcf_sealchk_free(struct sealchk *checks, unsigned int n)
+{
+    unsigned int c;
+
+    for (c = 0; c < n; c++)
     {
-        *err = strerror(errno);
+        regfree(&checks[c].sc_re);
+        ARC_FREE(checks[c].sc_hdr);
+    }
+
+    ARC_FREE(checks);
+}
+
+/*
+**  ARCF_SEALCHK_CMP -- qsort() comparator for SealHeaderChecks rules
+**
+**  Parameters:
+**  	a, b -- rules to compare
+**
+**  Return value:
+**  	Ordering of the two rules' header field names.
+*/
+
+static int
+arcf_sealchk_cmp(const void *a, const void *b)
+{
+    const struct sealchk *sa = a;
+    const struct sealchk *sb = b;
+
+    return strcasecmp(sa->sc_hdr, sb->sc_hdr);
+}
+
+/*
+**  ARCF_SEALCHK_LOAD -- load and compile SealHeaderChecks rules
+**
+**  Parameters:
+**  	conf -- configuration to update
+**  	path -- file containing the rules
+**  	err -- where to write errors
+**  	errlen -- bytes available at "err"
+**
+**  Return value:
+**  	true iff every rule in the file was valid.
+**
+**  Notes:
+**  	Blank lines are ignored.  The rules are sorted by header field name
+**  	so that all the rules for one field can be tried against each of
+**  	its values in turn.
+*/
+
+static bool
+arcf_sealchk_load(struct arcf_config *conf,
+                  char               *path,
+                  char               *err,
+                  size_t              errlen)
+{
+    bool                ok = true;
+    int                 status;
+    unsigned int        n = 0;
+    char               *dberr = NULL;
+    char               *p;
+    struct configvalue *node;
+    struct sealchk     *checks;
+    struct conflist     rules;
+    char                reerr[BUFRSZ];
+
+    LIST_INIT(&rules);
+    if (!arcf_list_load(&rules, path, &dberr))
+    {
+        snprintf(err, errlen, "%s: arcf_list_load(): %s", path, dberr);
+        arcf_list_destroy(&rules);
+        return false;
+    }
+
+    LIST_FOREACH(node, &rules, entries)
+    {
+        n++;
+    }
+
+    checks = ARC_CALLOC(n == 0 ? 1 : n, sizeof *checks);
+    if (checks == NULL)
+    {
+        snprintf(err, errlen, "%s: %s", path, strerror(errno));
+        arcf_list_destroy(&rules);
+        return false;
+    }
+
+    n = 0;
+    LIST_FOREACH(node, &rules, entries)
+    {
+        if (node->value[0] == '\0')
+        {
+            continue;
+        }
+
+        p = strchr(node->value, ':');
+        if (p == NULL || p == node->value)
+        {
+            snprintf(err, errlen, "%s: invalid seal header check \"%s\"",
+                     path, node->value);
+            ok = false;
+            break;
+        }
+
+        *p++ = '\0';
+        status = regcomp(&checks[n].sc_re, p, REG_NOSUB);
+        if (status != 0)
+        {
+            (void) regerror(status, &checks[n].sc_re, reerr, sizeof reerr);
+            snprintf(err, errlen, "%s: invalid seal header check \"%s:%s\": %s",
+                     path, node->value, p, reerr);
+            ok = false;
+            break;
+        }
+
+        /* take the field name from the list entry */
+        checks[n].sc_hdr = node->value;
+        node->value = NULL;
+        n++;
+    }
+
+    arcf_list_destroy(&rules);
+
+    if (!ok)
+    {
+        arcf_sealchk_free(checks, n);
         return false;
     }
-    v->value = ARC_STRDUP(str);
 
-    LIST_INSERT_HEAD(list, v, entries);
+    qsort(checks, n, sizeof *checks, arcf_sealchk_cmp);
+
+    conf->conf_sealchecks = checks;
+    conf->conf_nsealchecks = n;
+
     return true;
 }
 
+#ifdef USE_JANSSON
 /*
-**  ARCF_LIST_DESTROY -- destroy a list
+**  ARCF_SEALCHK_MATCH -- try a group of SealHeaderChecks rules on a string
 **
 **  Parameters:
-**  	list -- LIST to be destroyed
+**  	checks -- rules to try
+**  	n -- number of rules in "checks"
+**  	str -- string to test
 **
 **  Return value:
-**  	None.
+**  	true iff any of the rules matched.
 */
 
-void
-arcf_list_destroy(struct conflist *list)
+static bool
+arcf_sealchk_match(struct sealchk *checks, unsigned int n, const char *str)
 {
-    while (!LIST_EMPTY(list))
+    unsigned int c;
+
+    for (c = 0; c < n; c++)
     {
-        struct configvalue *n;
+        if (regexec(&checks[c].sc_re, str, 0, NULL, 0) == 0)
+        {
+            return true;
+        }
+    }
 
-        n = LIST_FIRST(list);
-        LIST_REMOVE(n, entries);
-        ARC_FREE(n->value);
-        ARC_FREE(n);
+    return false;
+}
+
+/*
+**  ARCF_SEALCHK_VALUE -- apply SealHeaderChecks rules to a header field value
+**
+**  Parameters:
+**  	checks -- rules for this header field
+**  	n -- number of rules in "checks"
+**  	value -- header field value
+**
+**  Return value:
+**  	true iff any of the rules matched the value or, if the value is
+**  	JSON, any string it contains.
+**
+**  Notes:
+**  	The value is decoded once no matter how many rules there are.
+*/
+
+static bool
+arcf_sealchk_value(struct sealchk *checks, unsigned int n, const char *value)
+{
+    bool         found = false;
+    size_t       jn;
+    json_t      *json;
+    json_t      *entry;
+    json_error_t json_err;
+
+    json = json_loads(value, 0, &json_err);
+    if (json == NULL)
+    {
+        return arcf_sealchk_match(checks, n, value);
+    }
+
+    if (json_is_string(json))
+    {
+        found = arcf_sealchk_match(checks, n, json_string_value(json));
+    }
+    else if (json_is_array(json))
+    {
+        for (jn = 0; !found && jn < json_array_size(json); jn++)
+        {
+            entry = json_array_get(json, jn);
+
+            if (json_is_string(entry))
+            {
+                found = arcf_sealchk_match(checks, n,
+                                           json_string_value(entry));
+            }
+        }
     }
+
+    json_decref(json);
+
+    return found;
 }
+#endif /* USE_JANSSON */
 
 /*
 **  ARCF_CONFIG_FREE -- destroy a configuration handle
@@ -1315,19 +1579,21 @@ arcf_config_free(struct arcf_config *conf)
         arc_close(conf->conf_libopenarc);
     }
 
+    arc_signkey_free(conf->conf_signkey);
+
     if (conf->conf_authservid != NULL)
     {
         ARC_FREE(conf->conf_authservid);
     }
 
-    if (!LIST_EMPTY(&conf->conf_peers))
+    if (conf->conf_peers != NULL)
     {
-        arcf_list_destroy(&conf->conf_peers);
+        arcf_hostset_free(conf->conf_peers);
     }
 
-    if (!LIST_EMPTY(&conf->conf_internal))
+    if (conf->conf_internal != NULL)
     {
-        arcf_list_destroy(&conf->conf_internal);
+        arcf_hostset_free(conf->conf_internal);
     }
 
     if (conf->conf_data != NULL)
@@ -1345,9 +1611,9 @@ arcf_config_free(struct arcf_config *conf)
         ARC_FREE(conf->conf_oversignhdrs);
     }
 
-    if (!LIST_EMPTY(&conf->conf_sealheaderchecks))
+    if (conf->conf_sealchecks != NULL)
     {
-        arcf_list_destroy(&conf->conf_sealheaderchecks);
+        arcf_sealchk_free(conf->conf_sealchecks, conf->conf_nsealchecks);
     }
 
     ARC_FREE(conf);
@@ -1507,6 +1773,9 @@ arcf_config_load(struct config      *data,
         (void) config_get(data, "EnableCoredumps", &conf->conf_enablecores,
                           sizeof conf->conf_enablecores);
 
+        (void) config_get(data, "EarlySealVerification", &conf->conf_earlyseal,
+                          sizeof conf->conf_earlyseal);
+
         (void) config_get(data, "FinalReceiver", &conf->conf_finalreceiver,
                           sizeof conf->conf_finalreceiver);
 
@@ -1528,6 +1797,22 @@ arcf_config_load(struct config      *data,
         config_get(data, "MinimumKeySizeRSA", &conf->conf_minkeysz,
                    sizeof conf->conf_minkeysz);
 
+        (void) config_get(data, "MaximumVerifyBits",
+                          &conf->conf_maxverifybits,
+                          sizeof conf->conf_maxverifybits);
+
+        (void) config_get(data, "KeyCacheSize", &conf->conf_keycachesz,
+                          sizeof conf->conf_keycachesz);
+
+        (void) config_get(data, "KeyCacheTTL", &conf->conf_keycachettl,
+                          sizeof conf->conf_keycachettl);
+
+        (void) config_get(data, "CryptoThreads", &conf->conf_cryptothreads,
+                          sizeof conf->conf_cryptothreads);
+
+        (void) config_get(data, "CryptoQueueSize", &conf->conf_cryptoqueue,
+                          sizeof conf->conf_cryptoqueue);
+
         (void) config_get(data, "SignHeaders", &conf->conf_signhdrs_raw,
                           sizeof conf->conf_signhdrs_raw);
 
@@ -1536,17 +1821,9 @@ arcf_config_load(struct config      *data,
 
         str = NULL;
         (void) config_get(data, "SealHeaderChecks", &str, sizeof str);
-        if (str != NULL)
+        if (str != NULL && !arcf_sealchk_load(conf, str, err, errlen))
         {
-            bool  status;
-            char *dberr = NULL;
-
-            status = arcf_list_load(&conf->conf_sealheaderchecks, str, &dberr);
-            if (!status)
-            {
-                snprintf(err, errlen, "%s: arcf_list_load(): %s", str, dberr);
-                return -1;
-            }
+            return -1;
         }
 
         str = NULL;
@@ -1610,6 +1887,9 @@ arcf_config_load(struct config      *data,
         (void) config_get(data, "TestKeys", &conf->conf_testkeys,
                           sizeof conf->conf_testkeys);
 
+        (void) config_get(data, "Nameservers", &conf->conf_nslist,
+                          sizeof conf->conf_nslist);
+
         if (!conf->conf_dolog)
         {
             (void) config_get(data, "Syslog", &conf->conf_dolog,
@@ -1651,10 +1931,12 @@ arcf_config_load(struct config      *data,
         bool  status;
         char *dberr = NULL;
 
-        status = arcf_list_load(&conf->conf_peers, str, &dberr);
+        status = arcf_hostset_load(conf->conf_peers, str,
+                                   curconf != NULL ? curconf->conf_peers : NULL,
+                                   &dberr);
         if (!status)
         {
-            snprintf(err, errlen, "%s: arcf_list_load(): %s", str, dberr);
+            snprintf(err, errlen, "%s: arcf_hostset_load(): %s", str, dberr);
             return -1;
         }
     }
@@ -1669,10 +1951,12 @@ arcf_config_load(struct config      *data,
         bool  status;
         char *dberr = NULL;
 
-        status = arcf_list_load(&conf->conf_internal, str, &dberr);
+        status = arcf_hostset_load(
+            conf->conf_internal, str,
+            curconf != NULL ? curconf->conf_internal : NULL, &dberr);
         if (!status)
         {
-            snprintf(err, errlen, "%s: arcf_list_load(): %s", str, dberr);
+            snprintf(err, errlen, "%s: arcf_hostset_load(): %s", str, dberr);
             return -1;
         }
     }
@@ -1682,18 +1966,18 @@ arcf_config_load(struct config      *data,
         char *dberr = NULL;
 
         str = LOCALHOST;
-        status = arcf_addlist(&conf->conf_internal, str, &dberr);
+        status = arcf_hostset_add(conf->conf_internal, str, &dberr);
         if (!status)
         {
-            snprintf(err, errlen, "%s: arcf_addlist(): %s", str, dberr);
+            snprintf(err, errlen, "%s: arcf_hostset_add(): %s", str, dberr);
             return -1;
         }
 
         str = LOCALHOST6;
-        status = arcf_addlist(&conf->conf_internal, str, &dberr);
+        status = arcf_hostset_add(conf->conf_internal, str, &dberr);
         if (!status)
         {
-            snprintf(err, errlen, "%s: arcf_addlist(): %s", str, dberr);
+            snprintf(err, errlen, "%s: arcf_hostset_add(): %s", str, dberr);
             return -1;
         }
     }
@@ -1706,6 +1990,7 @@ arcf_config_load(struct config      *data,
         ssize_t        rlen;
         ino_t          ino = -1;
         uid_t          asuser = (uid_t) -1;
+        const char    *keyerr = NULL;
         unsigned char *s33krit;
         struct stat    s;
 
@@ -1819,8 +2104,6 @@ arcf_config_load(struct config      *data,
             return -1;
         }
 
-        conf->conf_keylen = s.st_size + 1;
-
         rlen = read(fd, s33krit, s.st_size + 1);
         if (rlen == (ssize_t) -1)
         {
@@ -1859,7 +2142,25 @@ arcf_config_load(struct config      *data,
 
         close(fd);
         s33krit[s.st_size] = '\0';
-        conf->conf_keydata = s33krit;
+
+        /* decode it once here rather than for every message */
+        conf->conf_signkey = arc_signkey_load(s33krit, s.st_size + 1,
+                                              &keyerr);
+        memset(s33krit, '\0', s.st_size + 1);
+        ARC_FREE(s33krit);
+
+        if (conf->conf_signkey == NULL)
+        {
+            if (conf->conf_dolog)
+            {
+                syslog(LOG_ERR, "%s: can't load key: %s", conf->conf_keyfile,
+                       keyerr);
+            }
+
+            snprintf(err, errlen, "%s: can't load key: %s",
+                     conf->conf_keyfile, keyerr);
+            return -1;
+        }
     }
 
     /* activate logging if requested */
@@ -1932,6 +2233,11 @@ arcf_config_setlib(struct arcf_config *conf, char **err)
             opts |= ARC_LIBFLAGS_KEEPFILES;
         }
 
+        if (conf->conf_earlyseal)
+        {
+            opts |= ARC_LIBFLAGS_EARLYSEAL;
+        }
+
         status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
                              ARC_OPTS_FLAGS, &opts, sizeof opts);
     }
@@ -1974,6 +2280,52 @@ arcf_config_setlib(struct arcf_config *conf, char **err)
                              sizeof conf->conf_minkeysz);
     }
 
+    if (status == ARC_STAT_OK && conf->conf_maxverifybits > 0)
+    {
+        status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
+                             ARC_OPTS_MAXVERIFYBITS,
+                             &conf->conf_maxverifybits,
+                             sizeof conf->conf_maxverifybits);
+    }
+
+    if (status != ARC_STAT_OK)
+    {
+        if (err != NULL)
+        {
+            *err = "failed to set ARC library options";
+        }
+        return false;
+    }
+
+    if (conf->conf_keycachettl > 0)
+    {
+        status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
+                             ARC_OPTS_KEYCACHE_TTL, &conf->conf_keycachettl,
+                             sizeof conf->conf_keycachettl);
+    }
+
+    if (status == ARC_STAT_OK && conf->conf_keycachesz > 0)
+    {
+        status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
+                             ARC_OPTS_KEYCACHE, &conf->conf_keycachesz,
+                             sizeof conf->conf_keycachesz);
+    }
+
+    if (status == ARC_STAT_OK && conf->conf_cryptoqueue > 0)
+    {
+        status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
+                             ARC_OPTS_CRYPTO_QUEUE, &conf->conf_cryptoqueue,
+                             sizeof conf->conf_cryptoqueue);
+    }
+
+    if (status == ARC_STAT_OK && conf->conf_cryptothreads > 0)
+    {
+        status = arc_options(conf->conf_libopenarc, ARC_OP_SETOPT,
+                             ARC_OPTS_CRYPTO_THREADS,
+                             &conf->conf_cryptothreads,
+                             sizeof conf->conf_cryptothreads);
+    }
+
     if (status != ARC_STAT_OK)
     {
         if (err != NULL)
@@ -1999,6 +2351,17 @@ arcf_config_setlib(struct arcf_config *conf, char **err)
         }
     }
 
+    if (conf->conf_nslist != NULL &&
+        arc_dns_nslist(conf->conf_libopenarc, conf->conf_nslist) !=
+            ARC_STAT_OK)
+    {
+        if (err != NULL)
+        {
+            *err = "failed to set nameservers";
+        }
+        return false;
+    }
+
     if (conf->conf_signhdrs_raw != NULL)
     {
         conf->conf_signhdrs = arcf_mkarray(conf->conf_signhdrs_raw);
@@ -2037,51 +2400,117 @@ arcf_config_setlib(struct arcf_config *conf, char **err)
 }
 
 /*
-**  ARCF_CONFIG_RELOAD -- reload configuration if requested
+**  ARCF_CONFIG_ACQUIRE -- take a reference to the current configuration
 **
 **  Parameters:
-**   	None.
+**  	None.
 **
 **  Return value:
-**  	None.
+**  	The current configuration handle, to be released later with
+**  	arcf_config_release().
 **
-**  Side effects:
-**  	If a reload was requested and is successful, "curconf" now points
-**  	to a new configuration handle.
+**  Notes:
+**  	This never blocks.  "conf_acquiring" counts the threads that may
+**  	have read "curconf" but not yet taken their reference, in the slot
+**  	picked by the low bit of "conf_epoch".  A reload replaces "curconf",
+**  	moves later readers to the other slot and waits only for the slot
+**  	they left, so the old handle can't be freed in between.  If a
+**  	reload moves the slot while we're registering, we register again.
 */
 
-static void
-arcf_config_reload(void)
+static struct arcf_config *
+arcf_config_acquire(void)
 {
-    struct arcf_config *new;
-    char errbuf[BUFRSZ + 1];
-
-    pthread_mutex_lock(&conf_lock);
-
-    if (!reload)
-    {
-        pthread_mutex_unlock(&conf_lock);
-        return;
-    }
+    unsigned int        epoch;
+    struct arcf_config *conf;
 
-    if (conffile == NULL)
+    for (;;)
     {
-        if (curconf->conf_dolog)
+        epoch = __atomic_load_n(&conf_epoch, __ATOMIC_SEQ_CST);
+        (void) __atomic_add_fetch(&conf_acquiring[epoch & 1], 1,
+                                  __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&conf_epoch, __ATOMIC_SEQ_CST) == epoch)
         {
-            syslog(LOG_ERR, "ignoring reload signal");
+            break;
         }
+        (void) __atomic_sub_fetch(&conf_acquiring[epoch & 1], 1,
+                                  __ATOMIC_SEQ_CST);
+    }
 
-        reload = false;
+    conf = __atomic_load_n(&curconf, __ATOMIC_SEQ_CST);
+    (void) __atomic_add_fetch(&conf->conf_refcnt, 1, __ATOMIC_RELAXED);
+    (void) __atomic_sub_fetch(&conf_acquiring[epoch & 1], 1,
+                              __ATOMIC_SEQ_CST);
 
-        pthread_mutex_unlock(&conf_lock);
-        return;
-    }
+    return conf;
+}
 
-    new = arcf_config_new();
-    if (new == NULL)
-    {
-        if (curconf->conf_dolog)
-        {
+/*
+**  ARCF_CONFIG_RELEASE -- drop a reference to a configuration
+**
+**  Parameters:
+**  	conf -- configuration handle
+**
+**  Return value:
+**  	None.
+**
+**  Side effects:
+**  	"conf" is destroyed if this was the last reference to it.
+*/
+
+static void
+arcf_config_release(struct arcf_config *conf)
+{
+    if (__atomic_sub_fetch(&conf->conf_refcnt, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        arcf_config_free(conf);
+    }
+}
+
+/*
+**  ARCF_CONFIG_RELOAD -- reload configuration
+**
+**  Parameters:
+**   	None.
+**
+**  Return value:
+**  	None.
+**
+**  Side effects:
+**  	If the reload is successful, "curconf" now points to a new
+**  	configuration handle.
+**
+**  Notes:
+**  	Only the reloader thread calls this, or main() before that thread
+**  	starts, so there is only ever one writer of "curconf".  The new
+**  	configuration is built without holding any lock and then published
+**  	with an atomic swap; connections that start meanwhile keep using
+**  	the old one.
+*/
+
+static void
+arcf_config_reload(void)
+{
+    unsigned int        epoch;
+    struct arcf_config *new;
+    struct arcf_config *old;
+    char                errbuf[BUFRSZ + 1];
+
+    if (conffile == NULL)
+    {
+        if (curconf->conf_dolog)
+        {
+            syslog(LOG_ERR, "ignoring reload signal");
+        }
+
+        return;
+    }
+
+    new = arcf_config_new();
+    if (new == NULL)
+    {
+        if (curconf->conf_dolog)
+        {
             syslog(LOG_ERR, "malloc(): %s", strerror(errno));
         }
     }
@@ -2163,14 +2592,26 @@ arcf_config_reload(void)
         }
         else
         {
-            if (curconf->conf_refcnt == 0)
+            new->conf_data = cfg;
+            dolog = new->conf_dolog;
+
+            old = __atomic_exchange_n(&curconf, new, __ATOMIC_SEQ_CST);
+
+            /*
+            **  Let anyone who might have read the old pointer take a
+            **  reference first.  Readers arriving from now on use the
+            **  other slot, so this waits for a few instructions in each
+            **  thread that was already there, however busy the filter is.
+            */
+
+            epoch = __atomic_fetch_add(&conf_epoch, 1, __ATOMIC_SEQ_CST);
+            while (__atomic_load_n(&conf_acquiring[epoch & 1],
+                                   __ATOMIC_SEQ_CST) != 0)
             {
-                arcf_config_free(curconf);
+                (void) sched_yield();
             }
 
-            dolog = new->conf_dolog;
-            curconf = new;
-            new->conf_data = cfg;
+            arcf_config_release(old);
 
             if (new->conf_dolog)
             {
@@ -2179,10 +2620,6 @@ arcf_config_reload(void)
         }
     }
 
-    reload = false;
-
-    pthread_mutex_unlock(&conf_lock);
-
     return;
 }
 
@@ -2277,6 +2714,24 @@ arcf_cleanup(SMFICTX *ctx)
     /* release memory, reset state */
     if (afc != NULL)
     {
+        /*
+        **  The library refers to the queued header fields.  Keep one
+        **  handle per connection so the next message can reuse its
+        **  buffers and digest contexts.
+        */
+
+        if (afc->mctx_arcmsg != NULL)
+        {
+            if (cc->cctx_arcspare == NULL)
+            {
+                cc->cctx_arcspare = afc->mctx_arcmsg;
+            }
+            else
+            {
+                arc_free(afc->mctx_arcmsg);
+            }
+        }
+
         if (afc->mctx_hqhead != NULL)
         {
             Header hdr;
@@ -2285,19 +2740,12 @@ arcf_cleanup(SMFICTX *ctx)
             hdr = afc->mctx_hqhead;
             while (hdr != NULL)
             {
-                ARC_FREE(hdr->hdr_hdr);
-                ARC_FREE(hdr->hdr_val);
                 prev = hdr;
                 hdr = hdr->hdr_next;
                 ARC_FREE(prev);
             }
         }
 
-        if (afc->mctx_arcmsg != NULL)
-        {
-            arc_free(afc->mctx_arcmsg);
-        }
-
         if (afc->mctx_tmpstr != NULL)
         {
             arc_dstring_free(afc->mctx_tmpstr);
@@ -2400,320 +2848,31 @@ arcf_findheader(msgctx afc, char *hname, int instance)
 }
 
 /*
-**  ARCF_CHECKHOST -- check the peerlist for a host and its wildcards
+**  ARCF_NEXTHEADER -- find the next header with the same name
 **
 **  Parameters:
-**  	list -- list to check
-**  	host -- hostname to find
-**
-**  Return value:
-**  	true if there's a match, false otherwise.
-*/
-
-bool
-arcf_checkhost(struct conflist *list, char *host)
-{
-    char               *p;
-    struct configvalue *node;
-    char                buf[BUFRSZ + 1];
-
-    assert(host != NULL);
-
-    /* short circuits */
-    if (list == NULL || host[0] == '\0')
-    {
-        return false;
-    }
-
-    /* iterate over the possibilities */
-    for (p = host; p != NULL; p = strchr(p + 1, '.'))
-    {
-        /* try the negative case */
-        snprintf(buf, sizeof buf, "!%s", p);
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(node->value, buf) == 0)
-        {
-            return false;
-        }
-
-        /* ...and now the positive case */
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(node->value, &buf[1]) == 0)
-        {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-/*
-**  ARCF_CHECKIP -- check a peerlist table for an IP address or its matching
-**                 wildcards
-**
-**  Parameters:
-**  	list -- list to check
-**  	ip -- IP address to find
+**  	hdr -- header to start after
+**  	hname -- name of the header of interest
 **
 **  Return value:
-**  	true if there's a match, false otherwise.
+**  	Header handle, or NULL if there are no more.
 */
 
-bool
-arcf_checkip(struct conflist *list, struct sockaddr *ip)
+static Header
+arcf_nextheader(Header hdr, char *hname)
 {
-    char ipbuf[ARC_MAXHOSTNAMELEN + 1];
-
-    assert(ip != NULL);
-
-    /* short circuit */
-    if (list == NULL)
-    {
-        return false;
-    }
-
-#if AF_INET6
-    if (ip->sa_family == AF_INET6)
-    {
-        int                 bits;
-        size_t              dst_len;
-        size_t              iplen;
-        char               *dst;
-        struct configvalue *node;
-        struct sockaddr_in6 sin6;
-        struct in6_addr     addr;
-
-        memcpy(&sin6, ip, sizeof sin6);
-
-        memcpy(&addr, &sin6.sin6_addr, sizeof addr);
-
-        memset(ipbuf, '\0', sizeof ipbuf);
-        ipbuf[0] = '!';
-
-        dst = &ipbuf[1];
-        dst_len = sizeof ipbuf - 1;
-
-        inet_ntop(AF_INET6, &addr, dst, dst_len);
-        arc_lowercase(dst);
-        iplen = strlen(dst);
-
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(ipbuf, node->value) == 0)
-        {
-            return false;
-        }
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(&ipbuf[1], node->value) == 0)
-        {
-            return true;
-        }
-
-        /* try it with square brackets */
-        memmove(&ipbuf[2], &ipbuf[1], iplen + 1);
-        ipbuf[1] = '[';
-        ipbuf[iplen + 2] = ']';
-
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(ipbuf, node->value) == 0)
-        {
-            return false;
-        }
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(&ipbuf[1], node->value) == 0)
-        {
-            return true;
-        }
-
-        /* iterate over possible bitwise expressions */
-        for (bits = 0; bits <= 128; bits++)
-        {
-            size_t sz;
-
-            /* try this one */
-            memset(ipbuf, '\0', sizeof ipbuf);
-            ipbuf[0] = '!';
-
-            dst = &ipbuf[1];
-            dst_len = sizeof ipbuf - 1;
-
-            inet_ntop(AF_INET6, &addr, dst, dst_len);
-            arc_lowercase(dst);
-            iplen = strlen(dst);
-
-            sz = strlcat(ipbuf, "/", sizeof ipbuf);
-            if (sz >= sizeof ipbuf)
-            {
-                return false;
-            }
-
-            dst = &ipbuf[sz];
-            dst_len = sizeof ipbuf - sz;
-
-            sz = snprintf(dst, dst_len, "%d", 128 - bits);
-            if (sz >= sizeof ipbuf)
-            {
-                return false;
-            }
-
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(ipbuf, node->value) == 0)
-            {
-                return false;
-            }
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(&ipbuf[1], node->value) == 0)
-            {
-                return true;
-            }
-
-            /* try it with square brackets */
-            memmove(&ipbuf[2], &ipbuf[1], iplen + 1);
-            ipbuf[1] = '[';
-            ipbuf[iplen + 2] = ']';
-            ipbuf[iplen + 3] = '\0';
-
-            sz = strlcat(ipbuf, "/", sizeof ipbuf);
-            if (sz >= sizeof ipbuf)
-            {
-                return false;
-            }
-
-            dst = &ipbuf[sz];
-            dst_len = sizeof ipbuf - sz;
-
-            sz = snprintf(dst, dst_len, "%d", 128 - bits);
-            if (sz >= sizeof ipbuf)
-            {
-                return false;
-            }
-
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(ipbuf, node->value) == 0)
-            {
-                return false;
-            }
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(&ipbuf[1], node->value) == 0)
-            {
-                return true;
-            }
-
-            /* flip off a bit */
-            if (bits != 128)
-            {
-                int idx;
-                int bit;
-
-                idx = 15 - (bits / 8);
-                bit = bits % 8;
-                addr.s6_addr[idx] &= ~(1 << bit);
-            }
-        }
-    }
-#endif /* AF_INET6 */
+    assert(hdr != NULL);
+    assert(hname != NULL);
 
-    if (ip->sa_family == AF_INET)
+    for (hdr = hdr->hdr_next; hdr != NULL; hdr = hdr->hdr_next)
     {
-        int                 c;
-        int                 bits;
-        size_t              iplen;
-        struct configvalue *node;
-        struct in_addr      addr;
-        struct in_addr      mask;
-        struct sockaddr_in  sin;
-
-        memcpy(&sin, ip, sizeof sin);
-        memcpy(&addr.s_addr, &sin.sin_addr, sizeof addr.s_addr);
-
-        ipbuf[0] = '!';
-        (void) arcf_inet_ntoa(addr, &ipbuf[1], sizeof ipbuf - 1);
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(ipbuf, node->value) == 0)
-        {
-            return false;
-        }
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(&ipbuf[1], node->value) == 0)
-        {
-            return true;
-        }
-
-        /* try it with square brackets */
-        memmove(&ipbuf[2], &ipbuf[1], strlen(&ipbuf[1]) + 1);
-        ipbuf[1] = '[';
-        ipbuf[strlen(ipbuf)] = ']';
-
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(ipbuf, node->value) == 0)
-        {
-            return false;
-        }
-        LIST_FOREACH(node, list, entries)
-        if (strcmp(&ipbuf[1], node->value) == 0)
-        {
-            return true;
-        }
-
-        /* iterate over possible bitwise expressions */
-        for (bits = 32; bits >= 0; bits--)
+        if (strcasecmp(hdr->hdr_hdr, hname) == 0)
         {
-            if (bits == 32)
-            {
-                mask.s_addr = 0xffffffff;
-            }
-            else
-            {
-                mask.s_addr = 0;
-                for (c = 0; c < bits; c++)
-                {
-                    mask.s_addr |= htonl(1 << (31 - c));
-                }
-            }
-
-            addr.s_addr = addr.s_addr & mask.s_addr;
-
-            memset(ipbuf, '\0', sizeof ipbuf);
-            ipbuf[0] = '!';
-            (void) arcf_inet_ntoa(addr, &ipbuf[1], sizeof ipbuf - 1);
-            iplen = strlen(&ipbuf[1]);
-            c = strlen(ipbuf);
-            ipbuf[c] = '/';
-            c++;
-
-            snprintf(&ipbuf[c], sizeof ipbuf - c, "%d", bits);
-
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(ipbuf, node->value) == 0)
-            {
-                return false;
-            }
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(&ipbuf[1], node->value) == 0)
-            {
-                return true;
-            }
-
-            /* try it with square brackets */
-            memmove(&ipbuf[2], &ipbuf[1], strlen(&ipbuf[1]) + 1);
-            ipbuf[1] = '[';
-            ipbuf[iplen + 2] = ']';
-            ipbuf[iplen + 3] = '/';
-            snprintf(&ipbuf[iplen + 4], sizeof ipbuf - iplen - 4, "%d", bits);
-
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(ipbuf, node->value) == 0)
-            {
-                return false;
-            }
-            LIST_FOREACH(node, list, entries)
-            if (strcmp(&ipbuf[1], node->value) == 0)
-            {
-                return true;
-            }
+            return hdr;
         }
     }
 
-    return false;
+    return NULL;
 }
 
 #if SMFI_VERSION >= 0x01000000
@@ -2754,27 +2913,23 @@ mlfi_negotiate(SMFICTX       *ctx,
     connctx       cc;
     struct arcf_config *conf;
 
-    arcf_config_reload();
+    conf = arcf_config_acquire();
 
     /* initialize connection context */
     cc = ARC_CALLOC(1, sizeof(struct connctx));
     if (cc == NULL)
     {
-        if (curconf->conf_dolog)
+        if (conf->conf_dolog)
         {
             syslog(LOG_ERR, "mlfi_negotiate(): malloc(): %s", strerror(errno));
         }
 
+        arcf_config_release(conf);
+
         return SMFIS_TEMPFAIL;
     }
 
-    pthread_mutex_lock(&conf_lock);
-
-    cc->cctx_config = curconf;
-    curconf->conf_refcnt++;
-    conf = curconf;
-
-    pthread_mutex_unlock(&conf_lock);
+    cc->cctx_config = conf;
 
     /* verify the actions we need are available */
     if ((f0 & reqactions) != reqactions)
@@ -2787,9 +2942,7 @@ mlfi_negotiate(SMFICTX       *ctx,
                 f0, reqactions);
         }
 
-        pthread_mutex_lock(&conf_lock);
-        conf->conf_refcnt--;
-        pthread_mutex_unlock(&conf_lock);
+        arcf_config_release(conf);
 
         ARC_FREE(cc);
 
@@ -2847,40 +3000,37 @@ mlfi_negotiate(SMFICTX       *ctx,
 sfsistat
 mlfi_connect(SMFICTX *ctx, char *host, _SOCK_ADDR *ip)
 {
-    connctx cc;
-
-    arcf_config_reload();
+    connctx             cc;
+    struct arcf_config *conf;
 
     /* copy hostname and IP information to a connection context */
     cc = arcf_getpriv(ctx);
     if (cc == NULL)
     {
+        conf = arcf_config_acquire();
+
         cc = ARC_CALLOC(1, sizeof(struct connctx));
         if (cc == NULL)
         {
-            pthread_mutex_lock(&conf_lock);
+            sfsistat retval = conf->conf_ret_unable;
 
-            if (curconf->conf_dolog)
+            if (conf->conf_dolog)
             {
                 syslog(LOG_ERR, "%s malloc(): %s", host, strerror(errno));
             }
 
-            int retval = curconf->conf_ret_unable;
-            pthread_mutex_unlock(&conf_lock);
+            arcf_config_release(conf);
 
             return retval;
         }
 
-        pthread_mutex_lock(&conf_lock);
-
-        cc->cctx_config = curconf;
-        curconf->conf_refcnt++;
-
-        pthread_mutex_unlock(&conf_lock);
+        cc->cctx_config = conf;
 
         arcf_setpriv(ctx, cc);
     }
 
+    conf = cc->cctx_config;
+
     arc_lowercase(host);
 
     if (host != NULL)
@@ -2911,30 +3061,29 @@ mlfi_connect(SMFICTX *ctx, char *host, _SOCK_ADDR *ip)
 
     /* if the client is on the peer list, then ignore it */
     if (((host != NULL && host[0] != '[') &&
-         arcf_checkhost(&curconf->conf_peers, host)) ||
-        (ip != NULL && arcf_checkip(&curconf->conf_peers, ip)))
+         arcf_hostset_checkhost(conf->conf_peers, host)) ||
+        (ip != NULL && arcf_hostset_checkip(conf->conf_peers, ip)))
     {
-        if (curconf->conf_dolog)
+        if (conf->conf_dolog)
         {
-            syslog(
-                LOG_INFO, "peer connection from %s, returning %s", host,
-                arc_code_to_name(arcf_responses, curconf->conf_ret_disabled));
+            syslog(LOG_INFO, "peer connection from %s, returning %s", host,
+                   arc_code_to_name(arcf_responses, conf->conf_ret_disabled));
         }
-        return curconf->conf_ret_disabled;
+        return conf->conf_ret_disabled;
     }
 
     /* infer operating mode if not explicitly set */
-    if (curconf->conf_mode != 0)
+    if (conf->conf_mode != 0)
     {
-        cc->cctx_mode = curconf->conf_mode;
+        cc->cctx_mode = conf->conf_mode;
     }
     else
     {
         char *modestr;
 
         if (((host != NULL && host[0] != '[') &&
-             arcf_checkhost(&curconf->conf_internal, host)) ||
-            (ip != NULL && arcf_checkip(&curconf->conf_internal, ip)))
+             arcf_hostset_checkhost(conf->conf_internal, host)) ||
+            (ip != NULL && arcf_hostset_checkip(conf->conf_internal, ip)))
         {
             /* internal host; assume outbound, so sign */
             cc->cctx_mode = ARC_MODE_SIGN;
@@ -2947,7 +3096,7 @@ mlfi_connect(SMFICTX *ctx, char *host, _SOCK_ADDR *ip)
             modestr = "verify";
         }
 
-        if (curconf->conf_dolog)
+        if (conf->conf_dolog)
         {
             syslog(LOG_INFO, "assuming %s mode for host %s", modestr,
                    cc->cctx_host);
@@ -2995,8 +3144,10 @@ mlfi_helo(SMFICTX *ctx, char *helo)
 sfsistat
 mlfi_envfrom(SMFICTX *ctx, char **envfrom)
 {
+    unsigned int        mode;
     connctx             cc;
     msgctx              afc;
+    const char         *err = NULL;
     struct arcf_config *conf;
 
     assert(ctx != NULL);
@@ -3029,6 +3180,45 @@ mlfi_envfrom(SMFICTX *ctx, char **envfrom)
 
     cc->cctx_msg = afc;
 
+    /*
+    **  Start the libopenarc handle now so header fields can be handed
+    **  over as they arrive.
+    */
+
+    mode = conf->conf_mode;
+    if (mode == 0)
+    {
+        mode = cc->cctx_mode;
+    }
+    afc->mctx_arcmsg = cc->cctx_arcspare;
+    cc->cctx_arcspare = NULL;
+    if (afc->mctx_arcmsg != NULL &&
+        arc_message_reset(afc->mctx_arcmsg, conf->conf_canonhdr,
+                          conf->conf_canonbody, conf->conf_signalg,
+                          mode) != ARC_STAT_OK)
+    {
+        arc_free(afc->mctx_arcmsg);
+        afc->mctx_arcmsg = NULL;
+    }
+
+    if (afc->mctx_arcmsg == NULL)
+    {
+        afc->mctx_arcmsg = arc_message(conf->conf_libopenarc,
+                                       conf->conf_canonhdr,
+                                       conf->conf_canonbody,
+                                       conf->conf_signalg, mode, &err);
+    }
+    if (afc->mctx_arcmsg == NULL)
+    {
+        if (conf->conf_dolog)
+        {
+            syslog(LOG_INFO, "can't initialize ARC handle: %s", err);
+        }
+
+        arcf_cleanup(ctx);
+        return conf->conf_ret_unable;
+    }
+
     /*
     **  Continue processing.
     */
@@ -3053,8 +3243,16 @@ mlfi_envfrom(SMFICTX *ctx, char **envfrom)
 sfsistat
 mlfi_header(SMFICTX *ctx, char *headerf, char *headerv)
 {
+    char                last;
+    size_t              hlen;
+    size_t              vlen;
+    size_t              flen;
+    ARC_STAT            status;
     msgctx              afc;
     connctx             cc;
+    char               *p;
+    char               *q;
+    char               *val;
     Header              newhdr;
     struct arcf_config *conf;
 
@@ -3097,43 +3295,7 @@ mlfi_header(SMFICTX *ctx, char *headerf, char *headerv)
         return SMFIS_CONTINUE;
     }
 
-    newhdr = ARC_CALLOC(1, sizeof(struct Header));
-    if (newhdr == NULL)
-    {
-        if (conf->conf_dolog)
-        {
-            syslog(LOG_ERR, "malloc(): %s", strerror(errno));
-        }
-
-        arcf_cleanup(ctx);
-        return conf->conf_ret_unable;
-    }
-
-    newhdr->hdr_hdr = ARC_STRDUP(headerf);
-
-    if (afc->mctx_tmpstr == NULL)
-    {
-        afc->mctx_tmpstr = arc_dstring_new(BUFRSZ, 0, NULL, NULL);
-        if (afc->mctx_tmpstr == NULL)
-        {
-            if (conf->conf_dolog)
-            {
-                syslog(LOG_ERR, "arc_dstring_new() failed");
-            }
-
-            ARC_FREE(newhdr->hdr_hdr);
-            ARC_FREE(newhdr);
-
-            arcf_cleanup(ctx);
-
-            return conf->conf_ret_unable;
-        }
-    }
-    else
-    {
-        arc_dstring_blank(afc->mctx_tmpstr);
-    }
-
+    val = headerv;
     if (!cc->cctx_noleadspc)
     {
         /*
@@ -3160,42 +3322,79 @@ mlfi_header(SMFICTX *ctx, char *headerf, char *headerv)
         **  it).
         */
 
-        char *p;
-
-        p = headerv;
-        while (isascii(*p) && isspace(*p))
+        while (isascii(*val) && isspace(*val))
         {
-            p++;
+            val++;
         }
-
-        arc_dstring_copy(afc->mctx_tmpstr, p);
-    }
-    else
-    {
-        arc_dstring_copy(afc->mctx_tmpstr, headerv);
     }
 
-    newhdr->hdr_val = ARC_STRDUP(arc_dstring_get(afc->mctx_tmpstr));
+    /*
+    **  The name, the value, and the field as libopenarc will see it are
+    **  stored along with the queue entry.  The latter gets CRLF line
+    **  endings, so count the bare LFs that will grow.
+    */
 
-    newhdr->hdr_next = NULL;
-    newhdr->hdr_prev = afc->mctx_hqtail;
+    hlen = strlen(headerf) + 1;
+    vlen = strlen(val) + 1;
+    flen = hlen + vlen + (cc->cctx_noleadspc ? 0 : 1);
+    last = '\0';
+    for (p = val; *p != '\0'; p++)
+    {
+        if (*p == '\n' && last != '\r')
+        {
+            flen++;
+        }
+        last = *p;
+    }
 
-    if (newhdr->hdr_hdr == NULL || newhdr->hdr_val == NULL)
+    newhdr = ARC_MALLOC(sizeof(struct Header) + hlen + vlen + flen);
+    if (newhdr == NULL)
     {
         if (conf->conf_dolog)
         {
             syslog(LOG_ERR, "malloc(): %s", strerror(errno));
         }
 
-        ARC_FREE(newhdr->hdr_hdr);
-        ARC_FREE(newhdr->hdr_val);
-        ARC_FREE(newhdr);
         arcf_cleanup(ctx);
         return conf->conf_ret_unable;
     }
 
-    afc->mctx_hdrbytes += strlen(newhdr->hdr_hdr) + 1;
-    afc->mctx_hdrbytes += strlen(newhdr->hdr_val) + 1;
+    newhdr->hdr_hdr = (char *) (newhdr + 1);
+    memcpy(newhdr->hdr_hdr, headerf, hlen);
+    newhdr->hdr_val = newhdr->hdr_hdr + hlen;
+    memcpy(newhdr->hdr_val, val, vlen);
+    newhdr->hdr_field = newhdr->hdr_val + vlen;
+
+    q = newhdr->hdr_field;
+    memcpy(q, headerf, hlen - 1);
+    q += hlen - 1;
+    *q++ = ':';
+    if (!cc->cctx_noleadspc)
+    {
+        *q++ = ' ';
+    }
+
+    last = '\0';
+
+    /* do milter-ized continuation conversion */
+    for (p = val; *p != '\0'; p++)
+    {
+        if (*p == '\n' && last != '\r')
+        {
+            *q++ = '\r';
+        }
+
+        *q++ = *p;
+
+        last = *p;
+    }
+
+    *q = '\0';
+
+    newhdr->hdr_next = NULL;
+    newhdr->hdr_prev = afc->mctx_hqtail;
+
+    afc->mctx_hdrbytes += hlen + vlen;
 
     if (afc->mctx_hqhead == NULL)
     {
@@ -3209,6 +3408,22 @@ mlfi_header(SMFICTX *ctx, char *headerf, char *headerv)
 
     afc->mctx_hqtail = newhdr;
 
+    /*
+    **  Hand it to libopenarc straight away.  Errors are reported at EOH,
+    **  once it's known that the message is going to be processed at all.
+    */
+
+    if (afc->mctx_hdrstatus == ARC_STAT_OK)
+    {
+        status = arc_header_field_borrow(afc->mctx_arcmsg, newhdr->hdr_field,
+                                         q - newhdr->hdr_field);
+        if (status != ARC_STAT_OK)
+        {
+            afc->mctx_hdrstatus = status;
+            afc->mctx_hdrerr = newhdr;
+        }
+    }
+
     return SMFIS_CONTINUE;
 }
 
@@ -3225,13 +3440,9 @@ mlfi_header(SMFICTX *ctx, char *headerf, char *headerv)
 sfsistat
 mlfi_eoh(SMFICTX *ctx)
 {
-    char                last;
-    unsigned int        mode;
     ARC_STAT            status;
     connctx             cc;
     msgctx              afc;
-    char               *p;
-    const char         *err = NULL;
     struct arcf_config *conf;
     Header              hdr;
 
@@ -3257,67 +3468,31 @@ mlfi_eoh(SMFICTX *ctx)
     if (conf->conf_reqhdrs)
     {
         bool ok = true;
+        int  c;
+        int  hdrcount[sizeof arcf_hdrlimits / sizeof arcf_hdrlimits[0]];
 
-        /* exactly one From: */
-        if (arcf_findheader(afc, "From", 0) == NULL ||
-            arcf_findheader(afc, "From", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* exactly one Date: */
-        if (arcf_findheader(afc, "Date", 0) == NULL ||
-            arcf_findheader(afc, "Date", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one Reply-To: */
-        if (arcf_findheader(afc, "Reply-To", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one To: */
-        if (arcf_findheader(afc, "To", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one Cc: */
-        if (arcf_findheader(afc, "Cc", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one Bcc: */
-        if (arcf_findheader(afc, "Bcc", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one Message-Id: */
-        if (arcf_findheader(afc, "Message-Id", 1) != NULL)
-        {
-            ok = false;
-        }
-
-        /* no more than one In-Reply-To: */
-        if (arcf_findheader(afc, "In-Reply-To", 1) != NULL)
-        {
-            ok = false;
-        }
+        memset(hdrcount, '\0', sizeof hdrcount);
 
-        /* no more than one References: */
-        if (arcf_findheader(afc, "References", 1) != NULL)
+        /* count them all in one pass */
+        for (hdr = afc->mctx_hqhead; hdr != NULL; hdr = hdr->hdr_next)
         {
-            ok = false;
+            for (c = 0; arcf_hdrlimits[c].hl_name != NULL; c++)
+            {
+                if (strcasecmp(hdr->hdr_hdr, arcf_hdrlimits[c].hl_name) == 0)
+                {
+                    hdrcount[c]++;
+                    break;
+                }
+            }
         }
 
-        /* no more than one Subject: */
-        if (arcf_findheader(afc, "Subject", 1) != NULL)
+        for (c = 0; arcf_hdrlimits[c].hl_name != NULL; c++)
         {
-            ok = false;
+            if (hdrcount[c] < arcf_hdrlimits[c].hl_min ||
+                hdrcount[c] > arcf_hdrlimits[c].hl_max)
+            {
+                ok = false;
+            }
         }
 
         if (!ok)
@@ -3328,6 +3503,9 @@ mlfi_eoh(SMFICTX *ctx)
                        afc->mctx_jobid);
             }
 
+            arc_free(afc->mctx_arcmsg);
+            afc->mctx_arcmsg = NULL;
+
             return SMFIS_ACCEPT;
         }
     }
@@ -3338,97 +3516,35 @@ mlfi_eoh(SMFICTX *ctx)
     **  see if this is one of those.
     */
 
-    if (!LIST_EMPTY(&conf->conf_sealheaderchecks))
+    if (conf->conf_nsealchecks > 0)
     {
-        bool                found = false;
-        int                 restatus;
-        struct configvalue *node;
-        char                buf[BUFRSZ];
+        bool            found = false;
+        unsigned int    first;
+        unsigned int    last;
+        struct sealchk *group;
 
-        LIST_FOREACH(node, &conf->conf_sealheaderchecks, entries)
+        /* the rules are sorted, so each field's rules are adjacent */
+        for (first = 0; !found && first < conf->conf_nsealchecks;
+             first = last)
         {
-            int          hfnum = 0;
-            char        *hfname = NULL;
-            char        *hfmatch;
-            regex_t      re;
-            json_t      *json;
-            const char  *str;
-            json_error_t json_err;
-
-            strlcpy(buf, node->value, sizeof buf);
-            hfmatch = strchr(buf, ':');
-            if (hfmatch != NULL)
-            {
-                hfname = buf;
-                *hfmatch++ = '\0';
-            }
+            group = &conf->conf_sealchecks[first];
 
-            if (hfmatch != NULL)
+            for (last = first + 1;
+                 last < conf->conf_nsealchecks &&
+                 strcasecmp(conf->conf_sealchecks[last].sc_hdr,
+                            group->sc_hdr) == 0;
+                 last++)
             {
-                restatus = regcomp(&re, hfmatch, 0);
-            }
-
-            if (hfname == NULL || hfmatch == NULL || restatus != 0)
-            {
-                if (conf->conf_dolog)
-                {
-                    syslog(LOG_ERR, "%s: invalid seal header check \"%s\"",
-                           afc->mctx_jobid, node->value);
-                }
+                continue;
             }
 
-            for (hfnum = 0; !found; hfnum++)
+            for (hdr = arcf_findheader(afc, group->sc_hdr, 0);
+                 !found && hdr != NULL;
+                 hdr = arcf_nextheader(hdr, group->sc_hdr))
             {
-                hdr = arcf_findheader(afc, hfname, hfnum);
-                if (hdr == NULL)
-                {
-                    break;
-                }
-
-                json = json_loads(hdr->hdr_val, 0, &json_err);
-                if (json != NULL)
-                {
-                    if (json_is_string(json))
-                    {
-                        str = json_string_value(json);
-                        if (regexec(&re, str, 0, NULL, 0) == 0)
-                        {
-                            found = true;
-                            break;
-                        }
-                    }
-                    else if (json_is_array(json))
-                    {
-                        size_t  jn;
-                        json_t *entry;
-
-                        for (jn = 0; !found && jn < json_array_size(json); jn++)
-                        {
-                            entry = json_array_get(json, jn);
-
-                            if (json_is_string(entry))
-                            {
-                                str = json_string_value(entry);
-
-                                if (regexec(&re, str, 0, NULL, 0) == 0)
-                                {
-                                    found = true;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-
-                    json_decref(json);
-                }
-                else if (regexec(&re, hdr->hdr_val, 0, NULL, 0) == 0)
-                {
-                    found = true;
-                    break;
-                }
+                found = arcf_sealchk_value(group, last - first,
+                                           hdr->hdr_val);
             }
-
-            regfree(&re);
         }
 
         if (!found)
@@ -3439,91 +3555,28 @@ mlfi_eoh(SMFICTX *ctx)
                        afc->mctx_jobid);
             }
 
+            arc_free(afc->mctx_arcmsg);
+            afc->mctx_arcmsg = NULL;
+
             return conf->conf_ret_disabled;
         }
     }
 #endif /* USE_JANSSON */
 
-    /* run the header fields */
-    mode = conf->conf_mode;
-    if (mode == 0)
-    {
-        mode = cc->cctx_mode;
-    }
-    afc->mctx_arcmsg = arc_message(conf->conf_libopenarc, conf->conf_canonhdr,
-                                   conf->conf_canonbody, conf->conf_signalg,
-                                   mode, &err);
-    if (afc->mctx_arcmsg == NULL)
+    /* report any header field libopenarc refused */
+    if (afc->mctx_hdrstatus != ARC_STAT_OK)
     {
         if (conf->conf_dolog)
         {
-            syslog(LOG_INFO, "%s: can't initialize ARC handle: %s",
-                   afc->mctx_jobid, err);
-        }
-
-        return conf->conf_ret_unable;
-    }
-
-    for (hdr = afc->mctx_hqhead; hdr != NULL; hdr = hdr->hdr_next)
-    {
-        if (afc->mctx_tmpstr == NULL)
-        {
-            afc->mctx_tmpstr = arc_dstring_new(BUFRSZ, 0, NULL, NULL);
-            if (afc->mctx_tmpstr == NULL)
-            {
-                if (conf->conf_dolog)
-                {
-                    syslog(LOG_ERR, "%s: arc_dstring_new() failed",
-                           afc->mctx_jobid);
-                }
-
-                return conf->conf_ret_unable;
-            }
-        }
-        else
-        {
-            arc_dstring_blank(afc->mctx_tmpstr);
-        }
-
-        arc_dstring_copy(afc->mctx_tmpstr, hdr->hdr_hdr);
-        arc_dstring_cat1(afc->mctx_tmpstr, ':');
-        if (!cc->cctx_noleadspc)
-        {
-            arc_dstring_cat1(afc->mctx_tmpstr, ' ');
-        }
-
-        last = '\0';
-
-        /* do milter-ized continuation conversion */
-        for (p = hdr->hdr_val; *p != '\0'; p++)
-        {
-            if (*p == '\n' && last != '\r')
-            {
-                arc_dstring_cat1(afc->mctx_tmpstr, '\r');
-            }
-
-            arc_dstring_cat1(afc->mctx_tmpstr, *p);
-
-            last = *p;
+            syslog(LOG_INFO, "%s: error processing header field \"%s\"",
+                   afc->mctx_jobid, afc->mctx_hdrerr->hdr_hdr);
         }
 
-        status = arc_header_field(afc->mctx_arcmsg,
-                                  arc_dstring_get(afc->mctx_tmpstr),
-                                  arc_dstring_len(afc->mctx_tmpstr));
-        if (status != ARC_STAT_OK)
+        if (afc->mctx_hdrstatus == ARC_STAT_SYNTAX)
         {
-            if (conf->conf_dolog)
-            {
-                syslog(LOG_INFO, "%s: error processing header field \"%s\"",
-                       afc->mctx_jobid, hdr->hdr_hdr);
-            }
-
-            if (status == ARC_STAT_SYNTAX)
-            {
-                return conf->conf_ret_unwilling;
-            }
-            return conf->conf_ret_unable;
+            return conf->conf_ret_unwilling;
         }
+        return conf->conf_ret_unable;
     }
 
     /* signal end of headers to libopenarc */
@@ -3539,6 +3592,18 @@ mlfi_eoh(SMFICTX *ctx)
         /* record a bad chain here, and short-circuit crypto */
         arc_set_cv(afc->mctx_arcmsg, ARC_CHAIN_FAIL);
     }
+    else if (conf->conf_earlyseal && conf->conf_dolog &&
+             arc_chain_early_status(afc->mctx_arcmsg) == ARC_CHAIN_FAIL)
+    {
+        /*
+        **  Only logged.  libopenarc has already stopped hashing the body
+        **  for this chain, mlfi_body() asks for a skip if nothing else
+        **  needs it, and the failure is reported at end of message.
+        */
+
+        syslog(LOG_INFO, "%s: ARC chain failed at end of header",
+               afc->mctx_jobid);
+    }
 
     return SMFIS_CONTINUE;
 }
@@ -3598,11 +3663,62 @@ mlfi_body(SMFICTX *ctx, unsigned char *bodyp, size_t bodylen)
 
             return conf->conf_ret_unable;
         }
+
+#ifdef SMFIS_SKIP
+        /* ask the MTA to stop sending the body if nothing needs it */
+        if (cc->cctx_milterv2 && !arc_body_needed(afc->mctx_arcmsg))
+        {
+            return SMFIS_SKIP;
+        }
+#endif /* SMFIS_SKIP */
     }
 
     return SMFIS_CONTINUE;
 }
 
+/*
+**  helper function to copy header field text, unfolding any line breaks;
+**  with "collapse", each run of whitespace becomes a single space instead
+*/
+static void
+arcf_cattext(struct arc_dstring *dstr,
+             const char         *str,
+             size_t              len,
+             bool                collapse)
+{
+    const char *end = str + len;
+
+    while (str < end)
+    {
+        const char *p = str;
+
+        while (p < end && *p != '\r' && *p != '\n' &&
+               !(collapse && isascii(*p) && isspace(*p)))
+        {
+            p++;
+        }
+
+        arc_dstring_catn(dstr, str, p - str);
+        if (p == end)
+        {
+            break;
+        }
+
+        if (collapse)
+        {
+            arc_dstring_cat1(dstr, ' ');
+        }
+
+        while (p < end && (*p == '\r' || *p == '\n' ||
+                           (collapse && isascii(*p) && isspace(*p))))
+        {
+            p++;
+        }
+
+        str = p;
+    }
+}
+
 /* helper function to handle overriding the chain state */
 static bool
 reconcile_arc_state(msgctx afc, struct result *r)
@@ -3787,13 +3903,9 @@ mlfi_eom(SMFICTX *ctx)
         arc_dstring_blank(afc->mctx_tmpstr);
 
         /* assemble authentication results */
-        for (int i = 0;; i++)
+        for (hdr = arcf_findheader(afc, AUTHRESULTSHDR, 0); hdr != NULL;
+             hdr = arcf_nextheader(hdr, AUTHRESULTSHDR))
         {
-            hdr = arcf_findheader(afc, AUTHRESULTSHDR, i);
-            if (hdr == NULL)
-            {
-                break;
-            }
             status = ares_parse(hdr->hdr_val, &ar, conf->conf_authservid);
             if (status == -1)
             {
@@ -3809,7 +3921,9 @@ mlfi_eom(SMFICTX *ctx)
 
         for (int i = 0; i < ar.ares_count; i++)
         {
-            if (ar.ares_result[i].result_method == ARES_METHOD_ARC)
+            struct result *r = &ar.ares_result[i];
+
+            if (r->result_method == ARES_METHOD_ARC)
             {
                 if (!conf->conf_overridecv)
                 {
@@ -3817,8 +3931,7 @@ mlfi_eom(SMFICTX *ctx)
                 }
 
                 arfound = true;
-                if (reconcile_arc_state(afc, &ar.ares_result[i]) &&
-                    conf->conf_dolog)
+                if (reconcile_arc_state(afc, r) && conf->conf_dolog)
                 {
                     syslog(
                         LOG_INFO,
@@ -3834,35 +3947,37 @@ mlfi_eom(SMFICTX *ctx)
             }
 
             arc_dstring_printf(afc->mctx_tmpstr, "%s=%s",
-                               ares_getmethod(ar.ares_result[i].result_method),
-                               ares_getresult(ar.ares_result[i].result_result));
+                               ares_getmethod(r->result_method),
+                               ares_getresult(r->result_result));
 
-            if (ar.ares_result[i].result_reason[0] != '\0')
+            /* values are copied as they appeared, quoting included */
+            if (r->result_reason != NULL)
             {
-                arc_dstring_printf(afc->mctx_tmpstr, " reason=\"%s\"",
-                                   ar.ares_result[i].result_reason);
+                arc_dstring_cat(afc->mctx_tmpstr, " reason=");
+                arcf_cattext(afc->mctx_tmpstr, r->result_reason,
+                             r->result_reasonlen, false);
             }
 
-            for (int j = 0; j < ar.ares_result[i].result_props; j++)
+            for (int j = 0; j < r->result_props; j++)
             {
-                if (ar.ares_result[i].result_ptype[j] == ARES_PTYPE_COMMENT)
-                {
-                    arc_dstring_printf(afc->mctx_tmpstr, " %s",
-                                       ar.ares_result[i].result_value[j]);
-                }
-                else
+                struct prop *prop = &ar.ares_prop[r->result_firstprop + j];
+
+                arc_dstring_cat1(afc->mctx_tmpstr, ' ');
+                if (prop->prop_ptype != ARES_PTYPE_COMMENT)
                 {
-                    bool quote = !ares_istoken(
-                        ar.ares_result[i].result_value[j]);
-                    arc_dstring_printf(
-                        afc->mctx_tmpstr, " %s.%s=%s%s%s",
-                        ares_getptype(ar.ares_result[i].result_ptype[j]),
-                        ar.ares_result[i].result_property[j], quote ? "\"" : "",
-                        ar.ares_result[i].result_value[j], quote ? "\"" : "");
+                    arc_dstring_printf(afc->mctx_tmpstr, "%s.%.*s=",
+                                       ares_getptype(prop->prop_ptype),
+                                       (int) prop->prop_propertylen,
+                                       prop->prop_property);
                 }
+                arcf_cattext(afc->mctx_tmpstr, prop->prop_value,
+                             prop->prop_valuelen,
+                             prop->prop_ptype == ARES_PTYPE_COMMENT);
             }
         }
 
+        ares_free(&ar);
+
         if (!arfound)
         {
             if (arc_dstring_len(afc->mctx_tmpstr) > 0)
@@ -3876,12 +3991,12 @@ mlfi_eom(SMFICTX *ctx)
         **  Get the seal fields to apply.
         */
 
-        status = arc_getseal(afc->mctx_arcmsg, &seal, conf->conf_authservid,
-                             conf->conf_selector, conf->conf_domain,
-                             conf->conf_keydata, conf->conf_keylen,
-                             arc_dstring_len(afc->mctx_tmpstr) > 0
-                                 ? arc_dstring_get(afc->mctx_tmpstr)
-                                 : NULL);
+        status = arc_getseal_key(afc->mctx_arcmsg, &seal,
+                                 conf->conf_authservid, conf->conf_selector,
+                                 conf->conf_domain, conf->conf_signkey,
+                                 arc_dstring_len(afc->mctx_tmpstr) > 0
+                                     ? arc_dstring_get(afc->mctx_tmpstr)
+                                     : NULL);
         if (status != ARC_STAT_OK)
         {
             if (conf->conf_dolog)
@@ -4046,16 +4161,10 @@ mlfi_close(SMFICTX *ctx)
     cc = (connctx) arcf_getpriv(ctx);
     if (cc != NULL)
     {
-        pthread_mutex_lock(&conf_lock);
-
-        cc->cctx_config->conf_refcnt--;
-
-        if (cc->cctx_config->conf_refcnt == 0 && cc->cctx_config != curconf)
-        {
-            arcf_config_free(cc->cctx_config);
-        }
+        /* the handle belongs to this configuration's library */
+        arc_free(cc->cctx_arcspare);
 
-        pthread_mutex_unlock(&conf_lock);
+        arcf_config_release(cc->cctx_config);
 
         ARC_FREE(cc);
         arcf_setpriv(ctx, NULL);
@@ -5166,7 +5275,6 @@ main(int argc, char **argv)
     }
 #endif /* OpenSSL < 1.1.0 */
 
-    pthread_mutex_init(&conf_lock, NULL);
     pthread_mutex_init(&pwdb_lock, NULL);
 
     /* perform test mode */
@@ -5201,6 +5309,18 @@ main(int argc, char **argv)
         syslog(LOG_INFO, "%s v%s starting (%s)", ARCF_PRODUCT, VERSION, argstr);
     }
 
+    /*
+    **  If we were restarted, the parent may have been asked to reload
+    **  since it last loaded the configuration, so read it again before
+    **  taking any connections.
+    */
+
+    if (reload)
+    {
+        reload = false;
+        arcf_config_reload();
+    }
+
     /* spawn the SIGUSR1 handler */
     status = pthread_create(&rt, NULL, arcf_reloader, NULL);
     if (status != 0)
@@ -5228,9 +5348,10 @@ main(int argc, char **argv)
                ARCF_PRODUCT, VERSION, status, errno);
     }
 
-    /* tell the reloader thread to die */
+    /* tell the reloader thread to die, and wait for it */
     die = true;
-    (void) raise(SIGUSR1);
+    (void) pthread_kill(rt, SIGUSR1);
+    (void) pthread_join(rt, NULL);
 
     if (!autorestart && pidfile != NULL)
     {
@@ -54,6 +54,7 @@ struct Header
 {
     char          *hdr_hdr;
     char          *hdr_val;
+    char          *hdr_field; /* full field, as given to libopenarc */
     struct Header *hdr_next;
     struct Header *hdr_prev;
 };
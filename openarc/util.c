@@ -148,6 +148,7 @@ arcf_socket_cleanup(char *sockspec)
 {
     int                s;
     char              *colon;
+    char              *path;
     struct sockaddr_un sock;
 
     assert(sockspec != NULL);
@@ -166,7 +167,7 @@ arcf_socket_cleanup(char *sockspec)
     /* find the filename */
     if (colon == NULL)
     {
-        colon = sockspec;
+        path = sockspec;
     }
     else
     {
@@ -174,6 +175,8 @@ arcf_socket_cleanup(char *sockspec)
         {
             return EINVAL;
         }
+
+        path = colon + 1;
     }
 
     /* get a socket */
@@ -189,7 +192,7 @@ arcf_socket_cleanup(char *sockspec)
     sock.sun_len = sizeof sock;
 #endif /* BSD */
     sock.sun_family = PF_UNIX;
-    strlcpy(sock.sun_path, colon + 1, sizeof sock.sun_path);
+    strlcpy(sock.sun_path, path, sizeof sock.sun_path);
 
     /* try to connect */
     if (connect(s, (struct sockaddr *) &sock, (socklen_t) sizeof sock) != 0)
@@ -1,11 +1,14 @@
 #!/usr/bin/env python3
 
+import collections
 import copy
 import json
 import pathlib
 import socket
+import struct
 import subprocess
 import sys
+import threading
 import time
 
 import miltertest
@@ -43,10 +46,31 @@ def private_key(tmp_path_factory, tool_path):
         ]
         subprocess.run(binargs, check=True)
 
+    subprocess.run(
+        [
+            sys.executable,
+            tool_path('contrib/openarc-keygen'),
+            '-D',
+            str(basepath),
+            '-d',
+            'example.com',
+            '-s',
+            'ed25519',
+            '-t',
+            'ed25519',
+            '-f',
+            'testkey',
+        ],
+        check=True,
+    )
+
     basepath.joinpath('unsafe._domainkey.example.com.key').chmod(0o644)
 
     testkeys = ''
-    for s, d in selectors:
+    for s, d in [
+        *selectors,
+        ['ed25519', 'example.com'],
+    ]:
         with open(basepath.joinpath(f'{s}._domainkey.{d}.txt'), 'r') as f:
             testkeys += f.read()
 
@@ -60,6 +84,128 @@ def private_key(tmp_path_factory, tool_path):
     }
 
 
+class DNSResponder:
+    """A minimal nameserver that serves the test keys over UDP and TCP"""
+
+    def __init__(self, keyfile):
+        self.records = {}
+        with open(keyfile, 'r') as f:
+            for line in f:
+                name, txt = line.rstrip('\n').split(' ', 1)
+                self.records[name.lower()] = txt.encode()
+
+        # UDP and TCP on the same port, as the resolver expects
+        while True:
+            self.udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.udp.bind(('127.0.0.1', 0))
+            self.port = self.udp.getsockname()[1]
+            self.tcp = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            try:
+                self.tcp.bind(('127.0.0.1', self.port))
+                break
+            except OSError:
+                self.udp.close()
+                self.tcp.close()
+        self.tcp.listen()
+
+        self.reset()
+
+        threading.Thread(target=self._serve_udp, daemon=True).start()
+        threading.Thread(target=self._serve_tcp, daemon=True).start()
+
+    def reset(self):
+        # queries received, by name
+        self.udp_queries = collections.Counter()
+        self.tcp_queries = collections.Counter()
+        # names to answer over UDP with TC set and nothing else
+        self.truncate = set()
+        # how many UDP queries to ignore, by name
+        self.drop = collections.Counter()
+        self.ttl = 300
+
+    def queries(self, name):
+        return self.udp_queries[name] + self.tcp_queries[name]
+
+    @staticmethod
+    def _name(name):
+        return b''.join(bytes([len(x)]) + x.encode() for x in name.split('.')) + b'\0'
+
+    def _reply(self, query, tcp):
+        qid, flags = struct.unpack('!HH', query[:4])
+        pos = 12
+        labels = []
+        while query[pos]:
+            labels.append(query[pos + 1 : pos + 1 + query[pos]].decode())
+            pos += 1 + query[pos]
+        qtype = struct.unpack('!H', query[pos + 1 : pos + 3])[0]
+        question = query[12 : pos + 5]
+        name = '.'.join(labels).lower()
+
+        if tcp:
+            self.tcp_queries[name] += 1
+        else:
+            self.udp_queries[name] += 1
+            if self.drop[name] > 0:
+                self.drop[name] -= 1
+                return None
+
+        # QR, AA, and RD copied from the query
+        flags = 0x8400 | (flags & 0x0100)
+        answers = []
+        authority = []
+        if not tcp and name in self.truncate:
+            flags |= 0x0200
+        elif name in self.records:
+            if qtype == 16:  # TXT
+                txt = self.records[name]
+                rdata = b''.join(bytes([len(txt[i : i + 255])]) + txt[i : i + 255] for i in range(0, len(txt), 255))
+                answers.append(b'\xc0\x0c' + struct.pack('!HHIH', 16, 1, self.ttl, len(rdata)) + rdata)
+        else:
+            flags |= 3  # NXDOMAIN
+            rdata = self._name('ns.example.com') + self._name('hostmaster.example.com')
+            rdata += struct.pack('!IIIII', 1, 3600, 600, 86400, self.ttl)
+            authority.append(self._name('example.com') + struct.pack('!HHIH', 6, 1, self.ttl, len(rdata)) + rdata)
+
+        return (
+            struct.pack('!HHHHHH', qid, flags, 1, len(answers), len(authority), 0)
+            + question
+            + b''.join(answers)
+            + b''.join(authority)
+        )
+
+    def _serve_udp(self):
+        while True:
+            query, addr = self.udp.recvfrom(65535)
+            reply = self._reply(query, False)
+            if reply is not None:
+                self.udp.sendto(reply, addr)
+
+    def _serve_tcp(self):
+        while True:
+            conn, _ = self.tcp.accept()
+            with conn:
+                data = b''
+                while len(data) < 2 or len(data) < 2 + struct.unpack('!H', data[:2])[0]:
+                    chunk = conn.recv(65535)
+                    if not chunk:
+                        break
+                    data += chunk
+                else:
+                    reply = self._reply(data[2:], True)
+                    conn.sendall(struct.pack('!H', len(reply)) + reply)
+
+
+@pytest.fixture(scope='session')
+def dns_responder(private_key):
+    return DNSResponder(private_key['public_keys'])
+
+
+@pytest.fixture()
+def dns(dns_responder):
+    dns_responder.reset()
+    return dns_responder
+
+
 @pytest.fixture(scope='session')
 def tool_path():
     def _tool_path(tool):
@@ -69,13 +215,14 @@ def tool_path():
 
 
 @pytest.fixture()
-def milter_config(request, tmp_path, private_key):
+def milter_config(request, tmp_path, tool_path, private_key, dns):
     base_path = request.path.parent.joinpath('files')
 
     base_config = {
         'Domain': 'example.com',
         'AuthservID': 'example.com',
         'TestKeys': private_key['public_keys'],
+        'Nameservers': f'127.0.0.1:{dns.port}',
         'Selector': 'elpmaxe',
         'KeyFile': 'elpmaxe._domainkey.example.com.key',
         'Mode': 'sv',
@@ -109,7 +256,13 @@ def milter_config(request, tmp_path, private_key):
 
         for static_file in ['PeerList', 'InternalHosts']:
             if c.get(static_file):
-                c[static_file] = base_path.joinpath(c[static_file])
+                fname = base_path.joinpath(c[static_file])
+                if fname.suffix == '.db':
+                    # compile the text list of the same name
+                    dbname = tmp_path.joinpath(f'{i}-{fname.name}')
+                    subprocess.run([tool_path('openarc/openarc-hostdb'), '-o', dbname, fname.with_suffix('')], check=True)
+                    fname = dbname
+                c[static_file] = fname
 
         fname = tmp_path.joinpath(f'milter-{i}.conf')
         with open(fname, 'w') as f:
@@ -157,6 +310,22 @@ def milter(milter_cmdline, milter_config):
         proc.terminate()
 
 
+def _recv_exact(sock, length):
+    data = b''
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if not chunk:
+            raise miltertest.MilterError('connection closed')
+        data += chunk
+    return data
+
+
+def _recv_reply(sock):
+    """Read one reply packet from the milter"""
+    length = struct.unpack('!I', _recv_exact(sock, 4))[0]
+    return _recv_exact(sock, length)
+
+
 @pytest.fixture
 def run_miltertest(request, milter, milter_config):
     def _run_miltertest(
@@ -165,6 +334,9 @@ def run_miltertest(request, milter, milter_config):
         body='test body\r\n',
         protocol=miltertest.SMFI_V6_PROT,
         milter_instance=0,
+        conn=None,
+        hostname='localhost',
+        address='127.0.0.1',
     ):
         headers = copy.copy(headers) or []
         if standard_headers:
@@ -176,13 +348,16 @@ def run_miltertest(request, milter, milter_config):
                 ]
             )
 
-        # Connect
-        sock = socket.socket(family=socket.AF_UNIX)
-        sock.connect(bytes(milter_config[milter_instance]['sock']))
-        conn = miltertest.MilterConnection(sock)
-        conn.optneg_mta(protocol=protocol)
-        conn.send(miltertest.SMFIC_CONNECT, hostname='localhost', address='127.0.0.1', family=miltertest.SMFIA_INET, port=666)
-        conn.send(miltertest.SMFIC_HELO, helo='mx.example.com')
+        # Connect, unless this is another message on an existing connection
+        if conn is None:
+            sock = socket.socket(family=socket.AF_UNIX)
+            sock.connect(bytes(milter_config[milter_instance]['sock']))
+            conn = miltertest.MilterConnection(sock)
+            conn.optneg_mta(protocol=protocol)
+            family = miltertest.SMFIA_INET6 if ':' in address else miltertest.SMFIA_INET
+            conn.send(miltertest.SMFIC_CONNECT, hostname=hostname, address=address, family=family, port=666)
+            conn.send(miltertest.SMFIC_HELO, helo='mx.example.com')
+        sock = conn.sock
 
         # Envelope data
         conn.send(miltertest.SMFIC_MAIL, args=['<sender@example.com>'])
@@ -193,8 +368,18 @@ def run_miltertest(request, milter, milter_config):
         conn.send_headers(headers)
         conn.send(miltertest.SMFIC_EOH)
 
-        # Send body
-        conn.send_body(body)
+        # Send body, stopping if the milter asks to skip the rest of it
+        skipped = False
+        body_bytes = body.encode()
+        for i in range(0, len(body_bytes), 65535):
+            chunk = body_bytes[i : i + 65535]
+            sock.sendall(struct.pack('!IB', len(chunk) + 1, ord('B')) + chunk)
+            reply = _recv_reply(sock)
+            if reply[0:1] == b's':
+                skipped = True
+                break
+            assert reply[0:1] == b'c'
+
         resp = conn.send_eom()
         ins_headers = []
         for msg in resp:
@@ -214,6 +399,8 @@ def run_miltertest(request, milter, milter_config):
             'headers': ins_headers,
             'msg_headers': headers,
             'msg_body': body,
+            'body_skipped': skipped,
+            'conn': conn,
         }
 
     return _run_miltertest
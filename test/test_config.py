@@ -27,3 +27,10 @@ def test_config_requiresafekeys_false(milter_config, milter_cmdline):
     """World-readable keys are okay if the user said they're okay."""
     res = subprocess.run(milter_cmdline(milter_config[0], ['-n']), capture_output=True, text=True, timeout=4)
     assert res.returncode == 0
+
+
+def test_config_badkey(milter_config, milter_cmdline):
+    """A key file that can't be decoded should be rejected at startup"""
+    res = subprocess.run(milter_cmdline(milter_config[0], ['-n']), capture_output=True, text=True, timeout=4)
+    assert res.returncode != 0
+    assert "can't load key" in res.stderr
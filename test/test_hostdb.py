@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+
+import subprocess
+
+import pytest
+
+
+@pytest.fixture(params=['text', 'compiled'])
+def hostlist(request, tmp_path, tool_path):
+    listfile = request.path.parent.joinpath('files', 'hostlist')
+    if request.param == 'text':
+        return listfile
+
+    dbfile = tmp_path.joinpath('hostlist.db')
+    subprocess.run([tool_path('openarc/openarc-hostdb'), '-o', dbfile, listfile], check=True)
+    return dbfile
+
+
+def test_hostdb_default_output(tmp_path, tool_path):
+    """Without -o the compiled list is written next to the text one"""
+    listfile = tmp_path.joinpath('hostlist')
+    listfile.write_text('mx.example.com\n')
+    subprocess.run([tool_path('openarc/openarc-hostdb'), listfile], check=True)
+    assert tmp_path.joinpath('hostlist.db').exists()
+    assert not [x for x in tmp_path.iterdir() if x.name.startswith('hostlist.db.')]
+
+
+@pytest.mark.parametrize(
+    'host,match',
+    [
+        # host names
+        ('mx.example.com', True),
+        ('MX.example.com', False),
+        ('other.example.com', False),
+        ('example.com', False),
+        # domain suffixes
+        ('a.example.net', True),
+        ('b.a.example.net', True),
+        ('example.net', False),
+        # negated host names
+        ('bad.example.net', False),
+        ('x.bad.example.net', True),
+        # IPv4 addresses and networks
+        ('192.0.2.1', True),
+        ('192.0.2.2', False),
+        ('198.51.100.1', True),
+        ('198.51.100.127', True),
+        ('198.51.101.1', False),
+        # negated IPv4 networks
+        ('198.51.100.128', False),
+        ('198.51.100.200', True),
+        # IPv6 addresses and networks
+        ('2001:db8::1', True),
+        ('2001:db8::2', False),
+        ('2001:db8:1::1', True),
+        ('2001:db8:1:3::1', True),
+        ('2001:db8:2::1', False),
+        ('::ffff:192.0.2.1', False),
+        # negated IPv6 networks
+        ('2001:db8:1:2::1', False),
+        ('2001:db8:1:2::5', True),
+    ],
+)
+def test_hostdb_match(tool_path, hostlist, host, match):
+    """Text and compiled host lists match the same hosts"""
+    res = subprocess.run(
+        [
+            tool_path('openarc/openarc-hostdb'),
+            '-t',
+            hostlist,
+            host,
+        ],
+        capture_output=True,
+        text=True,
+    )
+
+    assert res.stdout == f'{host}: {"match" if match else "no match"}\n'
+    assert res.returncode == (0 if match else 1)
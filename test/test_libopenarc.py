@@ -0,0 +1,16 @@
+#!/usr/bin/env python3
+
+import subprocess
+
+
+def test_libopenarc_allocator(tool_path):
+    """Message memory comes from arc_set_allocator() and is all given back"""
+    res = subprocess.run([tool_path('libopenarc/alloc-test')], capture_output=True, text=True, check=True, timeout=10)
+    out = dict(x.rsplit(' ', 1) for x in res.stdout.splitlines())
+
+    # the handle was reset between messages, and both got results
+    assert out['first message'] == 'fail'
+    assert out['second message'] == 'none'
+    assert int(out['allocations']) > 0
+    assert out['frees'] == out['allocations']
+    assert out['outstanding'] == '0'
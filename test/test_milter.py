@@ -1,5 +1,10 @@
 #!/usr/bin/env python3
 
+import os
+import pathlib
+import signal
+import time
+
 import miltertest
 import pytest
 
@@ -298,6 +303,14 @@ def test_milter_mode_none_sign(run_miltertest):
             ['example.com; auth=pass smtp.auth="花木蘭\\"\\\\ []"'],
             'auth=pass smtp.auth="花木蘭\\"\\\\ []";\n\tarc=none smtp.remote-ip=127.0.0.1',
         ],
+        # quoted authserv-id
+        [
+            [
+                '"example.com"; spf=pass',
+                '"example.com" 1; dmarc=pass',
+            ],
+            'spf=pass;\n\tdmarc=pass;\n\tarc=none smtp.remote-ip=127.0.0.1',
+        ],
         # version
         [
             [
@@ -395,6 +408,67 @@ def test_milter_seal_failed(run_miltertest):
     assert res1['headers'] == res2['headers']
 
 
+def test_milter_connection_reuse(run_miltertest):
+    """Several messages on one connection each get their own result"""
+    res = run_miltertest()
+    # leave out the A-R field, so it can't override the result
+    headers = res['headers'][1:]
+
+    # a chain that fails, because the body changed
+    res = run_miltertest(headers, body='changed body\r\n')
+    assert res['headers'][0] == ['Authentication-Results', ' example.com; arc=fail smtp.remote-ip=127.0.0.1']
+    assert 'cv=fail' in res['headers'][1][1]
+
+    # a chain that passes
+    res = run_miltertest(headers, conn=res['conn'])
+    assert res['headers'][0] == ['Authentication-Results', ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1']
+    assert res['headers'][1][1].startswith(' i=2;')
+    assert 'cv=pass' in res['headers'][1][1]
+
+    # no chain at all
+    res = run_miltertest(conn=res['conn'])
+    assert res['headers'][0] == ['Authentication-Results', ' example.com; arc=none smtp.remote-ip=127.0.0.1']
+    assert 'cv=none' in res['headers'][1][1]
+    assert res['headers'][1:] == headers
+
+
+def test_milter_earlysealverification(run_miltertest):
+    """EarlySealVerification gives the same results as verifying at EOM"""
+    res = run_miltertest()
+
+    headers = [*res['headers']]
+    res = run_miltertest(headers)
+    assert 'cv=pass' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+
+    # break the seal
+    headers[1][1] = headers[1][1].replace('b=', 'b=A', 1)
+    res = run_miltertest(headers)
+    assert 'cv=fail' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+
+
+def test_milter_cryptothreads(run_miltertest):
+    """CryptoThreads gives the same results as verifying on the milter thread"""
+    headers = []
+    for i in range(3):
+        res = run_miltertest(headers)
+        headers = [x for x in res['headers'] + headers if x[0] != 'Authentication-Results']
+
+    res = run_miltertest(headers)
+    assert 'cv=pass' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+
+    # break the oldest seal
+    for h in headers:
+        if h[0] == 'ARC-Seal' and ' i=1;' in h[1]:
+            h[1] = h[1].replace('b=', 'b=A', 1)
+
+    res = run_miltertest(headers)
+    assert 'cv=fail' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+
+
 def test_milter_duplicate_header(run_miltertest):
     """A set consists of exactly three headers with a given instance value"""
     res = run_miltertest()
@@ -406,6 +480,32 @@ def test_milter_duplicate_header(run_miltertest):
     assert 'cv=fail' in res['headers'][1][1]
 
 
+def test_milter_malformed_chain(run_miltertest):
+    """Chains that can't pass fail whatever their signatures say"""
+    res = run_miltertest()
+
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    # a wrong cv= is a hard failure, so the chain isn't sealed
+    broken = [[x[0], x[1]] for x in headers]
+    broken[0][1] = broken[0][1].replace('cv=none', 'cv=pass', 1)
+    res = run_miltertest(broken)
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=fail smtp.remote-ip=127.0.0.1']]
+
+    for idx, old, new in [
+        (0, 'a=rsa-sha256', 'a=rsa-sha512'),
+        (1, 'a=rsa-sha256', 'a=rsa-sha512'),
+        (1, 'c=relaxed/simple', 'c=relaxed/bogus'),
+    ]:
+        broken = [[x[0], x[1]] for x in headers]
+        assert old in broken[idx][1]
+        broken[idx][1] = broken[idx][1].replace(old, new, 1)
+
+        res = run_miltertest(broken)
+        assert 'cv=fail' in res['headers'][1][1]
+        assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+
+
 def test_milter_idna(run_miltertest):
     """U-labels in domains and selectors"""
     res = run_miltertest(
@@ -441,6 +541,27 @@ def test_milter_oldest_pass(run_miltertest):
     assert res['headers'][3] == ['ARC-Authentication-Results', ' i=3; example.com; arc=pass header.oldest-pass=2 smtp.remote-ip=127.0.0.1']
 
 
+def test_milter_maximumverifybits(run_miltertest):
+    """MaximumVerifyBits caps the key work spent on one message"""
+    headers = []
+    for i in range(3):
+        res = run_miltertest(headers)
+        headers = [x for x in res['headers'] + headers if x[0] != 'Authentication-Results']
+
+    # the seals and the newest AMS fit in the limit, the older AMSs don't, so
+    # there's no telling which of them would pass
+    res = run_miltertest(headers)
+    assert 'cv=pass' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=pass smtp.remote-ip=127.0.0.1'
+    assert 'oldest-pass' not in res['headers'][3][1]
+
+    # one more set and the newest AMS doesn't either
+    headers = [x for x in res['headers'] + headers if x[0] != 'Authentication-Results']
+    res = run_miltertest(headers)
+    assert 'cv=fail' in res['headers'][1][1]
+    assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+
+
 def test_milter_authresip(run_miltertest):
     """AuthResIP false disables smtp.remote-ip"""
     res = run_miltertest()
@@ -478,12 +599,78 @@ def test_milter_minimum_key_bits_fail(run_miltertest):
     assert 'cv=fail' in res['headers'][0][1]
 
 
+def test_milter_ed25519(run_miltertest):
+    """Sign with Ed25519 and then verify it"""
+    res = run_miltertest()
+    assert 'a=ed25519-sha256' in res['headers'][1][1]
+    assert 'a=ed25519-sha256' in res['headers'][2][1]
+
+    res = run_miltertest(res['headers'])
+    assert 'cv=pass' in res['headers'][1][1]
+    assert res['headers'][0] == ['Authentication-Results', ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1']
+
+
 def test_milter_peerlist(run_miltertest):
     """Connections from peers just get `accept` back immediately"""
     with pytest.raises(miltertest.MilterError, match='unexpected response: a'):
         run_miltertest()
 
 
+@pytest.mark.parametrize(
+    'hostname,address,peer',
+    [
+        # host names; the filter lowercases the name before checking it
+        ('mx.example.com', '203.0.113.1', True),
+        ('MX.example.com', '203.0.113.1', True),
+        ('other.example.com', '203.0.113.1', False),
+        # domain suffixes
+        ('a.example.net', '203.0.113.1', True),
+        ('example.net', '203.0.113.1', False),
+        # negated host names
+        ('bad.example.net', '203.0.113.1', False),
+        ('x.bad.example.net', '203.0.113.1', True),
+        # IPv4 addresses and networks
+        ('[192.0.2.1]', '192.0.2.1', True),
+        ('[192.0.2.2]', '192.0.2.2', False),
+        ('[198.51.100.1]', '198.51.100.1', True),
+        # negated IPv4 networks
+        ('[198.51.100.128]', '198.51.100.128', False),
+        ('[198.51.100.200]', '198.51.100.200', True),
+        # IPv6 addresses and networks
+        ('[2001:db8::1]', '2001:db8::1', True),
+        ('[2001:db8::2]', '2001:db8::2', False),
+        ('[2001:db8:1:3::1]', '2001:db8:1:3::1', True),
+        # negated IPv6 networks
+        ('[2001:db8:1:2::1]', '2001:db8:1:2::1', False),
+        ('[2001:db8:1:2::5]', '2001:db8:1:2::5', True),
+    ],
+)
+def test_milter_peerlist_hostlist(run_miltertest, hostname, address, peer):
+    """The most specific PeerList entry decides, and negation wins a tie"""
+    if peer:
+        with pytest.raises(miltertest.MilterError, match='unexpected response: a'):
+            run_miltertest(hostname=hostname, address=address)
+    else:
+        res = run_miltertest(hostname=hostname, address=address)
+        assert res['headers'][0][0] == 'Authentication-Results'
+
+
+def test_milter_peerlist_compiled(run_miltertest):
+    """A compiled PeerList works the same as a text one"""
+    with pytest.raises(miltertest.MilterError, match='unexpected response: a'):
+        run_miltertest()
+
+
+def test_milter_internalhosts_compiled(run_miltertest):
+    """A compiled InternalHosts selects the mode like a text one"""
+    res = run_miltertest()
+    assert len(res['headers']) == 3
+    assert 'cv=none' in res['headers'][0][1]
+
+    res = run_miltertest(milter_instance=1)
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=none smtp.remote-ip=127.0.0.1']]
+
+
 def test_milter_responsedisabled(run_miltertest):
     """Configured to reject messages from peers"""
     with pytest.raises(miltertest.MilterError, match='unexpected response: r'):
@@ -515,3 +702,184 @@ def test_milter_softwareheader(run_miltertest):
 
     assert res['headers'][0][0] == 'ARC-Filter'
     assert res['headers'][0][1].startswith(' OpenARC Filter v')
+
+
+def test_milter_dns(run_miltertest, dns):
+    """Keys are looked up in DNS"""
+    res = run_miltertest()
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.udp_queries == {'elpmaxe._domainkey.example.com': 1}
+    assert not dns.tcp_queries
+
+
+def test_milter_dns_truncated(run_miltertest, dns):
+    """A truncated UDP reply is retried over TCP"""
+    res = run_miltertest()
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    dns.truncate.add('elpmaxe._domainkey.example.com')
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.udp_queries == {'elpmaxe._domainkey.example.com': 1}
+    assert dns.tcp_queries == {'elpmaxe._domainkey.example.com': 1}
+
+
+def test_milter_dns_retry(run_miltertest, dns):
+    """An unanswered query is sent again once it times out"""
+    res = run_miltertest()
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    dns.drop['elpmaxe._domainkey.example.com'] = 1
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.udp_queries == {'elpmaxe._domainkey.example.com': 2}
+
+
+def test_milter_dns_nxdomain(run_miltertest, dns):
+    """A missing key fails the chain without being asked for again"""
+    res = run_miltertest(milter_instance=1)
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+    assert dns.udp_queries == {'nokey._domainkey.example.com': 1}
+
+
+def test_milter_keycache(run_miltertest, dns):
+    """A cached key is not looked up again"""
+    res = run_miltertest()
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    for i in range(2):
+        res = run_miltertest(headers)
+        assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.queries('elpmaxe._domainkey.example.com') == 1
+
+
+def test_milter_keycache_negative(run_miltertest, dns):
+    """A missing key is cached too"""
+    res = run_miltertest(milter_instance=1)
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    for i in range(2):
+        res = run_miltertest(headers)
+        assert res['headers'][0][1] == ' example.com; arc=fail smtp.remote-ip=127.0.0.1'
+    assert dns.queries('nokey._domainkey.example.com') == 1
+
+
+def test_milter_keycache_ttl(run_miltertest, dns):
+    """Cached keys expire"""
+    res = run_miltertest()
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    res = run_miltertest(headers)
+    assert dns.queries('elpmaxe._domainkey.example.com') == 1
+
+    time.sleep(2)
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.queries('elpmaxe._domainkey.example.com') == 2
+
+
+def test_milter_prefetch(run_miltertest, dns):
+    """Each key in a chain is looked up once, however many sets use it"""
+    headers = []
+    for i in [0, 1, 0, 0]:
+        res = run_miltertest(headers, milter_instance=i)
+        headers = [x for x in res['headers'] + headers if x[0] != 'Authentication-Results']
+
+    dns.reset()
+    res = run_miltertest(headers)
+    assert res['headers'][0][1] == ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1'
+    assert dns.udp_queries == {
+        'elpmaxe._domainkey.example.com': 1,
+        'dkimpy._domainkey.example.com': 1,
+    }
+
+
+def test_milter_skip_body(run_miltertest):
+    """The MTA is asked to skip a body that can't change the result"""
+    # nothing to verify
+    res = run_miltertest()
+    assert res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=none smtp.remote-ip=127.0.0.1']]
+
+    # the same without SKIP
+    res = run_miltertest(protocol=miltertest.SMFI_V2_PROT)
+    assert not res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', 'example.com; arc=none smtp.remote-ip=127.0.0.1']]
+
+    # a chain that has already failed, because its set is incomplete
+    res = run_miltertest(milter_instance=1)
+    headers = [x for x in res['headers'] if x[0] not in ['Authentication-Results', 'ARC-Message-Signature']]
+
+    res = run_miltertest(headers)
+    assert res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=fail smtp.remote-ip=127.0.0.1']]
+
+    res = run_miltertest(headers, protocol=miltertest.SMFI_V2_PROT)
+    assert not res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', 'example.com; arc=fail smtp.remote-ip=127.0.0.1']]
+
+
+def test_milter_skip_body_needed(run_miltertest):
+    """The body is still hashed when the chain needs it"""
+    res = run_miltertest(milter_instance=1)
+    headers = [x for x in res['headers'] if x[0] != 'Authentication-Results']
+
+    res = run_miltertest(headers)
+    assert not res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=pass header.oldest-pass=0 smtp.remote-ip=127.0.0.1']]
+
+    res = run_miltertest(headers, body='different test body\r\n')
+    assert not res['body_skipped']
+    assert res['headers'] == [['Authentication-Results', ' example.com; arc=fail smtp.remote-ip=127.0.0.1']]
+
+
+def _reload_authservid(run_miltertest, milter, milter_config, authservid):
+    lines = [x for x in milter_config[0]['file'].read_text().splitlines() if not x.startswith('AuthservID ')]
+    lines.append(f'AuthservID {authservid}')
+    milter_config[0]['file'].write_text('\n'.join(lines) + '\n')
+
+    milter[0].send_signal(signal.SIGUSR1)
+
+    # the reload happens in the background
+    for i in range(50):
+        res = run_miltertest()
+        if res['headers'][0][1].startswith(f' {authservid};'):
+            break
+        time.sleep(0.1)
+    assert res['headers'][0][1].startswith(f' {authservid};')
+
+
+def test_milter_reload(run_miltertest, milter, milter_config):
+    """SIGUSR1 rereads the configuration file"""
+    res = run_miltertest()
+    assert res['headers'][0][1].startswith(' example.com;')
+
+    _reload_authservid(run_miltertest, milter, milter_config, 'reloaded.example.com')
+
+
+def test_milter_reload_restart(run_miltertest, milter, milter_config):
+    """A restarted filter keeps what was reloaded before it died"""
+    _reload_authservid(run_miltertest, milter, milter_config, 'reloaded.example.com')
+
+    pid = milter[0].pid
+    children = pathlib.Path(f'/proc/{pid}/task/{pid}/children')
+    child = children.read_text().split()
+    os.kill(int(child[0]), signal.SIGKILL)
+
+    # wait for the replacement to start listening
+    res = None
+    for i in range(50):
+        if children.read_text().split() not in ([], child):
+            try:
+                res = run_miltertest()
+                break
+            except (ConnectionRefusedError, FileNotFoundError):
+                pass
+        time.sleep(0.1)
+    assert res['headers'][0][1].startswith(' reloaded.example.com;')
@@ -64,3 +64,33 @@ arc_name_to_code(struct nametable *table, const char *name)
 
     return table->nt_code;
 }
+
+/**
+ *  Translate a name that isn't NUL-terminated to its code.
+ *
+ *  Parameters:
+ *      table: name table
+ *      name: name to translate
+ *      len: length of the name
+ *
+ *  Returns:
+ *      A code matching the provided name, or the default defined in
+ *      the table if not found.
+ */
+int
+arc_namen_to_code(struct nametable *table, const char *name, size_t len)
+{
+    assert(table != NULL);
+
+    while (table->nt_name != NULL)
+    {
+        if (strncasecmp(table->nt_name, name, len) == 0 &&
+            table->nt_name[len] == '\0')
+        {
+            return table->nt_code;
+        }
+        table++;
+    }
+
+    return table->nt_code;
+}
@@ -6,6 +6,8 @@
 #ifndef ARC_ARC_NAMETABLE_H
 #define ARC_ARC_NAMETABLE_H
 
+#include <sys/types.h>
+
 struct nametable
 {
     const char *nt_name;
@@ -14,5 +16,6 @@ struct nametable
 
 extern const char *arc_code_to_name(struct nametable *, int);
 extern int         arc_name_to_code(struct nametable *, const char *);
+extern int         arc_namen_to_code(struct nametable *, const char *, size_t);
 
 #endif /* ARC_ARC_NAMETABLE_H */